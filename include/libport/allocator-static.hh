@@ -36,6 +36,10 @@
 #  include <libport/pthread.h>
 # endif
 # include <libport/instrument.hh>
+# include <libport/lockable.hh>
+
+// smallest header for thread_specific_ptr
+# include <boost/thread/tss.hpp>
 
 namespace libport
 {
@@ -68,6 +72,86 @@ namespace libport
     static pthread_t thread;
 # endif
 
+# ifndef NVALGRIND
+    // This is necessary to identify the pool in Valgrind.
+    static int* initialize_pool();
+    static int* pool_header;
+# endif
+  };
+
+  /// Thread-safe counterpart of StaticallyAllocated.
+  ///
+  /// Objects may be allocated and released from any thread.  Each thread
+  /// keeps a small magazine of up to \p Magazine free slots which serves
+  /// most allocations and deletions without any synchronization.  When
+  /// a magazine runs empty it is refilled from a global depot of free
+  /// slots, and when it is full half of it is sent back to the depot;
+  /// only these exchanges take the depot lock.
+  template <typename Exact, size_t Chunk, size_t Magazine = 64>
+  class ThreadSafeStaticallyAllocated
+  {
+  public:
+    void* operator new(size_t);
+    void operator delete(void* obj);
+
+    /// Give the free slots cached by the current thread back to the
+    /// depot.
+    static void flush();
+
+    /// Release to the system the chunks whose slots are all free in the
+    /// depot, and return the number of bytes released.  Slots cached in
+    /// the magazines of other threads keep their chunk alive; flush() the
+    /// calling thread first if needed.
+    static size_t trim();
+
+  private:
+    /// Free slots owned by one thread.
+    struct magazine_type
+    {
+      magazine_type();
+      size_t size;
+      void* slots[Magazine];
+    };
+
+    /// A block of memory obtained from malloc.
+    struct chunk_type
+    {
+      char* base;
+      size_t size;
+      bool operator<(const chunk_type& other) const;
+    };
+
+    /// State shared by all the threads.  It is never destroyed, so that
+    /// objects can still be released while static destructors run.
+    struct shared_type
+    {
+      shared_type();
+      /// Protects the depot and the chunk list.
+      Lockable lock;
+      /// Free slots shared by all threads.
+      std::vector<void*> depot;
+      /// Allocated chunks, sorted by address.
+      std::vector<chunk_type> chunks;
+      /// Number of slots in all the chunks.
+      size_t storage_size;
+      /// Current chunk size to allocate.
+      size_t chunk_size;
+      /// Per-thread cache of free slots.
+      boost::thread_specific_ptr<magazine_type> magazine;
+    };
+
+    static shared_type& shared();
+    /// The magazine of the current thread, created on demand.
+    static magazine_type& magazine_get(shared_type& s);
+    /// Give the content of a dying thread's magazine back to the depot.
+    static void magazine_release(magazine_type* m);
+    /// Move up to \a n slots from the depot into \a m.  Lock held.
+    static void refill(shared_type& s, magazine_type& m, size_t n);
+    /// Move \a n slots from \a m to the depot.  Lock held.
+    static void unload(shared_type& s, magazine_type& m, size_t n);
+    /// Increase the depot by chunk_size slots.  Lock held.
+    static void _grow(shared_type& s);
+
 # ifndef NVALGRIND
     // This is necessary to identify the pool in Valgrind.
     static int* initialize_pool();
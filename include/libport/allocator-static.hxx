@@ -133,6 +133,229 @@ namespace libport
   template <typename Exact, size_t Chunk>
   int* StaticallyAllocated<Exact, Chunk>::pool_header = initialize_pool();
 # endif
+
+
+  /*--------------------------------.
+  | ThreadSafeStaticallyAllocated.  |
+  `--------------------------------*/
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::
+  magazine_type::magazine_type()
+    : size(0)
+  {
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  bool
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::
+  chunk_type::operator<(const chunk_type& other) const
+  {
+    return base < other.base;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::
+  shared_type::shared_type()
+    : storage_size(0)
+    , chunk_size(Chunk)
+    , magazine(&ThreadSafeStaticallyAllocated::magazine_release)
+  {
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void*
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::operator new(size_t size)
+  {
+    LIBPORT_USE(size);
+
+    // Allocations exceeds the chunk size.
+    assert_le(size, Exact::allocator_static_max_size);
+
+    shared_type& s = shared();
+    magazine_type& m = magazine_get(s);
+    if (!m.size)
+    {
+      BlockLock lock(s.lock);
+      refill(s, m, (Magazine + 1) / 2);
+    }
+
+    void* res = m.slots[--m.size];
+    POOL_ALLOC(pool_header, res, size);
+    aver(res);
+    return res;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::operator delete(void* obj)
+  {
+    aver(obj != 0);
+    POOL_FREE(pool_header, obj);
+
+    shared_type& s = shared();
+    magazine_type& m = magazine_get(s);
+    if (m.size == Magazine)
+    {
+      BlockLock lock(s.lock);
+      unload(s, m, (Magazine + 1) / 2);
+    }
+    m.slots[m.size++] = obj;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::flush()
+  {
+    shared_type& s = shared();
+    if (magazine_type* m = s.magazine.get())
+    {
+      BlockLock lock(s.lock);
+      unload(s, *m, m->size);
+    }
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  size_t
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::trim()
+  {
+    shared_type& s = shared();
+    BlockLock lock(s.lock);
+
+    // Find the chunk of each free slot, and count the free slots of
+    // each chunk.
+    std::vector<size_t> owner(s.depot.size());
+    std::vector<size_t> free_slots(s.chunks.size(), 0);
+    for (size_t i = 0; i < s.depot.size(); ++i)
+    {
+      chunk_type key = { static_cast<char*>(s.depot[i]), 0 };
+      typename std::vector<chunk_type>::iterator c =
+        std::upper_bound(s.chunks.begin(), s.chunks.end(), key);
+      aver(c != s.chunks.begin());
+      owner[i] = --c - s.chunks.begin();
+      ++free_slots[owner[i]];
+    }
+
+    // Drop the slots of the completely free chunks from the depot.
+    size_t kept = 0;
+    for (size_t i = 0; i < s.depot.size(); ++i)
+      if (free_slots[owner[i]] != s.chunks[owner[i]].size)
+        s.depot[kept++] = s.depot[i];
+    s.depot.resize(kept);
+
+    // Release these chunks.
+    size_t res = 0;
+    kept = 0;
+    for (size_t i = 0; i < s.chunks.size(); ++i)
+      if (free_slots[i] == s.chunks[i].size)
+      {
+        free(s.chunks[i].base);
+        s.storage_size -= s.chunks[i].size;
+        res += s.chunks[i].size * Exact::allocator_static_max_size;
+      }
+      else
+        s.chunks[kept++] = s.chunks[i];
+    s.chunks.resize(kept);
+
+    // Keep doubling the storage when growing again, but start over
+    // from the remaining storage instead of the historical maximum.
+    s.chunk_size = std::max(Chunk, s.storage_size);
+    return res;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  typename ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::shared_type&
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::shared()
+  {
+    static shared_type* res = new shared_type;
+    return *res;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  typename ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::magazine_type&
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::magazine_get
+  (shared_type& s)
+  {
+    magazine_type* res = s.magazine.get();
+    if (!res)
+    {
+      res = new magazine_type;
+      s.magazine.reset(res);
+    }
+    return *res;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::magazine_release
+  (magazine_type* m)
+  {
+    shared_type& s = shared();
+    {
+      BlockLock lock(s.lock);
+      unload(s, *m, m->size);
+    }
+    delete m;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::refill
+  (shared_type& s, magazine_type& m, size_t n)
+  {
+    if (s.depot.empty())
+      _grow(s);
+    n = std::min(n, s.depot.size());
+    aver(m.size + n <= Magazine);
+    for (size_t i = 0; i < n; ++i)
+    {
+      m.slots[m.size++] = s.depot.back();
+      s.depot.pop_back();
+    }
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::unload
+  (shared_type& s, magazine_type& m, size_t n)
+  {
+    aver(n <= m.size);
+    s.depot.insert(s.depot.end(), m.slots + m.size - n, m.slots + m.size);
+    m.size -= n;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  void
+  ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::_grow(shared_type& s)
+  {
+    char* pool = reinterpret_cast<char*>
+      (malloc(s.chunk_size * Exact::allocator_static_max_size));
+    if (!pool)
+      throw std::bad_alloc();
+    chunk_type c = { pool, s.chunk_size };
+    s.chunks.insert(std::upper_bound(s.chunks.begin(), s.chunks.end(), c), c);
+    // Push in reverse order so that the lowest addresses are served
+    // first.
+    s.depot.reserve(s.depot.size() + s.chunk_size);
+    for (size_t i = s.chunk_size; i; --i)
+      s.depot.push_back(pool + (i - 1) * Exact::allocator_static_max_size);
+    s.storage_size += s.chunk_size;
+    s.chunk_size *= 2;
+  }
+
+# ifndef NVALGRIND
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  int* ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::initialize_pool()
+  {
+    int* header = reinterpret_cast<int*>(malloc(sizeof(int)));
+    POOL_CREATE(header, 0, false);
+    return header;
+  }
+
+  template <typename Exact, size_t Chunk, size_t Magazine>
+  int* ThreadSafeStaticallyAllocated<Exact, Chunk, Magazine>::pool_header =
+    initialize_pool();
+# endif
 }
 
 #endif
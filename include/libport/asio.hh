@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -364,6 +364,22 @@ namespace libport
     listen(SocketFactory f, const std::string& host,
            unsigned port, bool udp = false);
 
+    /** Listen for connections from the same host, whose data goes
+     * through shared memory instead of the network stack.
+     *
+     * \param f a socket factory, as for listen().
+     * \param path the Unix socket on which the connections are set
+     *        up.  It must not exist.
+     *
+     * Only available on Linux.
+     */
+    boost::system::error_code
+    listenShm(SocketFactory f, const std::string& path);
+
+    /// Connect to a socket listening with listenShm() on \a path.
+    boost::system::error_code
+    connectShm(const std::string& path);
+
 #if defined LIBPORT_ENABLE_SSL
 
     boost::system::error_code
@@ -519,6 +535,13 @@ namespace libport
   LIBPORT_API void
   makePipe(std::pair<Socket*, Socket*>,
            boost::asio::io_service& io = get_io_service());
+
+  /** Return a pair of sockets connected through shared memory, both
+   *  readable and writable.  Only available on Linux.
+   */
+  LIBPORT_API void
+  makeShmPipe(std::pair<Socket*, Socket*>,
+              boost::asio::io_service& io = get_io_service());
 }
 
 # include "libport/asio.hxx"
@@ -8,6 +8,9 @@
  * See the LICENSE file for more information.
  */
 
+#ifndef LIBPORT_ATOMIC_HH
+# define LIBPORT_ATOMIC_HH
+
 #if defined(_MSC_VER)
 # include <Windows.h>
 # include <Winbase.h>
@@ -41,45 +44,125 @@ namespace libport
     }
 # endif
 #elif defined(__GNUC__)
-    inline long increment_fetch(long* ptr)
+    inline long increment_fetch(volatile long* ptr)
     {
       return __sync_add_and_fetch(ptr, 1);
     }
 
-    inline long decrement_fetch(long* ptr)
+    inline long decrement_fetch(volatile long* ptr)
     {
       return __sync_sub_and_fetch(ptr, 1);
     }
 
-    inline long fetch_increment(long* ptr)
+    inline long fetch_increment(volatile long* ptr)
     {
       return __sync_fetch_and_add(ptr, 1);
     }
 
-    inline long fetch_decrement(long* ptr)
+    inline long fetch_decrement(volatile long* ptr)
     {
       return __sync_fetch_and_sub(ptr, 1);
     }
+
+    /// Store \a desired in \a ptr if it still holds \a expected.
+    /// Return whether the store happened.
+    inline bool compare_and_swap(volatile long* ptr,
+                                 long expected, long desired)
+    {
+      return __sync_bool_compare_and_swap(ptr, expected, desired);
+    }
+
+    /// Full memory barrier.
+    inline void barrier()
+    {
+      __sync_synchronize();
+    }
+
+    /// Read \a ptr, later memory accesses are not moved before.
+    inline long load_acquire(const volatile long* ptr)
+    {
+# if 4 < __GNUC__ || 4 == __GNUC__ && 7 <= __GNUC_MINOR__
+      return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+# else
+      long res = *ptr;
+      __sync_synchronize();
+      return res;
+# endif
+    }
+
+    /// Write \a ptr, earlier memory accesses are not moved after.
+    inline void store_release(volatile long* ptr, long value)
+    {
+# if 4 < __GNUC__ || 4 == __GNUC__ && 7 <= __GNUC_MINOR__
+      __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+# else
+      __sync_synchronize();
+      *ptr = value;
+# endif
+    }
+
+    /// Tell the CPU we are busy waiting.
+    inline void relax()
+    {
+# if defined __i386__ || defined __x86_64__
+      __asm__ __volatile__("pause" ::: "memory");
+# elif defined __aarch64__
+      __asm__ __volatile__("yield" ::: "memory");
+# else
+      __asm__ __volatile__("" ::: "memory");
+# endif
+    }
 #elif defined(_MSC_VER)
-    inline long increment_fetch(long* ptr)
+    inline long increment_fetch(volatile long* ptr)
     {
       return InterlockedIncrement(ptr);
     };
 
-    inline long decrement_fetch(long* ptr)
+    inline long decrement_fetch(volatile long* ptr)
     {
       return InterlockedDecrement(ptr);
     };
 
-    inline long fetch_increment(long* ptr)
+    inline long fetch_increment(volatile long* ptr)
     {
       return increment_fetch(ptr) - 1;
     }
 
-    inline long fetch_decrement(long* ptr)
+    inline long fetch_decrement(volatile long* ptr)
     {
       return decrement_fetch(ptr) + 1;
     }
+
+    inline bool compare_and_swap(volatile long* ptr,
+                                 long expected, long desired)
+    {
+      return InterlockedCompareExchange(ptr, desired, expected) == expected;
+    }
+
+    inline void barrier()
+    {
+      MemoryBarrier();
+    }
+
+    inline long load_acquire(const volatile long* ptr)
+    {
+      long res = *ptr;
+      MemoryBarrier();
+      return res;
+    }
+
+    inline void store_release(volatile long* ptr, long value)
+    {
+      MemoryBarrier();
+      *ptr = value;
+    }
+
+    inline void relax()
+    {
+      YieldProcessor();
+    }
 #endif
   }
 }
+
+#endif // !LIBPORT_ATOMIC_HH
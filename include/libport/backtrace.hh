@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2010, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,6 +11,7 @@
 #ifndef LIBPORT_BACKTRACE_HH
 # define LIBPORT_BACKTRACE_HH
 
+# include <cstddef>
 # include <iosfwd>
 # include <string>
 # include <vector>
@@ -55,6 +56,60 @@ namespace libport
   };
 
   std::ostream& operator<<(std::ostream& o, const Backtrace& b);
+
+
+  /// A stack trace kept as return addresses, symbolized on demand.
+  ///
+  /// Capturing allocates nothing and is async-signal-safe, so it is
+  /// cheap enough to be done eagerly, e.g., when an exception is
+  /// thrown, and the addresses are only turned into strings if the
+  /// trace is printed.  The symbols are cached, so symbolizing the
+  /// same frames again is only a lookup.
+  class LIBPORT_API RawBacktrace
+  {
+  public:
+    /// Maximum number of frames kept: the outermost ones are lost.
+    enum { capacity = 64 };
+
+    /// An empty stack trace.
+    RawBacktrace();
+
+    /// Replace the frames with the current ones.  Async-signal-safe.
+    void capture();
+    void clear();
+
+    bool empty() const;
+    size_t size() const;
+    /// The return addresses, innermost first.
+    void* const* frames() const;
+    void* operator[](size_t i) const;
+
+    /// Store the description of the frames in \a bt.
+    /// \return \a bt.
+    backtrace_type& symbolize(backtrace_type& bt) const;
+    backtrace_type symbolize() const;
+
+    /// Write the addresses on \a fd, one per line.  Async-signal-safe.
+    void dump(int fd) const;
+    /// Write the description of the frames on \a o.
+    std::ostream& dump(std::ostream& o) const;
+
+  private:
+    void* frames_[capacity];
+    size_t size_;
+  };
+
+  std::ostream& operator<<(std::ostream& o, const RawBacktrace& b);
+
+  /// Number of addresses whose symbol is cached.
+  LIBPORT_API size_t backtrace_cache_size();
+  /// Forget the cached symbols, e.g., after unloading libraries.
+  LIBPORT_API void backtrace_cache_clear();
+
+  /// Write \a s on \a fd.  Async-signal-safe.
+  LIBPORT_API void signal_safe_write(int fd, const char* s);
+  /// Write \a p in hexadecimal on \a fd.  Async-signal-safe.
+  LIBPORT_API void signal_safe_write(int fd, const void* p);
 }
 
 # include <libport/backtrace.hxx>
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2010, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -33,4 +33,55 @@ namespace libport
   }
 
 
+  /*---------------.
+  | RawBacktrace.  |
+  `---------------*/
+
+  inline
+  RawBacktrace::RawBacktrace()
+    : size_(0)
+  {}
+
+  inline
+  void
+  RawBacktrace::clear()
+  {
+    size_ = 0;
+  }
+
+  inline
+  bool
+  RawBacktrace::empty() const
+  {
+    return !size_;
+  }
+
+  inline
+  size_t
+  RawBacktrace::size() const
+  {
+    return size_;
+  }
+
+  inline
+  void* const*
+  RawBacktrace::frames() const
+  {
+    return frames_;
+  }
+
+  inline
+  void*
+  RawBacktrace::operator[](size_t i) const
+  {
+    return frames_[i];
+  }
+
+  inline
+  std::ostream&
+  operator<<(std::ostream& o, const RawBacktrace& b)
+  {
+    return b.dump(o);
+  }
+
 }
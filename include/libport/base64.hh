@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2010, Gostai S.A.S.
+ * Copyright (C) 2008-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,6 +11,7 @@
 #ifndef LIBPORT_BASE64_HH
 # define LIBPORT_BASE64_HH
 
+# include <cstddef>
 # include <string>
 # include <libport/export.hh>
 
@@ -25,6 +26,94 @@ namespace libport
    */
   LIBPORT_API
   std::string base64(const std::string& input);
+
+  /// Convert \a input from base 64.
+  /**
+   ** The padding is optional.  Characters out of the base 64
+   ** alphabet, including white spaces, are errors.
+   **
+   ** @throw std::runtime_error if \a input is not valid base 64.
+   */
+  LIBPORT_API
+  std::string base64_decode(const std::string& input);
+
+  /// Incremental base 64 encoding, to caller buffers.
+  ///
+  /// Successive calls to update() may split the input anywhere: the
+  /// bytes which do not fill a group of three are kept for the next
+  /// call, or finish().
+  class LIBPORT_API Base64Encoder
+  {
+  public:
+    Base64Encoder();
+
+    /// The number of characters update(\a n bytes) writes.
+    size_t update_size(size_t n) const;
+    /// Encode \a n bytes from \a in to \a out, which must have room
+    /// for update_size(\a n) characters.
+    /// \return the number of characters written.
+    size_t update(const char* in, size_t n, char* out);
+    /// Encode the pending bytes, with padding, to \a out, which must
+    /// have room for 4 characters, and get ready for a new input.
+    /// \return the number of characters written.
+    size_t finish(char* out);
+
+  private:
+    unsigned char pending_[3];
+    size_t size_;
+  };
+
+  /// Incremental base 64 decoding, to caller buffers.
+  ///
+  /// Successive calls to update() may split the input anywhere.
+  /// Invalid input raises a std::runtime_error.
+  class LIBPORT_API Base64Decoder
+  {
+  public:
+    Base64Decoder();
+
+    /// An upper bound of the number of bytes update(\a n characters)
+    /// writes.
+    size_t update_size(size_t n) const;
+    /// Decode \a n characters from \a in to \a out, which must have
+    /// room for update_size(\a n) bytes.
+    /// \return the number of bytes written.
+    size_t update(const char* in, size_t n, char* out);
+    /// Decode an unpadded end of input to \a out, which must have
+    /// room for 2 bytes, and get ready for a new input.
+    /// \return the number of bytes written.
+    size_t finish(char* out);
+
+  private:
+    /// Add \a c to the current group, decoding it to \a out once
+    /// complete.
+    void push_(char c, char*& out);
+    /// Decode the complete current group to \a out.
+    size_t group_(char* out);
+
+    char pending_[4];
+    size_t size_;
+    /// Whether the padding was read.
+    bool done_;
+  };
+
+  /// The implementations of the bulk conversions.
+  enum Base64Kernel
+  {
+    BASE64_SCALAR,
+    BASE64_SSSE3,
+    BASE64_AVX2
+  };
+
+  /// The kernel in use, by default the best one the processor
+  /// supports.
+  LIBPORT_API
+  Base64Kernel base64_kernel();
+
+  /// Use \a k, or the best supported kernel below it.  Meant for
+  /// benchmarks and tests.
+  LIBPORT_API
+  void base64_kernel_set(Base64Kernel k);
 }
 
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2011, Gostai S.A.S.
+ * Copyright (C) 2011-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -28,7 +28,8 @@ namespace libport
   public:                                                                    \
     struct StatType                                                           \
     {                                                                        \
-      ::libport::Statistics< ::libport::utime_t, ::libport::ufloat> stats;   \
+      ::libport::Statistics< ::libport::utime_t, ::libport::ufloat,          \
+                             ::libport::Histogram<> > stats;                 \
       ::libport::utime_t lastDisplay;                                        \
       StatType() : lastDisplay(::libport::utime()) {}                        \
     };                                                                       \
@@ -63,13 +64,17 @@ namespace libport
                         __PRETTY_FUNCTION__, __LINE__ )
 
 /** Bench duration of the current block using LIBPORT_BENCH_BLOCK_, display
- * stats to stderr
+ * stats to stderr: mean, min, max, variance, and the 50th, 99th and
+ * 99.9th percentiles.
  */
 #define LIBPORT_BENCH_BLOCK_STDERR(N_SAMPLES_TRIGGER, DURATION_TRIGGER)  \
   LIBPORT_BENCH_BLOCK_(N_SAMPLES_TRIGGER, DURATION_TRIGGER,              \
     std::cerr << pf << ":" << line << " duration stats: "                \
               << s.stats.mean() <<" " << s.stats.min()                   \
               << " " << s.stats.max() << " "  << s.stats.variance()      \
+              << " " << s.stats.quantile(0.5)                            \
+              << " " << s.stats.quantile(0.99)                           \
+              << " " << s.stats.quantile(0.999)                          \
               << std::endl;)
 
 /** Bench duration of the current block using LIBPORT_BENCH_BLOCK_, display
@@ -77,9 +82,12 @@ namespace libport
  */
 #define LIBPORT_BENCH_BLOCK_GD(N_SAMPLES_TRIGGER, DURATION_TRIGGER)      \
   LIBPORT_BENCH_BLOCK_(N_SAMPLES_TRIGGER, DURATION_TRIGGER,              \
-    GD_FINFO_TRACE("%s:%s duration stats: %s %s %s %s",   pf, line,       \
+    GD_FINFO_TRACE("%s:%s duration stats: %s %s %s %s %s",   pf, line,    \
                    s.stats.mean(), s.stats.min(), s.stats.max(),          \
-                   s.vstats.ariance());)
+                   s.stats.variance(),                                    \
+                   ::libport::format("%s %s %s", s.stats.quantile(0.5),   \
+                                     s.stats.quantile(0.99),              \
+                                     s.stats.quantile(0.999)));)
 }
 
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2010, Gostai S.A.S.
+ * Copyright (C) 2009-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -12,14 +12,81 @@
 # define LIBPORT_DAMERAU_LEVENSHTEIN_DISTANCE_HH
 
 # include <string>
+# include <vector>
+
+# include <boost/function.hpp>
+
+# include <libport/cstdint>
 # include <libport/export.hh>
 
 namespace libport
 {
+  class ThreadPool;
+
   /// Return the distance between \a s1 and \a s2.
+  ///
+  /// This is the restricted distance: adjacent transpositions count
+  /// for one, but a transposed substring is not edited further.
   LIBPORT_API
   size_t
   damerau_levenshtein_distance(const std::string& s1, const std::string& s2);
+
+  /// Return the distance between \a s1 and \a s2 if it is at most
+  /// \a max, and \a max + 1 otherwise, giving up as soon as it is
+  /// known to exceed \a max.
+  LIBPORT_API
+  size_t
+  damerau_levenshtein_distance(const std::string& s1, const std::string& s2,
+                               size_t max);
+
+  /// Distances from a given string to many others.
+  ///
+  /// The string is preprocessed once, into a bit-vector per character
+  /// of its positions, so that a distance costs one pass over the
+  /// other string, processing 64 characters of this one at a time.
+  class LIBPORT_API DamerauLevenshteinMatcher
+  {
+  public:
+    DamerauLevenshteinMatcher(const std::string& s);
+
+    /// Distance to \a s, see damerau_levenshtein_distance().
+    size_t distance(const std::string& s, size_t max = size_t(-1)) const;
+
+    const std::string& string_get() const;
+
+  private:
+    std::string string_;
+    /// Number of 64 bits words per character.
+    size_t words_;
+    /// For each character, then for each word, the positions of the
+    /// character in the string.
+    std::vector<uint64_t> positions_;
+  };
+
+  /// The indexes of the at most \a k candidates closest to \a query,
+  /// nearest first, among those at distance at most \a max.  \a
+  /// candidate(i) must return the i-th of the \a n candidates.  If \a
+  /// pool is not null, the candidates are scanned in parallel, so \a
+  /// candidate must be thread-safe.
+  LIBPORT_API
+  std::vector<size_t>
+  damerau_levenshtein_closest
+  (const std::string& query,
+   size_t n, const boost::function1<const std::string&, size_t>& candidate,
+   size_t k, size_t max = size_t(-1), ThreadPool* pool = 0);
+
+  /// The at most \a k elements of \a candidates closest to \a query,
+  /// nearest first, among those at distance at most \a max.
+  ///
+  /// \a Container must provide random access to elements convertible
+  /// to std::string, such as std::vector<std::string> or
+  /// std::vector<Symbol>.
+  template <typename Container>
+  std::vector<typename Container::value_type>
+  closest(const std::string& query, const Container& candidates,
+          size_t k, size_t max = size_t(-1), ThreadPool* pool = 0);
 }
 
+# include <libport/damerau-levenshtein-distance.hxx>
+
 #endif // !LIBPORT_DAMERAU_LEVENSHTEIN_DISTANCE_HH
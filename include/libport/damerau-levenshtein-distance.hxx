@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_DAMERAU_LEVENSHTEIN_DISTANCE_HXX
+# define LIBPORT_DAMERAU_LEVENSHTEIN_DISTANCE_HXX
+
+# include <libport/bind.hh>
+
+namespace libport
+{
+  inline const std::string&
+  DamerauLevenshteinMatcher::string_get() const
+  {
+    return string_;
+  }
+
+  namespace damerau_levenshtein
+  {
+    template <typename Container>
+    const std::string&
+    element(const Container* c, size_t i)
+    {
+      return (*c)[i];
+    }
+  }
+
+  template <typename Container>
+  std::vector<typename Container::value_type>
+  closest(const std::string& query, const Container& candidates,
+          size_t k, size_t max, ThreadPool* pool)
+  {
+    std::vector<size_t> indexes =
+      damerau_levenshtein_closest(
+        query, candidates.size(),
+        boost::bind(&damerau_levenshtein::element<Container>,
+                    &candidates, _1),
+        k, max, pool);
+    std::vector<typename Container::value_type> res;
+    res.reserve(indexes.size());
+    for (size_t i = 0; i < indexes.size(); ++i)
+      res.push_back(candidates[indexes[i]]);
+    return res;
+  }
+}
+
+#endif // !LIBPORT_DAMERAU_LEVENSHTEIN_DISTANCE_HXX
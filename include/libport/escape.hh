@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -69,8 +69,19 @@ namespace libport
   /// Helper function.
   std::ostream& operator<< (std::ostream& o, const Escape&);
 
+  /// Escape [\a begin, \a end) into \a out, as Escape does.
+  /// \a out must have room for four times as many characters.
+  /// \return the end of the output.
+  LIBPORT_API char* escape(const char* begin, const char* end, char* out,
+                           char delimiter);
+
   /// Process \-based escapes.
   LIBPORT_API std::string unescape(const std::string& s);
+
+  /// Process the \-based escapes of [\a begin, \a end) into \a out,
+  /// which must have room for as many characters.
+  /// \return the end of the output.
+  LIBPORT_API char* unescape(const char* begin, const char* end, char* out);
 }
 
 # include <libport/escape.hxx>
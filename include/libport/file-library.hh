@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2010, Gostai S.A.S.
+ * Copyright (C) 2008-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -18,6 +18,7 @@
 
 # include <string>
 # include <list>
+# include <boost/shared_ptr.hpp>
 # include <libport/export.hh>
 # include <libport/path.hh>
 # include <exception>
@@ -122,6 +123,23 @@ namespace libport
     bool find_in_directory(const path& dir, const std::string& file) const;
     /// \}
 
+    /// \name Lookup cache.
+    /// \{
+    /** \brief Whether to look files up in snapshots of the directories.
+     *
+     * Each directory is listed once, then the lookups in it are hash
+     * lookups instead of calls to stat.  A snapshot is refreshed
+     * when its directory changes: inotify reports the changes on
+     * Linux, elsewhere the modification date of the directory is
+     * checked on each lookup.  Moving a parent of a listed
+     * directory is not noticed.  Copies of the library share the
+     * snapshots.  Disabled by default. */
+    void cache_set(bool cache);
+    bool cache_get() const;
+    /// Forget all the snapshots.
+    void cache_clear() const;
+    /// \}
+
     /// \name Printing.
     /// \{
     std::ostream& dump(std::ostream& ostr) const;
@@ -152,6 +170,10 @@ namespace libport
 
     /// Current directory stack.
     path_list_type current_directory_;
+
+    /// The directory snapshots, 0 if disabled.
+    class Cache;
+    boost::shared_ptr<Cache> cache_;
   };
 
   /// Print \a l on \a o.
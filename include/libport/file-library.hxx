@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2010, Gostai S.A.S.
+ * Copyright (C) 2008-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -113,6 +113,12 @@ namespace libport
     return search_path_;
   }
 
+  inline bool
+  file_library::cache_get() const
+  {
+    return cache_.get();
+  }
+
   inline std::ostream&
   operator<<(std::ostream& ostr, const file_library& l)
   {
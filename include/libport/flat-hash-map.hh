@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/// \file libport/flat-hash-map.hh
+/// \brief Open addressing hash tables.
+///
+/// The elements are stored inline, in a single array, next to an
+/// array of control bytes: one per slot, telling whether it is empty,
+/// deleted, or full, in which case it holds 7 bits of the hash of the
+/// element.  A lookup compares 16 control bytes at once against these
+/// bits, and only compares the keys of the matching slots.  This is
+/// the layout of Google's SwissTable.
+///
+/// Unlike boost::unordered_map, inserting an element allocates
+/// nothing until the table grows, and a lookup does not chase
+/// pointers.  In exchange, growing the table moves the elements, so
+/// insertions invalidate iterators and references.  Erasing only
+/// invalidates the erased element.
+
+#ifndef LIBPORT_FLAT_HASH_MAP_HH
+# define LIBPORT_FLAT_HASH_MAP_HH
+
+# include <cstddef>
+# include <functional>
+# include <utility>
+
+# include <boost/functional/hash.hpp>
+
+# include <libport/symbol.hh>
+
+namespace libport
+{
+  /// Scramble \a h so that all its bits depend on all the bits of the
+  /// input: the tables use both the low bits and the high ones.
+  size_t flat_hash_mix(size_t h);
+
+  /// The default hash function of flat tables: boost::hash, mixed.
+  template <typename T>
+  struct flat_hash
+  {
+    size_t operator()(const T& v) const;
+  };
+
+  /// Pointers are hashed by address.
+  template <typename T>
+  struct flat_hash<T*>
+  {
+    size_t operator()(T* p) const;
+  };
+
+  /// Symbols are hashed by the address of their unique string.
+  template <>
+  struct flat_hash<Symbol>
+  {
+    size_t operator()(const Symbol& s) const;
+  };
+
+  namespace details
+  {
+    /// The value of the control bytes which are not full.
+    enum FlatControl
+    {
+      flat_empty = -128,
+      flat_deleted = -2,
+      flat_sentinel = -1
+    };
+
+    /// Number of control bytes compared at once.
+    enum { flat_group_size = 16 };
+
+    /// Bits set for the control bytes among the 16 at \a ctrl equal
+    /// to \a c.
+    unsigned flat_match(const signed char* ctrl, signed char c);
+    /// Bits set for the empty or deleted control bytes among the 16
+    /// at \a ctrl.
+    unsigned flat_match_free(const signed char* ctrl);
+
+    /// The control bytes of the tables without slots: a sentinel
+    /// followed by empty bytes, so that lookups find nothing.
+    template <int N>
+    struct FlatEmptyGroup
+    {
+      static const signed char ctrl[flat_group_size];
+    };
+
+    /// Key extraction for sets.
+    template <typename T>
+    struct FlatIdentity
+    {
+      typedef T key_type;
+      static const key_type& key(const T& v);
+    };
+
+    /// Key extraction for maps.
+    template <typename K, typename V>
+    struct FlatFirst
+    {
+      typedef K key_type;
+      static const key_type& key(const std::pair<const K, V>& v);
+    };
+
+    /// The table, parameterized by the way to get the key of a value.
+    template <typename Value, typename KeyOf, typename Hash, typename Pred>
+    class FlatHashTable
+    {
+    public:
+      typedef typename KeyOf::key_type key_type;
+      typedef Value value_type;
+      typedef Hash hasher;
+      typedef Pred key_equal;
+      typedef size_t size_type;
+      typedef value_type& reference;
+      typedef const value_type& const_reference;
+
+      /// Iterator on values of type \a T, maybe const.
+      template <typename T>
+      class Iterator
+      {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename FlatHashTable::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
+        Iterator();
+        Iterator(const signed char* ctrl, T* slot);
+        /// Conversion to const_iterator.
+        template <typename U>
+        Iterator(const Iterator<U>& i);
+
+        reference operator*() const;
+        pointer operator->() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        template <typename U>
+        bool operator==(const Iterator<U>& i) const;
+        template <typename U>
+        bool operator!=(const Iterator<U>& i) const;
+
+        /// Skip the free slots.
+        void skip_();
+
+        const signed char* ctrl_;
+        T* slot_;
+      };
+
+      typedef Iterator<value_type> iterator;
+      typedef Iterator<const value_type> const_iterator;
+
+      FlatHashTable();
+      FlatHashTable(const FlatHashTable& table);
+      ~FlatHashTable();
+      FlatHashTable& operator=(const FlatHashTable& table);
+      void swap(FlatHashTable& table);
+
+      iterator begin();
+      iterator end();
+      const_iterator begin() const;
+      const_iterator end() const;
+
+      bool empty() const;
+      size_type size() const;
+      /// Number of slots.
+      size_type capacity() const;
+      void clear();
+      /// Make room for \a n elements without rehashing.
+      void reserve(size_type n);
+
+      iterator find(const key_type& k);
+      const_iterator find(const key_type& k) const;
+      size_type count(const key_type& k) const;
+
+      std::pair<iterator, bool> insert(const value_type& v);
+      template <typename InputIterator>
+      void insert(InputIterator first, InputIterator last);
+
+      /// Invalidates only the iterators on the erased element.
+      void erase(iterator i);
+      size_type erase(const key_type& k);
+
+    protected:
+      /// Index of the slot holding \a k, or capacity_.
+      size_t find_(const key_type& k, size_t hash) const;
+      /// Find \a k, or else take a slot for it, without constructing
+      /// the value.
+      /// \return the index of the slot, and whether it is new.
+      std::pair<size_t, bool> find_or_prepare_(const key_type& k,
+                                               size_t hash);
+      /// Take a slot for a new element whose hash is \a hash.
+      size_t prepare_(size_t hash);
+      /// Index of the first empty or deleted slot for \a hash.
+      size_t find_free_(size_t hash) const;
+      void set_ctrl_(size_t i, signed char c);
+      /// Move to \a capacity slots.
+      void rehash_(size_t capacity);
+      /// The number of elements \a capacity slots can hold.
+      static size_t max_load_(size_t capacity);
+      void destroy_();
+
+      signed char* ctrl_;
+      value_type* slots_;
+      /// Number of slots: a power of two minus one, or 0.  It is
+      /// also the index of a sentinel control byte, the end of the
+      /// iterations, followed by a copy of the first 15 control bytes
+      /// so that groups near the end need not wrap around.
+      size_t capacity_;
+      size_t size_;
+      /// Number of elements to insert before rehashing.
+      size_t growth_left_;
+      hasher hash_;
+      key_equal equal_;
+    };
+  }
+
+  /// A hash map with open addressing.
+  ///
+  /// The interface is a subset of boost::unordered_map's.
+  template <typename K, typename V,
+            typename Hash = flat_hash<K>, typename Pred = std::equal_to<K> >
+  class flat_hash_map
+    : public details::FlatHashTable<std::pair<const K, V>,
+                                    details::FlatFirst<K, V>, Hash, Pred>
+  {
+  public:
+    typedef details::FlatHashTable<std::pair<const K, V>,
+                                   details::FlatFirst<K, V>, Hash, Pred>
+      super_type;
+    typedef V mapped_type;
+    typedef typename super_type::key_type key_type;
+    typedef typename super_type::value_type value_type;
+
+    mapped_type& operator[](const key_type& k);
+  };
+
+  /// A hash set with open addressing.
+  ///
+  /// The interface is a subset of boost::unordered_set's.
+  template <typename K,
+            typename Hash = flat_hash<K>, typename Pred = std::equal_to<K> >
+  class flat_hash_set
+    : public details::FlatHashTable<K, details::FlatIdentity<K>, Hash, Pred>
+  {
+  public:
+    typedef details::FlatHashTable<K, details::FlatIdentity<K>, Hash, Pred>
+      super_type;
+    /// The elements are keys, they must not be modified.
+    typedef typename super_type::const_iterator iterator;
+
+    using super_type::erase;
+    void erase(iterator i);
+  };
+}
+
+# include <libport/flat-hash-map.hxx>
+
+#endif // !LIBPORT_FLAT_HASH_MAP_HH
@@ -0,0 +1,636 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_FLAT_HASH_MAP_HXX
+# define LIBPORT_FLAT_HASH_MAP_HXX
+
+# include <algorithm>
+# include <new>
+
+# include <libport/cassert>
+# include <libport/cstdint>
+# include <libport/cstring>
+
+# if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && 2 <= _M_IX86_FP)
+#  include <emmintrin.h>
+#  define LIBPORT_FLAT_HASH_SSE2 1
+# endif
+
+namespace libport
+{
+  /*------------.
+  | flat_hash.  |
+  `------------*/
+
+  inline size_t
+  flat_hash_mix(size_t h)
+  {
+    // Multiply by 2^64 / phi, and fold the high half, which depends on
+    // all the input bits, onto the low one.
+    uint64_t x = uint64_t(h) * 0x9e3779b97f4a7c15ULL;
+    return size_t(x ^ (x >> 32));
+  }
+
+  template <typename T>
+  inline size_t
+  flat_hash<T>::operator()(const T& v) const
+  {
+    return flat_hash_mix(boost::hash<T>()(v));
+  }
+
+  template <typename T>
+  inline size_t
+  flat_hash<T*>::operator()(T* p) const
+  {
+    return flat_hash_mix(reinterpret_cast<uintptr_t>(p));
+  }
+
+  inline size_t
+  flat_hash<Symbol>::operator()(const Symbol& s) const
+  {
+    return flat_hash_mix(reinterpret_cast<uintptr_t>(&s.name_get()));
+  }
+
+  namespace details
+  {
+    /*-----------------.
+    | Control groups.  |
+    `-----------------*/
+
+# if defined LIBPORT_FLAT_HASH_SSE2
+    inline unsigned
+    flat_match(const signed char* ctrl, signed char c)
+    {
+      __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+    }
+
+    inline unsigned
+    flat_match_free(const signed char* ctrl)
+    {
+      __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+      return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(flat_sentinel),
+                                              g));
+    }
+# else
+    inline unsigned
+    flat_match(const signed char* ctrl, signed char c)
+    {
+      unsigned res = 0;
+      for (unsigned i = 0; i < flat_group_size; ++i)
+        res |= unsigned(ctrl[i] == c) << i;
+      return res;
+    }
+
+    inline unsigned
+    flat_match_free(const signed char* ctrl)
+    {
+      unsigned res = 0;
+      for (unsigned i = 0; i < flat_group_size; ++i)
+        res |= unsigned(ctrl[i] < flat_sentinel) << i;
+      return res;
+    }
+# endif
+
+    /// Index of the lowest bit set in \a m, which is not null.
+    inline unsigned
+    flat_lowest(unsigned m)
+    {
+# if defined __GNUC__
+      return __builtin_ctz(m);
+# else
+      unsigned res = 0;
+      for (; !(m & 1); m >>= 1)
+        ++res;
+      return res;
+# endif
+    }
+
+    /// Number of leading zeros of the 16 bit mask \a m, which is not
+    /// null.
+    inline unsigned
+    flat_leading(unsigned m)
+    {
+      unsigned res = 0;
+      for (unsigned bit = 1 << (flat_group_size - 1); !(m & bit); bit >>= 1)
+        ++res;
+      return res;
+    }
+
+    template <int N>
+    const signed char FlatEmptyGroup<N>::ctrl[flat_group_size] =
+    {
+      flat_sentinel, flat_empty, flat_empty, flat_empty,
+      flat_empty, flat_empty, flat_empty, flat_empty,
+      flat_empty, flat_empty, flat_empty, flat_empty,
+      flat_empty, flat_empty, flat_empty, flat_empty,
+    };
+
+    template <typename T>
+    inline const typename FlatIdentity<T>::key_type&
+    FlatIdentity<T>::key(const T& v)
+    {
+      return v;
+    }
+
+    template <typename K, typename V>
+    inline const typename FlatFirst<K, V>::key_type&
+    FlatFirst<K, V>::key(const std::pair<const K, V>& v)
+    {
+      return v.first;
+    }
+
+    /*-----------.
+    | Iterator.  |
+    `-----------*/
+
+# define TABLE                                                  \
+    FlatHashTable<Value, KeyOf, Hash, Pred>
+
+# define TEMPLATE                                                       \
+    template <typename Value, typename KeyOf, typename Hash, typename Pred>
+
+    TEMPLATE
+    template <typename T>
+    inline
+    TABLE::Iterator<T>::Iterator()
+      : ctrl_(0)
+      , slot_(0)
+    {}
+
+    TEMPLATE
+    template <typename T>
+    inline
+    TABLE::Iterator<T>::Iterator(const signed char* ctrl, T* slot)
+      : ctrl_(ctrl)
+      , slot_(slot)
+    {}
+
+    TEMPLATE
+    template <typename T>
+    template <typename U>
+    inline
+    TABLE::Iterator<T>::Iterator(const Iterator<U>& i)
+      : ctrl_(i.ctrl_)
+      , slot_(i.slot_)
+    {}
+
+    TEMPLATE
+    template <typename T>
+    inline typename TABLE::template Iterator<T>::reference
+    TABLE::Iterator<T>::operator*() const
+    {
+      return *slot_;
+    }
+
+    TEMPLATE
+    template <typename T>
+    inline typename TABLE::template Iterator<T>::pointer
+    TABLE::Iterator<T>::operator->() const
+    {
+      return slot_;
+    }
+
+    TEMPLATE
+    template <typename T>
+    inline void
+    TABLE::Iterator<T>::skip_()
+    {
+      // Stop on full slots and on the sentinel.
+      while (*ctrl_ < flat_sentinel)
+      {
+        ++ctrl_;
+        ++slot_;
+      }
+    }
+
+    TEMPLATE
+    template <typename T>
+    inline typename TABLE::template Iterator<T>&
+    TABLE::Iterator<T>::operator++()
+    {
+      ++ctrl_;
+      ++slot_;
+      skip_();
+      return *this;
+    }
+
+    TEMPLATE
+    template <typename T>
+    inline typename TABLE::template Iterator<T>
+    TABLE::Iterator<T>::operator++(int)
+    {
+      Iterator res = *this;
+      ++*this;
+      return res;
+    }
+
+    TEMPLATE
+    template <typename T>
+    template <typename U>
+    inline bool
+    TABLE::Iterator<T>::operator==(const Iterator<U>& i) const
+    {
+      return ctrl_ == i.ctrl_;
+    }
+
+    TEMPLATE
+    template <typename T>
+    template <typename U>
+    inline bool
+    TABLE::Iterator<T>::operator!=(const Iterator<U>& i) const
+    {
+      return ctrl_ != i.ctrl_;
+    }
+
+    /*----------------.
+    | FlatHashTable.  |
+    `----------------*/
+
+    TEMPLATE
+    inline
+    TABLE::FlatHashTable()
+      : ctrl_(const_cast<signed char*>(FlatEmptyGroup<0>::ctrl))
+      , slots_(0)
+      , capacity_(0)
+      , size_(0)
+      , growth_left_(0)
+    {}
+
+    TEMPLATE
+    inline
+    TABLE::FlatHashTable(const FlatHashTable& table)
+      : ctrl_(const_cast<signed char*>(FlatEmptyGroup<0>::ctrl))
+      , slots_(0)
+      , capacity_(0)
+      , size_(0)
+      , growth_left_(0)
+      , hash_(table.hash_)
+      , equal_(table.equal_)
+    {
+      reserve(table.size());
+      insert(table.begin(), table.end());
+    }
+
+    TEMPLATE
+    inline
+    TABLE::~FlatHashTable()
+    {
+      destroy_();
+    }
+
+    TEMPLATE
+    inline TABLE&
+    TABLE::operator=(const FlatHashTable& table)
+    {
+      FlatHashTable copy(table);
+      swap(copy);
+      return *this;
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::swap(FlatHashTable& table)
+    {
+      std::swap(ctrl_, table.ctrl_);
+      std::swap(slots_, table.slots_);
+      std::swap(capacity_, table.capacity_);
+      std::swap(size_, table.size_);
+      std::swap(growth_left_, table.growth_left_);
+      std::swap(hash_, table.hash_);
+      std::swap(equal_, table.equal_);
+    }
+
+    TEMPLATE
+    inline typename TABLE::iterator
+    TABLE::begin()
+    {
+      iterator res(ctrl_, slots_);
+      res.skip_();
+      return res;
+    }
+
+    TEMPLATE
+    inline typename TABLE::iterator
+    TABLE::end()
+    {
+      return iterator(ctrl_ + capacity_, slots_ + capacity_);
+    }
+
+    TEMPLATE
+    inline typename TABLE::const_iterator
+    TABLE::begin() const
+    {
+      return const_cast<FlatHashTable*>(this)->begin();
+    }
+
+    TEMPLATE
+    inline typename TABLE::const_iterator
+    TABLE::end() const
+    {
+      return const_cast<FlatHashTable*>(this)->end();
+    }
+
+    TEMPLATE
+    inline bool
+    TABLE::empty() const
+    {
+      return !size_;
+    }
+
+    TEMPLATE
+    inline typename TABLE::size_type
+    TABLE::size() const
+    {
+      return size_;
+    }
+
+    TEMPLATE
+    inline typename TABLE::size_type
+    TABLE::capacity() const
+    {
+      return capacity_;
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::clear()
+    {
+      destroy_();
+      ctrl_ = const_cast<signed char*>(FlatEmptyGroup<0>::ctrl);
+      slots_ = 0;
+      capacity_ = size_ = growth_left_ = 0;
+    }
+
+    TEMPLATE
+    inline size_t
+    TABLE::max_load_(size_t capacity)
+    {
+      // Keep an eighth of the slots free, so that probing stops soon.
+      return capacity - capacity / 8;
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::reserve(size_type n)
+    {
+      if (!n)
+        return;
+      size_t capacity = flat_group_size - 1;
+      while (max_load_(capacity) < n)
+        capacity = capacity * 2 + 1;
+      if (capacity_ < capacity)
+        rehash_(capacity);
+    }
+
+    TEMPLATE
+    inline size_t
+    TABLE::find_(const key_type& k, size_t hash) const
+    {
+      signed char h2 = hash & 0x7f;
+      size_t pos = (hash >> 7) & capacity_;
+      for (size_t step = flat_group_size; ; step += flat_group_size)
+      {
+        for (unsigned m = flat_match(ctrl_ + pos, h2); m; m &= m - 1)
+        {
+          size_t i = (pos + flat_lowest(m)) & capacity_;
+          if (equal_(KeyOf::key(slots_[i]), k))
+            return i;
+        }
+        if (flat_match(ctrl_ + pos, flat_empty))
+          return capacity_;
+        pos = (pos + step) & capacity_;
+      }
+    }
+
+    TEMPLATE
+    inline typename TABLE::iterator
+    TABLE::find(const key_type& k)
+    {
+      size_t i = find_(k, hash_(k));
+      return iterator(ctrl_ + i, slots_ + i);
+    }
+
+    TEMPLATE
+    inline typename TABLE::const_iterator
+    TABLE::find(const key_type& k) const
+    {
+      return const_cast<FlatHashTable*>(this)->find(k);
+    }
+
+    TEMPLATE
+    inline typename TABLE::size_type
+    TABLE::count(const key_type& k) const
+    {
+      return find_(k, hash_(k)) != capacity_;
+    }
+
+    TEMPLATE
+    inline size_t
+    TABLE::find_free_(size_t hash) const
+    {
+      size_t pos = (hash >> 7) & capacity_;
+      for (size_t step = flat_group_size; ; step += flat_group_size)
+      {
+        if (unsigned m = flat_match_free(ctrl_ + pos))
+          return (pos + flat_lowest(m)) & capacity_;
+        pos = (pos + step) & capacity_;
+      }
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::set_ctrl_(size_t i, signed char c)
+    {
+      ctrl_[i] = c;
+      // The copy of the first bytes, after the sentinel.
+      ctrl_[((i - (flat_group_size - 1)) & capacity_)
+            + ((flat_group_size - 1) & capacity_)] = c;
+    }
+
+    TEMPLATE
+    inline size_t
+    TABLE::prepare_(size_t hash)
+    {
+      size_t i = find_free_(hash);
+      // Reusing a deleted slot costs no growth.  The empty table has
+      // no free slot at all.
+      if (!growth_left_ && ctrl_[i] != flat_deleted)
+      {
+        // Reclaim the deleted slots if they are numerous enough,
+        // otherwise grow.
+        if (size_ < max_load_(capacity_) / 2)
+          rehash_(capacity_);
+        else
+          rehash_(capacity_ ? capacity_ * 2 + 1 : flat_group_size - 1);
+        i = find_free_(hash);
+      }
+      growth_left_ -= ctrl_[i] == flat_empty;
+      return i;
+    }
+
+    TEMPLATE
+    inline std::pair<size_t, bool>
+    TABLE::find_or_prepare_(const key_type& k, size_t hash)
+    {
+      size_t i = find_(k, hash);
+      if (i != capacity_)
+        return std::make_pair(i, false);
+      return std::make_pair(prepare_(hash), true);
+    }
+
+    TEMPLATE
+    inline std::pair<typename TABLE::iterator, bool>
+    TABLE::insert(const value_type& v)
+    {
+      size_t hash = hash_(KeyOf::key(v));
+      std::pair<size_t, bool> res = find_or_prepare_(KeyOf::key(v), hash);
+      size_t i = res.first;
+      if (res.second)
+      {
+        new (slots_ + i) value_type(v);
+        set_ctrl_(i, hash & 0x7f);
+        ++size_;
+      }
+      return std::make_pair(iterator(ctrl_ + i, slots_ + i), res.second);
+    }
+
+    TEMPLATE
+    template <typename InputIterator>
+    inline void
+    TABLE::insert(InputIterator first, InputIterator last)
+    {
+      for (; first != last; ++first)
+        insert(*first);
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::erase(iterator it)
+    {
+      size_t i = it.ctrl_ - ctrl_;
+      aver(i < capacity_ && 0 <= ctrl_[i]);
+      slots_[i].~value_type();
+      --size_;
+      // If no group around the slot was ever full, no probe went past
+      // it: it can be empty again rather than deleted.
+      size_t before = (i - flat_group_size) & capacity_;
+      unsigned empty_before = flat_match(ctrl_ + before, flat_empty);
+      unsigned empty_after = flat_match(ctrl_ + i, flat_empty);
+      if (empty_before && empty_after
+          && (flat_leading(empty_before) + flat_lowest(empty_after)
+              < flat_group_size))
+      {
+        set_ctrl_(i, flat_empty);
+        ++growth_left_;
+      }
+      else
+        set_ctrl_(i, flat_deleted);
+    }
+
+    TEMPLATE
+    inline typename TABLE::size_type
+    TABLE::erase(const key_type& k)
+    {
+      iterator i = find(k);
+      if (i == end())
+        return 0;
+      erase(i);
+      return 1;
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::rehash_(size_t capacity)
+    {
+      aver(size_ <= max_load_(capacity));
+      signed char* ctrl = new signed char[capacity + flat_group_size];
+      value_type* slots =
+        static_cast<value_type*>(::operator new(capacity
+                                                * sizeof(value_type)));
+      memset(ctrl, flat_empty, capacity + flat_group_size);
+      ctrl[capacity] = flat_sentinel;
+
+      std::swap(ctrl, ctrl_);
+      std::swap(slots, slots_);
+      std::swap(capacity, capacity_);
+      size_t size = size_;
+      size_ = 0;
+      growth_left_ = max_load_(capacity_) - size;
+      // Move the elements, ctrl, slots and capacity are the former
+      // table.
+      for (size_t i = 0; i < capacity; ++i)
+        if (0 <= ctrl[i])
+        {
+          size_t hash = hash_(KeyOf::key(slots[i]));
+          size_t j = find_free_(hash);
+          new (slots_ + j) value_type(slots[i]);
+          set_ctrl_(j, hash & 0x7f);
+          ++size_;
+          slots[i].~value_type();
+        }
+      if (capacity)
+      {
+        delete [] ctrl;
+        ::operator delete(slots);
+      }
+    }
+
+    TEMPLATE
+    inline void
+    TABLE::destroy_()
+    {
+      if (!capacity_)
+        return;
+      for (size_t i = 0; i < capacity_; ++i)
+        if (0 <= ctrl_[i])
+          slots_[i].~value_type();
+      delete [] ctrl_;
+      ::operator delete(slots_);
+    }
+
+# undef TEMPLATE
+# undef TABLE
+  }
+
+  /*----------------.
+  | flat_hash_map.  |
+  `----------------*/
+
+  template <typename K, typename V, typename Hash, typename Pred>
+  inline typename flat_hash_map<K, V, Hash, Pred>::mapped_type&
+  flat_hash_map<K, V, Hash, Pred>::operator[](const key_type& k)
+  {
+    size_t hash = this->hash_(k);
+    std::pair<size_t, bool> res = this->find_or_prepare_(k, hash);
+    size_t i = res.first;
+    if (res.second)
+    {
+      new (this->slots_ + i) value_type(k, mapped_type());
+      this->set_ctrl_(i, hash & 0x7f);
+      ++this->size_;
+    }
+    return this->slots_[i].second;
+  }
+
+  /*----------------.
+  | flat_hash_set.  |
+  `----------------*/
+
+  template <typename K, typename Hash, typename Pred>
+  inline void
+  flat_hash_set<K, Hash, Pred>::erase(iterator i)
+  {
+    super_type::erase(typename super_type::iterator(
+                        i.ctrl_, const_cast<K*>(i.slot_)));
+  }
+}
+
+#endif // !LIBPORT_FLAT_HASH_MAP_HXX
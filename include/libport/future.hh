@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_FUTURE_HH
+# define LIBPORT_FUTURE_HH
+
+# include <stdexcept>
+# include <vector>
+
+# include <boost/exception_ptr.hpp>
+# include <boost/function.hpp>
+# include <boost/optional.hpp>
+# include <boost/utility/result_of.hpp>
+
+# include <libport/condition.hh>
+# include <libport/export.hh>
+# include <libport/intrusive-ptr.hh>
+# include <libport/ref-counted.hh>
+
+namespace libport
+{
+  class ThreadPool;
+
+  /// Error held by the future of a task dropped by its TaskLock.
+  class LIBPORT_API TaskDropped: public std::runtime_error
+  {
+  public:
+    TaskDropped();
+  };
+
+  namespace future
+  {
+    /// Synchronization shared by a Future and its producer.
+    class LIBPORT_API StateBase: public ThreadSafeRefCounted
+    {
+    public:
+      typedef boost::function0<void> callback_type;
+
+      StateBase();
+      virtual ~StateBase();
+
+      /// Whether a value or an exception was stored.
+      bool ready() const;
+      /// Whether an exception was stored.
+      bool failed() const;
+      /// Block until ready.
+      void wait() const;
+      /// The stored exception, if any.
+      boost::exception_ptr exception() const;
+
+      /// Call \a f once ready, from the thread which makes the state
+      /// ready, or right away if it already is.
+      void onReady(const callback_type& f);
+
+      /// Store an exception and wake up the waiters.
+      void fail(const boost::exception_ptr& e);
+
+    protected:
+      /// Mark ready, wake up the waiters and run the callbacks.
+      void complete();
+      /// Wait, and rethrow the stored exception if any.
+      void check() const;
+
+      mutable Condition cond_;
+      bool ready_;
+      boost::exception_ptr exception_;
+      std::vector<callback_type> callbacks_;
+    };
+    typedef libport::intrusive_ptr<StateBase> rStateBase;
+
+    template <typename T>
+    class State: public StateBase
+    {
+    public:
+      /// Store the value and wake up the waiters.
+      void set(const T& v);
+      /// Wait for the value, rethrowing the stored exception.
+      T get() const;
+    private:
+      boost::optional<T> value_;
+    };
+
+    template <>
+    class State<void>: public StateBase
+    {
+    public:
+      void set();
+      void get() const;
+    };
+  }
+
+  /** Result of an asynchronous computation.
+   *
+   * Futures are cheap handles on a shared state: copies refer to the
+   * same result.
+   */
+  template <typename T>
+  class Future
+  {
+  public:
+    typedef T value_type;
+    typedef future::State<T> state_type;
+    typedef libport::intrusive_ptr<state_type> rState;
+
+    /// An invalid future.
+    Future();
+    /// A future on \a state.
+    explicit Future(rState state);
+
+    /// Whether this future refers to a computation.
+    bool valid() const;
+    /// Whether the result is available.
+    bool ready() const;
+    /// Whether the computation threw.
+    bool failed() const;
+    /// Block until the result is available.
+    void wait() const;
+    /// Block until the result is available, and return it or rethrow
+    /// the exception of the computation.
+    T get() const;
+
+    /** Once ready, run \a f(*this) as a task of \a pool.
+     *  \return the future result of \a f.
+     */
+    template <typename F>
+    Future<typename boost::result_of<F(Future<T>)>::type>
+    then(ThreadPool& pool, F f) const;
+
+    const rState& state() const;
+
+  private:
+    rState state_;
+  };
+
+  /// A future ready once all the \a futures are, failing with the
+  /// first exception of them if any.
+  template <typename T>
+  Future<void> when_all(const std::vector<Future<T> >& futures);
+
+  namespace future
+  {
+    LIBPORT_API Future<void> when_all(const std::vector<rStateBase>& states);
+  }
+}
+
+# include <libport/future.hxx>
+
+// Future::then, ThreadPool::async and the parallel algorithms.
+# include <libport/thread-pool.hh>
+
+#endif // !LIBPORT_FUTURE_HH
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_FUTURE_HXX
+# define LIBPORT_FUTURE_HXX
+
+# include <libport/cassert>
+# include <libport/foreach.hh>
+
+namespace libport
+{
+  namespace future
+  {
+    /*--------.
+    | State.  |
+    `--------*/
+
+    template <typename T>
+    void
+    State<T>::set(const T& v)
+    {
+      {
+        BlockLock bl(cond_);
+        aver(!ready_);
+        value_ = v;
+      }
+      complete();
+    }
+
+    template <typename T>
+    T
+    State<T>::get() const
+    {
+      check();
+      return *value_;
+    }
+
+    inline
+    void
+    State<void>::set()
+    {
+      complete();
+    }
+
+    inline
+    void
+    State<void>::get() const
+    {
+      check();
+    }
+  }
+
+  /*---------.
+  | Future.  |
+  `---------*/
+
+  template <typename T>
+  Future<T>::Future()
+    : state_(0)
+  {
+  }
+
+  template <typename T>
+  Future<T>::Future(rState state)
+    : state_(state)
+  {
+  }
+
+  template <typename T>
+  bool
+  Future<T>::valid() const
+  {
+    return state_;
+  }
+
+  template <typename T>
+  bool
+  Future<T>::ready() const
+  {
+    aver(state_);
+    return state_->ready();
+  }
+
+  template <typename T>
+  bool
+  Future<T>::failed() const
+  {
+    aver(state_);
+    return state_->failed();
+  }
+
+  template <typename T>
+  void
+  Future<T>::wait() const
+  {
+    aver(state_);
+    state_->wait();
+  }
+
+  template <typename T>
+  T
+  Future<T>::get() const
+  {
+    aver(state_);
+    return state_->get();
+  }
+
+  template <typename T>
+  const typename Future<T>::rState&
+  Future<T>::state() const
+  {
+    return state_;
+  }
+
+  template <typename T>
+  Future<void>
+  when_all(const std::vector<Future<T> >& futures)
+  {
+    std::vector<future::rStateBase> states;
+    states.reserve(futures.size());
+    foreach (const Future<T>& f, futures)
+      states.push_back(f.state());
+    return future::when_all(states);
+  }
+}
+
+#endif // !LIBPORT_FUTURE_HXX
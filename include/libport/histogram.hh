@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/// \file libport/histogram.hh
+/// \brief Log-linear histograms, for quantiles in bounded memory.
+///
+/// The samples are non-negative integers.  Each power of two is split
+/// in 2^Bits buckets of equal width, as in HdrHistogram: the values
+/// below 2^(Bits+1) are counted exactly, and the others with a
+/// relative error under 2^-Bits.  The memory only depends on the
+/// greatest sample: with 4 bits, one bucket per 6% from 0 to one
+/// second in microseconds takes 272 counters.
+
+#ifndef LIBPORT_HISTOGRAM_HH
+# define LIBPORT_HISTOGRAM_HH
+
+# include <iosfwd>
+# include <vector>
+
+# include <libport/cstdint>
+
+namespace libport
+{
+  template <unsigned Bits = 4>
+  class Histogram
+  {
+  public:
+    typedef Histogram<Bits> self_type;
+    typedef uint64_t value_type;
+    /// Number of buckets per power of two.
+    enum { sub_buckets = 1 << Bits };
+
+    Histogram();
+
+    void clear();
+    bool empty() const;
+    /// Number of samples.
+    uint64_t size() const;
+
+    /// Count \a n samples of value \a v.  Negative values count as 0.
+    template <typename T>
+    void add(T v, uint64_t n = 1);
+    /// Uncount a sample of value \a v, previously added.
+    template <typename T>
+    void remove(T v);
+    /// Add the samples of \a h.
+    void merge(const self_type& h);
+
+    /// The value under which are a fraction \a q of the samples: 0.5
+    /// for the median, 0.99 for the 99th percentile.  The middle of
+    /// the bucket, or 0 if there are no samples.
+    value_type quantile(double q) const;
+
+    /// Number of buckets in use, up to the greatest sample.
+    size_t buckets() const;
+    /// Number of samples in the bucket \a i.
+    uint64_t count(size_t i) const;
+    /// The bucket of \a v.
+    static size_t index(value_type v);
+    /// The smallest value of bucket \a i.
+    static value_type lowest(size_t i);
+    /// The greatest value of bucket \a i.
+    static value_type highest(size_t i);
+
+    /// Save to \a o, on one line: the number of bits, the number of
+    /// samples, then for each non-empty bucket the number of empty
+    /// buckets before it and its count.
+    std::ostream& dump(std::ostream& o) const;
+    /// Restore what dump() saved.
+    /// \return false, leaving this unchanged, if \a i does not hold
+    ///   a histogram with the same number of bits.
+    bool load(std::istream& i);
+
+  private:
+    std::vector<uint64_t> counts_;
+    uint64_t size_;
+  };
+
+  template <unsigned Bits>
+  std::ostream&
+  operator<<(std::ostream& o, const Histogram<Bits>& h);
+}
+
+# include <libport/histogram.hxx>
+
+#endif // !LIBPORT_HISTOGRAM_HH
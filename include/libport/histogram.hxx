@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_HISTOGRAM_HXX
+# define LIBPORT_HISTOGRAM_HXX
+
+# include <cmath>
+# include <istream>
+# include <ostream>
+
+# include <libport/cassert>
+
+namespace libport
+{
+  namespace details
+  {
+    /// Index of the most significant bit of \a v, which is not 0.
+    inline unsigned
+    histogram_log2(uint64_t v)
+    {
+# if defined __GNUC__
+      return 63 - __builtin_clzll(v);
+# else
+      unsigned res = 0;
+      for (; v >>= 1; ++res)
+        ;
+      return res;
+# endif
+    }
+  }
+
+  template <unsigned Bits>
+  Histogram<Bits>::Histogram()
+    : size_(0)
+  {
+  }
+
+  template <unsigned Bits>
+  inline void
+  Histogram<Bits>::clear()
+  {
+    counts_.clear();
+    size_ = 0;
+  }
+
+  template <unsigned Bits>
+  inline bool
+  Histogram<Bits>::empty() const
+  {
+    return !size_;
+  }
+
+  template <unsigned Bits>
+  inline uint64_t
+  Histogram<Bits>::size() const
+  {
+    return size_;
+  }
+
+  template <unsigned Bits>
+  inline size_t
+  Histogram<Bits>::index(value_type v)
+  {
+    if (v < value_type(sub_buckets))
+      return v;
+    unsigned shift = details::histogram_log2(v) - Bits;
+    return (shift + 1) * sub_buckets + (v >> shift) - sub_buckets;
+  }
+
+  template <unsigned Bits>
+  inline typename Histogram<Bits>::value_type
+  Histogram<Bits>::lowest(size_t i)
+  {
+    if (i < size_t(sub_buckets))
+      return i;
+    unsigned shift = i / sub_buckets - 1;
+    return value_type(i % sub_buckets + sub_buckets) << shift;
+  }
+
+  template <unsigned Bits>
+  inline typename Histogram<Bits>::value_type
+  Histogram<Bits>::highest(size_t i)
+  {
+    if (i < size_t(sub_buckets))
+      return i;
+    unsigned shift = i / sub_buckets - 1;
+    return lowest(i) + ((value_type(1) << shift) - 1);
+  }
+
+  template <unsigned Bits>
+  template <typename T>
+  inline void
+  Histogram<Bits>::add(T v, uint64_t n)
+  {
+    size_t i = index(T(0) < v ? value_type(v) : 0);
+    if (counts_.size() <= i)
+      counts_.resize(i + 1, 0);
+    counts_[i] += n;
+    size_ += n;
+  }
+
+  template <unsigned Bits>
+  template <typename T>
+  inline void
+  Histogram<Bits>::remove(T v)
+  {
+    size_t i = index(T(0) < v ? value_type(v) : 0);
+    aver(i < counts_.size() && counts_[i]);
+    --counts_[i];
+    --size_;
+  }
+
+  template <unsigned Bits>
+  inline void
+  Histogram<Bits>::merge(const self_type& h)
+  {
+    if (counts_.size() < h.counts_.size())
+      counts_.resize(h.counts_.size(), 0);
+    for (size_t i = 0; i < h.counts_.size(); ++i)
+      counts_[i] += h.counts_[i];
+    size_ += h.size_;
+  }
+
+  template <unsigned Bits>
+  typename Histogram<Bits>::value_type
+  Histogram<Bits>::quantile(double q) const
+  {
+    if (!size_)
+      return 0;
+    // The rank of the sample, from 1 to size_.
+    uint64_t rank = q <= 0 ? 1 : uint64_t(std::ceil(q * size_));
+    if (rank < 1)
+      rank = 1;
+    if (size_ < rank)
+      rank = size_;
+    uint64_t seen = 0;
+    size_t i = 0;
+    for (; seen + counts_[i] < rank; ++i)
+      seen += counts_[i];
+    return lowest(i) + (highest(i) - lowest(i)) / 2;
+  }
+
+  template <unsigned Bits>
+  inline size_t
+  Histogram<Bits>::buckets() const
+  {
+    return counts_.size();
+  }
+
+  template <unsigned Bits>
+  inline uint64_t
+  Histogram<Bits>::count(size_t i) const
+  {
+    return i < counts_.size() ? counts_[i] : 0;
+  }
+
+  template <unsigned Bits>
+  std::ostream&
+  Histogram<Bits>::dump(std::ostream& o) const
+  {
+    o << Bits << ' ' << size_;
+    size_t gap = 0;
+    for (size_t i = 0; i < counts_.size(); ++i)
+      if (counts_[i])
+      {
+        o << ' ' << gap << ' ' << counts_[i];
+        gap = 0;
+      }
+      else
+        ++gap;
+    return o;
+  }
+
+  template <unsigned Bits>
+  bool
+  Histogram<Bits>::load(std::istream& i)
+  {
+    unsigned bits;
+    uint64_t size;
+    if (!(i >> bits >> size) || bits != Bits)
+      return false;
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    while (total < size)
+    {
+      size_t gap;
+      uint64_t count;
+      if (!(i >> gap >> count) || !count)
+        return false;
+      counts.resize(counts.size() + gap, 0);
+      counts.push_back(count);
+      total += count;
+    }
+    if (total != size)
+      return false;
+    counts_.swap(counts);
+    size_ = size;
+    return true;
+  }
+
+  template <unsigned Bits>
+  inline std::ostream&
+  operator<<(std::ostream& o, const Histogram<Bits>& h)
+  {
+    return h.dump(o);
+  }
+}
+
+#endif // !LIBPORT_HISTOGRAM_HXX
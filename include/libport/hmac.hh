@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_HMAC_HH
+# define LIBPORT_HMAC_HH
+# include <libport/config.h>
+# ifdef LIBPORT_ENABLE_SSL
+#   include <string>
+#   include <boost/noncopyable.hpp>
+#   include <libport/detect-win32.h>
+#   include <libport/export.hh>
+#   if !defined WIN32
+#     include <sys/uio.h>
+#   endif
+
+namespace libport
+{
+  /// A keyed HMAC computation.
+  ///
+  /// The key is hashed into the inner and outer pads once, at
+  /// construction, so signing many messages with the same key only
+  /// costs the hashing of the messages.  A message may be fed in
+  /// pieces with update(); final() returns its digest and gets ready
+  /// for the next message.
+  ///
+  /// See http://en.wikipedia.org/wiki/HMAC.
+  class LIBPORT_API Hmac: boost::noncopyable
+  {
+  public:
+    enum Algorithm
+    {
+      SHA1,
+      SHA256
+    };
+
+    Hmac(Algorithm algorithm, const std::string& key);
+    Hmac(Algorithm algorithm, const char* key, size_t size);
+    ~Hmac();
+
+    /// Size of the digests, in bytes.
+    size_t size() const;
+
+    /// Append \a size bytes from \a data to the message.
+    void update(const char* data, size_t size);
+    void update(const std::string& data);
+#   if !defined WIN32
+    /// Append the \a count buffers of \a iov to the message.
+    void update(const struct iovec* iov, size_t count);
+#   endif
+
+    /// Write the digest of the message to \a out, which must have
+    /// room for size() bytes, and start a new message.
+    void final(char* out);
+    /// The digest of the message, and start a new message.
+    std::string final();
+
+  private:
+    void init_(Algorithm algorithm, const char* key, size_t size);
+
+    /// The OpenSSL digest contexts.
+    struct Contexts;
+    Contexts* contexts_;
+    size_t size_;
+  };
+
+  /// The HMAC-SHA256 digest of \a input with \a key.
+  LIBPORT_API
+  std::string hmac_sha256(const std::string& input,
+                          const std::string& key);
+}
+
+# endif
+#endif
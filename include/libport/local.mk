@@ -85,6 +85,7 @@ libport_include_HEADERS +=                              \
   include/libport/containers.hh                         \
   include/libport/containers.hxx                        \
   include/libport/damerau-levenshtein-distance.hh       \
+  include/libport/damerau-levenshtein-distance.hxx      \
   include/libport/debug.hh                              \
   include/libport/debug.hxx                             \
   include/libport/deref.hh                              \
@@ -110,13 +111,20 @@ libport_include_HEADERS +=                              \
   include/libport/file-system.hh                        \
   include/libport/finally.hh                            \
   include/libport/finally.hxx                           \
+  include/libport/flat-hash-map.hh                      \
+  include/libport/flat-hash-map.hxx                     \
   include/libport/fnmatch.h                             \
   include/libport/fnmatch.hxx                           \
   include/libport/foreach.hh                            \
   include/libport/fwd.hh                                \
+  include/libport/future.hh                             \
+  include/libport/future.hxx                            \
   include/libport/hash.hh                               \
   include/libport/hierarchy.hh                          \
+  include/libport/histogram.hh                          \
+  include/libport/histogram.hxx                         \
   include/libport/hmac-sha1.hh                          \
+  include/libport/hmac.hh                               \
   include/libport/indent.hh                             \
   include/libport/input-arguments.hh                    \
   include/libport/input-arguments.hxx                   \
@@ -135,6 +143,8 @@ libport_include_HEADERS +=                              \
   include/libport/locale.hxx                            \
   include/libport/lockable.hh                           \
   include/libport/lockable.hxx                          \
+  include/libport/lockfree-queue.hh                     \
+  include/libport/lockfree-queue.hxx                    \
   include/libport/map.hh                                \
   include/libport/map.hxx                               \
   include/libport/markup-ostream.hh                     \
@@ -161,6 +171,8 @@ libport_include_HEADERS +=                              \
   include/libport/ref-pt.hh                             \
   include/libport/reserved-vector.hh                    \
   include/libport/reserved-vector.hxx                   \
+  include/libport/ring-fifo.hh                          \
+  include/libport/ring-fifo.hxx                         \
   include/libport/safe-container.hh                     \
   include/libport/safe-container.hxx                    \
   include/libport/sched.hh                              \
@@ -190,12 +202,15 @@ libport_include_HEADERS +=                              \
   include/libport/thread.hxx                            \
   include/libport/thread-data.hh                        \
   include/libport/thread-pool.hh                        \
+  include/libport/thread-pool.hxx                       \
   include/libport/throw-exception.hh                    \
   include/libport/time.hh                               \
   include/libport/time.hxx                              \
   include/libport/timer.hh                              \
   include/libport/timer.hxx                             \
   include/libport/tokenizer.hh                          \
+  include/libport/trace.hh                              \
+  include/libport/trace.hxx                             \
   include/libport/traits.hh                             \
   include/libport/type-info.hh                          \
   include/libport/type-info.hxx                         \
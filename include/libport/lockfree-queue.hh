@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_LOCKFREE_QUEUE_HH
+# define LIBPORT_LOCKFREE_QUEUE_HH
+
+# include <cstddef>
+
+# include <boost/noncopyable.hpp>
+# include <boost/static_assert.hpp>
+
+namespace libport
+{
+  /** Bounded multi-producer multi-consumer FIFO queue.
+   *
+   * Any number of threads may push and pop concurrently without
+   * taking a lock: each slot carries a sequence number telling whether
+   * it is ready to be written or read, and producers (respectively
+   * consumers) claim slots with a compare-and-swap on the enqueue
+   * (respectively dequeue) position.
+   *
+   * \p Size is the capacity of the queue, and must be a power of two.
+   */
+  template <typename T, size_t Size>
+  class LockFreeQueue: boost::noncopyable
+  {
+  public:
+    BOOST_STATIC_ASSERT(Size && !(Size & (Size - 1)));
+
+    LockFreeQueue();
+
+    /// Push \a v at the end of the queue.  Return false if the queue
+    /// is full.
+    bool push(const T& v);
+
+    /// Pop the head of the queue in \a v.  Return false if the queue
+    /// is empty.
+    bool pop(T& v);
+
+    /// Number of elements, only accurate when the queue is quiescent.
+    size_t size() const;
+
+    /// Whether the queue is empty, with the same accuracy as size().
+    bool empty() const;
+
+  private:
+    struct cell_type
+    {
+      volatile long sequence;
+      T value;
+    };
+
+    /// Keep the producers' and the consumers' positions on separate
+    /// cache lines.
+    enum { cache_line = 64 };
+
+    cell_type cells_[Size];
+    char pad0_[cache_line];
+    volatile long enqueue_;
+    char pad1_[cache_line];
+    volatile long dequeue_;
+    char pad2_[cache_line];
+  };
+}
+
+# include <libport/lockfree-queue.hxx>
+
+#endif // !LIBPORT_LOCKFREE_QUEUE_HH
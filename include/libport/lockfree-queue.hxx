@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_LOCKFREE_QUEUE_HXX
+# define LIBPORT_LOCKFREE_QUEUE_HXX
+
+# include <libport/atomic.hh>
+
+namespace libport
+{
+  template <typename T, size_t Size>
+  LockFreeQueue<T, Size>::LockFreeQueue()
+    : enqueue_(0)
+    , dequeue_(0)
+  {
+    for (size_t i = 0; i < Size; ++i)
+      cells_[i].sequence = i;
+  }
+
+  template <typename T, size_t Size>
+  bool
+  LockFreeQueue<T, Size>::push(const T& v)
+  {
+    long pos = enqueue_;
+    cell_type* cell;
+    while (true)
+    {
+      cell = &cells_[pos & (Size - 1)];
+      long seq = cell->sequence;
+      atomic::barrier();
+      long diff = seq - pos;
+      // The slot is free for this position: claim it.
+      if (!diff)
+      {
+        if (atomic::compare_and_swap(&enqueue_, pos, pos + 1))
+          break;
+      }
+      // The slot still holds the element pushed one lap ago.
+      else if (diff < 0)
+        return false;
+      pos = enqueue_;
+    }
+    cell->value = v;
+    atomic::barrier();
+    cell->sequence = pos + 1;
+    return true;
+  }
+
+  template <typename T, size_t Size>
+  bool
+  LockFreeQueue<T, Size>::pop(T& v)
+  {
+    long pos = dequeue_;
+    cell_type* cell;
+    while (true)
+    {
+      cell = &cells_[pos & (Size - 1)];
+      long seq = cell->sequence;
+      atomic::barrier();
+      long diff = seq - (pos + 1);
+      // The slot was filled for this position: claim it.
+      if (!diff)
+      {
+        if (atomic::compare_and_swap(&dequeue_, pos, pos + 1))
+          break;
+      }
+      // Nothing was pushed at this position yet.
+      else if (diff < 0)
+        return false;
+      pos = dequeue_;
+    }
+    v = cell->value;
+    // Do not keep a copy of the value alive in the queue.
+    cell->value = T();
+    atomic::barrier();
+    cell->sequence = pos + Size;
+    return true;
+  }
+
+  template <typename T, size_t Size>
+  size_t
+  LockFreeQueue<T, Size>::size() const
+  {
+    long res = enqueue_ - dequeue_;
+    return res < 0 ? 0 : res;
+  }
+
+  template <typename T, size_t Size>
+  bool
+  LockFreeQueue<T, Size>::empty() const
+  {
+    return !size();
+  }
+}
+
+#endif // !LIBPORT_LOCKFREE_QUEUE_HXX
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -12,7 +12,7 @@
 # define LIBPORT_REF_COUNTED_HH
 
 # include <boost/noncopyable.hpp>
-# include <libport/lockable.hh>
+# include <libport/atomic.hh>
 
 namespace libport
 {
@@ -45,15 +45,25 @@ namespace libport
       mutable count_type count_;
   };
 
-  class ThreadSafeRefCounted: RefCounted
+  /// A RefCounted whose references may be taken and released from
+  /// several threads.
+  ///
+  /// The count is updated with atomic operations, which are full
+  /// barriers: the writes of a thread releasing a reference are
+  /// visible to the thread which deletes the object.
+  class ThreadSafeRefCounted : boost::noncopyable
   {
   public:
+    typedef RefCounted::count_type count_type;
+    ThreadSafeRefCounted();
+    virtual ~ThreadSafeRefCounted();
     void counter_inc () const;
     bool counter_dec () const;
     count_type counter_get() const;
   protected:
     void counter_reset() const;
-    mutable libport::Lockable lock_;
+  private:
+    mutable volatile long count_;
   };
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -87,29 +87,49 @@ namespace libport
     ref_counted_.count_--;
   }
 
+  inline
+  ThreadSafeRefCounted::ThreadSafeRefCounted()
+    : count_(0)
+  {}
+
+  inline
+  ThreadSafeRefCounted::~ThreadSafeRefCounted()
+  {
+    // See ~RefCounted.
+    aver(count_ == dying_count || count_ == 0);
+    count_ = invalid_count;
+  }
+
   inline void
   ThreadSafeRefCounted::counter_inc() const
   {
-    libport::BlockLock bl(lock_);
-    RefCounted::counter_inc();
+    aver(count_ != invalid_count);
+    atomic::increment_fetch(&count_);
   }
+
   inline bool
   ThreadSafeRefCounted::counter_dec() const
   {
-    libport::BlockLock bl(lock_);
-    return RefCounted::counter_dec();
+    aver(count_ != invalid_count);
+    if (atomic::decrement_fetch(&count_))
+      return false;
+    // We held the last reference, no other thread may change it.
+    count_ = dying_count;
+    return true;
   }
+
   inline RefCounted::count_type
   ThreadSafeRefCounted::counter_get() const
   {
-    libport::BlockLock bl(lock_);
-    return RefCounted::counter_get();
+    long res = atomic::load_acquire(&count_);
+    aver(res != invalid_count);
+    return res;
   }
+
   inline void
   ThreadSafeRefCounted::counter_reset() const
   {
-    libport::BlockLock bl(lock_);
-    RefCounted::counter_reset();
+    atomic::store_release(&count_, 1);
   }
 }
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_RING_FIFO_HH
+# define LIBPORT_RING_FIFO_HH
+
+# include <cstddef>
+
+# include <boost/noncopyable.hpp>
+
+# include <libport/export.hh>
+
+namespace libport
+{
+  /*-----------------.
+  | MirroredBuffer.  |
+  `-----------------*/
+
+  /// A buffer whose storage is mapped twice, back to back, so that
+  /// any range of capacity() bytes starting in the first mapping is
+  /// contiguous.
+  ///
+  /// Where the mapping is not available, the buffer is a plain
+  /// allocation and mirrored() is false.
+  class LIBPORT_API MirroredBuffer: boost::noncopyable
+  {
+  public:
+    /// Build a buffer of at least \a capacity bytes, rounded up to a
+    /// power of two multiple of the page size.
+    MirroredBuffer(size_t capacity);
+    ~MirroredBuffer();
+
+    char* data() const;
+    size_t capacity() const;
+    bool mirrored() const;
+
+  private:
+    char* data_;
+    size_t capacity_;
+    bool mirrored_;
+  };
+
+  /*---------------.
+  | RingFifoBase.  |
+  `---------------*/
+
+  /// The consumer side of the ring FIFOs.
+  ///
+  /// Positions only grow, their remainder modulo the capacity is the
+  /// offset in the buffer.  The producers' and the consumer's ones
+  /// lie on separate cache lines.
+  class LIBPORT_API RingFifoBase: boost::noncopyable
+  {
+  public:
+    /// Consumer: the bytes which can be read, contiguous, and their
+    /// number in \a size.  All the queued bytes if the buffer is
+    /// mirrored, up to the end of the buffer otherwise.
+    const char* read_begin(size_t& size);
+    /// Consumer: release the \a n first bytes returned by read_begin.
+    void read_commit(size_t n);
+    /// Consumer: copy up to \a n bytes to \a data.
+    /// \return the number of bytes copied.
+    size_t pop(char* data, size_t n);
+
+    /// The number of queued bytes, exact only when called by the
+    /// consumer or the producer.
+    size_t size() const;
+    bool empty() const;
+    size_t capacity() const;
+    bool mirrored() const;
+
+  protected:
+    RingFifoBase(size_t capacity);
+
+    /// Writable span at \a position, for \a free bytes.
+    char* span_(unsigned long position, size_t& free) const;
+
+    enum { cache_line = 64 };
+
+    MirroredBuffer buffer_;
+    unsigned long mask_;
+    char pad0_[cache_line];
+    /// Written by the consumer.
+    volatile long read_;
+    /// The consumer's last view of write_.
+    unsigned long write_cache_;
+    char pad1_[cache_line];
+    /// Written by the producers, bytes before are readable.
+    volatile long write_;
+    /// The producer's last view of read_, single producer only.
+    unsigned long read_cache_;
+    char pad2_[cache_line];
+  };
+
+  /*-----------.
+  | RingFifo.  |
+  `-----------*/
+
+  /// Lock-free byte FIFO for a single producer and a single consumer,
+  /// which may run in two threads.
+  ///
+  /// Unlike Fifo, the data is never moved: the producer writes in
+  /// place in the span returned by write_begin(), and makes several
+  /// bytes readable at once with write_commit().
+  class LIBPORT_API RingFifo: public RingFifoBase
+  {
+  public:
+    RingFifo(size_t capacity = 65536);
+
+    /// Producer: where up to \a size bytes can be written, contiguous.
+    char* write_begin(size_t& size);
+    /// Producer: make the \a n first bytes of the span readable.
+    void write_commit(size_t n);
+    /// Producer: copy as much of \a data as fits.
+    /// \return the number of bytes copied.
+    size_t push(const char* data, size_t n);
+  };
+
+  /*------------------------.
+  | MultiProducerRingFifo.  |
+  `------------------------*/
+
+  /// Lock-free byte FIFO for several producers and a single consumer.
+  ///
+  /// Each producer reserves a span, with a compare-and-swap, and fills
+  /// it.  Spans become readable in the order of their reservation, so
+  /// a producer committing its span waits for the previous ones.
+  class LIBPORT_API MultiProducerRingFifo: public RingFifoBase
+  {
+  public:
+    MultiProducerRingFifo(size_t capacity = 65536);
+
+    /// Producer: reserve \a n contiguous bytes, and store their
+    /// position, to give to write_commit(), in \a position.
+    /// \return where to write them, or 0 if they do not fit, or would
+    /// wrap around the end of a buffer which is not mirrored.
+    char* write_begin(size_t n, unsigned long& position);
+    /// Producer: make the span reserved at \a position readable.
+    void write_commit(unsigned long position, size_t n);
+    /// Producer: copy \a data, not interleaved with other producers.
+    /// \return whether it fit.
+    bool push(const char* data, size_t n);
+
+  private:
+    /// Reserve \a n bytes, unless \a contiguous and they would wrap.
+    bool reserve_bytes_(size_t n, bool contiguous, unsigned long& position);
+
+    char pad_[cache_line];
+    /// Bytes before are reserved by the producers.
+    volatile long reserve_;
+  };
+}
+
+# include <libport/ring-fifo.hxx>
+
+#endif // !LIBPORT_RING_FIFO_HH
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_RING_FIFO_HXX
+# define LIBPORT_RING_FIFO_HXX
+
+# include <libport/atomic.hh>
+# include <libport/cassert>
+
+namespace libport
+{
+  /*-----------------.
+  | MirroredBuffer.  |
+  `-----------------*/
+
+  inline char*
+  MirroredBuffer::data() const
+  {
+    return data_;
+  }
+
+  inline size_t
+  MirroredBuffer::capacity() const
+  {
+    return capacity_;
+  }
+
+  inline bool
+  MirroredBuffer::mirrored() const
+  {
+    return mirrored_;
+  }
+
+  /*---------------.
+  | RingFifoBase.  |
+  `---------------*/
+
+  inline const char*
+  RingFifoBase::read_begin(size_t& size)
+  {
+    unsigned long r = read_;
+    write_cache_ = atomic::load_acquire(&write_);
+    size = write_cache_ - r;
+    size_t offset = r & mask_;
+    if (!buffer_.mirrored() && capacity() - offset < size)
+      size = capacity() - offset;
+    return buffer_.data() + offset;
+  }
+
+  inline void
+  RingFifoBase::read_commit(size_t n)
+  {
+    aver_le(n, size_t(write_cache_ - read_));
+    atomic::store_release(&read_, read_ + n);
+  }
+
+  inline size_t
+  RingFifoBase::size() const
+  {
+    return (unsigned long)(atomic::load_acquire(&write_))
+      - (unsigned long)(atomic::load_acquire(&read_));
+  }
+
+  inline bool
+  RingFifoBase::empty() const
+  {
+    return !size();
+  }
+
+  inline size_t
+  RingFifoBase::capacity() const
+  {
+    return buffer_.capacity();
+  }
+
+  inline bool
+  RingFifoBase::mirrored() const
+  {
+    return buffer_.mirrored();
+  }
+
+  inline char*
+  RingFifoBase::span_(unsigned long position, size_t& free) const
+  {
+    size_t offset = position & mask_;
+    if (!buffer_.mirrored() && capacity() - offset < free)
+      free = capacity() - offset;
+    return buffer_.data() + offset;
+  }
+
+  /*-----------.
+  | RingFifo.  |
+  `-----------*/
+
+  inline char*
+  RingFifo::write_begin(size_t& size)
+  {
+    unsigned long w = write_;
+    read_cache_ = atomic::load_acquire(&read_);
+    size = capacity() - (w - read_cache_);
+    return span_(w, size);
+  }
+
+  inline void
+  RingFifo::write_commit(size_t n)
+  {
+    aver_le(n, capacity() - size_t(write_ - read_cache_));
+    atomic::store_release(&write_, write_ + n);
+  }
+}
+
+#endif // !LIBPORT_RING_FIFO_HXX
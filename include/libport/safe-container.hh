@@ -12,6 +12,10 @@
 # define LIBPORT_SAFE_CONTAINER_HH
 
 # include <cstddef> // ptrdiff_t
+# include <deque>
+# include <iterator>
+# include <memory>
+# include <vector>
 
 namespace libport
 {
@@ -142,6 +146,130 @@ namespace libport
     friend class iterator;
     container_type_ container;
   };
+
+  /** SafeContainer backed by a contiguous vector.
+   *
+   * Same guarantees as the generic version, without its limits: any
+   * number of iterators may be live at the same time, and copies of
+   * iterators may be incremented independently.
+   *
+   * Each element records the epoch of its insertion, and each
+   * iterator the epoch of its begin(), so that it ignores the
+   * elements added since.  While iterators are live, erase() only
+   * marks the element as dead, and push_back() queues the new element
+   * in a deque, so that the elements do not move.  The vector is
+   * compacted, and the epochs restart, as soon as the last iterator
+   * is gone.  Live iterators are chained to their container, so that
+   * insertions in the middle can shift them.
+   *
+   * Unlike with the list, insert() and push_front() before the queued
+   * elements move the next ones: while iterating, references to the
+   * elements are invalidated by these insertions.
+   */
+  template <class T>
+  class SafeContainer<std::vector, T>
+  {
+  public:
+    typedef SafeContainer<std::vector, T> self_type;
+    typedef T value_type;
+    typedef T* pointer_type;
+    typedef T& reference_type;
+
+    class iterator
+    {
+    public:
+      typedef SafeContainer<std::vector, T> owner_type;
+      typedef T value_type;
+      typedef ptrdiff_t difference_type;
+      typedef T* pointer_type;
+      typedef T* pointer;
+      typedef T& reference_type;
+      typedef T& reference;
+      typedef std::forward_iterator_tag iterator_category;
+
+      /// The end.
+      iterator();
+      iterator(const iterator& i);
+      ~iterator();
+      iterator& operator=(const iterator& i);
+
+      value_type& operator*() const;
+      value_type* operator->() const;
+      bool operator==(const iterator& i) const;
+      bool operator!=(const iterator& i) const;
+      iterator& operator++();
+      iterator operator++(int);
+
+    private:
+      friend class SafeContainer<std::vector, T>;
+      iterator(owner_type& owner, unsigned long epoch);
+      /// Move to the next element inserted before our epoch, or to
+      /// the end.
+      void skip_();
+      void link_();
+      void unlink_();
+
+      /// 0 at the end.
+      owner_type* owner_;
+      size_t pos_;
+      unsigned long epoch_;
+      /// The other live iterators of owner_.
+      iterator* prev_;
+      iterator* next_;
+    };
+    typedef iterator const_iterator;
+
+    SafeContainer();
+    SafeContainer(const SafeContainer& c);
+    ~SafeContainer();
+    SafeContainer& operator=(const SafeContainer& c);
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    void erase(iterator v);
+    void push_back(const T& t);
+    void push_front(const T& t);
+    void pop_front();
+    void pop_back();
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    template<typename I>
+    void insert(iterator where, I beg, I end);
+
+  private:
+    struct slot
+    {
+      slot(const T& v, unsigned long epoch);
+      T v;
+      /// Epoch of the insertion, ULONG_MAX once erased.
+      unsigned long epoch;
+    };
+    typedef std::vector<slot> slots_type;
+    typedef std::deque<slot> tail_type;
+
+    /// The element at \a pos, in slots_ then tail_.
+    slot& at_(size_t pos);
+    /// Erase the element at \a pos, or mark it as dead.
+    void erase_(size_t pos);
+    /// Remove the dead elements, move tail_ to slots_, and restart
+    /// the epochs.  Once there are no live iterators.
+    void compact_();
+
+    slots_type slots_;
+    /// The elements added at the end while iterating.
+    tail_type tail_;
+    /// Number of dead elements in slots_ and tail_.
+    size_t dead_;
+    /// Whether elements were inserted in slots_ while iterating.
+    bool renumber_;
+    /// Incremented by begin(), back to 0 with no live iterators.
+    unsigned long epoch_;
+    /// Live iterators.
+    iterator* iterators_;
+  };
 }
 
 # include <libport/safe-container.hxx>
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,6 +11,7 @@
 #ifndef LIBPORT_SAFE_CONTAINER_HXX
 # define LIBPORT_SAFE_CONTAINER_HXX
 
+# include <climits>
 # include <stdexcept>
 # include <iostream>
 # include <libport/preproc.hh>
@@ -300,7 +301,353 @@ namespace libport
     res.val = currentMask & nextFlag;
     return res;
   }
+
+  /*----------------------------------.
+  | SafeContainer<std::vector, T>.    |
+  `----------------------------------*/
+
+#define VECTOR                                  \
+  SafeContainer<std::vector, T>
+
+#define VECTOR_SMETHOD(Ret)                     \
+  template <class T>                            \
+  inline                                        \
+  Ret                                           \
+  VECTOR::
+
+#define VECTOR_METHOD(Ret)                      \
+  VECTOR_SMETHOD(typename VECTOR::Ret)
+
+  VECTOR_SMETHOD(__) iterator::iterator()
+    : owner_(0)
+    , pos_(0)
+    , epoch_(0)
+    , prev_(0)
+    , next_(0)
+  {
+  }
+
+  VECTOR_SMETHOD(__) iterator::iterator(owner_type& owner, unsigned long epoch)
+    : owner_(&owner)
+    , pos_(0)
+    , epoch_(epoch)
+    , prev_(0)
+    , next_(0)
+  {
+    link_();
+    skip_();
+  }
+
+  VECTOR_SMETHOD(__) iterator::iterator(const iterator& i)
+    : owner_(i.owner_)
+    , pos_(i.pos_)
+    , epoch_(i.epoch_)
+    , prev_(0)
+    , next_(0)
+  {
+    if (owner_)
+      link_();
+  }
+
+  VECTOR_SMETHOD(__) iterator::~iterator()
+  {
+    if (owner_)
+      unlink_();
+  }
+
+  VECTOR_METHOD(iterator&) iterator::operator=(const iterator& i)
+  {
+    if (this != &i)
+    {
+      // If i has the same owner, it stays live: no compaction.
+      if (owner_)
+        unlink_();
+      owner_ = i.owner_;
+      pos_ = i.pos_;
+      epoch_ = i.epoch_;
+      if (owner_)
+        link_();
+    }
+    return *this;
+  }
+
+  VECTOR_METHOD(iterator::value_type&) iterator::operator*() const
+  {
+    return owner_->at_(pos_).v;
+  }
+
+  VECTOR_METHOD(iterator::value_type*) iterator::operator->() const
+  {
+    return &owner_->at_(pos_).v;
+  }
+
+  VECTOR_SMETHOD(bool) iterator::operator==(const iterator& i) const
+  {
+    if (!owner_ || !i.owner_)
+      return !owner_ && !i.owner_;
+    return owner_ == i.owner_ && pos_ == i.pos_;
+  }
+
+  VECTOR_SMETHOD(bool) iterator::operator!=(const iterator& i) const
+  {
+    return !(*this == i);
+  }
+
+  VECTOR_METHOD(iterator&) iterator::operator++()
+  {
+    if (owner_)
+    {
+      ++pos_;
+      skip_();
+    }
+    return *this;
+  }
+
+  VECTOR_METHOD(iterator) iterator::operator++(int)
+  {
+    iterator res = *this;
+    ++*this;
+    return res;
+  }
+
+  VECTOR_SMETHOD(void) iterator::skip_()
+  {
+    // The dead elements have the largest epoch.
+    const size_t size = owner_->slots_.size() + owner_->tail_.size();
+    while (pos_ < size && epoch_ <= owner_->at_(pos_).epoch)
+      ++pos_;
+    if (pos_ == size)
+    {
+      unlink_();
+      owner_ = 0;
+    }
+  }
+
+  VECTOR_SMETHOD(void) iterator::link_()
+  {
+    next_ = owner_->iterators_;
+    if (next_)
+      next_->prev_ = this;
+    owner_->iterators_ = this;
+  }
+
+  VECTOR_SMETHOD(void) iterator::unlink_()
+  {
+    if (prev_)
+      prev_->next_ = next_;
+    else
+      owner_->iterators_ = next_;
+    if (next_)
+      next_->prev_ = prev_;
+    prev_ = next_ = 0;
+    if (!owner_->iterators_)
+      owner_->compact_();
+  }
+
+  VECTOR_SMETHOD(__) slot::slot(const T& v, unsigned long epoch)
+    : v(v)
+    , epoch(epoch)
+  {
+  }
+
+  VECTOR_SMETHOD(__) SafeContainer()
+    : dead_(0)
+    , renumber_(false)
+    , epoch_(0)
+    , iterators_(0)
+  {
+  }
+
+  VECTOR_SMETHOD(__) SafeContainer(const SafeContainer& c)
+    : dead_(0)
+    , renumber_(false)
+    , epoch_(0)
+    , iterators_(0)
+  {
+    *this = c;
+  }
+
+  VECTOR_SMETHOD(__) ~SafeContainer()
+  {
+    // Leave the remaining iterators at the end.
+    for (iterator* i = iterators_; i; i = i->next_)
+      i->owner_ = 0;
+  }
+
+  VECTOR_METHOD(self_type&) operator=(const SafeContainer& c)
+  {
+    if (this != &c)
+    {
+      clear();
+      foreach (const slot& s, c.slots_)
+        if (s.epoch != ULONG_MAX)
+          push_back(s.v);
+      foreach (const slot& s, c.tail_)
+        if (s.epoch != ULONG_MAX)
+          push_back(s.v);
+    }
+    return *this;
+  }
+
+  VECTOR_METHOD(iterator) begin()
+  {
+    if (empty())
+      return end();
+    return iterator(*this, ++epoch_);
+  }
+
+  VECTOR_METHOD(iterator) end()
+  {
+    return iterator();
+  }
+
+  VECTOR_METHOD(iterator) begin() const
+  {
+    return const_cast<self_type*>(this)->begin();
+  }
+
+  VECTOR_METHOD(iterator) end() const
+  {
+    return iterator();
+  }
+
+  VECTOR_SMETHOD(void) erase(iterator v)
+  {
+    erase_(v.pos_);
+  }
+
+  VECTOR_SMETHOD(void) push_back(const value_type& t)
+  {
+    // Reallocating slots_ would move the elements under the feet of
+    // the iterations.
+    if (iterators_)
+      tail_.push_back(slot(t, epoch_));
+    else
+      slots_.push_back(slot(t, epoch_));
+  }
+
+  VECTOR_SMETHOD(void) push_front(const value_type& t)
+  {
+    const value_type* v = &t;
+    insert(begin(), v, v + 1);
+  }
+
+  VECTOR_SMETHOD(void) pop_front()
+  {
+    size_t i = 0;
+    while (at_(i).epoch == ULONG_MAX)
+      ++i;
+    erase_(i);
+  }
+
+  VECTOR_SMETHOD(void) pop_back()
+  {
+    size_t i = slots_.size() + tail_.size() - 1;
+    while (at_(i).epoch == ULONG_MAX)
+      --i;
+    erase_(i);
+  }
+
+  VECTOR_SMETHOD(void) clear()
+  {
+    if (iterators_)
+    {
+      foreach (slot& s, slots_)
+        s.epoch = ULONG_MAX;
+      foreach (slot& s, tail_)
+        s.epoch = ULONG_MAX;
+      dead_ = slots_.size() + tail_.size();
+    }
+    else
+      slots_.clear();
+  }
+
+  VECTOR_SMETHOD(size_t) size() const
+  {
+    return slots_.size() + tail_.size() - dead_;
+  }
+
+  VECTOR_SMETHOD(bool) empty() const
+  {
+    return !size();
+  }
+
+  template <class T>
+  template <typename I>
+  inline
+  void VECTOR::insert(iterator where, I beg, I end)
+  {
+    size_t pos = where.owner_ ? where.pos_ : slots_.size() + tail_.size();
+    size_t n = 0;
+    if (iterators_ && slots_.size() <= pos)
+    {
+      // Queued, as push_back does.
+      typename tail_type::iterator t = tail_.begin() + (pos - slots_.size());
+      for (I i = beg; i != end; ++i, ++n)
+        t = tail_.insert(t, slot(*i, epoch_)) + 1;
+    }
+    else
+    {
+      slots_type slots;
+      for (I i = beg; i != end; ++i)
+        slots.push_back(slot(*i, epoch_));
+      slots_.insert(slots_.begin() + pos, slots.begin(), slots.end());
+      n = slots.size();
+      if (iterators_)
+        renumber_ = true;
+    }
+    // Keep the live iterators on their element.
+    for (iterator* i = iterators_; i; i = i->next_)
+      if (pos <= i->pos_)
+        i->pos_ += n;
+  }
+
+  VECTOR_METHOD(slot&) at_(size_t pos)
+  {
+    if (pos < slots_.size())
+      return slots_[pos];
+    return tail_[pos - slots_.size()];
+  }
+
+  VECTOR_SMETHOD(void) erase_(size_t pos)
+  {
+    if (iterators_)
+    {
+      at_(pos).epoch = ULONG_MAX;
+      ++dead_;
+    }
+    else
+      slots_.erase(slots_.begin() + pos);
+  }
+
+  VECTOR_SMETHOD(void) compact_()
+  {
+    if (dead_ || renumber_ || !tail_.empty())
+    {
+      size_t j = 0;
+      for (size_t i = 0; i < slots_.size(); ++i)
+        if (slots_[i].epoch != ULONG_MAX)
+        {
+          if (i != j)
+            slots_[j] = slots_[i];
+          slots_[j].epoch = 0;
+          ++j;
+        }
+      slots_.erase(slots_.begin() + j, slots_.end());
+      foreach (const slot& s, tail_)
+        if (s.epoch != ULONG_MAX)
+          slots_.push_back(slot(s.v, 0));
+      tail_.clear();
+      dead_ = 0;
+      renumber_ = false;
+    }
+    // All the elements are at epoch 0: restart, lest the epochs wrap.
+    epoch_ = 0;
+  }
 }
+#undef VECTOR
+#undef VECTOR_METHOD
+#undef VECTOR_SMETHOD
 #undef CONTAINER
 #undef CONTAINER_METHOD
 #undef CONTAINER_SMETHOD
@@ -11,6 +11,8 @@
 #ifndef LIBPORT_SCHED_HH
 # define LIBPORT_SCHED_HH
 
+# include <vector>
+
 # include <libport/export.hh>
 
 namespace libport
@@ -18,6 +20,10 @@ namespace libport
   LIBPORT_API int sched_estimate_granularity();
 
   LIBPORT_API void sched_set_high_priority ();
+
+  /// Restrict the calling thread to the given CPUs.
+  /// \return whether it was possible.
+  LIBPORT_API bool sched_set_affinity(const std::vector<unsigned>& cpus);
 }
 
 #endif // !LIBPORT_SCHED_HH
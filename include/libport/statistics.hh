@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -13,18 +13,34 @@
 
 # include <vector>
 
+# include <libport/histogram.hh>
+
 namespace libport
 {
 
+  /// The histogram of Statistics which do not compute quantiles.
+  struct NoHistogram
+  {
+    template <typename T>
+    void add(T) {}
+    template <typename T>
+    void remove(T) {}
+    void merge(const NoHistogram&) {}
+    void clear() {}
+  };
+
   /// \c T is the type of the samples, \c R is the type of the result
   /// and intermediate computations.
   /// \c T must be a type convertible to \c R and \c R must be a type
   /// compatible to double.
-  template<typename T, typename R = double>
+  /// \c H keeps the distribution of the samples for quantile(): a
+  /// Histogram, or NoHistogram.
+  template<typename T, typename R = double, typename H = NoHistogram>
   class Statistics
   {
   public:
-    typedef Statistics<T, R> self_type;
+    typedef Statistics<T, R, H> self_type;
+    typedef H histogram_type;
 
     Statistics(size_t capacity = 0);
     void resize(size_t capacity);
@@ -32,6 +48,9 @@ namespace libport
     size_t size() const;
     bool empty() const;
     void add_sample(T value);
+    /// Add the samples of \a s, which must be running if this is
+    /// running.  Running statistics are given the samples of \a s
+    /// in order, the others merge its results.
     void add_samples(const self_type& s);
     size_t n_samples() const;
     R mean() const;
@@ -39,6 +58,10 @@ namespace libport
     R standard_deviation() const;
     T min() const;
     T max() const;
+    /// The value under which are a fraction \a q of the samples,
+    /// approximated by the histogram.
+    R quantile(double q) const;
+    const histogram_type& histogram() const;
   private:
     /// Update or invalidate min and max values.
     void update_min_max(T value);
@@ -52,6 +75,7 @@ namespace libport
     mutable T max_;
     mutable bool min_ok_;
     mutable bool max_ok_;
+    histogram_type histogram_;
   };
 
 } // namespace libport
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -17,26 +17,27 @@
 namespace libport
 {
 
-  template<typename T, typename R>
-  Statistics<T, R>::Statistics(size_t capacity)
+  template<typename T, typename R, typename H>
+  Statistics<T, R, H>::Statistics(size_t capacity)
   {
     resize(capacity);
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline void
-  Statistics<T, R>::resize(size_t capacity)
+  Statistics<T, R, H>::resize(size_t capacity)
   {
     capacity_ = capacity;
     count_ = index_ = 0;
     sum_ = sum2_ = 0;
     min_ok_ = max_ok_ = false;
     samples_.resize(capacity_);
+    histogram_.clear();
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline void
-  Statistics<T, R>::update_min_max(T value)
+  Statistics<T, R, H>::update_min_max(T value)
   {
     if (count_++)
     {
@@ -52,9 +53,9 @@ namespace libport
     }
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline void
-  Statistics<T, R>::add_sample(T value)
+  Statistics<T, R, H>::add_sample(T value)
   {
     if (capacity_)  // Running
     {
@@ -86,6 +87,7 @@ namespace libport
 	const T old_value = samples_[index_];
 	sum_ -= old_value;
 	sum2_ -= old_value * old_value;
+	histogram_.remove(old_value);
       }
 
       // Store the sample.
@@ -97,14 +99,30 @@ namespace libport
     // Update sums.
     sum_ += value;
     sum2_ += value * value;
+    histogram_.add(value);
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline void
-  Statistics<T, R>::add_samples(const self_type& s)
+  Statistics<T, R, H>::add_samples(const self_type& s)
   {
-    if (capacity_ || s.capacity_)  // Running
-      pabort("FIXME: implement add_samples");
+    if (s.capacity_)  // Running
+    {
+      if (&s == this)
+      {
+        self_type copy(s);
+        add_samples(copy);
+        return;
+      }
+      // Oldest first.
+      size_t first =
+        s.count_ < s.capacity_ ? 0 : (s.index_ + 1) % s.capacity_;
+      for (size_t i = 0; i < s.count_; ++i)
+        add_sample(s.samples_[(first + i) % s.capacity_]);
+      return;
+    }
+    // The samples of s are not kept.
+    aver(!capacity_);
 
     count_ += s.count_;
     sum_ += s.sum_;
@@ -113,45 +131,46 @@ namespace libport
     max_ = (!s.max_ok_ || (max_ok_ && s.max_ < max_)) ? max_ : s.max_;
     min_ok_ = min_ok_ || s.min_ok_;
     max_ok_ = max_ok_ || s.max_ok_;
+    histogram_.merge(s.histogram_);
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline size_t
-  Statistics<T, R>::size() const
+  Statistics<T, R, H>::size() const
   {
     return count_;
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline size_t
-  Statistics<T, R>::n_samples() const
+  Statistics<T, R, H>::n_samples() const
   {
     return count_;
   }
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline size_t
-  Statistics<T, R>::capacity() const
+  Statistics<T, R, H>::capacity() const
   {
     return capacity_;
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline bool
-  Statistics<T, R>::empty() const
+  Statistics<T, R, H>::empty() const
   {
     return !size();
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline R
-  Statistics<T, R>::mean() const
+  Statistics<T, R, H>::mean() const
   {
     return static_cast<R>(sum_) / static_cast<R>(count_);
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline R
-  Statistics<T, R>::variance() const
+  Statistics<T, R, H>::variance() const
   {
     return (static_cast<R>(sum2_) -
 	    (static_cast<R>(sum_) * static_cast<R>(sum_))
@@ -159,16 +178,16 @@ namespace libport
       static_cast<R>(count_);
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline R
-  Statistics<T, R>::standard_deviation() const
+  Statistics<T, R, H>::standard_deviation() const
   {
     return static_cast<R>(sqrt(static_cast<double>(variance())));
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline T
-  Statistics<T, R>::min() const
+  Statistics<T, R, H>::min() const
   {
     if (!min_ok_)
     {
@@ -181,9 +200,9 @@ namespace libport
     return min_;
   }
 
-  template<typename T, typename R>
+  template<typename T, typename R, typename H>
   inline T
-  Statistics<T, R>::max() const
+  Statistics<T, R, H>::max() const
   {
     if (!max_ok_)
     {
@@ -196,6 +215,20 @@ namespace libport
     return max_;
   }
 
+  template<typename T, typename R, typename H>
+  inline R
+  Statistics<T, R, H>::quantile(double q) const
+  {
+    return static_cast<R>(histogram_.quantile(q));
+  }
+
+  template<typename T, typename R, typename H>
+  inline const typename Statistics<T, R, H>::histogram_type&
+  Statistics<T, R, H>::histogram() const
+  {
+    return histogram_;
+  }
+
 } // namespace libport
 
 #endif // LIBPORT_STATISTICS_HXX
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011, Gostai S.A.S.
+ * Copyright (C) 2010-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,22 +11,34 @@
 #ifndef LIBPORT_THREAD_POOL_HH
 # define LIBPORT_THREAD_POOL_HH
 
+# include <deque>
 # include <list>
+# include <vector>
 
 # include <boost/function.hpp>
 
 # include <libport/export.hh>
+# include <libport/future.hh>
 # include <libport/intrusive-ptr.hh>
 # include <libport/lockable.hh>
+# include <libport/lockfree-queue.hh>
 # include <libport/ref-counted.hh>
 # include <libport/semaphore.hh>
+# include <libport/statistics.hh>
+# include <libport/thread-data.hh>
+# include <libport/utime.hh>
 
 namespace libport
 {
   /** Simple ThreadPool implementation.
-   * This is a shared-queue ThreadPool implementation with support for
+   * This is a work-stealing ThreadPool implementation with support for
    * 'locks' that prevents tasks sharing the same lock from executing in
    * parallel.
+   *
+   * Tasks queued from outside the pool go through a lock-free queue.
+   * Tasks queued by a task running in the pool go to the deque of its
+   * worker, which runs them last-in first-out; idle workers steal the
+   * oldest tasks of the others.
    */
   class LIBPORT_API ThreadPool
   {
@@ -57,6 +69,10 @@ namespace libport
         DROPPED
       };
       State getState() const;
+
+      /// Task handles are recycled from a pool.
+      static void* operator new(size_t size);
+      static void operator delete(void* obj);
     private:
       State state_;
       friend class ThreadPool;
@@ -73,6 +89,8 @@ namespace libport
       */
       TaskLock(unsigned int maxSize);
     private:
+      /// Protects waitingTasks and registered.
+      Lockable waitingLock;
       std::list<rTaskHandle> waitingTasks;
       bool registered;
       /// Thread handling this task set.
@@ -83,10 +101,54 @@ namespace libport
 
     /// Create a new thread pool that can grow up to \b maxThreads threads.
     ThreadPool(size_t maxThreads = 0);
+    /** Wait for the queued tasks to complete, and stop the threads.
+    *  Must not be called from a task of the pool, and no task may be
+    *  queued from outside of the pool meanwhile.
+    */
+    ~ThreadPool();
 
     /// Set maximum number of threads in pool
     void resize(size_t maxThreads);
 
+    /// CPUs a thread may run on.
+    typedef std::vector<unsigned> CpuSet;
+
+    /** Pin the threads started from now on: the i-th one runs on the
+    *  CPUs of \b cpus[i % cpus.size()].  Pinned threads allocate
+    *  their own data once pinned, so that on NUMA systems it lives on
+    *  the node of their CPUs.  An empty vector disables pinning.
+    */
+    void setAffinity(const std::vector<CpuSet>& cpus);
+
+    /** Let idle threads spin up to \b maxSpin rounds waiting for tasks
+    *  before sleeping.  Each thread adapts its spin between 0 and
+    *  maxSpin: it doubles it when spinning found a task, and halves it
+    *  otherwise.  0, the default, disables spinning, which is best
+    *  when the pool has as many threads as CPUs.
+    */
+    void setSpin(unsigned maxSpin);
+
+    /// Measurements of the pool behavior, see setMetrics().
+    struct Metrics
+    {
+      Metrics();
+      /// Time between waking up or spawning a thread and its running.
+      Statistics<utime_t, double, Histogram<> > wakeupLatency;
+      /// Number of waiting tasks, sampled when queuing one.
+      Statistics<long> queueDepth;
+      /// Number of times idle threads found a task by spinning.
+      size_t spinHits;
+      /// Number of times idle threads went to sleep.
+      size_t sleeps;
+    };
+
+    /// Enable or disable measurements.  They are off by default, as
+    /// they take a lock when queuing tasks.
+    void setMetrics(bool enable);
+    /// The measurements since the last reset.
+    Metrics metrics();
+    void resetMetrics();
+
     /** Queue a new task.
     *  @param func the function to execute when the task is scheduled.
     *  @param lock inter-task lock: no two tasks with the same lock will be
@@ -95,34 +157,140 @@ namespace libport
     rTaskHandle queueTask(TaskFunc func,
                           rTaskLock lock = 0);
 
+    /** Queue a new task computing a value.
+    *  @param func the function to execute when the task is scheduled.
+    *  @param lock as for queueTask.  A dropped task yields a future
+    *    holding a TaskDropped exception.
+    *  @return the future result of \b func.
+    */
+    template <typename F>
+    Future<typename boost::result_of<F()>::type>
+    async(F func, rTaskLock lock = 0);
+
+    /** Run \b chunk(i) for every i in [0, n), in parallel on the pool
+    *  threads and the calling thread.  Return once they are all done,
+    *  rethrowing the first exception raised by one of them, in which
+    *  case the chunks not started yet are skipped.
+    *
+    *  The calling thread processes chunks too and only waits for the
+    *  chunks already running, so it is safe to call from a task of
+    *  this pool.
+    */
+    void runChunks(size_t n, const boost::function1<void, size_t>& chunk);
+
     /// Return number of tasks in queue.
     size_t queueSize();
 
   private:
     void threadLoop(rThread thnead);
+    /// Make \a task available to the workers.
+    void schedule(const rTaskHandle& task);
+    /// Wake up an idle thread, or spawn a new one if allowed.
+    void wake();
+    /// Get a task for \a thread, sleeping until one is available, or
+    /// 0 if the pool is stopping.
+    rTaskHandle fetch(rThread thread);
+    /// Get a task for \a thread if one is available, 0 otherwise.
+    rTaskHandle tryFetch(rThread thread);
+    /// Whether some tasks wait for a thread.
+    bool pending() const;
+    /// \a thread, woken up by wake(), is no longer on its way.
+    void awake(rThread thread);
+    /// Remove \a thread from the pool if it exceeds maxThreads_, or if
+    /// the pool is stopping and no task is left.
+    bool retire(rThread thread);
+    /// Spin until some task is available, return whether one is.
+    bool spin(rThread thread);
+    /// Apply the affinity policy to the current thread.
+    void pin(rThread thread);
+
+    /// Protects the thread lists and the overflow queue.
     Lockable lock_;
-    /// Main task queue (locked by lock_).
-    std::list<rTaskHandle> queue_;
-    /// Cached number of locked tasks.
-    size_t nLockedTasks_;
+    /// Tasks queued from outside of the pool.
+    LockFreeQueue<rTaskHandle, 4096> injection_;
+    /// Tasks that did not fit in injection_ (locked by lock_).
+    std::list<rTaskHandle> overflow_;
+    /// Cached size of overflow_.
+    volatile long nOverflow_;
+    /// Number of tasks in the deques of the threads.
+    volatile long nLocal_;
+    /// Number of tasks that did not start yet, including locked ones.
+    volatile long nQueued_;
 
     class LIBPORT_API Thread: public ThreadSafeRefCounted
     {
     public:
+      Thread(ThreadPool* pool);
       /// Must have a dtor to avoid a g++ 'sorry, unimplemented' inlining error
       ~Thread();
       pthread_t handle;
       Semaphore sem;
       rTaskHandle currentTask;
       rTaskLock  taskLock; //taskLock we currently handle
+      /// The pool this thread works for.
+      ThreadPool* pool;
+      /// Whether wake() woke this thread up, and it did not fetch a
+      /// task yet.
+      bool waking;
+      /// Tasks queued by this thread (locked by tasksLock).
+      std::deque<rTaskHandle> tasks;
+      Lockable tasksLock;
+      /// Rank of the thread among the ones started by the pool.
+      size_t rank;
+      /// Current spin length.
+      unsigned spin;
+      /// When wake() woke us up, if metrics are enabled.
+      utime_t wokenAt;
     };
 
     /// All threads (locked by lock_)
-    std::list<rThread> threads_;
+    std::vector<rThread> threads_;
     /// Idle threads (locked by lock_)
     std::vector<rThread> idleThreads_;
+    /// Cached sizes of threads_ and idleThreads_.
+    volatile long nThreads_;
+    volatile long nIdle_;
+    /// Number of threads woken up that did not fetch a task yet.
+    volatile long nWaking_;
+    /// The pool thread running on the current thread, if any.
+    static UnmanagedThreadSpecificPtr<Thread> current_;
+    /// Where the next theft starts in threads_.
+    size_t stealFrom_;
     size_t maxThreads_;
+    /// Whether the destructor runs: no thread may sleep nor start.
+    volatile bool stopping_;
+    /// Number of threads started so far (locked by lock_).
+    size_t nStarted_;
+    /// CPUs of the threads (locked by lock_).
+    std::vector<CpuSet> affinity_;
+    unsigned maxSpin_;
+    /// Number of idle threads spinning.
+    volatile long nSpinning_;
+    volatile bool metricsEnabled_;
+    Lockable metricsLock_;
+    Metrics metrics_;
   };
+
+  /** Call \b f(i) for each i in [begin, end), in parallel on \b pool.
+   *  \param grain number of indices per task, 0 to split the range in
+   *    about 32 chunks.
+   */
+  template <typename Index, typename F>
+  void
+  parallel_for(ThreadPool& pool, Index begin, Index end, F f,
+               Index grain = 0);
+
+  /** Reduce [begin, end) in parallel on \b pool: \b f(b, e) computes
+   *  the value of the chunk [b, e), and the values are combined in
+   *  order with \b op, starting from \b init.
+   *  \param grain as for parallel_for.
+   */
+  template <typename T, typename Index, typename F, typename Op>
+  T
+  parallel_reduce(ThreadPool& pool, Index begin, Index end, T init,
+                  F f, Op op, Index grain = 0);
 }
 
+# include <libport/thread-pool.hxx>
+
 #endif
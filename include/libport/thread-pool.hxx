@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_THREAD_POOL_HXX
+# define LIBPORT_THREAD_POOL_HXX
+
+# include <algorithm>
+
+# include <boost/bind.hpp>
+# include <boost/ref.hpp>
+# include <boost/scoped_array.hpp>
+
+namespace libport
+{
+  namespace future
+  {
+    template <typename R>
+    struct Compute
+    {
+      static void
+      run(State<R>& state, const boost::function0<R>& f)
+      {
+        state.set(f());
+      }
+    };
+
+    template <>
+    struct Compute<void>
+    {
+      static void
+      run(State<void>& state, const boost::function0<void>& f)
+      {
+        f();
+        state.set();
+      }
+    };
+
+    /// Store the result of \a f in \a state.  Exceptions are also
+    /// passed on to the pool, which marks the task as failed.
+    template <typename R>
+    void
+    compute(libport::intrusive_ptr<State<R> > state,
+            const boost::function0<R>& f)
+    {
+      try
+      {
+        Compute<R>::run(*state, f);
+      }
+      catch (...)
+      {
+        state->fail(boost::current_exception());
+        throw;
+      }
+    }
+
+    /// Queue the continuation \a f of \a src in \a pool.
+    template <typename T, typename R, typename F>
+    void
+    chain(ThreadPool& pool, Future<T> src,
+          libport::intrusive_ptr<State<R> > state, F f)
+    {
+      boost::function0<R> g = boost::bind<R>(f, src);
+      pool.queueTask(boost::bind(&compute<R>, state, g));
+    }
+
+    /// Call f on each index of the c-th chunk of [begin, end).
+    ///
+    /// A functor rather than a bind: f may itself be a bind expression.
+    template <typename Index, typename F>
+    struct ForChunk
+    {
+      typedef void result_type;
+
+      ForChunk(Index begin, Index end, Index grain, F f)
+        : begin(begin), end(end), grain(grain), f(f)
+      {}
+
+      void
+      operator()(size_t c)
+      {
+        Index b = begin + Index(c * grain);
+        Index e = std::min(end, Index(b + grain));
+        for (Index i = b; i < e; ++i)
+          f(i);
+      }
+
+      Index begin, end, grain;
+      F f;
+    };
+
+    /// Store in res[c] the value of the c-th chunk of [begin, end).
+    template <typename T, typename Index, typename F>
+    struct ReduceChunk
+    {
+      typedef void result_type;
+
+      ReduceChunk(Index begin, Index end, Index grain, F f, T* res)
+        : begin(begin), end(end), grain(grain), f(f), res(res)
+      {}
+
+      void
+      operator()(size_t c)
+      {
+        Index b = begin + Index(c * grain);
+        Index e = std::min(end, Index(b + grain));
+        res[c] = f(b, e);
+      }
+
+      Index begin, end, grain;
+      F f;
+      T* res;
+    };
+
+    /// Number of chunks of size \a grain in [begin, end), picking the
+    /// grain if it is null.
+    template <typename Index>
+    size_t
+    chunks(Index begin, Index end, Index& grain)
+    {
+      size_t n = end - begin;
+      if (!grain)
+        grain = Index(std::max(size_t(1), (n + 31) / 32));
+      return (n + grain - 1) / grain;
+    }
+  }
+
+  /*---------.
+  | Future.  |
+  `---------*/
+
+  template <typename T>
+  template <typename F>
+  Future<typename boost::result_of<F(Future<T>)>::type>
+  Future<T>::then(ThreadPool& pool, F f) const
+  {
+    typedef typename boost::result_of<F(Future<T>)>::type result_type;
+    typedef Future<result_type> future_type;
+    aver(state_);
+    typename future_type::rState res(new future::State<result_type>);
+    state_->onReady(boost::bind(&future::chain<T, result_type, F>,
+                                boost::ref(pool), *this, res, f));
+    return future_type(res);
+  }
+
+  /*-------------.
+  | ThreadPool.  |
+  `-------------*/
+
+  template <typename F>
+  Future<typename boost::result_of<F()>::type>
+  ThreadPool::async(F func, rTaskLock lock)
+  {
+    typedef typename boost::result_of<F()>::type result_type;
+    typedef Future<result_type> future_type;
+    typename future_type::rState res(new future::State<result_type>);
+    boost::function0<result_type> f = func;
+    rTaskHandle task =
+      queueTask(boost::bind(&future::compute<result_type>, res, f), lock);
+    if (task->getState() == TaskHandle::DROPPED)
+      res->fail(boost::copy_exception(TaskDropped()));
+    return future_type(res);
+  }
+
+  /*-----------------------.
+  | Parallel algorithms.   |
+  `-----------------------*/
+
+  template <typename Index, typename F>
+  void
+  parallel_for(ThreadPool& pool, Index begin, Index end, F f, Index grain)
+  {
+    if (!(begin < end))
+      return;
+    size_t n = future::chunks(begin, end, grain);
+    pool.runChunks(n, future::ForChunk<Index, F>(begin, end, grain, f));
+  }
+
+  template <typename T, typename Index, typename F, typename Op>
+  T
+  parallel_reduce(ThreadPool& pool, Index begin, Index end, T init,
+                  F f, Op op, Index grain)
+  {
+    if (!(begin < end))
+      return init;
+    size_t n = future::chunks(begin, end, grain);
+    // Not a vector: std::vector<bool> elements cannot be written
+    // concurrently.
+    boost::scoped_array<T> values(new T[n]);
+    pool.runChunks(n, future::ReduceChunk<T, Index, F>(begin, end, grain,
+                                                       f, values.get()));
+    T res = init;
+    for (size_t i = 0; i < n; ++i)
+      res = op(res, values[i]);
+    return res;
+  }
+}
+
+#endif // !LIBPORT_THREAD_POOL_HXX
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/// \file libport/trace.hh
+/// \brief Scoped probes recording a timeline.
+///
+/// LIBPORT_TRACE_SCOPE("name") records when the enclosing block starts
+/// and ends, in a ring of the current thread.  When tracing is
+/// disabled, which is the default, a probe costs a test of a global
+/// flag.  When it is enabled, it reads the time stamp counter when
+/// available, and stores an event at the end of the block.
+///
+/// Each event also records the context of its thread at the end of
+/// the block, for instance the current sched::Job.  trace_dump()
+/// exports the events in the JSON format of Chrome's trace viewer,
+/// which Perfetto also loads.
+
+#ifndef LIBPORT_TRACE_HH
+# define LIBPORT_TRACE_HH
+
+# include <iosfwd>
+
+# include <libport/cstdint>
+# include <libport/export.hh>
+# include <libport/preproc.hh>
+
+namespace libport
+{
+  /// Whether the probes record.
+  bool trace_enabled();
+  /// Start or stop recording.
+  LIBPORT_API void trace_enable(bool enable = true);
+  /// Forget the recorded events.  Call it while tracing is disabled.
+  LIBPORT_API void trace_clear();
+
+  /// Set the context recorded with the next events of this thread.
+  /// Only called while tracing is enabled.
+  LIBPORT_API void trace_context_set(const void* context);
+
+  /// Number of events each thread keeps: the older ones are
+  /// overwritten.  The ring of a thread is reused by the next threads
+  /// once it exits.
+  enum { trace_ring_size = 1 << 16 };
+
+  /// The clock of the probes, in ticks.
+  uint64_t trace_clock();
+  /// Record the event \a name, from \a begin to now.
+  /// \param name  a string which must live until the events are
+  ///              dumped, such as a literal.
+  LIBPORT_API void trace_record(const char* name, uint64_t begin);
+
+  /// Number of recorded events, in all the threads.
+  LIBPORT_API size_t trace_size();
+  /// Write the recorded events to \a o, as a Chrome trace.  The events
+  /// of each ring are on a track, with the context as argument.
+  LIBPORT_API std::ostream& trace_dump(std::ostream& o);
+
+  /// The event recorded by LIBPORT_TRACE_SCOPE.
+  class TraceScope
+  {
+  public:
+    TraceScope(const char* name);
+    ~TraceScope();
+
+  private:
+    /// 0 if not recording.
+    const char* name_;
+    uint64_t begin_;
+  };
+
+  namespace details
+  {
+    extern LIBPORT_API bool trace_enabled;
+  }
+}
+
+/// Record the duration of the current block as \a Name, a literal.
+# define LIBPORT_TRACE_SCOPE(Name)                                      \
+  ::libport::TraceScope LIBPORT_CAT(libport_trace_scope_, __LINE__)(Name)
+
+# include <libport/trace.hxx>
+
+#endif // !LIBPORT_TRACE_HH
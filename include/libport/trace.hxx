@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef LIBPORT_TRACE_HXX
+# define LIBPORT_TRACE_HXX
+
+# include <libport/compiler.hh>
+# include <libport/utime.hh>
+
+namespace libport
+{
+  inline bool
+  trace_enabled()
+  {
+    return unlikely(details::trace_enabled);
+  }
+
+  inline uint64_t
+  trace_clock()
+  {
+# if defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return uint64_t(high) << 32 | low;
+# else
+    return utime();
+# endif
+  }
+
+  inline
+  TraceScope::TraceScope(const char* name)
+    : name_(0)
+  {
+    if (trace_enabled())
+    {
+      name_ = name;
+      begin_ = trace_clock();
+    }
+  }
+
+  inline
+  TraceScope::~TraceScope()
+  {
+    if (name_)
+      trace_record(name_, begin_);
+  }
+}
+
+#endif // !LIBPORT_TRACE_HXX
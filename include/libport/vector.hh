@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2011, Gostai S.A.S.
+ * Copyright (C) 2011-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -12,14 +12,54 @@
 # define LIBPORT_VECTOR_HH
 
 # include <libport/cstdlib>
+# include <libport/cstring>
 # include <iostream>
 # include <string>
 
+# include <boost/mpl/bool.hpp>
+# include <boost/type_traits/has_trivial_copy.hpp>
+# include <boost/type_traits/has_trivial_destructor.hpp>
+# include <boost/type_traits/is_base_of.hpp>
+
 # include <libport/cassert>
 # include <libport/cast.hh>
 
 namespace libport
 {
+  namespace traits
+  {
+    /*-------------------------.
+    | IsTriviallyRelocatable.  |
+    `-------------------------*/
+
+    /// Whether a 'T' can be moved to another address with memcpy,
+    /// without calling its copy constructor and destructor.
+    ///
+    /// True for trivial types, specialize it for types which do not
+    /// depend on their own address, such as most smart pointers.
+    template <typename T>
+    struct IsTriviallyRelocatable
+    {
+      static const bool res =
+        boost::has_trivial_copy<T>::value
+        && boost::has_trivial_destructor<T>::value;
+    };
+
+    /*---------------------.
+    | IsRelocatingPolicy.  |
+    `---------------------*/
+
+    /// Whether the construction policy \a P moves the elements
+    /// bitwise, in which case Vector also grows and shrinks with
+    /// Allocator::reallocate().
+    ///
+    /// False by default, so that any policy works.
+    template <typename P>
+    struct IsRelocatingPolicy
+    {
+      static const bool res = false;
+    };
+  }
 
   /*------------.
   | Allocator.  |
@@ -56,6 +96,17 @@ namespace libport
         // FIXME: we could realloc, but only if it doesn't move ...
         return reinterpret_cast<T*>(malloc(count * sizeof(T)));
       }
+
+      /// Resize \a p to \a count elements, keeping its first \a size
+      /// ones, moved bitwise.  Only for trivially relocatable types.
+      /// \return the new block, or 0 if \a p is kept.
+      ATTRIBUTE_ALWAYS_INLINE
+      T* reallocate(T* p, unsigned, unsigned count)
+      {
+        // realloc(p, 0) would free p.
+        return reinterpret_cast<T*>(realloc(p, (count ? count : 1)
+                                               * sizeof(T)));
+      }
   };
 
 
@@ -107,6 +158,27 @@ namespace libport
         return super_type::shrink(p, count);
       }
 
+      ATTRIBUTE_ALWAYS_INLINE
+      T* reallocate(T* p, unsigned size, unsigned count)
+      {
+        T* buffer = union_cast<Align*, T*>(buffer_);
+        if (p == buffer)
+        {
+          if (count <= Floor)
+            return 0;
+          T* res = super_type::allocate(count);
+          memcpy(static_cast<void*>(res), p, size * sizeof(T));
+          return res;
+        }
+        if (count <= Floor)
+        {
+          memcpy(static_cast<void*>(buffer), p, size * sizeof(T));
+          super_type::deallocate(p, size);
+          return buffer;
+        }
+        return super_type::reallocate(p, size, count);
+      }
+
     private:
       typedef long long Align;
       Align buffer_[((sizeof(T) - 1) / sizeof(Align) + 1) * Floor];
@@ -117,7 +189,10 @@ namespace libport
   | Constructor.  |
   `--------------*/
 
-  template <typename T>
+  /// Copy-construct then destroy the elements to move them, unless
+  /// \a Relocatable.
+  template <typename T,
+            bool Relocatable = traits::IsTriviallyRelocatable<T>::res>
   class Constructor
   {
     public:
@@ -182,6 +257,39 @@ namespace libport
       }
   };
 
+  /// Move the elements with memmove.
+  template <typename T>
+  class Constructor<T, true>: public Constructor<T, false>
+  {
+    public:
+      ATTRIBUTE_ALWAYS_INLINE
+      void move(T* from, void* to)
+      {
+        memcpy(to, from, sizeof(T));
+      }
+
+      ATTRIBUTE_ALWAYS_INLINE
+      void move(T* from, void* to, unsigned count)
+      {
+        memmove(to, from, count * sizeof(T));
+      }
+
+      ATTRIBUTE_ALWAYS_INLINE
+      void rmove(T* from, void* to, unsigned count)
+      {
+        memmove(to, from, count * sizeof(T));
+      }
+  };
+
+  namespace traits
+  {
+    template <typename T>
+    struct IsRelocatingPolicy<Constructor<T, true> >
+    {
+      static const bool res = true;
+    };
+  }
+
   /*----------------------.
   | ExponentialCapacity.  |
   `----------------------*/
@@ -325,7 +433,9 @@ namespace libport
         if (size_ == capacity_.size())
         {
           capacity_.grow(size_ + 1);
-          if (void* data = allocation_.grow(data_, capacity_.size()))
+          if (relocatable_)
+            reallocate_();
+          else if (void* data = allocation_.grow(data_, capacity_.size()))
           {
             construction_.move(data_, data, size_);
             allocation_.deallocate(data_, size_);
@@ -353,12 +463,16 @@ namespace libport
         --size_;
         construction_.destroy(data_ + size_);
         if (capacity_.shrink(size_))
-          if (void* data = allocation_.shrink(data_, capacity_.size()))
+        {
+          if (relocatable_)
+            reallocate_();
+          else if (void* data = allocation_.shrink(data_, capacity_.size()))
           {
             construction_.move(data_, data, size_);
             allocation_.deallocate(data_, size_);
             data_ = reinterpret_cast<T*>(data);
           }
+        }
       }
 
       void pop_front()
@@ -441,6 +555,14 @@ namespace libport
         construction_.destroy(it);
         const unsigned before = it - data_;
         const unsigned after  = size_ - before - 1;
+        if (relocatable_)
+        {
+          construction_.move(it + 1, it, after);
+          --size_;
+          if (capacity_.shrink(size_))
+            reallocate_();
+          return data_ + before;
+        }
         if (capacity_.shrink(size_ - 1))
         {
           if (void* data = allocation_.shrink(data_, capacity_.size()))
@@ -474,6 +596,19 @@ namespace libport
         const unsigned before = it - data_;
         const unsigned after  = size_ - before;
 
+        if (relocatable_)
+        {
+          if (size_ == capacity_.size())
+          {
+            capacity_.grow(size_ + 1);
+            reallocate_();
+          }
+          construction_.rmove(data_ + before, data_ + before + 1, after);
+          construction_.construct(data_ + before, v);
+          ++size_;
+          return;
+        }
+
         if (size_ == capacity_.size())
         {
           capacity_.grow(size_ + 1);
@@ -504,6 +639,32 @@ namespace libport
         return (*const_cast<self_type*>(this))[idx];
       }
     private:
+      /// Whether the elements are moved bitwise, and the block resized
+      /// with reallocate(), which only the Allocator provides.
+      static const bool relocatable_ =
+        traits::IsRelocatingPolicy<ConstructionPolicy>::res
+        && boost::is_base_of<Allocator<T>, AllocationPolicy>::value;
+
+      /// Resize the block to the capacity, moving the elements bitwise.
+      ATTRIBUTE_ALWAYS_INLINE
+      void reallocate_()
+      {
+        reallocate_(boost::mpl::bool_<relocatable_>());
+      }
+
+      ATTRIBUTE_ALWAYS_INLINE
+      void reallocate_(boost::mpl::true_)
+      {
+        if (T* data = allocation_.reallocate(data_, size_, capacity_.size()))
+          data_ = data;
+      }
+
+      /// Not called, the policies may lack reallocate().
+      ATTRIBUTE_ALWAYS_INLINE
+      void reallocate_(boost::mpl::false_)
+      {
+      }
+
       AllocationPolicy allocation_;
       ConstructionPolicy construction_;
       CapacityPolicy capacity_;
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2010, Gostai S.A.S.
+ * Copyright (C) 2009-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -12,15 +12,19 @@
 # define LIBPORT_XLTDL_HH
 
 # include <stdexcept>
+# include <vector>
 
 # include <libport/fwd.hh>
 # include <libport/compiler.hh>
 # include <libport/export.hh>
 # include <libport/file-library.hh>
+# include <libport/utime.hh>
 
 typedef void* lt_dlhandle;
 namespace libport
 {
+  class ThreadPool;
+  struct xlt_library;
 
   class LIBPORT_API xlt_advise
   {
@@ -44,6 +48,20 @@ namespace libport
 
     xlt_handle open(const std::string& s) throw(exception);
 
+    /** Open the libraries \a names, as open() would, in a batch.
+     *
+     * Their files are first located in the search path, then read
+     * ahead in parallel on \a pool, so that the dlopens find them in
+     * the page cache.  On ELF systems, a library is opened after the
+     * libraries of the batch it needs; otherwise the order of \a
+     * names is kept.  As with open(), if a file cannot be opened, the
+     * next directories of the search path are tried.
+     *
+     * \return the libraries, in the order they were opened.  */
+    std::vector<xlt_library>
+    open_all(const std::vector<std::string>& names, ThreadPool& pool)
+      throw(exception);
+
     /// Throw an exception, or exit with exit_status_ if nonnull.
     ATTRIBUTE_NORETURN
     static void fail(std::string msg) throw (exception);
@@ -52,6 +70,12 @@ namespace libport
     /// Does not use the search path.  Can return 0.
     lt_dlhandle dlopen_(const std::string& s) const throw (exception);
 
+    /// The file of library \a s in the search path, "" if not found.
+    /// If \a after, a previous result, is not empty, only look in the
+    /// next directories.
+    std::string resolve_(const std::string& s,
+                         const std::string& after = "") const;
+
     file_library path_;
     bool global_;
   };
@@ -87,6 +111,20 @@ namespace libport
     lt_dlhandle handle;
   };
 
+  /// A library opened by xlt_advise::open_all.
+  struct LIBPORT_API xlt_library
+  {
+    /// As given to open_all.
+    std::string name;
+    /// The file opened, "" if it was not found in the search path.
+    std::string file;
+    xlt_handle handle;
+    /// Time spent reading the file ahead, in the pool.
+    utime_t read_time;
+    /// Time spent in dlopen.
+    utime_t open_time;
+  };
+
   /// Wrapper around lt_dlopenext that exits on failures.
   LIBPORT_API
   xlt_handle
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/channel.hh
+ ** \brief Definition of sched::Channel.
+ */
+
+#ifndef SCHED_CHANNEL_HH
+# define SCHED_CHANNEL_HH
+
+# include <deque>
+# include <list>
+
+# include <boost/utility.hpp>
+
+# include <libport/condition.hh>
+
+# include <sched/fwd.hh>
+
+namespace sched
+{
+  /// Bounded queue of values sent to a job.
+  ///
+  /// Values may be sent by jobs and by other threads; a single job
+  /// receives them.  Jobs blocked on the channel are not scheduled
+  /// until the channel wakes them up, and react to their tags as with
+  /// WaitQueue.
+  template <typename T>
+  class Channel: boost::noncopyable
+  {
+  public:
+    /// A channel holding up to \a capacity values.
+    Channel(size_t capacity);
+
+    /// Send \a v if the channel is not full.  Thread-safe.
+    /// \return whether \a v was sent.
+    bool try_send(const T& v);
+    /// Send \a v from a thread, blocking it while the channel is
+    /// full.  Must not be called from a job.
+    void send(const T& v);
+    /// Send \a v from \a job, the current one, suspending it while
+    /// the channel is full.
+    void send(Job& job, const T& v);
+
+    /// Receive a value if one is available.
+    /// \return whether \a v was set.
+    bool try_receive(T& v);
+    /// Receive a value in \a job, the current one, suspending it until
+    /// one is available.
+    T receive(Job& job);
+
+    size_t size() const;
+    size_t capacity() const;
+
+  private:
+    /// Suspend \a job until it may receive, or send.
+    void wait_(Job& job, bool receive);
+    /// Forget \a waker once its job is woken up, by us or not.  If it
+    /// was given some room and \a pass_on, give it to the next sender.
+    void leave_(const rWaker& waker, bool receive, bool pass_on);
+    /// Pop the next sender, in arrival order (lock held).  A thread
+    /// is signaled, the waker of a job is returned.
+    rWaker next_sender_();
+
+    /// A sender waiting for room: either a job, or a thread which
+    /// waits for \a woken.
+    struct Sender
+    {
+      Sender(const rWaker& waker, bool* woken);
+      rWaker waker;
+      bool* woken;
+    };
+
+    size_t capacity_;
+    /// Protects everything, and wakes up sending threads.
+    mutable libport::Condition cond_;
+    std::deque<T> values_;
+    /// The waiting receiving job, if any.
+    rWaker receiver_;
+    /// The waiting senders, jobs and threads.
+    std::list<Sender> senders_;
+  };
+}
+
+# include <sched/channel.hxx>
+
+#endif // !SCHED_CHANNEL_HH
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/channel.hxx
+ ** \brief Implementation of sched::Channel.
+ */
+
+#ifndef SCHED_CHANNEL_HXX
+# define SCHED_CHANNEL_HXX
+
+# include <algorithm>
+
+# include <libport/cassert>
+
+# include <sched/job.hh>
+# include <sched/scheduler.hh>
+
+namespace sched
+{
+  template <typename T>
+  Channel<T>::Channel(size_t capacity)
+    : capacity_(capacity)
+  {
+    aver(capacity);
+  }
+
+  template <typename T>
+  Channel<T>::Sender::Sender(const rWaker& waker, bool* woken)
+    : waker(waker)
+    , woken(woken)
+  {}
+
+  template <typename T>
+  bool
+  Channel<T>::try_send(const T& v)
+  {
+    rWaker receiver;
+    {
+      libport::BlockLock lock(cond_);
+      if (values_.size() >= capacity_)
+        return false;
+      values_.push_back(v);
+      std::swap(receiver, receiver_);
+    }
+    if (receiver)
+      receiver->wake_up();
+    return true;
+  }
+
+  template <typename T>
+  void
+  Channel<T>::send(const T& v)
+  {
+    rWaker receiver;
+    {
+      libport::BlockLock lock(cond_);
+      // Wait for our turn, again if the room was taken meanwhile.
+      while (values_.size() >= capacity_)
+      {
+        bool woken = false;
+        senders_.push_back(Sender(0, &woken));
+        while (!woken)
+          cond_.wait();
+      }
+      values_.push_back(v);
+      std::swap(receiver, receiver_);
+    }
+    if (receiver)
+      receiver->wake_up();
+  }
+
+  template <typename T>
+  void
+  Channel<T>::send(Job& job, const T& v)
+  {
+    while (!try_send(v))
+      wait_(job, false);
+  }
+
+  template <typename T>
+  bool
+  Channel<T>::try_receive(T& v)
+  {
+    rWaker sender;
+    {
+      libport::BlockLock lock(cond_);
+      if (values_.empty())
+        return false;
+      v = values_.front();
+      values_.pop_front();
+      sender = next_sender_();
+    }
+    if (sender)
+      sender->wake_up();
+    return true;
+  }
+
+  template <typename T>
+  T
+  Channel<T>::receive(Job& job)
+  {
+    T res;
+    while (!try_receive(res))
+      wait_(job, true);
+    return res;
+  }
+
+  template <typename T>
+  size_t
+  Channel<T>::size() const
+  {
+    libport::BlockLock lock(cond_);
+    return values_.size();
+  }
+
+  template <typename T>
+  size_t
+  Channel<T>::capacity() const
+  {
+    return capacity_;
+  }
+
+  template <typename T>
+  rWaker
+  Channel<T>::next_sender_()
+  {
+    if (senders_.empty())
+      return 0;
+    Sender next = senders_.front();
+    senders_.pop_front();
+    if (next.woken)
+    {
+      *next.woken = true;
+      // The waiting threads check whether they were chosen.
+      cond_.broadcast();
+    }
+    return next.waker;
+  }
+
+  template <typename T>
+  void
+  Channel<T>::wait_(Job& job, bool receive)
+  {
+    rWaker waker = job.scheduler_get().waker_make(job);
+    {
+      libport::BlockLock lock(cond_);
+      // Check again with the lock held, lest we miss the wake up.
+      if (receive ? !values_.empty() : values_.size() < capacity_)
+        return;
+      if (receive)
+      {
+        aver(!receiver_);
+        receiver_ = waker;
+      }
+      else
+        senders_.push_back(Sender(waker, 0));
+    }
+    try
+    {
+      job.yield_until_woken_up();
+    }
+    catch (...)
+    {
+      leave_(waker, receive, true);
+      throw;
+    }
+    leave_(waker, receive, false);
+  }
+
+  template <typename T>
+  void
+  Channel<T>::leave_(const rWaker& waker, bool receive, bool pass_on)
+  {
+    waker->cancel();
+    rWaker next;
+    {
+      libport::BlockLock lock(cond_);
+      if (receive)
+      {
+        if (receiver_ == waker)
+          receiver_ = 0;
+      }
+      else
+      {
+        typename std::list<Sender>::iterator i = senders_.begin();
+        while (i != senders_.end() && i->waker != waker)
+          ++i;
+        if (i != senders_.end())
+          senders_.erase(i);
+        // We were given some room: pass it on.
+        else if (pass_on && values_.size() < capacity_)
+          next = next_sender_();
+      }
+    }
+    if (next)
+      next->wake_up();
+  }
+}
+
+#endif // !SCHED_CHANNEL_HXX
@@ -35,6 +35,8 @@ SCHED_API extern void (*coroutine_new_hook) (Coro*);
 // Hack to force inclusion of hook object when the user links against a static
 // libsched
 SCHED_API void coroutine_force_hook_linkage();
+// Coroutine-local storage of the main coroutines, which have no stack.
+SCHED_API extern void* coroutine_main_locals_;
 
 
 typedef std::pair<void (*)(void*), void*> CoroStartContext;
@@ -55,7 +57,9 @@ inline Coro* coroutine_new(size_t size)
 {
   if (size == 0)
     size = sched::configuration.default_stack_size;
-  void * sp1( malloc(size));
+  // The coroutine-local storage is kept just above the stack.
+  void * sp1( malloc(size + sizeof(void*)));
+  *(void**)((char*)sp1 + size) = 0;
   Coro* res = boost::context::make_fcontext( (char*)sp1 + size, size, &coroutine_starter);
   if (coroutine_new_hook)
     coroutine_new_hook(res);
@@ -119,6 +123,13 @@ inline size_t coroutine_stack_size(Coro* self)
 }
 
 
+inline void*& coroutine_locals(Coro* self)
+{
+  if (!self->fc_stack.sp)
+    return coroutine_main_locals_;
+  return *(void**)self->fc_stack.sp;
+}
+
 inline void coroutine_initialize_main(Coro*) {}
 inline Coro* coroutine_main() { return new Coro;}
 inline Coro* coroutine_current() { return coroutine_current_;}
@@ -94,11 +94,18 @@ coroutine_stack_size(Coro* self)
   return self->requestedStackSize;
 }
 
+inline void*&
+coroutine_locals(Coro* self)
+{
+  return self->locals;
+}
+
 inline void
 coroutine_initialize_main(Coro* coro)
 {
   GD_CATEGORY(Sched.Coroutine);
   GD_FINFO_TRACE("Initialize main coroutine: %s.", coro);
+  coro->locals = 0;
   coroutine_main_ = coro;
   coroutine_current_ = coro;
   Coro_initializeMainCoro(coro);
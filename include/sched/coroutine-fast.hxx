@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef SCHED_COROUTINE_FAST_HXX
+# define SCHED_COROUTINE_FAST_HXX
+
+# include <libport/config.h>
+# include <libport/cstdlib>
+# include <libport/debug.hh>
+# include <libport/local-data.hh>
+# include <libport/thread-data.hh>
+
+# if ! defined __UCLIBC__ && defined LIBPORT_SCHED_MULTITHREAD
+typedef ::libport::LocalSingleton<Coro*, ::libport::localdata::Thread>
+  LocalCoroPtr;
+# else
+typedef Coro* LocalCoroPtr;
+# endif
+
+SCHED_API extern LocalCoroPtr coroutine_current_;
+SCHED_API extern Coro* coroutine_main_;
+SCHED_API extern void (*coroutine_free_hook)(Coro*);
+SCHED_API extern void (*coroutine_new_hook) (Coro*);
+SCHED_API void coroutine_force_hook_linkage();
+
+// Define SCHED_FAST_CORO_PRESERVE_FPU to 1 if coroutines change the
+// rounding mode or the floating point exception masks.  As for
+// SCHED_USE_FAST_CORO, libsched and its users must agree on it.
+# ifndef SCHED_FAST_CORO_PRESERVE_FPU
+#  define SCHED_FAST_CORO_PRESERVE_FPU 0
+# endif
+
+static const bool coroutine_preserve_fpu = SCHED_FAST_CORO_PRESERVE_FPU;
+
+inline Coro*
+coroutine_current()
+{
+  return coroutine_current_;
+}
+
+inline Coro*
+coroutine_main()
+{
+  return coroutine_main_;
+}
+
+inline Coro*
+coroutine_new(size_t stack_size)
+{
+  GD_CATEGORY(Sched.Coroutine);
+  Coro* res = new Coro;
+  // The stack is allocated when the coroutine is started, so that the
+  // main coroutine does not get one.
+  res->sp = 0;
+  res->stack = 0;
+  res->locals = 0;
+  res->stack_size = (stack_size
+                     ? stack_size
+                     : sched::configuration.default_stack_size);
+  GD_FINFO_TRACE("Create coroutine: %s.", res);
+  if (coroutine_new_hook)
+    coroutine_new_hook(res);
+  return res;
+}
+
+inline void
+coroutine_free(Coro* coro)
+{
+  GD_CATEGORY(Sched.Coroutine);
+  GD_FINFO_TRACE("Free coroutine: %s.", coro);
+  if (coroutine_free_hook)
+    coroutine_free_hook(coro);
+  free(coro->stack);
+  delete coro;
+}
+
+inline void*
+coroutine_stack_addr(Coro* self)
+{
+  return self->stack;
+}
+
+inline size_t
+coroutine_stack_size(Coro* self)
+{
+  return self->stack_size;
+}
+
+inline void*&
+coroutine_locals(Coro* self)
+{
+  return self->locals;
+}
+
+inline void
+coroutine_initialize_main(Coro* coro)
+{
+  GD_CATEGORY(Sched.Coroutine);
+  GD_FINFO_TRACE("Initialize main coroutine: %s.", coro);
+  // The main coroutine runs on the stack of the thread.
+  coro->sp = 0;
+  coro->stack = 0;
+  coro->stack_size = 0;
+  coro->locals = 0;
+  coroutine_main_ = coro;
+  coroutine_current_ = coro;
+  coroutine_force_hook_linkage();
+}
+
+inline void
+coroutine_jump_(Coro* self, Coro* next)
+{
+  if (coroutine_preserve_fpu)
+    sched_fast_coro_jump_fpu(&self->sp, next->sp);
+  else
+    sched_fast_coro_jump(&self->sp, next->sp);
+}
+
+template<typename T>
+inline void
+coroutine_start(Coro* self, Coro* other, void (*callback)(T*), T* context)
+{
+  GD_CATEGORY(Sched.Coroutine);
+  GD_FINFO_TRACE("Start coroutine: %s.", other);
+  if (!other->stack)
+    other->stack = malloc(other->stack_size);
+  sched_fast_coro_make(other,
+                       reinterpret_cast<void (*)(void*)>(callback),
+                       context);
+  coroutine_current_ = other;
+  coroutine_jump_(self, other);
+  coroutine_current_ = self;
+}
+
+inline void
+coroutine_switch_to(Coro* self, Coro* next)
+{
+  GD_CATEGORY(Sched.Coroutine);
+  GD_FINFO_TRACE("Switch coroutine: %s => %s.", self, next);
+  coroutine_current_ = next;
+  coroutine_jump_(self, next);
+  coroutine_current_ = self;
+}
+
+#endif // SCHED_COROUTINE_FAST_HXX
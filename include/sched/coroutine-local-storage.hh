@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011, Gostai S.A.S.
+ * Copyright (C) 2010-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,12 +11,56 @@
 #ifndef SCHED_COROUTINE_LOCAL_STORAGE_HH
 # define SCHED_COROUTINE_LOCAL_STORAGE_HH
 
-# include <boost/unordered_map.hpp>
+# include <vector>
 
 # include <sched/coroutine.hh>
+# include <sched/export.hh>
 
 namespace sched
 {
+  namespace coroutine_local
+  {
+    /// The value of a CoroutineLocalStorage in a coroutine.
+    struct Slot
+    {
+      /// Destroy the value, null if there is none.
+      void (*destroy)(Slot&);
+      /// Small values are stored inline, others are allocated and
+      /// pointed to by data[0].
+      void* data[2];
+    };
+
+    /// The slots of a coroutine, indexed by CoroutineLocalStorage.
+    struct Slots
+    {
+      std::vector<Slot> slots;
+      /// All the slot arrays, to release an index.
+      Slots* prev;
+      Slots* next;
+    };
+
+    /// The slots of \a coro, or of code run outside of any coroutine
+    /// if null.
+    Slots*& slots(Coro* coro);
+    SCHED_API extern void* outside;
+
+    /// Reserve a slot index.
+    SCHED_API size_t allocate();
+    /// Destroy the values of slot \a index in all the coroutines, and
+    /// make it available again.
+    SCHED_API void release(size_t index);
+    /// The slot \a index of the current coroutine, created if needed.
+    SCHED_API Slot& make(size_t index);
+    /// Destroy all the values of \a coro.
+    SCHED_API void release(Coro* coro);
+  }
+
+  /// A value per coroutine.
+  ///
+  /// Each instance reserves an index in the slot array of every
+  /// coroutine, so that accessing the value is an indexed load.  Small
+  /// trivial values are stored in the slot, others are allocated on
+  /// first access.  Values are destroyed with their coroutine.
   template <typename T>
   class CoroutineLocalStorage
   {
@@ -30,9 +74,12 @@ namespace sched
     T* operator -> ();
     const T* operator -> () const;
   private:
-    typedef boost::unordered_map<Coro*, T*> map_type;
-    map_type map_;
-    void cleanup_(Coro* coro);
+    /// Whether T is stored in the slot.
+    static const bool inline_;
+    static T& value_(coroutine_local::Slot& slot);
+    static void destroy_(coroutine_local::Slot& slot);
+    T& create_();
+    size_t index_;
   };
 }
 
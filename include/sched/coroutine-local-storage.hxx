@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011, Gostai S.A.S.
+ * Copyright (C) 2010-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,54 +11,93 @@
 #ifndef SCHED_THREAD_LOCAL_STORAGE_HXX
 # define SCHED_THREAD_LOCAL_STORAGE_HXX
 
+# include <new>
+
+# include <boost/type_traits/alignment_of.hpp>
+# include <boost/type_traits/has_trivial_copy.hpp>
+# include <boost/type_traits/has_trivial_destructor.hpp>
+
 # include <sched/coroutine.hh>
 
 namespace sched
 {
-  template <typename T>
-  CoroutineLocalStorage<T>::CoroutineLocalStorage()
+  namespace coroutine_local
   {
-    add_coroutine_free_hook
-    (boost::bind(&CoroutineLocalStorage<T>::cleanup_, this, _1));
+    inline Slots*&
+    slots(Coro* coro)
+    {
+      return reinterpret_cast<Slots*&>(coro ? coroutine_locals(coro)
+                                            : outside);
+    }
   }
 
+  template <typename T>
+  const bool CoroutineLocalStorage<T>::inline_ =
+    sizeof(T) <= sizeof(static_cast<coroutine_local::Slot*>(0)->data)
+    && (boost::alignment_of<T>::value
+        <= boost::alignment_of<void*>::value)
+    && boost::has_trivial_copy<T>::value
+    && boost::has_trivial_destructor<T>::value;
+
+  template <typename T>
+  CoroutineLocalStorage<T>::CoroutineLocalStorage()
+    : index_(coroutine_local::allocate())
+  {}
+
   template <typename T>
   CoroutineLocalStorage<T>::~CoroutineLocalStorage()
   {
-    typename map_type::iterator it = map_.begin();
-    while (it != map_.end())
-    {
-      delete it->second;
-      it = map_.erase(it);
-    }
+    coroutine_local::release(index_);
   }
 
   template <typename T>
   T&
-  CoroutineLocalStorage<T>::get()
+  CoroutineLocalStorage<T>::value_(coroutine_local::Slot& slot)
   {
-    Coro* token = coroutine_current();
-    typename map_type::iterator it = map_.find(token);
-    if (it == map_.end())
-    {
-      T* res = new T;
-      map_[token] = res;
-      return *res;
-    }
+    if (inline_)
+      return *reinterpret_cast<T*>(slot.data);
     else
-      return *it->second;
+      return *static_cast<T*>(slot.data[0]);
   }
 
   template <typename T>
   void
-  CoroutineLocalStorage<T>::cleanup_(Coro* coro)
+  CoroutineLocalStorage<T>::destroy_(coroutine_local::Slot& slot)
+  {
+    if (!inline_)
+      delete static_cast<T*>(slot.data[0]);
+  }
+
+  template <typename T>
+  T&
+  CoroutineLocalStorage<T>::get()
   {
-    typename map_type::iterator it = map_.find(coro);
-    if (it != map_.end())
+    coroutine_local::Slots* s = coroutine_local::slots(coroutine_current());
+    if (s && index_ < s->slots.size())
     {
-      delete it->second;
-      map_.erase(it);
+      coroutine_local::Slot& slot = s->slots[index_];
+      if (slot.destroy)
+        return value_(slot);
     }
+    return create_();
+  }
+
+  template <typename T>
+  T&
+  CoroutineLocalStorage<T>::create_()
+  {
+    // Build the value before fetching the slot: the constructor of T
+    // might use other coroutine-local storages, and reallocate the
+    // slots.
+    coroutine_local::Slot res;
+    res.destroy = &destroy_;
+    if (inline_)
+      new (res.data) T;
+    else
+      res.data[0] = new T;
+    coroutine_local::Slot& slot = coroutine_local::make(index_);
+    slot = res;
+    return value_(slot);
   }
 
   template <typename T>
@@ -86,14 +125,14 @@ namespace sched
   T*
   CoroutineLocalStorage<T>::operator -> ()
   {
-    return get();
+    return &get();
   }
 
   template <typename T>
   const T*
   CoroutineLocalStorage<T>::operator -> () const
   {
-    return get();
+    return &get();
   }
 }
 
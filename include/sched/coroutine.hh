@@ -21,16 +21,29 @@
 // In the pthread implementation, these functions are compiled in
 // the library, otherwise they are inlined.
 #  define SCHED_CORO_API SCHED_API
+#  define SCHED_CORO_BACKEND "os-thread"
 # else
+// Define SCHED_USE_FAST_CORO (or configure with
+// --enable-sched-fast-coro) to use the register-only switch.
+#  if defined LIBPORT_SCHED_FAST_CORO && ! defined SCHED_USE_FAST_CORO
+#   define SCHED_USE_FAST_CORO 1
+#  endif
 #  if defined SCHED_USE_BOOST_CORO
 #   include <boost/context/all.hpp>
 typedef boost::context::fcontext_t Coro;
+#   define SCHED_CORO_BACKEND "boost::context"
+#  elif defined SCHED_USE_FAST_CORO
+#   include <sched/fast-coro.hh>
+#   define SCHED_CORO_BACKEND "fast"
 #  else
 #   include <sched/libcoroutine/Coro.h>
+#   define SCHED_CORO_BACKEND "libcoroutine (" CORO_IMPLEMENTATION ")"
 #  endif
 #  define SCHED_CORO_API
 # endif
 
+// SCHED_CORO_BACKEND names the implementation in use, for reports.
+
 # include <sched/coroutine-hooks.hh>
 
 /// This package provides an interface to the \c libcoroutine. Using this
@@ -81,6 +94,11 @@ size_t coroutine_stack_size(Coro* self);
 SCHED_CORO_API
 bool coroutine_stack_space_almost_gone(Coro* coro);
 
+/// The coroutine-local storage of a coroutine, null until first used.
+/// See sched/coroutine-local-storage.hh.
+SCHED_CORO_API
+void*& coroutine_locals(Coro* coro);
+
 /// Initialize the main coroutine.
 /// \param coro The coroutine structure that will be used for the main
 ///        task. This coroutine must never be destroyed.
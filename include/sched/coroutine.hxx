@@ -15,7 +15,11 @@
 
 // Implementation based on libcoroutine.
 # if !defined LIBPORT_SCHED_CORO_OSTHREAD and !defined SCHED_USE_BOOST_CORO
-#  include <sched/coroutine-coro.hxx>
+#  if defined SCHED_USE_FAST_CORO
+#   include <sched/coroutine-fast.hxx>
+#  else
+#   include <sched/coroutine-coro.hxx>
+#  endif
 # endif
 
 // Implementation independendant routines.
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/event-loop.hh
+ ** \brief Definition of sched::EventLoop.
+ */
+
+#ifndef SCHED_EVENT_LOOP_HH
+# define SCHED_EVENT_LOOP_HH
+
+# include <boost/asio/deadline_timer.hpp>
+# include <boost/asio/io_service.hpp>
+# include <boost/utility.hpp>
+
+# include <libport/utime.hh>
+
+# include <sched/export.hh>
+# include <sched/fwd.hh>
+
+namespace sched
+{
+  /// Run a scheduler and an io_service in the same thread.
+  ///
+  /// Between two rounds, instead of sleeping until the deadline
+  /// returned by Scheduler::work(), the thread waits in the reactor of
+  /// the io_service, with this deadline as timeout.  Completion
+  /// handlers thus run in the scheduler thread, and may wake up jobs
+  /// directly, for instance through an Event or a WaitQueue.  Jobs
+  /// woken up from other threads through a Waker interrupt the
+  /// reactor, so that the next round starts right away.
+  ///
+  /// The io_service must not be run by another thread, use
+  /// libport::get_io_service(false) for the default one.
+  class SCHED_API EventLoop: boost::noncopyable
+  {
+  public:
+    EventLoop(Scheduler& scheduler, boost::asio::io_service& io);
+    ~EventLoop();
+
+    /// Run a round of the scheduler, then the ready handlers, waiting
+    /// for one until the deadline of the next round if there is
+    /// nothing else to do.  If the io_service was stopped, reset it,
+    /// and make run() return.
+    /// \return the value returned by Scheduler::work().
+    libport::utime_t run_once();
+
+    /// Call run_once() until the scheduler exits or stop() is called.
+    void run();
+
+    /// Make run() return after the current round, or as soon as it
+    /// is called if it is not running.  Thread-safe.
+    void stop();
+
+    Scheduler& scheduler_get();
+    boost::asio::io_service& io_service_get();
+
+  private:
+    /// Interrupt the reactor.
+    void interrupt_();
+
+    Scheduler& scheduler_;
+    boost::asio::io_service& io_;
+    /// Keep run_one() waiting while there are no handlers.
+    boost::asio::io_service::work work_;
+    /// Bound the wait to the deadline of the next round.
+    boost::asio::deadline_timer timer_;
+    /// Set by stop(), until run() sees it.
+    volatile long stop_;
+  };
+}
+
+# include <sched/event-loop.hxx>
+
+#endif // !SCHED_EVENT_LOOP_HH
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef SCHED_EVENT_LOOP_HXX
+# define SCHED_EVENT_LOOP_HXX
+
+namespace sched
+{
+  inline Scheduler&
+  EventLoop::scheduler_get()
+  {
+    return scheduler_;
+  }
+
+  inline boost::asio::io_service&
+  EventLoop::io_service_get()
+  {
+    return io_;
+  }
+}
+
+#endif // !SCHED_EVENT_LOOP_HXX
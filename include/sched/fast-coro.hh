@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/// \file sched/fast-coro.hh
+/// \brief Register-only context switch for x86-64 and AArch64.
+///
+/// Unlike swapcontext, switching does not save nor restore the signal
+/// mask (no system call), and only the callee-saved registers are
+/// saved on the stack of the suspended coroutine.
+
+#ifndef SCHED_FAST_CORO_HH
+# define SCHED_FAST_CORO_HH
+
+# include <cstddef>
+
+# include <sched/export.hh>
+
+# if ! (defined __x86_64__ || defined __aarch64__) || ! defined __ELF__
+#  error "the fast coroutine backend requires x86-64 or AArch64 on ELF"
+# endif
+
+struct Coro
+{
+  /// The saved stack pointer while suspended.
+  void* sp;
+  /// The lowest address of the stack, 0 for the main coroutine.
+  void* stack;
+  /// The size of \a stack.
+  size_t stack_size;
+  /// Coroutine-local storage.
+  void* locals;
+};
+
+extern "C"
+{
+  /// Prepare the stack of \a coro so that switching to it for the
+  /// first time calls \a callback (\a context).
+  SCHED_API void
+  sched_fast_coro_make(Coro* coro, void (*callback)(void*), void* context);
+
+  /// Save the callee-saved registers in \a from and restore \a to.
+  SCHED_API void sched_fast_coro_jump(void** from, void* to);
+
+  /// Likewise, also preserving the floating point control words
+  /// (MXCSR and x87 control word, or FPCR).
+  SCHED_API void sched_fast_coro_jump_fpu(void** from, void* to);
+}
+
+#endif // !SCHED_FAST_CORO_HH
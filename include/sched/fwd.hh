@@ -31,6 +31,8 @@ namespace sched
   typedef std::list<rJob> jobs_type;
   class Tag;
   typedef libport::intrusive_ptr<Tag> rTag;
+  class Waker;
+  typedef libport::intrusive_ptr<Waker> rWaker;
 
   // This exception is above other scheduler-related exceptions such
   // as BlockedException. This allows catching more specific exceptions
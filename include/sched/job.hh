@@ -18,10 +18,16 @@
 
 # include <iosfwd>
 # include <list>
+# include <vector>
 
 # include <boost/any.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/utility/result_of.hpp>
 
+# include <libport/backtrace.hh>
+# include <libport/future.hh>
 # include <libport/symbol.hh>
+# include <libport/trace.hh>
 # include <libport/utime.hh>
 
 # include <sched/coroutine.hh>
@@ -179,9 +185,51 @@ namespace sched
     void yield_until_terminated(Job& other);
 
     /// Same as \p yield_until_terminated above(), but wait for every
-    /// job in the collection.
+    /// job in the collection.  The job is suspended once, and woken up
+    /// when the last of them terminates.  Meanwhile, the exceptions of
+    /// our children in \a jobs are collected instead of interrupting
+    /// the wait, and are thrown afterwards: as a ChildException if
+    /// there is one, as a ChildrenException if there are several.
     void yield_until_terminated(const jobs_type& jobs);
 
+    /// Same as \p yield_until_terminated above(), but wait for any
+    /// job in the collection to terminate, and return it (or 0 if \a
+    /// jobs is empty).  If it is a child that threw, throw a
+    /// ChildException instead.
+    rJob yield_until_any_terminated(const jobs_type& jobs);
+
+    /// Suspend the job in the \c joining state until it is woken up by
+    /// wake_up(), by a Waker, or by an exception.  The job is not
+    /// scheduled in the meantime.  Callers must check whatever they
+    /// are waiting for in a loop.
+    ///
+    /// \sa WaitQueue, Event, Channel
+    void yield_until_woken_up();
+
+    /// Wake up a job suspended by yield_until_woken_up().  Must be
+    /// called from the scheduler thread; use a Waker otherwise.
+    void wake_up();
+
+    /// Wait for \a state to be ready without being scheduled in the
+    /// meantime.  The state is expected to be made ready by another
+    /// thread, typically by a libport::ThreadPool task, which wakes
+    /// the job up through a Waker.
+    ///
+    /// \sa yield_until_terminated(), offload()
+    void yield_until_ready(const libport::future::rStateBase& state);
+
+    /// Wait for \a future as above, then return its value or rethrow
+    /// its exception in the context of this job.
+    template <typename T>
+    T yield_until_ready(const libport::Future<T>& future);
+
+    /// Run \a f in \a pool, and wait for its result as
+    /// yield_until_ready().  This lets a job run blocking or CPU
+    /// intensive code without stalling the scheduler.
+    template <typename F>
+    typename boost::result_of<F()>::type
+    offload(libport::ThreadPool& pool, F f);
+
     /// Wait for any other task to be scheduled.  This function is no longer
     /// a good way to wait for changes.  The current methods used is to
     /// create a tag which is added to the job and to freeze the tag.
@@ -366,7 +414,8 @@ namespace sched
     {
       stats_type();
 
-      typedef libport::Statistics<libport::utime_t, libport::ufloat>
+      typedef libport::Statistics<libport::utime_t, libport::ufloat,
+                                  libport::Histogram<> >
         time_stat_type;
 
       struct thread_stats_type
@@ -402,6 +451,12 @@ namespace sched
     /// Should the job stats be logged.
     void stats_log(bool);
 
+    /// Where the job was when it last gave the control back to the
+    /// scheduler, if the scheduler captures the backtraces.
+    ///
+    /// \sa Scheduler::capture_backtraces_set()
+    const libport::RawBacktrace& backtrace_get() const;
+
     /// Copy own stats to an other job
     void copy_stats_to(rJob& b);
 
@@ -452,12 +507,37 @@ namespace sched
     /// Other jobs to wake up when we terminate.
     jobs_type to_wake_up_;
 
+    /// Jobs waiting for a group of jobs including us.
+    struct Join;
+    typedef libport::intrusive_ptr<Join> rJoin;
+    std::vector<rJoin> joins_;
+
+    /// Implementation of yield_until_terminated() and
+    /// yield_until_any_terminated() on a collection.
+    rJob join_(const jobs_type& jobs, bool any);
+
+    /// Hand \a e over to our parent if it is joining us, and return
+    /// whether it was.
+    bool join_collect_(const exception& e);
+
+    /// Handle to wake us up from another thread, if we are waiting
+    /// for one.
+    rWaker waker_;
+
     /// Coro structure corresponding to this job.
     Coro* coro_;
 
     // Statistics of this job.
     stats_type stats_;
 
+    /// The stack when we last resumed the scheduler.
+    libport::RawBacktrace backtrace_;
+    /// When the job was last resumed, for its trace, or 0 if tracing
+    /// was disabled.
+    uint64_t trace_resume_;
+    /// Start the trace of a slice.
+    void trace_resumed_();
+
   protected:
 
     /// Is the current job non-interruptible? If yes, yielding will
@@ -526,6 +606,39 @@ namespace sched
     mutable exception_ptr child_exception_;
   };
 
+  /// This exception encapsulates several ones, sent by children
+  /// joined together.
+  struct SCHED_API ChildrenException : public SchedulerException
+  {
+    typedef std::vector<boost::shared_ptr<exception> > exceptions_type;
+    ChildrenException(const exceptions_type&);
+    ~ChildrenException() throw() {}
+    const exceptions_type& exceptions_get() const;
+    COMPLETE_EXCEPTION(ChildrenException)
+  private:
+    exceptions_type exceptions_;
+  };
+
+  /// Jobs waiting for a group of jobs, referred to by each of them.
+  struct Job::Join: public libport::RefCounted
+  {
+    Join(Job& w, bool a);
+    /// Called by \a job when it terminates.
+    void terminated(Job& job);
+    /// Stop waiting for \a jobs.
+    void leave(const jobs_type& jobs);
+    /// The waiting job, 0 once it stopped waiting.
+    Job* waiter;
+    /// Whether the first termination is enough.
+    bool any;
+    /// Number of jobs not terminated yet.
+    size_t remaining;
+    /// The first job to terminate.
+    rJob first;
+    /// The exceptions of the waiter's children.
+    ChildrenException::exceptions_type exceptions;
+  };
+
   /// Exception used to terminate a job.
   struct SCHED_API TerminateException : public SchedulerException
   {
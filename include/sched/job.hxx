@@ -68,6 +68,7 @@ namespace sched
     non_interruptible_ = false;
     check_stack_space_ = stack_size == 0;
     ignore_pending_exceptions_ = false;
+    trace_resume_ = 0;
     alive_jobs_++;
   }
 
@@ -94,6 +95,8 @@ namespace sched
   Job::~Job()
   {
     aver(children_.empty(), children_);
+    if (waker_)
+      waker_->cancel();
     coroutine_free(coro_);
     alive_jobs_--;
   }
@@ -123,6 +126,21 @@ namespace sched
     resume_scheduler_();
   }
 
+  template <typename T>
+  T
+  Job::yield_until_ready(const libport::Future<T>& future)
+  {
+    yield_until_ready(future.state());
+    return future.get();
+  }
+
+  template <typename F>
+  typename boost::result_of<F()>::type
+  Job::offload(libport::ThreadPool& pool, F f)
+  {
+    return yield_until_ready(pool.async(f));
+  }
+
   inline void
   Job::yield_until(libport::utime_t deadline)
   {
@@ -267,10 +285,25 @@ namespace sched
     return j.dump(o);
   }
 
+  inline void
+  Job::trace_resumed_()
+  {
+    trace_resume_ = 0;
+    if (libport::trace_enabled())
+    {
+      libport::trace_context_set(this);
+      trace_resume_ = libport::trace_clock();
+    }
+  }
+
   inline void
   Job::resume_scheduler_()
   {
     hook_preempted();
+    if (scheduler_.capture_backtraces_get())
+      backtrace_.capture();
+    if (trace_resume_ && libport::trace_enabled())
+      libport::trace_record("job", trace_resume_);
 
     job_state last_state = state_;
     if (frozen())
@@ -307,6 +340,7 @@ namespace sched
     }
     else
       scheduler_.resume_scheduler(this);
+    trace_resumed_();
     hook_resumed();
   }
 
@@ -328,6 +362,13 @@ namespace sched
     return stats_;
   }
 
+  inline
+  const libport::RawBacktrace&
+  Job::backtrace_get() const
+  {
+    return backtrace_;
+  }
+
   inline
   Job::stats_type::stats_type()
     : logging(true)
@@ -423,6 +464,36 @@ namespace sched
   }
 
 
+  /*--------------------.
+  | ChildrenException.  |
+  `--------------------*/
+
+  inline
+  ChildrenException::ChildrenException(const exceptions_type& exceptions)
+    : exceptions_(exceptions)
+  {
+  }
+
+  inline const ChildrenException::exceptions_type&
+  ChildrenException::exceptions_get() const
+  {
+    return exceptions_;
+  }
+
+
+  /*------------.
+  | Job::Join.  |
+  `------------*/
+
+  inline
+  Job::Join::Join(Job& w, bool a)
+    : waiter(&w)
+    , any(a)
+    , remaining(0)
+  {
+  }
+
+
   /*------------.
   | Collector.  |
   `------------*/
@@ -94,6 +94,8 @@ struct Coro
 #endif
 
 	unsigned char isMain;
+	// Coroutine-local storage, owned by libsched.
+	void *locals;
 };
 
 CORO_API Coro *Coro_new(void);
@@ -8,23 +8,31 @@
 
 sched_includedir = $(includedir)/sched
 sched_include_HEADERS =				\
+  include/sched/channel.hh			\
+  include/sched/channel.hxx			\
   include/sched/configuration.hh		\
   include/sched/coroutine.hh			\
   include/sched/coroutine.hxx			\
   include/sched/coroutine-coro.hxx		\
+  include/sched/coroutine-fast.hxx		\
   include/sched/coroutine-hooks.hh		\
   include/sched/coroutine-local-storage.hh	\
   include/sched/coroutine-local-storage.hxx	\
+  include/sched/event-loop.hh			\
+  include/sched/event-loop.hxx			\
   include/sched/exception.hh			\
   include/sched/exception.hxx			\
   include/sched/export.hh			\
+  include/sched/fast-coro.hh			\
   include/sched/fwd.hh				\
   include/sched/job.hh				\
   include/sched/job.hxx				\
   include/sched/scheduler.hh			\
   include/sched/scheduler.hxx			\
   include/sched/tag.hh				\
-  include/sched/tag.hxx
+  include/sched/tag.hxx				\
+  include/sched/wait-queue.hh			\
+  include/sched/wait-queue.hxx
 
 libcoroutine_includedir = $(sched_includedir)/libcoroutine
 libcoroutine_include_HEADERS =			\
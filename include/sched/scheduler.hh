@@ -17,12 +17,15 @@
 # define SCHED_SCHEDULER_HH
 
 # include <iosfwd>
+# include <vector>
 
 # include <boost/any.hpp>
 # include <boost/function.hpp>
 # include <libport/ufloat.hh>
 # include <libport/statistics.hh>
 # include <boost/utility.hpp>
+# include <libport/lockable.hh>
+# include <libport/ref-counted.hh>
 # include <libport/utime.hh>
 
 # include <sched/coroutine.hh>
@@ -37,7 +40,8 @@ namespace sched
     SCHED_IMMEDIATE = 0
   };
 
-  typedef libport::Statistics<libport::utime_t, libport::ufloat>
+  typedef libport::Statistics<libport::utime_t, libport::ufloat,
+                              libport::Histogram<> >
     scheduler_stats_type;
 
   class SCHED_API Scheduler : boost::noncopyable
@@ -169,9 +173,41 @@ namespace sched
     /// Notify the scheduler that one of its jobs was woken up.
     void job_was_woken_up();
 
+    /// Create a handle to wake up \a job from another thread.
+    ///
+    /// \sa Waker
+    rWaker waker_make(Job& job);
+
+    /// Set the function called, from any thread, when a job is woken
+    /// up through a Waker.  It lets a host sleeping until the
+    /// deadline returned by work() call it again right away, so it
+    /// must be thread-safe.
+    void remote_wakeup_hook_set(const boost::function0<void>& hook);
+
     /// Returns whether the scheduler is terminating.
     bool is_dying() const;
 
+    /// Whether the jobs capture their stack each time they give the
+    /// control back.  Off by default.
+    ///
+    /// \sa Job::backtrace_get(), dump_backtraces()
+    void capture_backtraces_set(bool capture);
+    bool capture_backtraces_get() const;
+
+    /// Write the jobs and their captured stacks on \a fd, unsymbolized.
+    /// The stack of the current job is the current one.
+    ///
+    /// Async-signal-safe, but the lists of jobs may be being modified
+    /// when the signal is delivered: the dump is a best effort to
+    /// find stuck jobs.
+    void dump_backtraces(int fd) const;
+
+# ifndef WIN32
+    /// Dump the backtraces on the standard error when \a sig is
+    /// received.  Only one scheduler can be dumped this way.
+    void dump_backtraces_on(int sig);
+# endif
+
   private:
     /// Execute one round in the scheduler.
     ///
@@ -181,6 +217,9 @@ namespace sched
     /// Compute and return next job to wake up.
     void switch_to_next_(Coro* current, bool first_call = false);
 
+    /// Wake up the jobs whose Waker fired since the previous round.
+    void wake_up_remote_jobs_();
+
     /// Function to retrieve the current system time.
     boost::function0<libport::utime_t> get_time_;
 
@@ -228,10 +267,54 @@ namespace sched
     /// Deadline for next round
     libport::utime_t deadline_;
 
+    /// Whether jobs capture their stack when they yield.
+    bool capture_backtraces_;
+
     // execute_round context
     libport::utime_t start_time_;
     bool at_least_one_started_;
     jobs_type::iterator job_p_;
+
+    friend class Waker;
+    /// Wakers fired by other threads, shared with the wakers so that
+    /// they may outlive the scheduler.
+    struct Mailbox: public libport::ThreadSafeRefCounted
+    {
+      Mailbox();
+      libport::Lockable lock;
+      std::vector<rWaker> wakers;
+      /// Whether wakers is not empty, readable without the lock.
+      volatile bool pending;
+      boost::function0<void> hook;
+    };
+    typedef libport::intrusive_ptr<Mailbox> rMailbox;
+    rMailbox mailbox_;
+  };
+
+  /// Wake up a job from another thread.
+  ///
+  /// A job creates a waker before suspending itself in the \c joining
+  /// state, and hands it to another thread which calls wake_up() when
+  /// the awaited event occurs.  The job is then resumed at the next
+  /// round of its scheduler, through Scheduler::job_was_woken_up(),
+  /// unless it cancelled the waker in the meantime.
+  class SCHED_API Waker: public libport::ThreadSafeRefCounted
+  {
+  public:
+    /// Wake up the job.  Thread-safe.
+    void wake_up();
+
+    /// Forget about the job, which will no longer be woken up.  Must
+    /// be called from the scheduler thread.
+    void cancel();
+
+  private:
+    friend class Scheduler;
+    Waker(const Scheduler::rMailbox& mailbox, Job& job);
+
+    Scheduler::rMailbox mailbox_;
+    /// Only accessed from the scheduler thread.
+    Job* job_;
   };
 
 } // namespace sched
@@ -88,6 +88,18 @@ namespace sched
     terminated_jobs_.clear();
   }
 
+  inline void
+  Scheduler::capture_backtraces_set(bool capture)
+  {
+    capture_backtraces_ = capture;
+  }
+
+  inline bool
+  Scheduler::capture_backtraces_get() const
+  {
+    return capture_backtraces_;
+  }
+
   inline libport::utime_t
   Scheduler::deadline_get() const
   {
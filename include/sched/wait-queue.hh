@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/wait-queue.hh
+ ** \brief Definition of sched::WaitQueue and sched::Event.
+ */
+
+#ifndef SCHED_WAIT_QUEUE_HH
+# define SCHED_WAIT_QUEUE_HH
+
+# include <boost/utility.hpp>
+
+# include <sched/export.hh>
+# include <sched/fwd.hh>
+
+namespace sched
+{
+  /// Jobs waiting for a notification.
+  ///
+  /// Waiting jobs are not scheduled until they are notified, unlike
+  /// jobs in yield_until_things_changed().  They still react to their
+  /// tags: a frozen job is resumed once notified and unfrozen, and a
+  /// stopped or blocked job leaves the queue with its exception.
+  ///
+  /// Must only be used from the scheduler thread.
+  class SCHED_API WaitQueue: boost::noncopyable
+  {
+  public:
+    /// Suspend \a job, the current one, until it is notified.
+    void wait(Job& job);
+
+    /// Wake up the oldest waiting job.
+    /// \return whether there was one.
+    bool notify_one();
+
+    /// Wake up all the waiting jobs.
+    /// \return their number.
+    size_t notify_all();
+
+    bool empty() const;
+    size_t size() const;
+
+  private:
+    jobs_type waiters_;
+  };
+
+  /// A flag jobs can wait for.
+  class SCHED_API Event: boost::noncopyable
+  {
+  public:
+    Event(bool set = false);
+
+    /// Set the flag and wake up the waiting jobs.
+    void set();
+    /// Clear the flag.
+    void reset();
+    /// Wake up the waiting jobs without setting the flag.
+    void pulse();
+    bool is_set() const;
+
+    /// Suspend \a job, the current one, until the flag is set or the
+    /// event pulsed.
+    void wait(Job& job);
+
+  private:
+    bool set_;
+    WaitQueue waiters_;
+  };
+}
+
+# include <sched/wait-queue.hxx>
+
+#endif // !SCHED_WAIT_QUEUE_HH
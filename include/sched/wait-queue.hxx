@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/wait-queue.hxx
+ ** \brief Inline implementation of sched::WaitQueue and sched::Event.
+ */
+
+#ifndef SCHED_WAIT_QUEUE_HXX
+# define SCHED_WAIT_QUEUE_HXX
+
+namespace sched
+{
+  /*------------.
+  | WaitQueue.  |
+  `------------*/
+
+  inline bool
+  WaitQueue::empty() const
+  {
+    return waiters_.empty();
+  }
+
+  inline size_t
+  WaitQueue::size() const
+  {
+    return waiters_.size();
+  }
+
+  /*--------.
+  | Event.  |
+  `--------*/
+
+  inline
+  Event::Event(bool set)
+    : set_(set)
+  {
+  }
+
+  inline void
+  Event::set()
+  {
+    set_ = true;
+    waiters_.notify_all();
+  }
+
+  inline void
+  Event::reset()
+  {
+    set_ = false;
+  }
+
+  inline void
+  Event::pulse()
+  {
+    waiters_.notify_all();
+  }
+
+  inline bool
+  Event::is_set() const
+  {
+    return set_;
+  }
+
+  inline void
+  Event::wait(Job& job)
+  {
+    if (!set_)
+      waiters_.wait(job);
+  }
+}
+
+#endif // !SCHED_WAIT_QUEUE_HXX
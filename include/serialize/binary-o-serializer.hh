@@ -11,6 +11,7 @@
 #ifndef LIBPORT_SERIALIZE_BINARY_O_SERIALIZER_HH
 # define LIBPORT_SERIALIZE_BINARY_O_SERIALIZER_HH
 
+# include <libport/flat-hash-map.hh>
 # include <libport/hash.hh>
 # include <libport/symbol.hh>
 # include <serialize/export.hh>
@@ -35,11 +36,11 @@ namespace libport
       void serialize(typename traits::Arg<T>::res v);
       using super_type::serialize;
     private:
-      typedef boost::unordered_map<long, unsigned> ptr_map_type;
+      typedef flat_hash_map<long, unsigned> ptr_map_type;
       unsigned ptr_id_;
       ptr_map_type ptr_map_;
 
-      typedef boost::unordered_map<Symbol, unsigned> symbol_map_type;
+      typedef flat_hash_map<Symbol, unsigned> symbol_map_type;
       unsigned symbol_id_;
       symbol_map_type symbol_map_;
     };
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -10,6 +10,7 @@
 
 #include <libport/debug.hh>
 #include <libport/escape.hh>
+#include <libport/trace.hh>
 
 #ifndef LIBPORT_SERIALIZE_I_SERIALIZER_HXX
 # define LIBPORT_SERIALIZE_I_SERIALIZER_HXX
@@ -32,6 +33,7 @@ namespace libport
     typename meta::If<meta::Inherits<T, meta::BaseHierarchy>::res, T*, T>::res
     ISerializer<Exact>::unserialize(const std::string& name)
     {
+      LIBPORT_TRACE_SCOPE("unserialize");
       GD_CATEGORY(Serialize.Input);
       GD_FINFO_TRACE("Unserialize %s with name \"%s\"",
                      typeid(T).name(), libport::escape(name));
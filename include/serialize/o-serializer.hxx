@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -10,6 +10,7 @@
 
 #include <libport/debug.hh>
 #include <libport/escape.hh>
+#include <libport/trace.hh>
 
 #ifndef O_SERIALIZER_HXX
 # define O_SERIALIZER_HXX
@@ -33,6 +34,7 @@ namespace libport
     OSerializer<Exact>::serialize(const std::string& name,
                                   typename traits::Arg<T>::res v)
     {
+      LIBPORT_TRACE_SCOPE("serialize");
       GD_CATEGORY(Serialize.Output);
       GD_FPUSH_TRACE("Serialize %s with name \"%s\"",
                      typeid(T).name(), libport::escape(name));
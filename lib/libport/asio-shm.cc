@@ -0,0 +1,798 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+// Sockets between processes of the same host, whose data goes
+// through rings in shared memory.  Each end waits on an eventfd, and
+// the ends watch each other through a Unix socket, which also carries
+// the file descriptors of the connection.
+
+// This compilation unit must not have any ssl-dependent code.
+// Said code goes in asio-ssl.cc
+#define LIBPORT_NO_SSL
+
+#include <libport/asio.hh>
+#include <libport/atomic.hh>
+#include <libport/cstring>
+#include <libport/debug.hh>
+#include <libport/format.hh>
+#include <libport/unistd.h>
+
+#include "asio-impl.hxx"
+
+#if defined __linux__
+# include <fcntl.h>
+# include <sys/eventfd.h>
+# include <sys/mman.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+#endif
+
+GD_CATEGORY(Libport.Asio);
+
+#define FRAISE(...)                                             \
+  throw std::runtime_error(libport::format(__VA_ARGS__))
+
+#if defined __linux__
+
+namespace libport
+{
+  namespace netdetail
+  {
+    typedef boost::asio::local::stream_protocol local_protocol;
+
+    /// Size of each ring.
+    static const size_t shm_capacity = 1 << 20;
+
+    /*----------.
+    | ShmRing.  |
+    `----------*/
+
+    /// The positions of one direction of a connection.  As in
+    /// RingFifo, they only grow, and their remainder modulo the
+    /// capacity is the offset in the data.
+    struct ShmRing
+    {
+      enum { cache_line = 64 };
+      /// Written by the reader.
+      volatile long read;
+      /// Set by the reader before it waits for data.
+      volatile long reader_waiting;
+      char pad0[cache_line - 2 * sizeof(long)];
+      /// Written by the writer.
+      volatile long write;
+      /// Set by the writer before it waits for room.
+      volatile long writer_waiting;
+      char pad1[cache_line - 2 * sizeof(long)];
+    };
+
+    /// Layout of the shared memory: the rings, from the first end to
+    /// the second and back, then their data.
+    struct ShmHeader
+    {
+      ShmRing rings[2];
+    };
+
+    /// Create the shared memory of a new connection.
+    static int
+    shm_create()
+    {
+      static volatile long counter = 0;
+      std::string name =
+        libport::format("/libport-shm-%s-%s",
+                        getpid(), atomic::fetch_increment(&counter));
+      int res = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (res == -1)
+        FRAISE("shm_open: %s", strerror(errno));
+      shm_unlink(name.c_str());
+      if (ftruncate(res, sizeof(ShmHeader) + 2 * shm_capacity))
+      {
+        int error = errno;
+        ::close(res);
+        FRAISE("ftruncate: %s", strerror(error));
+      }
+      return res;
+    }
+
+    static int
+    wake_create()
+    {
+      int res = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (res == -1)
+        FRAISE("eventfd: %s", strerror(errno));
+      return res;
+    }
+
+    static int
+    shm_dup(int fd)
+    {
+      int res = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+      if (res == -1)
+        FRAISE("dup: %s", strerror(errno));
+      return res;
+    }
+
+    /// Close a file descriptor when leaving the scope, unless it was
+    /// released.
+    class ShmFd
+    {
+    public:
+      explicit ShmFd(int fd)
+        : fd_(fd)
+      {}
+
+      ~ShmFd()
+      {
+        if (fd_ != -1)
+          ::close(fd_);
+      }
+
+      int get() const
+      {
+        return fd_;
+      }
+
+      int release()
+      {
+        int res = fd_;
+        fd_ = -1;
+        return res;
+      }
+
+    private:
+      ShmFd(const ShmFd&);
+      ShmFd& operator=(const ShmFd&);
+      int fd_;
+    };
+
+    /*------------.
+    | ShmSocket.  |
+    `------------*/
+
+    class ShmSocket
+      : public BaseSocket
+      , protected libport::Lockable
+    {
+    public:
+      /// Map the rings in \a memory, as the end \a side, 0 or 1.
+      /// Keep copies of \a wake, on which we are woken up, of
+      /// \a peer_wake, on which we wake up the other end, and of
+      /// \a control, the Unix socket to the other end.  The caller
+      /// keeps the ownership of the descriptors it gave, even if the
+      /// construction fails.
+      ShmSocket(boost::asio::io_service& io, int memory,
+                int wake, int peer_wake, int control, unsigned side);
+      ~ShmSocket();
+
+      void write(const void* data, size_t length);
+      bool isConnected() const;
+      void close();
+      unsigned short getRemotePort() const { return 0; }
+      std::string getRemoteHost() const { return std::string(); }
+      unsigned short getLocalPort() const { return 0; }
+      std::string getLocalHost() const { return std::string(); }
+      void syncWrite(const void* data, size_t length);
+      std::string read(size_t length);
+      void startReader();
+      native_handle_type stealFD() { return invalid_handle; }
+      native_handle_type getFD() const;
+      unsigned long bytesReceived() const { return bytesReceived_; }
+      unsigned long bytesSent() const { return bytesSent_; }
+
+    private:
+      /// Copy as much of \a data as fits in the outgoing ring.
+      size_t push_(const char* data, size_t length);
+      /// Move the incoming bytes to readBuffer_.  Close the socket if
+      /// the other end broke the ring.
+      size_t pop_();
+      /// Close with protocol_error: the other end broke a ring, which
+      /// holds \a used bytes.
+      void broken_(size_t used);
+      /// Wake the other end up if it set \a waiting.
+      void wake_peer_(volatile long* waiting);
+      /// Push the pending bytes, or ask to be woken up when there is
+      /// room.  Called with the lock.
+      void flush_();
+      /// Deliver the incoming bytes, and flush the pending ones.
+      void process_(DestructionLock lock);
+      void wait_wake_(DestructionLock lock);
+      void on_wake_(DestructionLock lock, boost::system::error_code erc);
+      void wait_control_(DestructionLock lock);
+      void on_control_(DestructionLock lock, boost::system::error_code erc);
+
+      char* memory_;
+      size_t size_;
+      ShmRing* in_;
+      const char* in_data_;
+      ShmRing* out_;
+      char* out_data_;
+      unsigned long mask_;
+      boost::asio::posix::stream_descriptor wake_;
+      boost::uint64_t wake_count_;
+      int peer_wake_;
+      local_protocol::socket control_;
+      char control_byte_;
+      /// Bytes written while the outgoing ring was full.
+      boost::asio::streambuf pending_;
+      boost::asio::streambuf readBuffer_;
+      /// Whether the incoming bytes are delivered to onReadFunc.
+      bool reading_;
+      /// Reported instead of operation_aborted once we closed.
+      boost::system::error_code error_;
+      unsigned long bytesReceived_;
+      unsigned long bytesSent_;
+    };
+
+    ShmSocket::ShmSocket(boost::asio::io_service& io, int memory,
+                         int wake, int peer_wake, int control,
+                         unsigned side)
+      : BaseSocket(io)
+      , memory_(0)
+      , size_(sizeof(ShmHeader) + 2 * shm_capacity)
+      , wake_(io)
+      , peer_wake_(-1)
+      , control_(io)
+      , reading_(false)
+      , bytesReceived_(0)
+      , bytesSent_(0)
+    {
+      // Do not trust the other end for the size.
+      struct stat st;
+      if (fstat(memory, &st) || st.st_size != off_t(size_))
+        FRAISE("invalid shared memory");
+      void* m = mmap(0, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     memory, 0);
+      if (m == MAP_FAILED)
+        FRAISE("mmap: %s", strerror(errno));
+      memory_ = static_cast<char*>(m);
+      try
+      {
+        ShmFd w(shm_dup(wake));
+        wake_.assign(w.get());
+        w.release();
+        ShmFd c(shm_dup(control));
+        control_.assign(local_protocol(), c.get());
+        c.release();
+        peer_wake_ = shm_dup(peer_wake);
+      }
+      catch (...)
+      {
+        // wake_ and control_ close the copies they were given.
+        munmap(memory_, size_);
+        throw;
+      }
+      ShmHeader* header = reinterpret_cast<ShmHeader*>(memory_);
+      char* data = memory_ + sizeof(ShmHeader);
+      out_ = &header->rings[side];
+      out_data_ = data + side * shm_capacity;
+      in_ = &header->rings[1 - side];
+      in_data_ = data + (1 - side) * shm_capacity;
+      mask_ = shm_capacity - 1;
+      wait_wake_(getDestructionLock());
+      wait_control_(getDestructionLock());
+    }
+
+    ShmSocket::~ShmSocket()
+    {
+      close();
+      wasDestroyed();
+      waitForDestructionPermission();
+      ::close(peer_wake_);
+      munmap(memory_, size_);
+    }
+
+    bool
+    ShmSocket::isConnected() const
+    {
+      return control_.is_open();
+    }
+
+    native_handle_type
+    ShmSocket::getFD() const
+    {
+      return const_cast<local_protocol::socket&>(control_).native();
+    }
+
+    void
+    ShmSocket::close()
+    {
+      BlockLock bl(this);
+      // The other end is told by the closing of the Unix socket.  The
+      // rings and peer_wake_ remain until the destruction, as the
+      // handlers may still be running.
+      boost::system::error_code erc;
+      if (control_.is_open())
+      {
+        control_.shutdown(local_protocol::socket::shutdown_both, erc);
+        control_.close(erc);
+      }
+      if (wake_.is_open())
+        wake_.close(erc);
+    }
+
+    void
+    ShmSocket::wake_peer_(volatile long* waiting)
+    {
+      // Pairs with the barrier of a waiting end, between setting its
+      // flag and checking the ring again: either it sees our update,
+      // or we see its flag.
+      atomic::barrier();
+      if (*waiting && atomic::compare_and_swap(waiting, 1, 0))
+      {
+        boost::uint64_t one = 1;
+        // If the counter is saturated, the other end will wake up.
+        if (::write(peer_wake_, &one, sizeof one) == -1)
+          GD_FINFO_TRACE("eventfd write: %s", strerror(errno));
+      }
+    }
+
+    size_t
+    ShmSocket::push_(const char* data, size_t length)
+    {
+      unsigned long w = out_->write;
+      size_t used = w - atomic::load_acquire(&out_->read);
+      // Do not trust the other end for the positions.
+      if (shm_capacity < used)
+      {
+        broken_(used);
+        return 0;
+      }
+      length = std::min(length, shm_capacity - used);
+      if (!length)
+        return 0;
+      size_t offset = w & mask_;
+      size_t first = std::min(length, shm_capacity - offset);
+      memcpy(out_data_ + offset, data, first);
+      memcpy(out_data_, data + first, length - first);
+      atomic::store_release(&out_->write, w + length);
+      wake_peer_(&out_->reader_waiting);
+      return length;
+    }
+
+    void
+    ShmSocket::broken_(size_t used)
+    {
+      GD_FWARN("invalid shared memory ring: %s bytes", used);
+      error_ = make_error_code(errorcodes::protocol_error);
+      reading_ = false;
+      close();
+    }
+
+    size_t
+    ShmSocket::pop_()
+    {
+      unsigned long r = in_->read;
+      size_t length = atomic::load_acquire(&in_->write) - r;
+      if (!length)
+        return 0;
+      // Do not trust the other end for the positions either.
+      if (shm_capacity < length)
+      {
+        broken_(length);
+        return 0;
+      }
+      size_t offset = r & mask_;
+      size_t first = std::min(length, shm_capacity - offset);
+      readBuffer_.sputn(in_data_ + offset, first);
+      readBuffer_.sputn(in_data_, length - first);
+      atomic::store_release(&in_->read, r + length);
+      wake_peer_(&in_->writer_waiting);
+      bytesReceived_ += length;
+      return length;
+    }
+
+    void
+    ShmSocket::flush_()
+    {
+      while (pending_.size() && isConnected())
+      {
+        size_t n = push_(boost::asio::buffer_cast<const char*>(
+                           pending_.data()),
+                         pending_.size());
+        pending_.consume(n);
+        if (!n)
+        {
+          atomic::store_release(&out_->writer_waiting, 1);
+          atomic::barrier();
+          // Still full: the reader will wake us up.
+          if (atomic::load_acquire(&out_->read) + shm_capacity
+              == (unsigned long) out_->write)
+            return;
+        }
+      }
+    }
+
+    void
+    ShmSocket::write(const void* data, size_t length)
+    {
+      BlockLock bl(this);
+      if (!isConnected())
+      {
+        using netdetail::errorcodes::bad_file_descriptor;
+        if (onErrorFunc)
+          onErrorFunc(make_error_code(bad_file_descriptor));
+        return;
+      }
+      bytesSent_ += length;
+      const char* d = static_cast<const char*>(data);
+      // Do not overtake the pending bytes.
+      if (!pending_.size())
+      {
+        size_t n = push_(d, length);
+        d += n;
+        length -= n;
+      }
+      if (length)
+      {
+        pending_.sputn(d, length);
+        flush_();
+      }
+    }
+
+    void
+    ShmSocket::syncWrite(const void* data, size_t length)
+    {
+      write(data, length);
+      while (true)
+      {
+        {
+          BlockLock bl(this);
+          flush_();
+          if (!pending_.size())
+            return;
+        }
+        if (!isConnected())
+          FRAISE("syncWrite: connection closed");
+        Socket::sleep(100);
+      }
+    }
+
+    std::string
+    ShmSocket::read(size_t length)
+    {
+      while (readBuffer_.size() < length)
+        if (!pop_())
+        {
+          if (!isConnected())
+            FRAISE("read: connection closed");
+          Socket::sleep(100);
+        }
+      std::string res(length, 0);
+      std::istream is(&readBuffer_);
+      is.read(&res[0], length);
+      return res;
+    }
+
+    void
+    ShmSocket::startReader()
+    {
+      reading_ = true;
+      io_.post(boost::bind(&ShmSocket::process_, this,
+                           getDestructionLock()));
+    }
+
+    void
+    ShmSocket::process_(DestructionLock)
+    {
+      while (reading_)
+      {
+        if (pop_())
+        {
+          BlockLock bl(callbackLock);
+          if (onReadFunc)
+            onReadFunc(readBuffer_);
+          if (readOnce)
+            reading_ = false;
+          continue;
+        }
+        // Ask to be woken up, and check again not to miss a write
+        // which did not see the flag.
+        atomic::store_release(&in_->reader_waiting, 1);
+        atomic::barrier();
+        if (atomic::load_acquire(&in_->write) == in_->read
+            || !isConnected())
+          break;
+      }
+      BlockLock bl(this);
+      flush_();
+    }
+
+    void
+    ShmSocket::wait_wake_(DestructionLock lock)
+    {
+      wake_.async_read_some(
+        boost::asio::buffer(&wake_count_, sizeof wake_count_),
+        boost::bind(&ShmSocket::on_wake_, this, lock, _1));
+    }
+
+    void
+    ShmSocket::on_wake_(DestructionLock lock, boost::system::error_code erc)
+    {
+      // Errors are reported through the control socket.
+      if (erc)
+        return;
+      process_(lock);
+      if (isConnected())
+        wait_wake_(lock);
+    }
+
+    void
+    ShmSocket::wait_control_(DestructionLock lock)
+    {
+      control_.async_read_some(
+        boost::asio::buffer(&control_byte_, 1),
+        boost::bind(&ShmSocket::on_control_, this, lock, _1));
+    }
+
+    void
+    ShmSocket::on_control_(DestructionLock lock,
+                           boost::system::error_code erc)
+    {
+      if (!erc)
+      {
+        // Nothing is sent on the control socket after the set up.
+        wait_control_(lock);
+        return;
+      }
+      // As for the other sockets, closing reports operation_aborted.
+      // Otherwise the other end is gone, deliver what it wrote before.
+      if (erc != boost::asio::error::operation_aborted)
+        process_(lock);
+      close();
+      if (error_)
+        erc = error_;
+      BlockLock bl(callbackLock);
+      if (onErrorFunc)
+        onErrorFunc(erc);
+    }
+
+    /*--------------------.
+    | Connection set up.  |
+    `--------------------*/
+
+    /// Send \a fds to \a socket.
+    static bool
+    send_fds(int socket, const int* fds, size_t n)
+    {
+      char byte = 0;
+      iovec iov = { &byte, 1 };
+      char control[CMSG_SPACE(3 * sizeof(int))];
+      msghdr msg;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = CMSG_SPACE(n * sizeof(int));
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(n * sizeof(int));
+      memcpy(CMSG_DATA(cmsg), fds, n * sizeof(int));
+      return sendmsg(socket, &msg, MSG_NOSIGNAL) == 1;
+    }
+
+    /// Receive \a n file descriptors from \a socket.
+    static bool
+    recv_fds(int socket, int* fds, size_t n)
+    {
+      char byte;
+      iovec iov = { &byte, 1 };
+      char control[CMSG_SPACE(3 * sizeof(int))];
+      msghdr msg;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = CMSG_SPACE(n * sizeof(int));
+      if (recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != 1)
+        return false;
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS
+          || cmsg->cmsg_len != CMSG_LEN(n * sizeof(int)))
+        return false;
+      memcpy(fds, CMSG_DATA(cmsg), n * sizeof(int));
+      return true;
+    }
+
+    static void shm_accept_one(boost::asio::io_service& io,
+                               SocketFactory fact,
+                               local_protocol::acceptor* a);
+
+    /// Create the connection, give its other end to the client.
+    static void
+    shm_on_accept(boost::asio::io_service& io,
+                  boost::system::error_code erc,
+                  local_protocol::socket* s,
+                  SocketFactory fact,
+                  local_protocol::acceptor* a)
+    {
+      if (erc)
+      {
+        delete s;
+        return;
+      }
+      try
+      {
+        ShmFd memory(shm_create());
+        ShmFd wake(wake_create());
+        ShmFd peer_wake(wake_create());
+        // The client's memory, wake up, and peer wake up.
+        int fds[3] = { memory.get(), peer_wake.get(), wake.get() };
+        if (!send_fds(s->native(), fds, 3))
+          FRAISE("sendmsg: %s", strerror(errno));
+        BaseSocket* base = new ShmSocket(io, memory.get(), wake.get(),
+                                         peer_wake.get(), s->native(), 0);
+        Socket* sock;
+        try
+        {
+          sock = fact();
+        }
+        catch (...)
+        {
+          delete base;
+          throw;
+        }
+        sock->setBase(base);
+        sock->onConnect();
+        if (sock->getAutoRead())
+          base->startReader();
+      }
+      catch (const std::exception& e)
+      {
+        GD_FWARN("shared memory connection failed: %s", e.what());
+      }
+      delete s;
+      shm_accept_one(io, fact, a);
+    }
+
+    static void
+    shm_accept_one(boost::asio::io_service& io, SocketFactory fact,
+                   local_protocol::acceptor* a)
+    {
+      local_protocol::socket* s = new local_protocol::socket(io);
+      a->async_accept(*s, boost::bind(&shm_on_accept, boost::ref(io), _1,
+                                      s, fact, a));
+    }
+
+    template<>
+    unsigned short
+    AcceptorImpl<local_protocol::acceptor>::getLocalPort() const
+    {
+      return 0;
+    }
+
+    template<>
+    std::string
+    AcceptorImpl<local_protocol::acceptor>::getLocalHost() const
+    {
+      return base_->local_endpoint().path();
+    }
+  }
+
+  boost::system::error_code
+  Socket::listenShm(SocketFactory f, const std::string& path)
+  {
+    using netdetail::local_protocol;
+    local_protocol::acceptor* a;
+    try
+    {
+      a = new local_protocol::acceptor(get_io_service(),
+                                       local_protocol::endpoint(path));
+    }
+    catch (const boost::system::system_error& se)
+    {
+      return se.code();
+    }
+    setBase(new netdetail::AcceptorImpl<local_protocol::acceptor>(
+              get_io_service(), a));
+    netdetail::shm_accept_one(get_io_service(), f, a);
+    return boost::system::error_code();
+  }
+
+  boost::system::error_code
+  Socket::connectShm(const std::string& path)
+  {
+    using netdetail::local_protocol;
+    boost::system::error_code erc;
+    local_protocol::socket s(get_io_service());
+    s.connect(local_protocol::endpoint(path), erc);
+    if (erc)
+      return erc;
+    int fds[3];
+    // The server closes the connection if it cannot set it up.
+    if (!netdetail::recv_fds(s.native(), fds, 3))
+      return netdetail::errorcodes::make_error_code(
+        netdetail::errorcodes::connection_refused);
+    netdetail::ShmFd memory(fds[0]);
+    netdetail::ShmFd wake(fds[1]);
+    netdetail::ShmFd peer_wake(fds[2]);
+    BaseSocket* base;
+    try
+    {
+      base = new netdetail::ShmSocket(get_io_service(), memory.get(),
+                                      wake.get(), peer_wake.get(),
+                                      s.native(), 1);
+    }
+    catch (const std::exception& e)
+    {
+      GD_FWARN("shared memory connection failed: %s", e.what());
+      return netdetail::errorcodes::make_error_code(
+        netdetail::errorcodes::bad_address);
+    }
+    setBase(base);
+    base->link(getDestructionLock());
+    if (autostart_reader_)
+      base->startReader();
+    onConnect();
+    return erc;
+  }
+
+  void
+  makeShmPipe(std::pair<Socket*, Socket*> s, boost::asio::io_service& io)
+  {
+    using netdetail::ShmFd;
+    using netdetail::ShmSocket;
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, control))
+      FRAISE("socketpair: %s", strerror(errno));
+    ShmFd control1(control[0]);
+    ShmFd control2(control[1]);
+    ShmFd memory(netdetail::shm_create());
+    ShmFd wake1(netdetail::wake_create());
+    ShmFd wake2(netdetail::wake_create());
+    BaseSocket* b1 = new ShmSocket(io, memory.get(), wake1.get(),
+                                   wake2.get(), control1.get(), 0);
+    BaseSocket* b2;
+    try
+    {
+      b2 = new ShmSocket(io, memory.get(), wake2.get(), wake1.get(),
+                         control2.get(), 1);
+    }
+    catch (...)
+    {
+      delete b1;
+      throw;
+    }
+    s.first->setBase(b1);
+    s.second->setBase(b2);
+    if (s.first->getAutoRead())
+      b1->startReader();
+    if (s.second->getAutoRead())
+      b2->startReader();
+    s.first->onConnect();
+    s.second->onConnect();
+  }
+}
+
+#else // !__linux__
+
+namespace libport
+{
+  boost::system::error_code
+  Socket::listenShm(SocketFactory, const std::string&)
+  {
+    return netdetail::errorcodes::make_error_code(
+      netdetail::errorcodes::operation_not_supported);
+  }
+
+  boost::system::error_code
+  Socket::connectShm(const std::string&)
+  {
+    return netdetail::errorcodes::make_error_code(
+      netdetail::errorcodes::operation_not_supported);
+  }
+
+  void
+  makeShmPipe(std::pair<Socket*, Socket*>, boost::asio::io_service&)
+  {
+    FRAISE("makeShmPipe: not supported");
+  }
+}
+
+#endif
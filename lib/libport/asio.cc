@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -18,6 +18,7 @@
 #include <libport/detect-win32.h>
 #include <libport/format.hh>
 #include <libport/thread.hh>
+#include <libport/trace.hh>
 
 #include "asio-impl.hxx"
 
@@ -601,6 +602,7 @@ namespace libport
   bool
   Socket::onRead_(boost::asio::streambuf& buf)
   {
+    LIBPORT_TRACE_SCOPE("socket read");
     DestructionLock lock = getDestructionLock();
     // Dump the stream in our linear buffer
     std::istream is(&buf);
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -14,6 +14,10 @@
 #include <libport/backtrace.hh>
 #include <libport/config.h>
 #include <libport/containers.hh>
+#include <libport/cstring>
+#include <libport/flat-hash-map.hh>
+#include <libport/lockable.hh>
+#include <libport/unistd.h>
 
 #ifdef WIN32
 # include <windows.h>
@@ -45,108 +49,120 @@
 
 namespace libport
 {
-  backtrace_type&
-  backtrace(backtrace_type& res)
+  namespace
   {
-    // Avoid looping when an assertion fail.
-    static bool execute_backtrace = false;
-    if (execute_backtrace)
-    {
-      res.clear();
-      return res;
-    }
-    execute_backtrace = true;
-
-    // Load function definitions from windows libraries.
-
-    typedef HANDLE (WINAPI *GetCurrentProcess_t)(void);
     typedef USHORT (WINAPI *CaptureStackBackTrace_t)(
       ULONG, ULONG, PVOID*, PULONG);
 
-    typedef DWORD (WINAPI *SymSetOptions_t)(DWORD);
-    typedef BOOL (WINAPI *SymInitialize_t)(HANDLE, PCTSTR, BOOL);
-    typedef BOOL (WINAPI *SymFromAddr_t)(
-      HANDLE, DWORD64, PDWORD64, PSYMBOL_INFO);
-    typedef BOOL (WINAPI *SymGetLineFromAddr64_t)(
-      HANDLE, DWORD64, PDWORD64, PIMAGEHLP_LINE64);
+    size_t
+    capture_frames(void** frames, size_t size)
+    {
+      // CaptureStackBackTrace fails on XP if asked for more than 62.
+      if (62 < size)
+        size = 62;
+      LOAD_LIBRARY(kernel32);
+      LOAD_FUNCTION_PREFIX(CaptureStackBackTrace, "Rtl", kernel32);
+      return CaptureStackBackTrace(0, size, frames, 0);
+    }
 
-    LOAD_LIBRARY(kernel32);
-    LOAD_FUNCTION(GetCurrentProcess, kernel32);
-    LOAD_FUNCTION_PREFIX(CaptureStackBackTrace, "Rtl", kernel32);
+    /// Append the symbols of the \a n \a frames to \a res, an empty
+    /// string for those which are unknown.
+    void
+    symbolize_frames(void* const* frames, size_t n, backtrace_type& res)
+    {
+      // Load function definitions from windows libraries.
 
-    LOAD_LIBRARY(dbghelp);
-    LOAD_FUNCTION(SymSetOptions, dbghelp);
-    LOAD_FUNCTION(SymInitialize, dbghelp);
-    LOAD_FUNCTION(SymFromAddr, dbghelp);
-    LOAD_FUNCTION(SymGetLineFromAddr64, dbghelp);
+      typedef HANDLE (WINAPI *GetCurrentProcess_t)(void);
 
-    // The real code of the backtrace function start Here.
+      typedef DWORD (WINAPI *SymSetOptions_t)(DWORD);
+      typedef BOOL (WINAPI *SymInitialize_t)(HANDLE, PCTSTR, BOOL);
+      typedef BOOL (WINAPI *SymFromAddr_t)(
+        HANDLE, DWORD64, PDWORD64, PSYMBOL_INFO);
+      typedef BOOL (WINAPI *SymGetLineFromAddr64_t)(
+        HANDLE, DWORD64, PDWORD64, PIMAGEHLP_LINE64);
 
-    void* array[63];
-    HANDLE process;
-    IMAGEHLP_LINE64* line;
-    SYMBOL_INFO* symbol;
-    DWORD64 displacement;
+      LOAD_LIBRARY(kernel32);
+      LOAD_FUNCTION(GetCurrentProcess, kernel32);
 
-    SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
-    process = GetCurrentProcess();
+      LOAD_LIBRARY(dbghelp);
+      LOAD_FUNCTION(SymSetOptions, dbghelp);
+      LOAD_FUNCTION(SymInitialize, dbghelp);
+      LOAD_FUNCTION(SymFromAddr, dbghelp);
+      LOAD_FUNCTION(SymGetLineFromAddr64, dbghelp);
 
-    if (!SymInitialize(process, 0, true))
-    {
-      res.clear();
-      execute_backtrace = false;
-      return res;
-    }
+      // The real code of the symbolization starts here.
 
-    size_t frames = CaptureStackBackTrace(0, 63, array, 0);
+      HANDLE process;
+      IMAGEHLP_LINE64* line;
+      SYMBOL_INFO* symbol;
+      DWORD64 displacement;
 
-    // Symbol names are wrote after the structure's end, so we need to
-    // allocate extra space for it.
-    symbol = (SYMBOL_INFO *)
-      calloc(sizeof(SYMBOL_INFO) + 256 * sizeof(TCHAR), 1);
+      SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS
+                    | SYMOPT_LOAD_LINES);
+      process = GetCurrentProcess();
 
-    // Initialized field of the structure which are used by SymFromAddr to
-    // fill other fields.
-    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-    symbol->MaxNameLen = 255;
+      if (!SymInitialize(process, 0, true))
+      {
+        for (size_t i = 0; i < n; ++i)
+          res << std::string();
+        return;
+      }
 
-    // Initialized the structure in which PDB informations would be added.
-    line = (IMAGEHLP_LINE64 *) calloc(sizeof(IMAGEHLP_LINE64), 1);
-    line->SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+      // Symbol names are wrote after the structure's end, so we need to
+      // allocate extra space for it.
+      symbol = (SYMBOL_INFO *)
+        calloc(sizeof(SYMBOL_INFO) + 256 * sizeof(TCHAR), 1);
 
-    // Clear the vector of frames.
-    res.clear();
-    res.reserve(frames);
+      // Initialized field of the structure which are used by SymFromAddr to
+      // fill other fields.
+      symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+      symbol->MaxNameLen = 255;
 
-    for (size_t i = 0; i < frames; ++i)
-    {
-      bool printable = false;
-      std::ostringstream ostr;
+      // Initialized the structure in which PDB informations would be added.
+      line = (IMAGEHLP_LINE64 *) calloc(sizeof(IMAGEHLP_LINE64), 1);
+      line->SizeOfStruct = sizeof(IMAGEHLP_LINE64);
 
-      // Call after all previous information have been stored because
-      // functions could sahre buffers.
-      if (SymGetLineFromAddr64(process, (size_t) array[i], &displacement, line))
+      for (size_t i = 0; i < n; ++i)
       {
-        printable = true;
-        ostr << line->FileName << ":" << std::dec << line->LineNumber << " ";
-      }
+        std::ostringstream ostr;
 
-      // see also SymGetSymFromAddr64 and SymGetLineFromAddr64
-      if (SymFromAddr(process, (size_t) array[i], &displacement, symbol))
-      {
-        printable = true;
-        ostr << symbol->Name << std::hex << " +0x" << displacement
-             << "[0x" << symbol->Address << "]";
-      }
-      else
-        ostr << "???";
+        // Call after all previous information have been stored because
+        // functions could sahre buffers.
+        if (SymGetLineFromAddr64(process, (size_t) frames[i],
+                                 &displacement, line))
+          ostr << line->FileName << ":" << std::dec << line->LineNumber << " ";
+
+        // see also SymGetSymFromAddr64 and SymGetLineFromAddr64
+        if (SymFromAddr(process, (size_t) frames[i], &displacement, symbol))
+          ostr << symbol->Name << std::hex << " +0x" << displacement
+               << "[0x" << symbol->Address << "]";
 
-      if (printable)
         res << ostr.str();
+      }
+
+      free(line);
+      free(symbol);
     }
+  }
+
+  backtrace_type&
+  backtrace(backtrace_type& res)
+  {
+    // Avoid looping when an assertion fail.
+    static bool execute_backtrace = false;
+    res.clear();
+    if (execute_backtrace)
+      return res;
+    execute_backtrace = true;
+
+    void* frames[62];
+    backtrace_type symbols;
+    symbolize_frames(frames, capture_frames(frames, 62), symbols);
+    // Skip the frames without symbols.
+    foreach (const std::string& s, symbols)
+      if (!s.empty())
+        res << s;
 
-    free(line);
-    free(symbol);
     execute_backtrace = false;
     return res;
   }
@@ -164,20 +180,46 @@ namespace libport
 
 namespace libport
 {
+  namespace
+  {
+    /// ::backtrace loads libgcc on its first call, which allocates:
+    /// do it now so that the captures are async-signal-safe.
+    struct Preload
+    {
+      Preload()
+      {
+        void* frame;
+        ::backtrace(&frame, 1);
+      }
+    } preload;
+
+    size_t
+    capture_frames(void** frames, size_t size)
+    {
+      return ::backtrace(frames, size);
+    }
+
+    void
+    symbolize_frames(void* const* frames, size_t n, backtrace_type& res)
+    {
+      char** strs = backtrace_symbols(frames, n);
+      for (size_t i = 0; i < n; ++i)
+        res << (strs ? strs[i] : "");
+      // Free strs, and the strings in contains.
+      free(strs);
+    }
+  }
+
   backtrace_type&
   backtrace(backtrace_type& res)
   {
     enum { size = 128 };
     void* callstack[size];
-    size_t frames = ::backtrace(callstack, size);
-    char** strs = backtrace_symbols(callstack, frames);
+    size_t frames = capture_frames(callstack, size);
 
     res.clear();
     res.reserve(frames);
-    for (size_t i = 0; i < frames; ++i)
-      res << strs[i];
-    // Free strs, and the strings in contains.
-    free(strs);
+    symbolize_frames(callstack, frames, res);
     return res;
   }
 }
@@ -186,6 +228,22 @@ namespace libport
 
 namespace libport
 {
+  namespace
+  {
+    size_t
+    capture_frames(void**, size_t)
+    {
+      return 0;
+    }
+
+    void
+    symbolize_frames(void* const*, size_t n, backtrace_type& res)
+    {
+      for (size_t i = 0; i < n; ++i)
+        res << std::string();
+    }
+  }
+
   backtrace_type&
   backtrace(backtrace_type& res)
   {
@@ -227,4 +285,135 @@ namespace libport
     return o;
   }
 
+
+
+  /*---------------.
+  | RawBacktrace.  |
+  `---------------*/
+
+  namespace
+  {
+    /// The symbols of the addresses already seen.
+    struct SymbolCache
+    {
+      Lockable lock;
+      flat_hash_map<void*, std::string> symbols;
+    };
+
+    SymbolCache&
+    symbol_cache()
+    {
+      // Never destroyed, so that traces can be printed at exit.
+      static SymbolCache* res = new SymbolCache;
+      return *res;
+    }
+  }
+
+  void
+  RawBacktrace::capture()
+  {
+    size_ = capture_frames(frames_, capacity);
+  }
+
+  backtrace_type&
+  RawBacktrace::symbolize(backtrace_type& res) const
+  {
+    SymbolCache& cache = symbol_cache();
+    BlockLock lock(cache.lock);
+
+    // Symbolize all the unknown addresses at once.
+    void* missing[capacity];
+    size_t n = 0;
+    for (size_t i = 0; i < size_; ++i)
+      if (cache.symbols.insert(std::make_pair(frames_[i],
+                                              std::string())).second)
+        missing[n++] = frames_[i];
+    if (n)
+    {
+      backtrace_type symbols;
+      symbols.reserve(n);
+      symbolize_frames(missing, n, symbols);
+      for (size_t i = 0; i < n; ++i)
+        cache.symbols[missing[i]] = symbols[i].empty() ? "???" : symbols[i];
+    }
+
+    res.clear();
+    res.reserve(size_);
+    for (size_t i = 0; i < size_; ++i)
+      res << cache.symbols.find(frames_[i])->second;
+    return res;
+  }
+
+  backtrace_type
+  RawBacktrace::symbolize() const
+  {
+    backtrace_type res;
+    return symbolize(res);
+  }
+
+  void
+  RawBacktrace::dump(int fd) const
+  {
+    for (size_t i = 0; i < size_; ++i)
+    {
+      signal_safe_write(fd, "  ");
+      signal_safe_write(fd, frames_[i]);
+      signal_safe_write(fd, "\n");
+    }
+  }
+
+  std::ostream&
+  RawBacktrace::dump(std::ostream& o) const
+  {
+    foreach(const std::string& s, symbolize())
+      o << s << std::endl;
+    return o;
+  }
+
+  size_t
+  backtrace_cache_size()
+  {
+    SymbolCache& cache = symbol_cache();
+    BlockLock lock(cache.lock);
+    return cache.symbols.size();
+  }
+
+  void
+  backtrace_cache_clear()
+  {
+    SymbolCache& cache = symbol_cache();
+    BlockLock lock(cache.lock);
+    cache.symbols.clear();
+  }
+
+  void
+  signal_safe_write(int fd, const char* s)
+  {
+    size_t size = strlen(s);
+    while (size)
+    {
+      ssize_t n = write(fd, s, size);
+      if (n <= 0)
+        return;
+      s += n;
+      size -= n;
+    }
+  }
+
+  void
+  signal_safe_write(int fd, const void* p)
+  {
+    static const char digits[] = "0123456789abcdef";
+    char buf[2 + 2 * sizeof p + 1];
+    char* end = buf + sizeof buf - 1;
+    char* s = end;
+    *end = 0;
+    size_t v = reinterpret_cast<size_t>(p);
+    do
+      *--s = digits[v % 16];
+    while (v /= 16);
+    *--s = 'x';
+    *--s = '0';
+    signal_safe_write(fd, s);
+  }
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,46 +8,333 @@
  * See the LICENSE file for more information.
  */
 
-#include <libport/system-warning-push.hh>
-# include <boost/multi_array.hpp>
-#include <libport/system-warning-pop.hh>
-#include <libport/export.hh>
+/// \file libport/damerau-levenshtein-distance.cc
+///
+/// Bit-parallel computation of the restricted Damerau-Levenshtein
+/// distance, after H. Hyyrö, "A bit-vector algorithm for computing
+/// Levenshtein and Damerau edit distances", 2003.
+///
+/// The columns of the dynamic programming matrix, along the pattern,
+/// are encoded as bit-vectors of vertical deltas (+1 in vp, -1 in vn)
+/// updated for each character of the text with a handful of word
+/// operations.  Patterns longer than 64 characters use several words
+/// per column, the carries flowing from the lower words to the upper
+/// ones.
+
+#include <algorithm>
+#include <climits>
+
+#include <libport/atomic.hh>
 #include <libport/damerau-levenshtein-distance.hh>
+#include <libport/thread-pool.hh>
 
 namespace libport
 {
-  using std::min;
-
-  template <typename T>
-  static
-  T min(T t1, T t2, T t3)
+  namespace
   {
-    return min(t1, min(t2, t3));
+    enum { bits = 64 };
+
+    /// The positions of each character in \a s, \a words per
+    /// character.
+    void
+    make_positions(const char* s, size_t m, size_t words, uint64_t* res)
+    {
+      std::fill(res, res + 256 * words, uint64_t(0));
+      for (size_t i = 0; i < m; ++i)
+        res[static_cast<unsigned char>(s[i]) * words + i / bits]
+          |= uint64_t(1) << (i % bits);
+    }
+
+    /// Whether the distance \a d, computed for the \a j first
+    /// characters of a text of \a n, will end up above \a max: each
+    /// remaining character lowers it by at most one.
+    inline bool
+    hopeless(size_t d, size_t max, size_t j, size_t n)
+    {
+      return max < d && n - j < d - max;
+    }
+
+    /// Distance between a pattern of \a m characters, 0 < m <= 64,
+    /// and the text \a t of \a n characters.
+    size_t
+    distance_word(const uint64_t* positions, size_t m,
+                  const char* t, size_t n, size_t max)
+    {
+      uint64_t vp = ~uint64_t(0);
+      uint64_t vn = 0;
+      uint64_t d0 = 0;
+      uint64_t pm_old = 0;
+      const uint64_t last = uint64_t(1) << (m - 1);
+      size_t res = m;
+      for (size_t j = 0; j < n; ++j)
+      {
+        uint64_t pm = positions[static_cast<unsigned char>(t[j])];
+        uint64_t tr = ((~d0 & pm) << 1) & pm_old;
+        d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = d0 & vp;
+        res += !!(hp & last);
+        res -= !!(hn & last);
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        pm_old = pm;
+        if (hopeless(res, max, j + 1, n))
+          return max + 1;
+      }
+      return res <= max ? res : max + 1;
+    }
+
+    /// The state of a word of the column.
+    struct Word
+    {
+      Word()
+        : vp(~uint64_t(0))
+        , vn(0)
+        , d0(0)
+        , pm(0)
+      {}
+
+      uint64_t vp;
+      uint64_t vn;
+      uint64_t d0;
+      /// Positions of the previous character of the text.
+      uint64_t pm;
+    };
+
+    /// Distance between a pattern of \a m characters, spread over \a
+    /// words words, and the text \a t of \a n characters.
+    size_t
+    distance_block(const uint64_t* positions, size_t m, size_t words,
+                   const char* t, size_t n, size_t max)
+    {
+      // Two columns, the previous and the current one.  Their first
+      // word is a sentinel, below the pattern.
+      std::vector<Word> previous(words + 1);
+      std::vector<Word> current(words + 1);
+      const uint64_t last = uint64_t(1) << ((m - 1) % bits);
+      size_t res = m;
+      for (size_t j = 0; j < n; ++j)
+      {
+        std::swap(previous, current);
+        const uint64_t* pms =
+          positions + static_cast<unsigned char>(t[j]) * words;
+        uint64_t hp_carry = 1;
+        uint64_t hn_carry = 0;
+        for (size_t w = 0; w < words; ++w)
+        {
+          const Word& old = previous[w + 1];
+          uint64_t pm = pms[w];
+          // A transposition may straddle two words.
+          uint64_t tr =
+            (((~old.d0 & pm) << 1)
+             | ((~previous[w].d0 & current[w].pm) >> (bits - 1)))
+            & old.pm;
+          uint64_t x = pm | hn_carry;
+          uint64_t d0 = (((x & old.vp) + old.vp) ^ old.vp) | x | old.vn | tr;
+          uint64_t hp = old.vn | ~(d0 | old.vp);
+          uint64_t hn = d0 & old.vp;
+          if (w == words - 1)
+          {
+            res += !!(hp & last);
+            res -= !!(hn & last);
+          }
+          uint64_t carry = hp_carry;
+          hp_carry = hp >> (bits - 1);
+          hp = (hp << 1) | carry;
+          carry = hn_carry;
+          hn_carry = hn >> (bits - 1);
+          hn = (hn << 1) | carry;
+
+          Word& word = current[w + 1];
+          word.vp = hn | ~(d0 | hp);
+          word.vn = hp & d0;
+          word.d0 = d0;
+          word.pm = pm;
+        }
+        if (hopeless(res, max, j + 1, n))
+          return max + 1;
+      }
+      return res <= max ? res : max + 1;
+    }
+
+    /// Distance between \a p and \a t, whose positions have been
+    /// computed if \a positions is not null.
+    size_t
+    osa_distance(const char* p, size_t m, const uint64_t* positions,
+                 const char* t, size_t n, size_t max)
+    {
+      // Keep max + 1 representable.
+      max = std::min(max, size_t(-1) - 1);
+      if ((m < n ? n - m : m - n) > max)
+        return max + 1;
+      if (!m)
+        return n;
+      if (!n)
+        return m;
+      size_t words = (m + bits - 1) / bits;
+      std::vector<uint64_t> buffer;
+      uint64_t word_buffer[256];
+      if (!positions)
+      {
+        uint64_t* res = word_buffer;
+        if (1 < words)
+        {
+          buffer.resize(256 * words);
+          res = &buffer[0];
+        }
+        make_positions(p, m, words, res);
+        positions = res;
+      }
+      if (words == 1)
+        return distance_word(positions, m, t, n, max);
+      else
+        return distance_block(positions, m, words, t, n, max);
+    }
   }
 
   size_t
   damerau_levenshtein_distance(const std::string& s1, const std::string& s2)
   {
-    size_t ss1 = s1.size();
-    size_t ss2 = s2.size();
-    boost::multi_array<size_t, 2> d(boost::extents[ss1+1][ss2+1]);
+    return damerau_levenshtein_distance(s1, s2, size_t(-1));
+  }
+
+  size_t
+  damerau_levenshtein_distance(const std::string& s1, const std::string& s2,
+                               size_t max)
+  {
+    const char* p = s1.data();
+    size_t m = s1.size();
+    const char* t = s2.data();
+    size_t n = s2.size();
+    // Common prefixes and suffixes cost nothing.
+    while (m && n && *p == *t)
+    {
+      ++p; --m;
+      ++t; --n;
+    }
+    while (m && n && p[m - 1] == t[n - 1])
+    {
+      --m;
+      --n;
+    }
+    // Use the shortest string as the pattern, to have fewer words.
+    if (n < m)
+    {
+      std::swap(p, t);
+      std::swap(m, n);
+    }
+    return osa_distance(p, m, 0, t, n, max);
+  }
+
+  /*----------------------------.
+  | DamerauLevenshteinMatcher.  |
+  `----------------------------*/
+
+  DamerauLevenshteinMatcher::DamerauLevenshteinMatcher(const std::string& s)
+    : string_(s)
+    , words_((s.size() + bits - 1) / bits)
+    , positions_(256 * words_)
+  {
+    if (words_)
+      make_positions(s.data(), s.size(), words_, &positions_[0]);
+  }
+
+  size_t
+  DamerauLevenshteinMatcher::distance(const std::string& s, size_t max) const
+  {
+    return osa_distance(string_.data(), string_.size(),
+                        words_ ? &positions_[0] : 0,
+                        s.data(), s.size(), max);
+  }
+
+  /*----------.
+  | closest.  |
+  `----------*/
+
+  namespace
+  {
+    /// A distance and the index of the candidate.
+    typedef std::pair<size_t, size_t> match_type;
 
-    for (size_t i = 0; i <= ss1; ++i)
-      d[i][0] = i;
-    for (size_t j = 1; j <= ss2; ++j)
-      d[0][j] = j;
+    /// State of a damerau_levenshtein_closest call.
+    struct Closest
+    {
+      typedef boost::function1<const std::string&, size_t> candidate_type;
 
-    for (size_t i = 1; i <= ss1; ++i)
-      for (size_t j = 1; j <= ss2; ++j)
+      Closest(const std::string& query,
+              size_t n, const candidate_type& candidate,
+              size_t k, size_t max)
+        : matcher(query)
+        , n(n)
+        , candidate(candidate)
+        , k(k)
+        , bound(std::min(max, size_t(LONG_MAX)))
+        , results((n + chunk_size - 1) / chunk_size)
+      {}
+
+      /// Scan the candidates of \a chunk.
+      void
+      run(size_t chunk)
       {
-	size_t cost = s1[i-1] == s2[j-1] ? 0 : 1;
-	d[i][j] = min(d[i-1][j] + 1,        // Deletion
-                      d[i][j-1] + 1,        // Insertion
-                      d[i-1][j-1] + cost);  // Substitution
-	if (i > 1 && j > 1 && s1[i-1] == s2[j-2] && s1[i-2] == s2[j-1])
-	  d[i][j] = min(d[i][j],
-                        d[i-2][j-2] + cost); // Transposition
+        std::vector<match_type>& best = results[chunk];
+        size_t end = std::min(n, (chunk + 1) * chunk_size);
+        for (size_t i = chunk * chunk_size; i < end; ++i)
+        {
+          size_t max = atomic::load_acquire(&bound);
+          size_t d = matcher.distance(candidate(i), max);
+          if (max < d)
+            continue;
+          match_type m(d, i);
+          best.insert(std::upper_bound(best.begin(), best.end(), m), m);
+          if (best.size() < k)
+            continue;
+          best.resize(k);
+          // The k-th best distance of this chunk bounds the one of
+          // all the candidates, let the others use it.
+          long b = best.back().first;
+          long old;
+          while (b < (old = atomic::load_acquire(&bound))
+                 && !atomic::compare_and_swap(&bound, old, b))
+            continue;
+        }
       }
-    return d[ss1][ss2];
+
+      enum { chunk_size = 256 };
+
+      DamerauLevenshteinMatcher matcher;
+      size_t n;
+      const candidate_type& candidate;
+      size_t k;
+      volatile long bound;
+      std::vector<std::vector<match_type> > results;
+    };
+  }
+
+  std::vector<size_t>
+  damerau_levenshtein_closest
+  (const std::string& query,
+   size_t n, const boost::function1<const std::string&, size_t>& candidate,
+   size_t k, size_t max, ThreadPool* pool)
+  {
+    std::vector<size_t> res;
+    if (!k || !n)
+      return res;
+    Closest c(query, n, candidate, k, max);
+    if (pool)
+      pool->runChunks(c.results.size(),
+                      boost::bind(&Closest::run, &c, _1));
+    else
+      for (size_t i = 0; i < c.results.size(); ++i)
+        c.run(i);
+
+    std::vector<match_type> all;
+    for (size_t i = 0; i < c.results.size(); ++i)
+      all.insert(all.end(), c.results[i].begin(), c.results[i].end());
+    std::sort(all.begin(), all.end());
+    for (size_t i = 0; i < all.size() && i < k; ++i)
+      res.push_back(all[i].second);
+    return res;
   }
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -13,14 +13,19 @@
  ** \brief Implementation for libport/escape.hh.
  **/
 
+#include <algorithm>
 #include <cctype>
 #include <libport/cstdlib>
-#include <iomanip>
-#include <ios>
+#include <libport/cstring>
+#include <ostream>
 #include <stdexcept>
 #include <libport/escape.hh>
 #include <libport/format.hh>
 
+#if defined __SSE2__
+# include <emmintrin.h>
+#endif
+
 namespace libport
 {
   std::ostream&
@@ -32,77 +37,163 @@ namespace libport
   std::ostream&
   Escape::escape_ (std::ostream& o, const std::string& es) const
   {
-    // For some reason yet to be found, when we use the locale for
-    // std::isprint, Valgrind goes berzerk.  So we no longer do the
-    // following:
-    //
-    // static std::locale locale ("");
-    //
-    // if (std::isprint (*p, locale))
-    std::ios_base::fmtflags flags = o.flags(std::ios_base::hex);
-    char fill = o.fill('0');
+    // Escape by chunks, each one written at once.
+    char buf[4096];
+    const char* p = es.data();
+    const char* end = p + es.size();
+    while (p != end)
+    {
+      const char* q = p + std::min(size_t(end - p), sizeof buf / 4);
+      o.write(buf, escape(p, q, buf, delimiter_) - buf);
+      p = q;
+    }
+    return o;
+  }
+
+  /// The first character of [\a p, \a end) which may need an escape:
+  /// a control character, a non-ASCII one, a backslash or the
+  /// delimiter.
+  static inline
+  const char*
+  escape_scan(const char* p, const char* end, char delimiter)
+  {
+#if defined __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8('\x7f');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i delim = _mm_set1_epi8(delimiter);
+    for (; 16 <= end - p; p += 16)
+    {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      // The comparison is signed: the non-ASCII bytes are below ' '.
+      __m128i m =
+        _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(c, space),
+                                  _mm_cmpeq_epi8(c, del)),
+                     _mm_or_si128(_mm_cmpeq_epi8(c, backslash),
+                                  _mm_cmpeq_epi8(c, delim)));
+      if (int bits = _mm_movemask_epi8(m))
+        return p + __builtin_ctz(bits);
+    }
+#endif
+    for (; p != end; ++p)
+    {
+      unsigned char c = *p;
+      if (c < ' ' || '\x7f' <= c || c == '\\' || *p == delimiter)
+        break;
+    }
+    return p;
+  }
+
+  char*
+  escape(const char* p, const char* end, char* o, char delimiter)
+  {
+    static const char digits[] = "0123456789abcdef";
+    while (true)
+    {
+      // Copy the run of characters which need no escape.
+      const char* q = escape_scan(p, end, delimiter);
+      memcpy(o, p, q - p);
+      o += q - p;
+      if (q == end)
+        return o;
+      p = q + 1;
 
-    for (std::string::const_iterator p = es.begin (); p != es.end (); ++p)
-      switch (*p)
+      // For some reason yet to be found, when we use the locale for
+      // std::isprint, Valgrind goes berzerk.  So we no longer do the
+      // following:
+      //
+      // static std::locale locale ("");
+      //
+      // if (std::isprint (*q, locale))
+      char c = *q;
+      switch (c)
       {
-	case '\b': o << "\\b"; break;
-	case '\f': o << "\\f"; break;
-	case '\n': o << "\\n"; break;
-	case '\r': o << "\\r"; break;
-	case '\t': o << "\\t"; break;
-	case '\v': o << "\\v"; break;
-	case '\\': o << "\\\\"; break;
+	case '\b': *o++ = '\\'; *o++ = 'b'; break;
+	case '\f': *o++ = '\\'; *o++ = 'f'; break;
+	case '\n': *o++ = '\\'; *o++ = 'n'; break;
+	case '\r': *o++ = '\\'; *o++ = 'r'; break;
+	case '\t': *o++ = '\\'; *o++ = 't'; break;
+	case '\v': *o++ = '\\'; *o++ = 'v'; break;
+	case '\\': *o++ = '\\'; *o++ = '\\'; break;
 	default:
-	  if (*p == delimiter_)
-	    o << '\\' << *p;
-	  else if (std::isprint((unsigned char) *p))
-	    o << *p;
+	  if (c == delimiter)
+          {
+            *o++ = '\\';
+            *o++ = c;
+          }
+	  else if (std::isprint((unsigned char) c))
+	    *o++ = c;
 	  else
-	    o << "\\x" << std::setw(2) << (int) (unsigned char) *p;
+          {
+            *o++ = '\\';
+            *o++ = 'x';
+            *o++ = digits[(unsigned char) c >> 4];
+            *o++ = digits[c & 0xf];
+          }
       }
-
-    o.fill(fill);
-    o.flags(flags);
-    return o;
+    }
   }
 
 #define FRAISE(...)                             \
   throw std::runtime_error(format(__VA_ARGS__))
 
-  std::string
-  unescape(const std::string& s)
+  static inline
+  int
+  hex_value(char c)
+  {
+    return ('0' <= c && c <= '9' ? c - '0'
+            : 'a' <= c && c <= 'f' ? c - 'a' + 10
+            : c - 'A' + 10);
+  }
+
+  char*
+  unescape(const char* p, const char* end, char* res)
   {
-    std::string res;
-    for (size_t i = 0; i < s.size(); ++i)
+    while (true)
     {
-      if (s[i] == '\\')
+      // Copy up to the next backslash.
+      const char* q =
+        static_cast<const char*>(memchr(p, '\\', end - p));
+      if (!q)
+        q = end;
+      memcpy(res, p, q - p);
+      res += q - p;
+      if (q == end)
+        return res;
+      if (q + 1 == end)
+        FRAISE("invalid escape: '\\' at end of string");
+      p = q + 2;
+      switch (q[1])
       {
-	if (i == s.size() - 1)
-	  FRAISE("invalid escape: '\\' at end of string");
-	switch(s[++i])
-	{
-	  case 'b': res += '\b'; break;
-	  case 'f': res += '\f'; break;
-	  case 'n': res += '\n'; break;
-	  case 'r': res += '\r'; break;
-	  case 't': res += '\t'; break;
-	  case 'v': res += '\v'; break;
-	  case '\\': res += '\\'; break;
-	  case '\"': res += '"'; break;
-	  case '\'': res += '\''; break;
-	  case 'x':
-	    if (s.length() < i + 3 || !isxdigit(s[i+1]) || !isxdigit(s[i+2]))
-	      FRAISE("invalid escape: '\\x' not followed by two digits");
-	    res += strtol(s.substr(i+1, 2).c_str(), 0, 16);
-	    i += 2;
-	    break;
-	  default:
-	    FRAISE("invalid escape: '\\%s'", s[i]);
-	}
+	case 'b': *res++ = '\b'; break;
+	case 'f': *res++ = '\f'; break;
+	case 'n': *res++ = '\n'; break;
+	case 'r': *res++ = '\r'; break;
+	case 't': *res++ = '\t'; break;
+	case 'v': *res++ = '\v'; break;
+	case '\\': *res++ = '\\'; break;
+	case '\"': *res++ = '"'; break;
+	case '\'': *res++ = '\''; break;
+	case 'x':
+	  if (end - p < 2
+              || !isxdigit((unsigned char) p[0])
+              || !isxdigit((unsigned char) p[1]))
+	    FRAISE("invalid escape: '\\x' not followed by two digits");
+	  *res++ = hex_value(p[0]) * 16 + hex_value(p[1]);
+	  p += 2;
+	  break;
+	default:
+	  FRAISE("invalid escape: '\\%s'", q[1]);
       }
-      else
-	res += s[i];
     }
+  }
+
+  std::string
+  unescape(const std::string& s)
+  {
+    std::string res(s.size(), 0);
+    char* begin = &res[0];
+    res.resize(unescape(s.data(), s.data() + s.size(), begin) - begin);
     return res;
   }
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2010, Gostai S.A.S.
+ * Copyright (C) 2008-2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -26,15 +26,213 @@
 # include <direct.h>
 #endif
 
+#if defined __linux__
+# include <sys/inotify.h>
+# define LIBPORT_FILE_LIBRARY_INOTIFY 1
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include <libport/ctime>
 #include <libport/file-library.hh>
 #include <libport/file-system.hh>
+#include <libport/flat-hash-map.hh>
 #include <libport/foreach.hh>
+#include <libport/lockable.hh>
+#include <libport/sys/stat.h>
 #include <libport/tokenizer.hh>
 #include <libport/unistd.h>
 
 namespace libport
 {
 
+  /*----------------------.
+  | file_library::Cache.  |
+  `----------------------*/
+
+  class file_library::Cache
+  {
+  public:
+    Cache();
+    ~Cache();
+    /// Whether \a dir contains \a file, according to its snapshot.
+    bool exists(const std::string& dir, const std::string& file);
+    bool exists(const path& file);
+    void clear();
+
+  private:
+    struct Directory
+    {
+      Directory();
+      bool exists;
+      /// Modification date when listed.
+      std::time_t mtime;
+      /// Date of the listing.
+      std::time_t listed;
+      /// The inotify watch, or -1.
+      int watch;
+      /// Changed since listed, according to inotify.
+      bool stale;
+      flat_hash_set<std::string> entries;
+    };
+    typedef flat_hash_map<std::string, Directory> directories_type;
+
+    /// Whether the snapshot \a d of \a name is still valid.
+    bool fresh_(const std::string& name, const Directory& d) const;
+    /// (Re)list \a name into \a d.
+    void list_(const std::string& name, Directory& d);
+    /// Process the pending inotify events.
+    void update_();
+
+    directories_type directories_;
+    Lockable lock_;
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    /// The inotify descriptor, or -1.
+    int inotify_;
+#endif
+  };
+
+  file_library::Cache::Directory::Directory()
+    : exists(false)
+    , mtime(0)
+    , listed(0)
+    , watch(-1)
+    , stale(true)
+  {}
+
+  file_library::Cache::Cache()
+  {
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  }
+
+  file_library::Cache::~Cache()
+  {
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    if (inotify_ != -1)
+      close(inotify_);
+#endif
+  }
+
+  void
+  file_library::Cache::clear()
+  {
+    BlockLock lock(lock_);
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    if (inotify_ != -1)
+    {
+      close(inotify_);
+      inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#endif
+    directories_.clear();
+  }
+
+  bool
+  file_library::Cache::exists(const path& file)
+  {
+    std::string base = file.basename();
+    if (base.empty() || base == "." || base == "..")
+      return file.exists();
+    return exists(file.dirname().to_string(), base);
+  }
+
+  bool
+  file_library::Cache::exists(const std::string& dir,
+                              const std::string& base)
+  {
+    BlockLock lock(lock_);
+    update_();
+    directories_type::iterator i = directories_.find(dir);
+    if (i == directories_.end())
+      list_(dir, directories_[dir]);
+    else if (!fresh_(dir, i->second))
+      list_(dir, i->second);
+    const Directory& d = directories_.find(dir)->second;
+    return d.exists && d.entries.count(base);
+  }
+
+  bool
+  file_library::Cache::fresh_(const std::string& name,
+                              const Directory& d) const
+  {
+    if (d.watch != -1)
+      return !d.stale;
+    struct stat st;
+    if (stat(name.c_str(), &st))
+      return !d.exists;
+    // A change in the second of the listing might have been missed.
+    return d.exists && st.st_mtime == d.mtime && d.mtime < d.listed;
+  }
+
+  void
+  file_library::Cache::list_(const std::string& name, Directory& d)
+  {
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    // Watch before listing, not to miss changes.
+    if (d.watch == -1 && inotify_ != -1)
+      d.watch = inotify_add_watch(inotify_, name.c_str(),
+                                  IN_CREATE | IN_DELETE
+                                  | IN_MOVED_FROM | IN_MOVED_TO
+                                  | IN_DELETE_SELF | IN_MOVE_SELF
+                                  | IN_ONLYDIR);
+#endif
+    d.stale = false;
+    d.entries.clear();
+    struct stat st;
+    d.exists = !stat(name.c_str(), &st) && S_ISDIR(st.st_mode);
+    if (!d.exists)
+      return;
+    d.mtime = st.st_mtime;
+    d.listed = time(0);
+    try
+    {
+      boost::filesystem::directory_iterator end;
+      for (boost::filesystem::directory_iterator i(name); i != end; ++i)
+        d.entries.insert(i->path().filename().string());
+    }
+    catch (const boost::filesystem::filesystem_error&)
+    {
+      d.exists = false;
+    }
+  }
+
+  void
+  file_library::Cache::update_()
+  {
+#ifdef LIBPORT_FILE_LIBRARY_INOTIFY
+    if (inotify_ == -1)
+      return;
+    char buf[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while (0 < (len = read(inotify_, buf, sizeof buf)))
+      for (const char* p = buf; p < buf + len; )
+      {
+        const inotify_event* e = reinterpret_cast<const inotify_event*>(p);
+        p += sizeof *e + e->len;
+        foreach (directories_type::value_type& v, directories_)
+        {
+          Directory& d = v.second;
+          if (e->mask & IN_Q_OVERFLOW || d.watch == e->wd)
+            d.stale = true;
+          // The watch no longer follows this name.
+          if (d.watch == e->wd && e->mask & (IN_MOVE_SELF | IN_IGNORED))
+          {
+            if (e->mask & IN_MOVE_SELF)
+              inotify_rm_watch(inotify_, d.watch);
+            d.watch = -1;
+          }
+        }
+      }
+#endif
+  }
+
+  /*---------------.
+  | file_library.  |
+  `---------------*/
+
   void
   file_library::push_cwd()
   {
@@ -158,7 +356,7 @@ namespace libport
     if (directory.absolute_get())
     {
       // If file is absolute, just check that it exists.
-      if (!file.exists())
+      if (!(cache_ ? cache_->exists(file) : file.exists()))
       {
         errno = ENOENT;
         throw Not_found();
@@ -180,16 +378,47 @@ namespace libport
   file_library::find_in_directory(const path& dir,
                                   const std::string& file) const
   {
-    return (dir / file).exists();
+    if (cache_ && file.find_first_of(WIN32_IF("/\\", "/")) == file.npos)
+      return cache_->exists(dir.to_string(), file);
+    path p = dir / file;
+    return cache_ ? cache_->exists(p) : p.exists();
+  }
+
+  void
+  file_library::cache_set(bool cache)
+  {
+    if (!cache)
+      cache_.reset();
+    else if (!cache_)
+      cache_.reset(new Cache);
+  }
+
+  void
+  file_library::cache_clear() const
+  {
+    if (cache_)
+      cache_->clear();
   }
 
   path
   file_library::find_in_search_path(const path& relative_path,
                                     const std::string& filename) const
   {
+    // Path operations are expensive compared to lookups in the
+    // cache, avoid them when possible.
+    bool here = cache_ && relative_path.to_string() == ".";
     // Otherwise start scanning the search path.
     foreach (const path& p, search_path_)
     {
+      if (here && p.absolute_get())
+      {
+        // Build the result from the string: copying paths is
+        // deprecated.
+        std::string dir = p.to_string();
+        if (cache_->exists(dir, filename))
+          return path(dir);
+        continue;
+      }
       path checked_dir = p.absolute_get() ? p : current_directory_get() / p;
       checked_dir /= relative_path;
       if (find_in_directory(checked_dir, filename))
@@ -10,12 +10,12 @@
 
 #include <libport/format.hh>
 #include <libport/debug.hh>
+#include <libport/flat-hash-map.hh>
 #include <libport/lockable.hh>
-#include <boost/unordered_map.hpp>
 
 namespace libport
 {
-  class FormatMap: public boost::unordered_map<std::string, boost::format>
+  class FormatMap: public flat_hash_map<std::string, boost::format>
   {
     public:
       FormatMap(bool& ward)
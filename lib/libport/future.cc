@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <boost/bind.hpp>
+
+#include <libport/atomic.hh>
+#include <libport/foreach.hh>
+#include <libport/future.hh>
+
+namespace libport
+{
+  TaskDropped::TaskDropped()
+    : std::runtime_error("task dropped")
+  {
+  }
+
+  namespace future
+  {
+    /*------------.
+    | StateBase.  |
+    `------------*/
+
+    StateBase::StateBase()
+      : ready_(false)
+    {
+    }
+
+    StateBase::~StateBase()
+    {
+    }
+
+    bool
+    StateBase::ready() const
+    {
+      BlockLock bl(cond_);
+      return ready_;
+    }
+
+    bool
+    StateBase::failed() const
+    {
+      BlockLock bl(cond_);
+      return ready_ && exception_;
+    }
+
+    void
+    StateBase::wait() const
+    {
+      BlockLock bl(cond_);
+      while (!ready_)
+        cond_.wait();
+    }
+
+    boost::exception_ptr
+    StateBase::exception() const
+    {
+      BlockLock bl(cond_);
+      return exception_;
+    }
+
+    void
+    StateBase::check() const
+    {
+      wait();
+      if (exception_)
+        boost::rethrow_exception(exception_);
+    }
+
+    void
+    StateBase::onReady(const callback_type& f)
+    {
+      {
+        BlockLock bl(cond_);
+        if (!ready_)
+        {
+          callbacks_.push_back(f);
+          return;
+        }
+      }
+      f();
+    }
+
+    void
+    StateBase::fail(const boost::exception_ptr& e)
+    {
+      {
+        BlockLock bl(cond_);
+        aver(!ready_);
+        exception_ = e;
+      }
+      complete();
+    }
+
+    void
+    StateBase::complete()
+    {
+      std::vector<callback_type> callbacks;
+      {
+        BlockLock bl(cond_);
+        ready_ = true;
+        cond_.broadcast();
+        // The callbacks may hold references on this state.
+        std::swap(callbacks, callbacks_);
+      }
+      foreach (const callback_type& f, callbacks)
+        f();
+    }
+
+    /*-----------.
+    | when_all.  |
+    `-----------*/
+
+    namespace
+    {
+      struct Join: public ThreadSafeRefCounted
+      {
+        Join(const std::vector<rStateBase>& states)
+          : remaining(states.size())
+          , states(states)
+          , res(new State<void>)
+        {}
+
+        volatile long remaining;
+        std::vector<rStateBase> states;
+        libport::intrusive_ptr<State<void> > res;
+      };
+
+      void
+      join_one(libport::intrusive_ptr<Join> join)
+      {
+        if (atomic::decrement_fetch(&join->remaining))
+          return;
+        foreach (const rStateBase& s, join->states)
+          if (s->failed())
+          {
+            join->res->fail(s->exception());
+            return;
+          }
+        join->res->set();
+      }
+    }
+
+    Future<void>
+    when_all(const std::vector<rStateBase>& states)
+    {
+      libport::intrusive_ptr<Join> join(new Join(states));
+      Future<void> res(join->res);
+      if (states.empty())
+        join->res->set();
+      else
+        foreach (const rStateBase& s, states)
+          s->onReady(boost::bind(&join_one, join));
+      return res;
+    }
+  }
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010, Gostai S.A.S.
+ * Copyright (C) 2010, 2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -11,21 +11,17 @@
 #include <libport/config.h>
 #ifdef LIBPORT_ENABLE_SSL
 
-# include <openssl/hmac.h>
 # include <libport/hmac-sha1.hh>
+# include <libport/hmac.hh>
 
 namespace libport
 {
   std::string hmac_sha1(const std::string& input,
 			const std::string& key)
   {
-    unsigned int res_size = 0;
-    const unsigned char *in = (const unsigned char*)(input.c_str ());
-    unsigned char *res = HMAC(EVP_sha1(),
-			      key.c_str(), key.size(),
-			      in, input.size(),
-			      0, &res_size);
-    return std::string ((const char*) res, res_size);
+    Hmac hmac(Hmac::SHA1, key);
+    hmac.update(input);
+    return hmac.final();
   }
 }
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <libport/config.h>
+#ifdef LIBPORT_ENABLE_SSL
+
+# include <openssl/evp.h>
+# include <openssl/opensslv.h>
+
+# include <libport/cassert>
+# include <libport/cstring>
+# include <libport/hmac.hh>
+
+# if OPENSSL_VERSION_NUMBER < 0x10100000L
+#  define EVP_MD_CTX_new EVP_MD_CTX_create
+#  define EVP_MD_CTX_free EVP_MD_CTX_destroy
+# endif
+
+namespace libport
+{
+  struct Hmac::Contexts
+  {
+    Contexts()
+      : inner(EVP_MD_CTX_new())
+      , outer(EVP_MD_CTX_new())
+      , current(EVP_MD_CTX_new())
+    {}
+
+    ~Contexts()
+    {
+      EVP_MD_CTX_free(inner);
+      EVP_MD_CTX_free(outer);
+      EVP_MD_CTX_free(current);
+    }
+
+    /// The state after the inner pad.
+    EVP_MD_CTX* inner;
+    /// The state after the outer pad.
+    EVP_MD_CTX* outer;
+    /// The state of the current message.
+    EVP_MD_CTX* current;
+  };
+
+  Hmac::Hmac(Algorithm algorithm, const std::string& key)
+    : contexts_(new Contexts)
+  {
+    init_(algorithm, key.data(), key.size());
+  }
+
+  Hmac::Hmac(Algorithm algorithm, const char* key, size_t size)
+    : contexts_(new Contexts)
+  {
+    init_(algorithm, key, size);
+  }
+
+  Hmac::~Hmac()
+  {
+    delete contexts_;
+  }
+
+  void
+  Hmac::init_(Algorithm algorithm, const char* key, size_t size)
+  {
+    const EVP_MD* md = algorithm == SHA256 ? EVP_sha256() : EVP_sha1();
+    size_ = EVP_MD_size(md);
+    size_t block = EVP_MD_block_size(md);
+    // Large enough for the blocks of SHA-512.
+    unsigned char ipad[128];
+    unsigned char opad[128];
+    aver(block <= sizeof ipad);
+
+    // Keys longer than a block are replaced by their digest.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    if (block < size)
+    {
+      unsigned len;
+      EVP_DigestInit_ex(contexts_->current, md, 0);
+      EVP_DigestUpdate(contexts_->current, key, size);
+      EVP_DigestFinal_ex(contexts_->current, digest, &len);
+      key = reinterpret_cast<const char*>(digest);
+      size = len;
+    }
+    memset(ipad, 0x36, block);
+    memset(opad, 0x5c, block);
+    for (size_t i = 0; i < size; ++i)
+    {
+      ipad[i] ^= key[i];
+      opad[i] ^= key[i];
+    }
+
+    EVP_DigestInit_ex(contexts_->inner, md, 0);
+    EVP_DigestUpdate(contexts_->inner, ipad, block);
+    EVP_DigestInit_ex(contexts_->outer, md, 0);
+    EVP_DigestUpdate(contexts_->outer, opad, block);
+    EVP_MD_CTX_copy_ex(contexts_->current, contexts_->inner);
+    memset(ipad, 0, block);
+    memset(opad, 0, block);
+  }
+
+  size_t
+  Hmac::size() const
+  {
+    return size_;
+  }
+
+  void
+  Hmac::update(const char* data, size_t size)
+  {
+    EVP_DigestUpdate(contexts_->current, data, size);
+  }
+
+  void
+  Hmac::update(const std::string& data)
+  {
+    update(data.data(), data.size());
+  }
+
+# if !defined WIN32
+  void
+  Hmac::update(const struct iovec* iov, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+      EVP_DigestUpdate(contexts_->current, iov[i].iov_base, iov[i].iov_len);
+  }
+# endif
+
+  void
+  Hmac::final(char* out)
+  {
+    unsigned char inner[EVP_MAX_MD_SIZE];
+    unsigned len;
+    EVP_DigestFinal_ex(contexts_->current, inner, &len);
+    EVP_MD_CTX_copy_ex(contexts_->current, contexts_->outer);
+    EVP_DigestUpdate(contexts_->current, inner, len);
+    EVP_DigestFinal_ex(contexts_->current,
+                       reinterpret_cast<unsigned char*>(out), &len);
+    // Ready for the next message.
+    EVP_MD_CTX_copy_ex(contexts_->current, contexts_->inner);
+  }
+
+  std::string
+  Hmac::final()
+  {
+    char res[EVP_MAX_MD_SIZE];
+    final(res);
+    return std::string(res, size_);
+  }
+
+  std::string
+  hmac_sha256(const std::string& input, const std::string& key)
+  {
+    Hmac hmac(Hmac::SHA256, key);
+    hmac.update(input);
+    return hmac.final();
+  }
+}
+
+#endif
@@ -34,6 +34,7 @@ lib_libport_libport@LIBSFX@_la_CPPFLAGS =       \
 dist_lib_libport_libport@LIBSFX@_la_SOURCES =   \
   lib/libport/asio.cc                           \
   lib/libport/asio-impl.hxx                     \
+  lib/libport/asio-shm.cc                       \
   lib/libport/asio-ssl.cc                       \
   lib/libport/backtrace.cc                      \
   lib/libport/base64.cc                         \
@@ -55,7 +56,9 @@ dist_lib_libport_libport@LIBSFX@_la_SOURCES =   \
   lib/libport/file-system.cc                    \
   lib/libport/fnmatch.cc                        \
   lib/libport/format.cc                         \
+  lib/libport/future.cc                         \
   lib/libport/hmac-sha1.cc                      \
+  lib/libport/hmac.cc                           \
   lib/libport/indent.cc                         \
   lib/libport/input-arguments.cc                \
   lib/libport/io-stream.cc                      \
@@ -68,6 +71,7 @@ dist_lib_libport_libport@LIBSFX@_la_SOURCES =   \
   lib/libport/pid-file.cc                       \
   lib/libport/program-name.cc                   \
   lib/libport/read-stdin.cc                     \
+  lib/libport/ring-fifo.cc                      \
   lib/libport/sched.cc                          \
   lib/libport/semaphore-rpl.cc                  \
   lib/libport/semaphore.cc                      \
@@ -78,6 +82,7 @@ dist_lib_libport_libport@LIBSFX@_la_SOURCES =   \
   lib/libport/timer.cc                          \
   lib/libport/thread-pool.cc                    \
   lib/libport/tokenizer.cc                      \
+  lib/libport/trace.cc                          \
   lib/libport/ufloat.cc                         \
   lib/libport/umatrix.cc                        \
   lib/libport/unique-pointer.cc                 \
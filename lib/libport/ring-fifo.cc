@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include <libport/cstring>
+#include <libport/detect-win32.h>
+#include <libport/ring-fifo.hh>
+#include <libport/unistd.h>
+
+#if defined WIN32
+# include <libport/windows.hh>
+#else
+# include <fcntl.h>
+# include <sched.h>
+# include <sys/mman.h>
+#endif
+
+namespace libport
+{
+  /*-----------------.
+  | MirroredBuffer.  |
+  `-----------------*/
+
+#if !defined WIN32
+  /// Map a shared memory object of \a size bytes twice in a row.
+  /// \return the address of the first mapping, or 0 on failure.
+  static char*
+  mirror_map(size_t size)
+  {
+    static volatile long counter = 0;
+    char name[64];
+    snprintf(name, sizeof name, "/libport-ring-%ld-%ld",
+             long(getpid()), atomic::fetch_increment(&counter));
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+      return 0;
+    shm_unlink(name);
+    char* res = 0;
+    if (!ftruncate(fd, size))
+    {
+      // Reserve the whole range, then replace both halves.
+      void* base = mmap(0, 2 * size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANON, -1, 0);
+      if (base != MAP_FAILED)
+      {
+        res = static_cast<char*>(base);
+        if (mmap(res, size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+            || mmap(res + size, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+          munmap(base, 2 * size);
+          res = 0;
+        }
+      }
+    }
+    close(fd);
+    return res;
+  }
+#endif
+
+  MirroredBuffer::MirroredBuffer(size_t capacity)
+    : data_(0)
+    , capacity_(0)
+    , mirrored_(false)
+  {
+#if defined WIN32
+    capacity_ = 4096;
+#else
+    capacity_ = sysconf(_SC_PAGESIZE);
+#endif
+    while (capacity_ < capacity)
+      capacity_ <<= 1;
+#if !defined WIN32
+    data_ = mirror_map(capacity_);
+    mirrored_ = data_;
+#endif
+    if (!data_)
+      data_ = new char[capacity_];
+  }
+
+  MirroredBuffer::~MirroredBuffer()
+  {
+#if !defined WIN32
+    if (mirrored_)
+    {
+      munmap(data_, 2 * capacity_);
+      return;
+    }
+#endif
+    delete [] data_;
+  }
+
+  /*---------------.
+  | RingFifoBase.  |
+  `---------------*/
+
+  RingFifoBase::RingFifoBase(size_t capacity)
+    : buffer_(capacity)
+    , mask_(buffer_.capacity() - 1)
+    , read_(0)
+    , write_cache_(0)
+    , write_(0)
+    , read_cache_(0)
+  {}
+
+  size_t
+  RingFifoBase::pop(char* data, size_t n)
+  {
+    unsigned long r = read_;
+    if (write_cache_ - r < n)
+      write_cache_ = atomic::load_acquire(&write_);
+    n = std::min(n, size_t(write_cache_ - r));
+    // Do not rely on the mirror, pop() works on any buffer.
+    size_t offset = r & mask_;
+    size_t first = std::min(n, capacity() - offset);
+    memcpy(data, buffer_.data() + offset, first);
+    memcpy(data + first, buffer_.data(), n - first);
+    atomic::store_release(&read_, r + n);
+    return n;
+  }
+
+  /*-----------.
+  | RingFifo.  |
+  `-----------*/
+
+  RingFifo::RingFifo(size_t capacity)
+    : RingFifoBase(capacity)
+  {}
+
+  size_t
+  RingFifo::push(const char* data, size_t n)
+  {
+    unsigned long w = write_;
+    if (capacity() - (w - read_cache_) < n)
+      read_cache_ = atomic::load_acquire(&read_);
+    n = std::min(n, size_t(capacity() - (w - read_cache_)));
+    size_t offset = w & mask_;
+    size_t first = std::min(n, capacity() - offset);
+    memcpy(buffer_.data() + offset, data, first);
+    memcpy(buffer_.data(), data + first, n - first);
+    atomic::store_release(&write_, w + n);
+    return n;
+  }
+
+  /*------------------------.
+  | MultiProducerRingFifo.  |
+  `------------------------*/
+
+  MultiProducerRingFifo::MultiProducerRingFifo(size_t capacity)
+    : RingFifoBase(capacity)
+    , reserve_(0)
+  {}
+
+  bool
+  MultiProducerRingFifo::reserve_bytes_(size_t n, bool contiguous,
+                                        unsigned long& position)
+  {
+    while (true)
+    {
+      unsigned long p = atomic::load_acquire(&reserve_);
+      unsigned long r = atomic::load_acquire(&read_);
+      if (capacity() - (p - r) < n)
+        return false;
+      if (contiguous && !mirrored() && capacity() - (p & mask_) < n)
+        return false;
+      if (atomic::compare_and_swap(&reserve_, p, p + n))
+      {
+        position = p;
+        return true;
+      }
+      atomic::relax();
+    }
+  }
+
+  char*
+  MultiProducerRingFifo::write_begin(size_t n, unsigned long& position)
+  {
+    if (!reserve_bytes_(n, true, position))
+      return 0;
+    return buffer_.data() + (position & mask_);
+  }
+
+  void
+  MultiProducerRingFifo::write_commit(unsigned long position, size_t n)
+  {
+    // Wait for the producers which reserved before us, letting them
+    // run if they were preempted.
+    for (unsigned i = 0;
+         (unsigned long)(atomic::load_acquire(&write_)) != position;
+         ++i)
+      if (i < 64)
+        atomic::relax();
+      else
+#if defined WIN32
+        Sleep(0);
+#else
+        sched_yield();
+#endif
+    atomic::store_release(&write_, position + n);
+  }
+
+  bool
+  MultiProducerRingFifo::push(const char* data, size_t n)
+  {
+    unsigned long position;
+    if (!reserve_bytes_(n, false, position))
+      return false;
+    size_t offset = position & mask_;
+    size_t first = std::min(n, capacity() - offset);
+    memcpy(buffer_.data() + offset, data, first);
+    memcpy(buffer_.data(), data + first, n - first);
+    write_commit(position, n);
+    return true;
+  }
+}
@@ -17,7 +17,7 @@
 
 #include <libport/unistd.h>
 
-#if defined LIBPORT_HAVE_SCHED_H
+#if defined LIBPORT_HAVE_SCHED_H || defined LIBPORT_HAVE_SCHED_SETAFFINITY
 # include <sched.h>
 #endif
 #if defined LIBPORT_HAVE_SYS_RESOURCE_H
@@ -27,6 +27,7 @@
 # include <sys/mman.h>
 #endif
 
+#include <libport/foreach.hh>
 #include <libport/utime.hh>
 #include <libport/sched.hh>
 #include <libport/windows.hh>
@@ -88,4 +89,28 @@ namespace libport
 #endif
   lockStack();
   }
+
+  bool
+  sched_set_affinity(const std::vector<unsigned>& cpus)
+  {
+    if (cpus.empty())
+      return false;
+#if defined WIN32
+    DWORD_PTR mask = 0;
+    foreach (unsigned cpu, cpus)
+      if (cpu < sizeof mask * 8)
+        mask |= DWORD_PTR(1) << cpu;
+    return mask && SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined LIBPORT_HAVE_SCHED_SETAFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    foreach (unsigned cpu, cpus)
+      if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    // Pid 0 is the calling thread.
+    return !sched_setaffinity(0, sizeof set, &set);
+#else
+    return false;
+#endif
+  }
 }
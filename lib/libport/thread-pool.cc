@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011, Gostai S.A.S.
+ * Copyright (C) 2010-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,6 +8,12 @@
  * See the LICENSE file for more information.
  */
 
+#include <algorithm>
+
+#include <libport/allocator-static.hh>
+#include <libport/atomic.hh>
+#include <libport/foreach.hh>
+#include <libport/sched.hh>
 #include <libport/utime.hh>
 #include <libport/thread-pool.hh>
 #include <libport/thread.hh>
@@ -18,78 +24,163 @@
 
 namespace libport
 {
+  namespace
+  {
+    /// Storage for the task handles.
+    struct TaskSlot
+      : ThreadSafeStaticallyAllocated<TaskSlot, 256>
+    {
+      static const size_t allocator_static_max_size;
+    };
+
+    const size_t TaskSlot::allocator_static_max_size =
+      sizeof(ThreadPool::TaskHandle);
+  }
+
+  UnmanagedThreadSpecificPtr<ThreadPool::Thread> ThreadPool::current_;
+
+  namespace
+  {
+    /// State of a ThreadPool::runChunks call.
+    struct Chunks: public ThreadSafeRefCounted
+    {
+      typedef boost::function1<void, size_t> chunk_type;
+
+      Chunks(size_t n, const chunk_type& chunk)
+        : n(n)
+        , next(0)
+        , done(0)
+        , failed(false)
+        , chunk(chunk)
+      {}
+
+      /// Process chunks until none is left.
+      void
+      work()
+      {
+        size_t i;
+        while ((i = atomic::fetch_increment(&next)) < n)
+        {
+          // Once a chunk failed, the others are claimed but skipped.
+          if (!failed)
+            try
+            {
+              chunk(i);
+            }
+            catch (...)
+            {
+              libport::BlockLock bl(cond);
+              if (!failed)
+                exception = boost::current_exception();
+              failed = true;
+            }
+          libport::BlockLock bl(cond);
+          if (++done == n)
+            cond.broadcast();
+        }
+      }
+
+      size_t n;
+      volatile long next;
+      size_t done;
+      volatile bool failed;
+      boost::exception_ptr exception;
+      Condition cond;
+      chunk_type chunk;
+    };
+  }
+
   ThreadPool::ThreadPool(size_t maxThreads)
-    : maxThreads_(maxThreads)
+    : nOverflow_(0)
+    , nLocal_(0)
+    , nQueued_(0)
+    , nThreads_(0)
+    , nIdle_(0)
+    , nWaking_(0)
+    , stealFrom_(0)
+    , maxThreads_(maxThreads)
+    , stopping_(false)
+    , nStarted_(0)
+    , maxSpin_(0)
+    , nSpinning_(0)
+    , metricsEnabled_(false)
   {
   }
 
+  ThreadPool::~ThreadPool()
+  {
+    std::vector<rThread> threads;
+    {
+      libport::BlockLock bl(lock_);
+      stopping_ = true;
+      // No thread starts from now on.
+      threads = threads_;
+      // Wake the sleepers up as wake() does, so that they retire.
+      foreach (const rThread& t, idleThreads_)
+      {
+        atomic::decrement_fetch(&nIdle_);
+        t->waking = true;
+        atomic::increment_fetch(&nWaking_);
+        t->sem++;
+      }
+      idleThreads_.clear();
+    }
+    foreach (const rThread& t, threads)
+      PTHREAD_RUN(pthread_join, t->handle, 0);
+  }
+
   size_t
   ThreadPool::queueSize()
   {
-    libport::BlockLock bl(lock_);
-    return queue_.size() + nLockedTasks_;
+    return nQueued_;
   }
 
   void
   ThreadPool::threadLoop(rThread thread)
   {
-    // will wait on our sem if true
     debug("new thread start");
-    bool waiting = true;
+    pin(thread);
+    current_.reset(thread.get());
     while (true)
     {
-      debug(" thread waiting? " << waiting);
-      if (waiting)
-      {
-        thread->sem--; // our task was set by another thread
-        debug("thread done waiting");
-        waiting = false;
-      }
-      else if (thread->taskLock)
+      if (thread->taskLock)
       {
         debug("handling taskLock task");
-        libport::BlockLock bl(lock_);
-        if (thread->taskLock->waitingTasks.empty())
+        rTaskLock lock = thread->taskLock;
+        libport::BlockLock bl(lock->waitingLock);
+        if (lock->waitingTasks.empty())
         { // No more tasks, deregister.
           debug("deregistering taskLock");
-          thread->taskLock->handler = 0;
-          thread->taskLock->registered = false;
+          lock->handler = 0;
+          lock->registered = false;
           thread->taskLock = 0;
           continue;
         }
         else
         {
           debug("popping taskLock task");
-          thread->currentTask = thread->taskLock->waitingTasks.front();
-          thread->taskLock->waitingTasks.pop_front();
-          nLockedTasks_--;
+          thread->currentTask = lock->waitingTasks.front();
+          lock->waitingTasks.pop_front();
         }
       }
       else
       {
-        debug("thread fetching task to main queue");
-        // Go fetch ourselve a task
-        libport::BlockLock bl(lock_);
-        if (threads_.size() > maxThreads_ && maxThreads_)
+        if (retire(thread))
         {
-          debug("thread diing");
-          // maxThreads_ was decreased, die
-          threads_.remove(thread);
+          current_.reset();
+          // Someone has to handle the tasks we left.
+          if (pending())
+            wake();
           return;
         }
-        if (queue_.empty())
-        {
-          // Nothing to do, register as idle.
-          debug("queue empty, will wait");
-          idleThreads_.push_back(thread);
-          waiting = true;
+        debug("thread fetching task");
+        thread->currentTask = fetch(thread);
+        if (!thread->currentTask)
           continue;
-        }
-        thread->currentTask = queue_.front();
-        queue_.pop_front();
         // If current task was associated to a taskLock, handle it from now.
         thread->taskLock = thread->currentTask->taskLock;
       }
+      atomic::decrement_fetch(&nQueued_);
       thread->currentTask->state_ = TaskHandle::RUNNING;
       try {
         thread->currentTask->taskFunc();
@@ -105,57 +196,359 @@ namespace libport
     }
   }
 
+  bool
+  ThreadPool::retire(rThread thread)
+  {
+    if (!stopping_ && (!maxThreads_ || size_t(nThreads_) <= maxThreads_))
+      return false;
+    libport::BlockLock bl(lock_);
+    if (stopping_ ? pending() : threads_.size() <= maxThreads_)
+      return false;
+    debug("thread diing");
+    // maxThreads_ was decreased, or the pool is done, die.  Leave our
+    // pending tasks, if any, to the others.
+    {
+      libport::BlockLock tl(thread->tasksLock);
+      overflow_.insert(overflow_.end(),
+                       thread->tasks.begin(), thread->tasks.end());
+      nOverflow_ += thread->tasks.size();
+      nLocal_ -= thread->tasks.size();
+      thread->tasks.clear();
+    }
+    threads_.erase(std::find(threads_.begin(), threads_.end(), thread));
+    atomic::decrement_fetch(&nThreads_);
+    return true;
+  }
+
   ThreadPool::rTaskHandle
-  ThreadPool::queueTask(TaskFunc func, rTaskLock lock)
+  ThreadPool::tryFetch(rThread thread)
   {
-    rTaskHandle res(new TaskHandle);
-    res->taskFunc = func;
-    res->taskLock = lock;
-    /* Three cases:
-       - Task depends on another running task: add to this dependency queue.
-       - We have IDLE threads: wake one up
-       - Thread count is below limit: spawn a thread.
-       - Else: queue
-    */
+    rTaskHandle res;
+    // Newest task we queued ourselves.
+    {
+      libport::BlockLock bl(thread->tasksLock);
+      if (!thread->tasks.empty())
+      {
+        res = thread->tasks.back();
+        thread->tasks.pop_back();
+        atomic::decrement_fetch(&nLocal_);
+        return res;
+      }
+    }
+
+    // Tasks from the outside world.
+    if (injection_.pop(res))
+      return res;
+
+    // Nothing overflowed and nothing to steal: no need to look further.
+    if (!nOverflow_ && !nLocal_)
+      return 0;
+
     libport::BlockLock bl(lock_);
-    if (lock && lock->registered)
+    if (!overflow_.empty())
+    {
+      res = overflow_.front();
+      overflow_.pop_front();
+      atomic::decrement_fetch(&nOverflow_);
+      return res;
+    }
+
+    // Oldest task of another thread.
+    for (size_t i = 0; i < threads_.size(); ++i)
+    {
+      Thread& victim = *threads_[(stealFrom_ + i) % threads_.size()];
+      if (&victim == thread.get())
+        continue;
+      libport::BlockLock tl(victim.tasksLock);
+      if (!victim.tasks.empty())
+      {
+        debug("stealing task");
+        res = victim.tasks.front();
+        victim.tasks.pop_front();
+        atomic::decrement_fetch(&nLocal_);
+        stealFrom_ += i + 1;
+        return res;
+      }
+    }
+    return 0;
+  }
+
+  void
+  ThreadPool::pin(rThread thread)
+  {
+    CpuSet cpus;
+    {
+      libport::BlockLock bl(lock_);
+      if (affinity_.empty())
+        return;
+      cpus = affinity_[thread->rank % affinity_.size()];
+    }
+    if (!sched_set_affinity(cpus))
+      return;
+    debug("thread pinned");
+    // Reallocate our deque from the thread, so that it is first
+    // touched from our NUMA node.
+    libport::BlockLock tl(thread->tasksLock);
+    std::deque<rTaskHandle>(thread->tasks.begin(), thread->tasks.end())
+      .swap(thread->tasks);
+  }
+
+  bool
+  ThreadPool::spin(rThread thread)
+  {
+    unsigned max = maxSpin_;
+    if (!max)
+      return false;
+    unsigned n = std::max(1u, std::min(thread->spin, max));
+    // Let wake() rely on us rather than on the sleeping threads.
+    atomic::increment_fetch(&nSpinning_);
+    bool found = false;
+    for (unsigned i = 0; i < n && !(found = pending()); ++i)
+      atomic::relax();
+    atomic::decrement_fetch(&nSpinning_);
+    thread->spin = found ? std::min(2 * n, max) : n / 2;
+    if (found && metricsEnabled_)
+    {
+      libport::BlockLock bl(metricsLock_);
+      ++metrics_.spinHits;
+    }
+    return found;
+  }
+
+  bool
+  ThreadPool::pending() const
+  {
+    return !injection_.empty() || nOverflow_ || nLocal_;
+  }
+
+  void
+  ThreadPool::awake(rThread thread)
+  {
+    thread->waking = false;
+    atomic::decrement_fetch(&nWaking_);
+    if (thread->wokenAt)
     {
-      if (lock->maxSize && lock->waitingTasks.size() >= lock->maxSize -1)
+      utime_t latency = utime() - thread->wokenAt;
+      thread->wokenAt = 0;
+      libport::BlockLock bl(metricsLock_);
+      metrics_.wakeupLatency.add_sample(latency);
+    }
+  }
+
+  ThreadPool::rTaskHandle
+  ThreadPool::fetch(rThread thread)
+  {
+    while (true)
+    {
+      rTaskHandle res = tryFetch(thread);
+      if (thread->waking)
+      {
+        awake(thread);
+        // The producers did not wake anybody while we were on our
+        // way: either look again, or pass the baton.
+        if (!res)
+          res = tryFetch(thread);
+        else if (pending())
+          wake();
+      }
+      if (res)
+        return res;
+
+      // Spin a bit before sleeping.
+      if (spin(thread))
       {
-        debug("queuetask: dropping task");
-        res->state_ = TaskHandle::DROPPED;
+        if ((res = tryFetch(thread)))
+        {
+          // The producers relied on us: pass the baton.
+          if (pending())
+            wake();
+          return res;
+        }
+        continue;
+      }
+
+      // Register as idle, then look again: a task queued before we
+      // were visible to wake() would be missed otherwise.
+      {
+        libport::BlockLock bl(lock_);
+        // The destructor would not wake us up: retire instead.
+        if (stopping_)
+          return 0;
+        idleThreads_.push_back(thread);
+        atomic::increment_fetch(&nIdle_);
+      }
+      if ((res = tryFetch(thread)))
+      {
+        bool picked;
+        {
+          libport::BlockLock bl(lock_);
+          std::vector<rThread>::iterator i =
+            std::find(idleThreads_.begin(), idleThreads_.end(), thread);
+          picked = i == idleThreads_.end();
+          if (!picked)
+          {
+            idleThreads_.erase(i);
+            atomic::decrement_fetch(&nIdle_);
+          }
+        }
+        // wake() picked us in the meantime: consume its token, and
+        // act as if it woke us up.
+        if (picked)
+        {
+          thread->sem--;
+          awake(thread);
+          if (pending())
+            wake();
+        }
         return res;
       }
-      debug("queuetask: registered taskLock");
-      lock->waitingTasks.push_back(res);
-      nLockedTasks_++;
+
+      debug("queue empty, will wait");
+      if (metricsEnabled_)
+      {
+        libport::BlockLock bl(metricsLock_);
+        ++metrics_.sleeps;
+      }
+      thread->sem--;
+      debug("thread done waiting");
     }
-    else if (!idleThreads_.empty())
+  }
+
+  void
+  ThreadPool::wake()
+  {
+    // Publish the task before looking for sleepers, see fetch().
+    atomic::barrier();
+    // A thread already on its way, or spinning, will wake another one
+    // if needed.
+    if (nWaking_ || nSpinning_)
+      return;
+    if (nIdle_)
     {
-      debug("queuetask to idle thread");
-      rThread t = idleThreads_.back();
-      idleThreads_.pop_back();
-      t->currentTask = res;
-      t->sem++;
+      libport::BlockLock bl(lock_);
+      if (!idleThreads_.empty())
+      {
+        debug("waking idle thread");
+        rThread t = idleThreads_.back();
+        idleThreads_.pop_back();
+        atomic::decrement_fetch(&nIdle_);
+        t->waking = true;
+        atomic::increment_fetch(&nWaking_);
+        t->wokenAt = metricsEnabled_ ? utime() : 0;
+        t->sem++;
+        return;
+      }
     }
-    else if (threads_.size() < maxThreads_ || !maxThreads_)
+    if (!maxThreads_ || size_t(nThreads_) < maxThreads_)
     {
-      debug("queuetask to new thread");
-      rThread rt(new Thread);
+      libport::BlockLock bl(lock_);
+      if (stopping_ || (maxThreads_ && threads_.size() >= maxThreads_))
+        return;
+      debug("spawning new thread");
+      rThread rt(new Thread(this));
+      rt->rank = nStarted_++;
+      rt->spin = maxSpin_;
+      rt->wokenAt = metricsEnabled_ ? utime() : 0;
+      rt->waking = true;
+      atomic::increment_fetch(&nWaking_);
       threads_.push_back(rt);
+      atomic::increment_fetch(&nThreads_);
       rt->handle = libport::startThread(boost::bind(&ThreadPool::threadLoop,
                                                     this, rt));
-      rt->currentTask = res;
-      rt->sem++;
     }
-    else
-      queue_.push_back(res);
+  }
+
+  void
+  ThreadPool::schedule(const rTaskHandle& task)
+  {
+    Thread* self = current_.get();
+    if (self && self->pool == this)
+    {
+      debug("queuetask to local deque");
+      libport::BlockLock bl(self->tasksLock);
+      self->tasks.push_back(task);
+      atomic::increment_fetch(&nLocal_);
+    }
+    else if (!injection_.push(task))
+    {
+      debug("queuetask to overflow queue");
+      libport::BlockLock bl(lock_);
+      overflow_.push_back(task);
+      atomic::increment_fetch(&nOverflow_);
+    }
+    wake();
+  }
+
+  ThreadPool::rTaskHandle
+  ThreadPool::queueTask(TaskFunc func, rTaskLock lock)
+  {
+    rTaskHandle res(new TaskHandle);
+    res->taskFunc = func;
+    res->taskLock = lock;
+    res->state_ = TaskHandle::QUEUED;
+    /* Two cases:
+       - Task depends on another running task: add to this dependency queue.
+       - Else: queue, and wake up or spawn a thread to handle it.
+    */
     if (lock)
+    {
+      libport::BlockLock bl(lock->waitingLock);
+      if (lock->registered)
+      {
+        if (lock->maxSize && lock->waitingTasks.size() >= lock->maxSize -1)
+        {
+          debug("queuetask: dropping task");
+          res->state_ = TaskHandle::DROPPED;
+          return res;
+        }
+        debug("queuetask: registered taskLock");
+        lock->waitingTasks.push_back(res);
+        atomic::increment_fetch(&nQueued_);
+        return res;
+      }
       lock->registered = true;
-    res->state_ = TaskHandle::QUEUED;
+    }
+    atomic::increment_fetch(&nQueued_);
+    schedule(res);
+    if (metricsEnabled_)
+    {
+      libport::BlockLock bl(metricsLock_);
+      metrics_.queueDepth.add_sample(nQueued_);
+    }
     return res;
   }
 
+  void
+  ThreadPool::runChunks(size_t n, const boost::function1<void, size_t>& chunk)
+  {
+    if (!n)
+      return;
+    libport::intrusive_ptr<Chunks> chunks(new Chunks(n, chunk));
+    // Helpers which start late just find nothing left to do.
+    size_t helpers = n - 1;
+    if (maxThreads_)
+      helpers = std::min(helpers, maxThreads_);
+    for (size_t i = 0; i < helpers; ++i)
+      queueTask(boost::bind(&Chunks::work, chunks));
+    chunks->work();
+    {
+      libport::BlockLock bl(chunks->cond);
+      while (chunks->done != n)
+        chunks->cond.wait();
+    }
+    if (chunks->failed)
+      boost::rethrow_exception(chunks->exception);
+  }
+
+  ThreadPool::Thread::Thread(ThreadPool* pool)
+    : pool(pool)
+    , waking(false)
+    , rank(0)
+    , spin(0)
+    , wokenAt(0)
+  {
+  }
+
   ThreadPool::Thread::~Thread()
   {
   }
@@ -178,9 +571,60 @@ namespace libport
     return state_;
   }
 
+  void*
+  ThreadPool::TaskHandle::operator new(size_t size)
+  {
+    return TaskSlot::operator new(size);
+  }
+
+  void
+  ThreadPool::TaskHandle::operator delete(void* obj)
+  {
+    TaskSlot::operator delete(obj);
+  }
+
   void
   ThreadPool::resize(size_t maxThreads)
   {
     maxThreads_ = maxThreads;
   }
+
+  void
+  ThreadPool::setAffinity(const std::vector<CpuSet>& cpus)
+  {
+    libport::BlockLock bl(lock_);
+    affinity_ = cpus;
+  }
+
+  void
+  ThreadPool::setSpin(unsigned maxSpin)
+  {
+    maxSpin_ = maxSpin;
+  }
+
+  ThreadPool::Metrics::Metrics()
+    : spinHits(0)
+    , sleeps(0)
+  {
+  }
+
+  void
+  ThreadPool::setMetrics(bool enable)
+  {
+    metricsEnabled_ = enable;
+  }
+
+  ThreadPool::Metrics
+  ThreadPool::metrics()
+  {
+    libport::BlockLock bl(metricsLock_);
+    return metrics_;
+  }
+
+  void
+  ThreadPool::resetMetrics()
+  {
+    libport::BlockLock bl(metricsLock_);
+    metrics_ = Metrics();
+  }
 };
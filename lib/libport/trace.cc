@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include <boost/thread/tss.hpp>
+
+#include <libport/atomic.hh>
+#include <libport/foreach.hh>
+#include <libport/lockable.hh>
+#include <libport/trace.hh>
+#include <libport/unistd.h>
+
+namespace libport
+{
+  namespace details
+  {
+    bool trace_enabled = false;
+  }
+
+  namespace
+  {
+    struct TraceEvent
+    {
+      uint64_t begin;
+      uint64_t end;
+      const char* name;
+      const void* context;
+    };
+
+    /// The events of a thread.  Only this thread writes them.
+    struct TraceRing
+    {
+      TraceRing(unsigned id)
+        : id(id)
+        , used(true)
+        , context(0)
+        , size(0)
+      {}
+
+      /// Number of the ring, from 0.
+      unsigned id;
+      /// Whether a thread records in it.  Protected by the lock of
+      /// the TraceState.
+      bool used;
+      const void* context;
+      /// Number of events ever recorded, modulo the clear()s.
+      volatile long size;
+      TraceEvent events[trace_ring_size];
+    };
+
+    static void ring_release(TraceRing* r);
+
+    /// It is never destroyed, so that probes can still run while
+    /// static destructors do.
+    struct TraceState
+    {
+      TraceState()
+        : ring(&ring_release)
+        , origin_ticks(0)
+        , origin_time(0)
+      {}
+
+      /// Protects rings.
+      Lockable lock;
+      /// The rings are never freed: they are reused by the next
+      /// threads, after their events, so that they can be dumped.
+      std::vector<TraceRing*> rings;
+      boost::thread_specific_ptr<TraceRing> ring;
+      /// The clocks when tracing was first enabled, to convert ticks
+      /// to microseconds.
+      uint64_t origin_ticks;
+      utime_t origin_time;
+    };
+
+    static TraceState&
+    state()
+    {
+      static TraceState* res = new TraceState;
+      return *res;
+    }
+
+    static TraceRing&
+    ring_get()
+    {
+      TraceState& s = state();
+      TraceRing* res = s.ring.get();
+      if (!res)
+      {
+        BlockLock lock(s.lock);
+        foreach (TraceRing* r, s.rings)
+          if (!r->used)
+          {
+            res = r;
+            res->used = true;
+            res->context = 0;
+            break;
+          }
+        if (!res)
+        {
+          res = new TraceRing(s.rings.size());
+          s.rings.push_back(res);
+        }
+        s.ring.reset(res);
+      }
+      return *res;
+    }
+
+    /// Called when a thread exits.
+    static void
+    ring_release(TraceRing* r)
+    {
+      BlockLock lock(state().lock);
+      r->used = false;
+    }
+
+    static void
+    json_string(std::ostream& o, const char* s)
+    {
+      o << '"';
+      for (; *s; ++s)
+        if (*s == '"' || *s == '\\')
+          o << '\\' << *s;
+        else if (static_cast<unsigned char>(*s) < 0x20)
+          o << ' ';
+        else
+          o << *s;
+      o << '"';
+    }
+  }
+
+  void
+  trace_enable(bool enable)
+  {
+    TraceState& s = state();
+    if (enable && !s.origin_time)
+    {
+      s.origin_time = utime();
+      s.origin_ticks = trace_clock();
+    }
+    details::trace_enabled = enable;
+  }
+
+  void
+  trace_clear()
+  {
+    TraceState& s = state();
+    BlockLock lock(s.lock);
+    foreach (TraceRing* r, s.rings)
+      atomic::store_release(&r->size, 0);
+  }
+
+  void
+  trace_context_set(const void* context)
+  {
+    ring_get().context = context;
+  }
+
+  void
+  trace_record(const char* name, uint64_t begin)
+  {
+    uint64_t end = trace_clock();
+    TraceRing& r = ring_get();
+    long size = r.size;
+    TraceEvent& e = r.events[size & (trace_ring_size - 1)];
+    e.begin = begin;
+    e.end = end;
+    e.name = name;
+    e.context = r.context;
+    atomic::store_release(&r.size, size + 1);
+  }
+
+  size_t
+  trace_size()
+  {
+    TraceState& s = state();
+    BlockLock lock(s.lock);
+    size_t res = 0;
+    foreach (TraceRing* r, s.rings)
+      res += std::min(long(trace_ring_size), atomic::load_acquire(&r->size));
+    return res;
+  }
+
+  std::ostream&
+  trace_dump(std::ostream& o)
+  {
+    TraceState& s = state();
+    BlockLock lock(s.lock);
+    // Ticks per microsecond.
+    double ratio = 1;
+    utime_t elapsed = utime() - s.origin_time;
+    if (s.origin_time && 0 < elapsed)
+      ratio = double(trace_clock() - s.origin_ticks) / elapsed;
+
+    std::ios::fmtflags flags = o.flags();
+    std::streamsize precision = o.precision();
+    o << std::fixed << std::setprecision(3);
+    o << "{\"traceEvents\":[";
+    const char* sep = "\n";
+    long pid = getpid();
+    foreach (TraceRing* r, s.rings)
+    {
+      o << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":" << r->id
+        << ",\"args\":{\"name\":\"thread " << r->id << "\"}}";
+      sep = ",\n";
+      long size = atomic::load_acquire(&r->size);
+      for (long i = std::max(0L, size - long(trace_ring_size)); i < size; ++i)
+      {
+        const TraceEvent& e = r->events[i & (trace_ring_size - 1)];
+        o << sep << "{\"name\":";
+        json_string(o, e.name);
+        o << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << r->id
+          << ",\"ts\":" << int64_t(e.begin - s.origin_ticks) / ratio
+          << ",\"dur\":" << (e.end - e.begin) / ratio;
+        if (e.context)
+          o << ",\"args\":{\"context\":\"" << e.context << "\"}";
+        o << '}';
+      }
+    }
+    o << "\n]}\n";
+    o.flags(flags);
+    o.precision(precision);
+    return o;
+  }
+}
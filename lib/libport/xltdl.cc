@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,15 +8,30 @@
  * See the LICENSE file for more information.
  */
 
+#include <libport/bind.hh>
 #include <libport/cstdio>
+#include <libport/cstring>
 #include <libport/debug.hh>
+#include <libport/fcntl.h>
+#include <libport/flat-hash-map.hh>
 #include <libport/format.hh>
 #include <libport/iostream>
 #include <libport/path.hxx>
 #include <libport/program-name.hh>
+#include <libport/sys/stat.h>
 #include <libport/sysexits.hh>
+#include <libport/thread-pool.hh>
+#include <libport/unistd.h>
 #include <libport/xltdl.hh>
 
+#if !defined WIN32
+# include <sys/mman.h>
+#endif
+#if defined __linux__
+# include <link.h>
+# define LIBPORT_XLTDL_ELF 1
+#endif
+
 GD_CATEGORY(Libport.Xltdl);
 
 extern "C"
@@ -145,6 +160,37 @@ namespace libport
 # define APPLE_LINUX_WINDOWS(Apple, Linux, Windows) Linux
 #endif
 
+  /// \a s with the extension of libraries.
+  static
+  std::string
+  with_libext(const std::string& s)
+  {
+    const char* libext = APPLE_LINUX_WINDOWS(".dylib", ".so", ".dll");
+    size_t len = strlen(libext);
+    if (s.size() < len || s.substr(s.size() - len) != libext)
+      return s + libext;
+    return s;
+  }
+
+  /// Append the error of the last dlopen of \a where to \a errors.
+  static
+  void
+  dlerror_append(std::string& errors, const std::string& where)
+  {
+    const char* e = dlerror();
+    errors += where + " : " + (e ? e : "unknown error") + "\n";
+  }
+
+  /// Report that no library could be opened, given the \a errors.
+  ATTRIBUTE_NORETURN
+  static
+  void
+  open_fail(const std::string& errors)
+  {
+    GD_FINFO_TRACE("errors where: %s", errors);
+    throw xlt_advise::exception(errors);
+  }
+
 
   xlt_handle
   xlt_advise::open(const std::string& ss)
@@ -164,9 +210,7 @@ namespace libport
     // no-error) when eventually we managed to load the file.
 
     lt_dlhandle res = 0;
-    const char* libext = APPLE_LINUX_WINDOWS(".dylib", ".so", ".dll");
-    if (s.substr(s.length() - strlen(libext)) != libext)
-      s += libext;
+    s = with_libext(s);
     std::string errors;
     // We cannot simply use search_file in file_library, because we
     // don't know the extension of the file we are looking for (*.la,
@@ -180,21 +224,233 @@ namespace libport
     else
       foreach (const libport::path& p, path_.search_path_get())
       {
+        // With a cache, skip the directories without the file.
+        if (path_.cache_get() && !path_.find_in_directory(p, s))
+        {
+          errors += boost::lexical_cast<std::string>(p) + " : not found\n";
+          continue;
+        }
         std::cerr << "try " << p << " " << s << std::endl;
         if ((res = dlopen_(p / s)))
           break;
-       const char* e = dlerror();
-       errors += boost::lexical_cast<std::string>(p)  + " : " + (e?e:"unknown error") + "\n";
+        dlerror_append(errors, boost::lexical_cast<std::string>(p));
       }
     if (!res)
+      open_fail(errors);
+    return res;
+  }
+
+
+  std::string
+  xlt_advise::resolve_(const std::string& name,
+                       const std::string& after) const
+  {
+    std::string s = with_libext(name);
+    if (path_.search_path_get().empty() || libport::path(s).absolute_get())
+      return after.empty() ? s : "";
+    bool skip = !after.empty();
+    foreach (const libport::path& p, path_.search_path_get())
+      if (skip)
+        skip = (p / s).to_string() != after;
+      else if (path_.find_in_directory(p, s))
+        return (p / s).to_string();
+    return "";
+  }
+
+  namespace
+  {
+    /// The batch of libraries of open_all.
+    struct Batch
     {
-      GD_FINFO_TRACE("errors where: %s", errors);
-      throw exception(errors);
+      struct Library
+      {
+        Library()
+          : read_time(0)
+          , state(0)
+        {}
+
+        std::string file;
+        /// Its name for the dynamic linker.
+        std::string soname;
+        std::vector<std::string> needed;
+        utime_t read_time;
+        /// For the topological sort: 0 unvisited, 1 visiting, 2 done.
+        int state;
+      };
+
+      Batch(size_t n)
+        : libraries(n)
+      {}
+
+#ifdef LIBPORT_XLTDL_ELF
+      /// Get the soname and the needed libraries from the ELF image
+      /// of \a size bytes at \a data.
+      static void
+      dynamic(const char* data, size_t size, Library& l)
+      {
+        const ElfW(Ehdr)* eh = reinterpret_cast<const ElfW(Ehdr)*>(data);
+        if (size < sizeof *eh
+            || memcmp(eh->e_ident, ELFMAG, SELFMAG)
+            || eh->e_ident[EI_CLASS] != (sizeof(void*) == 8
+                                         ? ELFCLASS64 : ELFCLASS32)
+            || size < eh->e_phoff + eh->e_phnum * sizeof(ElfW(Phdr)))
+          return;
+        const ElfW(Phdr)* ph =
+          reinterpret_cast<const ElfW(Phdr)*>(data + eh->e_phoff);
+        const ElfW(Phdr)* dynamic = 0;
+        for (int i = 0; i < eh->e_phnum; ++i)
+          if (ph[i].p_type == PT_DYNAMIC)
+            dynamic = ph + i;
+        if (!dynamic || size < dynamic->p_offset + dynamic->p_filesz)
+          return;
+        const ElfW(Dyn)* dyn =
+          reinterpret_cast<const ElfW(Dyn)*>(data + dynamic->p_offset);
+        size_t ndyn = dynamic->p_filesz / sizeof *dyn;
+
+        // The string table, from its address to its offset.
+        ElfW(Addr) strtab = 0;
+        size_t strsz = 0;
+        for (size_t i = 0; i < ndyn && dyn[i].d_tag != DT_NULL; ++i)
+          if (dyn[i].d_tag == DT_STRTAB)
+            strtab = dyn[i].d_un.d_ptr;
+          else if (dyn[i].d_tag == DT_STRSZ)
+            strsz = dyn[i].d_un.d_val;
+        size_t offset = 0;
+        for (int i = 0; i < eh->e_phnum && !offset; ++i)
+          if (ph[i].p_type == PT_LOAD
+              && ph[i].p_vaddr <= strtab
+              && strtab < ph[i].p_vaddr + ph[i].p_filesz)
+            offset = strtab - ph[i].p_vaddr + ph[i].p_offset;
+        if (!offset || size < offset + strsz)
+          return;
+        const char* strings = data + offset;
+
+        for (size_t i = 0; i < ndyn && dyn[i].d_tag != DT_NULL; ++i)
+          if ((dyn[i].d_tag == DT_NEEDED || dyn[i].d_tag == DT_SONAME)
+              && dyn[i].d_un.d_val < strsz)
+          {
+            const char* s = strings + dyn[i].d_un.d_val;
+            std::string name(s, strnlen(s, strsz - dyn[i].d_un.d_val));
+            if (dyn[i].d_tag == DT_NEEDED)
+              l.needed.push_back(name);
+            else
+              l.soname = name;
+          }
+      }
+#endif
+
+      /// Read library \a i ahead, and find its dependencies.
+      void
+      read(size_t i)
+      {
+        Library& l = libraries[i];
+        utime_t start = utime();
+#if !defined WIN32
+        int fd = l.file.empty() ? -1 : ::open(l.file.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd != -1 && !fstat(fd, &st) && st.st_size)
+        {
+          void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (map != MAP_FAILED)
+          {
+            const char* data = static_cast<const char*>(map);
+            madvise(map, st.st_size, MADV_WILLNEED);
+            // Fault the pages in now.
+            volatile char sum = 0;
+            for (off_t p = 0; p < st.st_size; p += 4096)
+              sum ^= data[p];
+# ifdef LIBPORT_XLTDL_ELF
+            dynamic(data, st.st_size, l);
+# endif
+            munmap(map, st.st_size);
+          }
+        }
+        if (fd != -1)
+          close(fd);
+#endif
+        if (l.soname.empty() && !l.file.empty())
+          l.soname = libport::path(l.file).basename();
+        l.read_time = utime() - start;
+      }
+
+      /// Put the libraries needed by \a i, then \a i, in order.
+      void
+      visit(size_t i)
+      {
+        Library& l = libraries[i];
+        if (l.state)
+          return;
+        l.state = 1;
+        foreach (const std::string& n, l.needed)
+        {
+          flat_hash_map<std::string, size_t>::iterator j = sonames.find(n);
+          if (j != sonames.end())
+            visit(j->second);
+        }
+        l.state = 2;
+        order.push_back(i);
+      }
+
+      std::vector<Library> libraries;
+      flat_hash_map<std::string, size_t> sonames;
+      std::vector<size_t> order;
+    };
+  }
+
+  std::vector<xlt_library>
+  xlt_advise::open_all(const std::vector<std::string>& names,
+                       ThreadPool& pool)
+    throw(xlt_advise::exception)
+  {
+    size_t n = names.size();
+    Batch batch(n);
+    for (size_t i = 0; i < n; ++i)
+      batch.libraries[i].file = resolve_(names[i]);
+    pool.runChunks(n, boost::bind(&Batch::read, &batch, _1));
+
+    for (size_t i = 0; i < n; ++i)
+      if (!batch.libraries[i].soname.empty())
+        batch.sonames.insert(std::make_pair(batch.libraries[i].soname, i));
+    for (size_t i = 0; i < n; ++i)
+      batch.visit(i);
+
+    std::vector<xlt_library> res;
+    foreach (size_t i, batch.order)
+    {
+      const Batch::Library& l = batch.libraries[i];
+      xlt_library lib;
+      lib.name = names[i];
+      lib.file = l.file;
+      lib.read_time = l.read_time;
+      utime_t start = utime();
+      if (l.file.empty())
+        // Report the errors as open does.
+        lib.handle = open(names[i]);
+      else
+      {
+        // As open, try the next directories, and report them all.
+        std::string errors;
+        for (std::string f = l.file; !f.empty(); f = resolve_(names[i], f))
+        {
+          if ((lib.handle.handle = dlopen_(f)))
+          {
+            lib.file = f;
+            break;
+          }
+          dlerror_append(errors, boost::lexical_cast<std::string>(
+                           libport::path(f).dirname()));
+        }
+        if (!lib.handle.handle)
+          open_fail(errors);
+      }
+      lib.open_time = utime() - start;
+      GD_FINFO_TRACE("loaded %s: read %sus, open %sus",
+                     lib.name, lib.read_time, lib.open_time);
+      res.push_back(lib);
     }
     return res;
   }
 
-
   /// Throw an exception, or exit with exit_failure_ if nonnull.
   ATTRIBUTE_NORETURN
   void
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/coroutine-local-storage.cc
+ ** \brief Slots of sched::CoroutineLocalStorage.
+ */
+
+#include <libport/lockable.hh>
+
+#include <sched/coroutine-hooks.hh>
+#include <sched/coroutine-local-storage.hh>
+
+namespace sched
+{
+  namespace coroutine_local
+  {
+    void* outside = 0;
+
+    /// Protects the indexes and the list of slot arrays.  Built on
+    /// first use, as storages are often static.
+    static libport::Lockable&
+    lock()
+    {
+      static libport::Lockable* res = new libport::Lockable;
+      return *res;
+    }
+
+    /// Whether each index is used.
+    static std::vector<bool>&
+    used()
+    {
+      static std::vector<bool>* res = new std::vector<bool>;
+      return *res;
+    }
+
+    static Slots* all = 0;
+
+    size_t
+    allocate()
+    {
+      libport::BlockLock l(lock());
+      std::vector<bool>& u = used();
+      size_t res = 0;
+      while (res < u.size() && u[res])
+        ++res;
+      if (res == u.size())
+        u.push_back(true);
+      else
+        u[res] = true;
+      return res;
+    }
+
+    void
+    release(size_t index)
+    {
+      // Run the destructors without the lock, they might use other
+      // storages.
+      std::vector<Slot> values;
+      {
+        libport::BlockLock l(lock());
+        for (Slots* s = all; s; s = s->next)
+          if (index < s->slots.size() && s->slots[index].destroy)
+          {
+            values.push_back(s->slots[index]);
+            s->slots[index].destroy = 0;
+          }
+        used()[index] = false;
+      }
+      for (size_t i = 0; i < values.size(); ++i)
+        values[i].destroy(values[i]);
+    }
+
+    static void
+    free_hook(Coro* coro)
+    {
+      release(coro);
+    }
+
+    Slot&
+    make(size_t index)
+    {
+      Slots*& res = slots(coroutine_current());
+      libport::BlockLock l(lock());
+      if (!res)
+      {
+        static bool hooked = false;
+        if (!hooked)
+        {
+          add_coroutine_free_hook(&free_hook);
+          hooked = true;
+        }
+        res = new Slots;
+        res->slots.reserve(used().size());
+        res->prev = 0;
+        res->next = all;
+        if (all)
+          all->prev = res;
+        all = res;
+      }
+      if (res->slots.size() <= index)
+      {
+        Slot empty = { 0, { 0, 0 } };
+        res->slots.resize(index + 1, empty);
+      }
+      return res->slots[index];
+    }
+
+    void
+    release(Coro* coro)
+    {
+      Slots*& s = slots(coro);
+      if (!s)
+        return;
+      {
+        libport::BlockLock l(lock());
+        if (s->prev)
+          s->prev->next = s->next;
+        else
+          all = s->next;
+        if (s->next)
+          s->next->prev = s->prev;
+      }
+      for (size_t i = 0; i < s->slots.size(); ++i)
+        if (s->slots[i].destroy)
+          s->slots[i].destroy(s->slots[i]);
+      delete s;
+      s = 0;
+    }
+  }
+}
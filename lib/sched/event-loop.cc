@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/event-loop.cc
+ ** \brief Implementation of sched::EventLoop.
+ */
+
+#include <libport/atomic.hh>
+#include <libport/bind.hh>
+#include <libport/debug.hh>
+
+#include <sched/event-loop.hh>
+#include <sched/scheduler.hh>
+
+GD_CATEGORY(Sched);
+
+namespace sched
+{
+  static void
+  nothing()
+  {
+  }
+
+  static void
+  expired(const boost::system::error_code&)
+  {
+  }
+
+  EventLoop::EventLoop(Scheduler& scheduler, boost::asio::io_service& io)
+    : scheduler_(scheduler)
+    , io_(io)
+    , work_(io)
+    , timer_(io)
+    , stop_(0)
+  {
+    scheduler_.remote_wakeup_hook_set(boost::bind(&EventLoop::interrupt_,
+                                                  this));
+  }
+
+  EventLoop::~EventLoop()
+  {
+    scheduler_.remote_wakeup_hook_set(0);
+  }
+
+  void
+  EventLoop::interrupt_()
+  {
+    // The reactor is woken up by its own interrupter (an eventfd on
+    // Linux) when a handler is posted while it waits.
+    io_.post(&nothing);
+  }
+
+  libport::utime_t
+  EventLoop::run_once()
+  {
+    libport::utime_t deadline = scheduler_.work();
+    if (deadline == SCHED_EXIT)
+      return deadline;
+    if (deadline != SCHED_IMMEDIATE)
+    {
+      libport::utime_t delay = deadline - scheduler_.get_time();
+      if (0 < delay)
+      {
+        GD_FINFO_DUMP("waiting for events for %sus", delay);
+        timer_.expires_from_now(boost::posix_time::microseconds(delay));
+        timer_.async_wait(&expired);
+        io_.run_one();
+        // The cancelled wait completes in the poll below.
+        timer_.cancel();
+      }
+    }
+    io_.poll();
+    // Otherwise run_one() and poll() would return at once.
+    if (io_.stopped())
+    {
+      GD_INFO_DEBUG("io_service stopped");
+      io_.reset();
+      libport::atomic::store_release(&stop_, 1);
+    }
+    return deadline;
+  }
+
+  void
+  EventLoop::run()
+  {
+    while (!libport::atomic::compare_and_swap(&stop_, 1, 0)
+           && run_once() != SCHED_EXIT)
+      continue;
+  }
+
+  void
+  EventLoop::stop()
+  {
+    libport::atomic::store_release(&stop_, 1);
+    interrupt_();
+  }
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/// \file sched/fast-coro.cc
+/// \brief Register-only context switch.
+
+#include <sched/coroutine.hh>
+
+#if defined SCHED_USE_FAST_CORO
+
+# include <boost/cstdint.hpp>
+
+extern "C"
+{
+  /// First frame of every coroutine: call the callback stored in the
+  /// initial frame.  It must never return.
+  __attribute__ ((visibility("hidden")))
+  void sched_fast_coro_trampoline();
+}
+
+/*---------.
+| x86-64.  |
+`---------*/
+
+// Saved frame, from the stack pointer upward: MXCSR and x87 control
+// word, r15, r14, r13, r12, rbx, rbp, return address.
+
+# if defined __x86_64__
+
+__asm__(
+  ".text\n"
+  ".globl sched_fast_coro_jump\n"
+  ".type sched_fast_coro_jump, @function\n"
+  ".align 16\n"
+  "sched_fast_coro_jump:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size sched_fast_coro_jump, .-sched_fast_coro_jump\n"
+
+  ".globl sched_fast_coro_jump_fpu\n"
+  ".type sched_fast_coro_jump_fpu, @function\n"
+  ".align 16\n"
+  "sched_fast_coro_jump_fpu:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size sched_fast_coro_jump_fpu, .-sched_fast_coro_jump_fpu\n"
+
+  ".type sched_fast_coro_trampoline, @function\n"
+  ".align 16\n"
+  "sched_fast_coro_trampoline:\n"
+  "  .cfi_startproc\n"
+  "  .cfi_undefined rip\n"
+  "  movq %r13, %rdi\n"
+  "  callq *%r12\n"
+  "  ud2\n"
+  "  .cfi_endproc\n"
+  ".size sched_fast_coro_trampoline, .-sched_fast_coro_trampoline\n"
+  );
+
+static const size_t frame_size = 8;
+static const size_t frame_fpu_slot = 0;
+static const size_t frame_callback = 4;
+static const size_t frame_context = 3;
+static const size_t frame_return = 7;
+// MXCSR with all exceptions masked, and x87 control word with double
+// extended precision, as mandated by the ABI.
+static const boost::uint64_t frame_fpu = 0x037F00001F80ULL;
+
+/*----------.
+| AArch64.  |
+`----------*/
+
+// Saved frame, from the stack pointer upward: x19 to x30, d8 to d15,
+// FPCR and padding.
+
+# elif defined __aarch64__
+
+#  define SAVE                                  \
+  "  sub sp, sp, #176\n"                        \
+  "  stp x19, x20, [sp, #0]\n"                  \
+  "  stp x21, x22, [sp, #16]\n"                 \
+  "  stp x23, x24, [sp, #32]\n"                 \
+  "  stp x25, x26, [sp, #48]\n"                 \
+  "  stp x27, x28, [sp, #64]\n"                 \
+  "  stp x29, x30, [sp, #80]\n"                 \
+  "  stp d8, d9, [sp, #96]\n"                   \
+  "  stp d10, d11, [sp, #112]\n"                \
+  "  stp d12, d13, [sp, #128]\n"                \
+  "  stp d14, d15, [sp, #144]\n"
+
+#  define SWAP                                  \
+  "  mov x9, sp\n"                              \
+  "  str x9, [x0]\n"                            \
+  "  mov sp, x1\n"
+
+#  define RESTORE                               \
+  "  ldp x19, x20, [sp, #0]\n"                  \
+  "  ldp x21, x22, [sp, #16]\n"                 \
+  "  ldp x23, x24, [sp, #32]\n"                 \
+  "  ldp x25, x26, [sp, #48]\n"                 \
+  "  ldp x27, x28, [sp, #64]\n"                 \
+  "  ldp x29, x30, [sp, #80]\n"                 \
+  "  ldp d8, d9, [sp, #96]\n"                   \
+  "  ldp d10, d11, [sp, #112]\n"                \
+  "  ldp d12, d13, [sp, #128]\n"                \
+  "  ldp d14, d15, [sp, #144]\n"                \
+  "  add sp, sp, #176\n"                        \
+  "  ret\n"
+
+__asm__(
+  ".text\n"
+  ".globl sched_fast_coro_jump\n"
+  ".type sched_fast_coro_jump, %function\n"
+  ".align 4\n"
+  "sched_fast_coro_jump:\n"
+  SAVE
+  SWAP
+  RESTORE
+  ".size sched_fast_coro_jump, .-sched_fast_coro_jump\n"
+
+  ".globl sched_fast_coro_jump_fpu\n"
+  ".type sched_fast_coro_jump_fpu, %function\n"
+  ".align 4\n"
+  "sched_fast_coro_jump_fpu:\n"
+  SAVE
+  "  mrs x9, fpcr\n"
+  "  str x9, [sp, #160]\n"
+  SWAP
+  "  ldr x9, [sp, #160]\n"
+  "  msr fpcr, x9\n"
+  RESTORE
+  ".size sched_fast_coro_jump_fpu, .-sched_fast_coro_jump_fpu\n"
+
+  ".type sched_fast_coro_trampoline, %function\n"
+  ".align 4\n"
+  "sched_fast_coro_trampoline:\n"
+  "  .cfi_startproc\n"
+  "  .cfi_undefined x30\n"
+  "  mov x0, x20\n"
+  "  blr x19\n"
+  "  brk #0\n"
+  "  .cfi_endproc\n"
+  ".size sched_fast_coro_trampoline, .-sched_fast_coro_trampoline\n"
+  );
+
+#  undef SAVE
+#  undef SWAP
+#  undef RESTORE
+
+static const size_t frame_size = 22;
+static const size_t frame_fpu_slot = 20;
+static const size_t frame_callback = 0;
+static const size_t frame_context = 1;
+static const size_t frame_return = 11;
+static const boost::uint64_t frame_fpu = 0;
+
+# endif
+
+void
+sched_fast_coro_make(Coro* coro, void (*callback)(void*), void* context)
+{
+  // The stack grows downward, and must be 16-byte aligned once the
+  // trampoline is entered.
+  uintptr_t top =
+    (reinterpret_cast<uintptr_t>(coro->stack) + coro->stack_size)
+    & ~uintptr_t(15);
+  uintptr_t* frame =
+    reinterpret_cast<uintptr_t*>(top) - frame_size - 2;
+  for (size_t i = 0; i < frame_size + 2; ++i)
+    frame[i] = 0;
+  frame[frame_fpu_slot] = frame_fpu;
+  frame[frame_callback] = reinterpret_cast<uintptr_t>(callback);
+  frame[frame_context] = reinterpret_cast<uintptr_t>(context);
+  frame[frame_return] =
+    reinterpret_cast<uintptr_t>(&sched_fast_coro_trampoline);
+  coro->sp = frame;
+}
+
+void*
+coroutine_current_stack_pointer(Coro*)
+{
+  return __builtin_frame_address(0);
+}
+
+#endif
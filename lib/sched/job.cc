@@ -112,6 +112,7 @@ namespace sched
       state_ = running;
       if (stats_.logging)
         stats_.last_resume = scheduler_.get_time();
+      trace_resumed_();
       try
       {
         if (has_pending_exception()
@@ -132,8 +133,9 @@ namespace sched
       }
       catch (const exception& e)
       {
-        // Rethrow the exception into the parent job if it exists.
-        if (parent_)
+        // Rethrow the exception into the parent job if it exists,
+        // unless it is joining us and collects it.
+        if (parent_ && !join_collect_(e))
         {
           parent_->async_throw(ChildException(e.clone()));
           // Warn the scheduler that the world may have changed.
@@ -212,6 +214,9 @@ namespace sched
 	job->state_set(running);
       }
     to_wake_up_.clear();
+    foreach (const rJoin& join, joins_)
+      join->terminated(*this);
+    joins_.clear();
     state_ = zombie;
     resume_scheduler_();
   }
@@ -292,11 +297,161 @@ namespace sched
     }
   }
 
+  void
+  Job::yield_until_woken_up()
+  {
+    if (non_interruptible_)
+      scheduling_error("attempt to wait in non-interruptible code");
+
+    state_ = joining;
+    resume_scheduler_();
+  }
+
+  void
+  Job::wake_up()
+  {
+    if (state_ == joining)
+      state_set(running);
+  }
+
+  void
+  Job::yield_until_ready(const libport::future::rStateBase& state)
+  {
+    if (state->ready())
+      return;
+    if (non_interruptible_)
+      scheduling_error("dependency on a thread task in non-interruptible code");
+
+    aver(!waker_);
+    waker_ = scheduler_.waker_make(*this);
+    state->onReady(boost::bind(&Waker::wake_up, waker_));
+    try
+    {
+      GD_FINFO_DEBUG("job %s: waiting for a thread", this);
+      // The state may have been made ready before the callback was
+      // registered, in which case the waker was already fired.
+      while (!state->ready())
+        yield_until_woken_up();
+    }
+    catch (...)
+    {
+      GD_FINFO_DEBUG("job %s: stopped waiting by exception", this);
+      waker_->cancel();
+      waker_ = 0;
+      throw;
+    }
+    waker_->cancel();
+    waker_ = 0;
+  }
+
   void
   Job::yield_until_terminated(const jobs_type& jobs)
   {
+    join_(jobs, false);
+  }
+
+  rJob
+  Job::yield_until_any_terminated(const jobs_type& jobs)
+  {
+    return join_(jobs, true);
+  }
+
+  rJob
+  Job::join_(const jobs_type& jobs, bool any)
+  {
+    if (non_interruptible_)
+    {
+      foreach (const rJob& job, jobs)
+        if (job.get() != this && !job->terminated())
+        {
+          scheduling_error("dependency on other task in non-interruptible code");
+          break;
+        }
+    }
+
+    // Before registering the join anywhere, lest it outlives us.
+    if (any)
+      foreach (const rJob& job, jobs)
+        if (job->terminated())
+          return job;
+
+    rJoin join = new Join(*this, any);
+    foreach (const rJob& job, jobs)
+      if (!job->terminated())
+      {
+        ++join->remaining;
+        // We allow waiting for ourselves, but without doing it for real.
+        if (job.get() != this)
+          job->joins_.push_back(join);
+      }
+    if (!join->remaining)
+      return 0;
+
+    try
+    {
+      GD_FINFO_DEBUG("job %s: joining %s jobs", this, join->remaining);
+      while (any ? !join->first : join->remaining)
+      {
+        state_ = joining;
+        resume_scheduler_();
+      }
+    }
+    catch (...)
+    {
+      GD_FINFO_DEBUG("job %s: join interrupted by exception", this);
+      join->leave(jobs);
+      throw;
+    }
+    join->leave(jobs);
+
+    if (join->exceptions.size() == 1)
+      throw ChildException(join->exceptions.front()->clone());
+    if (!join->exceptions.empty())
+      throw ChildrenException(join->exceptions);
+    return join->first;
+  }
+
+  bool
+  Job::join_collect_(const exception& e)
+  {
+    foreach (const rJoin& join, joins_)
+      if (join->waiter == parent_.get())
+      {
+        if (parent_->stats_.logging)
+          parent_->stats_.job.nb_exn++;
+        join->exceptions.push_back
+          (boost::shared_ptr<exception>(e.clone().release()));
+        return true;
+      }
+    return false;
+  }
+
+  /*------------.
+  | Job::Join.  |
+  `------------*/
+
+  void
+  Job::Join::terminated(Job& job)
+  {
+    if (!waiter)
+      return;
+    if (!first)
+      first = &job;
+    --remaining;
+    if (any || !remaining)
+    {
+      GD_FINFO_DEBUG("job %s: waking up joining job %s", &job, waiter);
+      waiter->wake_up();
+    }
+  }
+
+  void
+  Job::Join::leave(const jobs_type& jobs)
+  {
+    waiter = 0;
     foreach (const rJob& job, jobs)
-      yield_until_terminated(*job);
+      if (!job->terminated())
+        libport::erase_if(job->joins_, boost::lambda::_1 == this);
   }
 
   void
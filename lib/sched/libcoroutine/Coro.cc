@@ -9,6 +9,8 @@
  */
 #include <libport/config.h>
 
-#ifndef LIBPORT_SCHED_CORO_OSTHREAD
+#if ! defined LIBPORT_SCHED_CORO_OSTHREAD               \
+  && ! defined LIBPORT_SCHED_FAST_CORO                  \
+  && ! defined SCHED_USE_FAST_CORO
 # include "Coro.c"
 #endif
@@ -24,13 +24,17 @@ endif
 dist_lib_sched_libsched@LIBSFX@_la_SOURCES =	\
   lib/sched/configuration.cc			\
   lib/sched/coroutine-hooks.cc			\
+  lib/sched/coroutine-local-storage.cc		\
+  lib/sched/event-loop.cc			\
+  lib/sched/fast-coro.cc			\
   lib/sched/job.cc				\
   lib/sched/pthread-coro.cc			\
   lib/sched/pthread-coro.hh			\
   lib/sched/pthread-coro.hxx			\
   lib/sched/scheduler.cc			\
   lib/sched/tag.cc				\
-  lib/sched/uclibc-workaround.cc
+  lib/sched/uclibc-workaround.cc		\
+  lib/sched/wait-queue.cc
 
 lib_sched_libsched@LIBSFX@_la_CPPFLAGS +=	\
   -I$(top_srcdir)/include/sched/libcoroutine
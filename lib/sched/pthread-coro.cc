@@ -36,6 +36,7 @@ SCHED_API extern void (*coroutine_new_hook) (Coro*);
 Coro::Coro()
   : started_(false)
   , die_(false)
+  , locals_(0)
 {}
 
 Coro*
@@ -150,6 +151,12 @@ coroutine_stack_size(Coro*)
 #endif
 }
 
+void*&
+coroutine_locals(Coro* c)
+{
+  return c->locals_;
+}
+
 void
 coroutine_initialize_main(Coro* c)
 {
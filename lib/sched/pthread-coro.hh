@@ -26,6 +26,7 @@ public:
   bool started_;
   bool die_;
   pthread_t thread_;
+  void* locals_;
 };
 
 #  include <sched/pthread-coro.hxx>
@@ -17,9 +17,15 @@
 #include <libport/cassert>
 #include <libport/cstdlib>
 
+#include <libport/backtrace.hh>
 #include <libport/containers.hh>
+#include <libport/csignal>
+#include <libport/cstdio>
+#include <libport/cstring>
 #include <libport/deref.hh>
 #include <libport/foreach.hh>
+#include <libport/trace.hh>
+#include <libport/unistd.h>
 
 #include <sched/scheduler.hh>
 #include <sched/job.hh>
@@ -28,6 +34,9 @@ Coro* coroutine_main_;
 LocalCoroPtr coroutine_current_;
 void (*coroutine_new_hook) (Coro*) = 0;
 void (*coroutine_free_hook)(Coro*) = 0;
+#ifdef SCHED_USE_BOOST_CORO
+void* coroutine_main_locals_ = 0;
+#endif
 
 GD_CATEGORY(Sched);
 
@@ -43,6 +52,8 @@ namespace sched
     , ready_to_die_(false)
     , real_time_behavior_(false)
     , keep_terminated_jobs_(false)
+    , capture_backtraces_(false)
+    , mailbox_(new Mailbox)
   {
     GD_INFO_DUMP("Initializing main coroutine");
     coroutine_initialize_main(&coro_);
@@ -57,6 +68,10 @@ namespace sched
       GD_FWARN("%s pending jobs remaining", pending_.size());
     if (!jobs_.empty())
       GD_FWARN("s jobs remaining", jobs_.size());
+    // Break the cycle between the mailbox and the fired wakers.
+    libport::BlockLock lock(mailbox_->lock);
+    mailbox_->wakers.clear();
+    mailbox_->hook = 0;
   }
 
   // This function is required to start a new job using the libcoroutine.
@@ -119,12 +134,15 @@ namespace sched
   libport::utime_t
   Scheduler::execute_round()
   {
+    LIBPORT_TRACE_SCOPE("scheduler round");
     // We are using a direct coro-to-coro switch.
     // Just initialize our loop variables here, all the per-job logic is in
     // switch_to_next_.
 
     // Run all the jobs in the run queue once.
     pending_.clear();
+    if (mailbox_->pending)
+      wake_up_remote_jobs_();
     std::swap(pending_, jobs_);
 
     // Sort all the jobs according to their priority.
@@ -153,6 +171,9 @@ namespace sched
 
     job_p_ = pending_.begin();
     switch_to_next_(&coro_, true);
+    // The jobs set their context.
+    if (libport::trace_enabled())
+      libport::trace_context_set(0);
     // When we reach here, IDLE job has already been executed.
     GD_FINFO_DUMP("Back to execute_round, nj=%s, aj=%s, die=%s, returning %d",
                   new_job_, awoken_job_, ready_to_die_, deadline_);
@@ -300,7 +321,8 @@ namespace sched
     // If during this cycle a job has been marked running behind our back, rerun
     // immediately.
     // Same thing if we are ready to die, finish the job ASAP.
-    if (new_job_ || awoken_job_ || ready_to_die_)
+    // Same thing if a job was woken up from another thread.
+    if (new_job_ || awoken_job_ || ready_to_die_ || mailbox_->pending)
       signal_work_next_round();
     GD_INFO_DUMP(deadline_
                  ? libport::format("Scheduler asking to be woken up in %ss",
@@ -474,6 +496,71 @@ namespace sched
       current_job_->register_stopped_tag(tag, payload);
   }
 
+  rWaker
+  Scheduler::waker_make(Job& job)
+  {
+    return new Waker(mailbox_, job);
+  }
+
+  void
+  Scheduler::remote_wakeup_hook_set(const boost::function0<void>& hook)
+  {
+    libport::BlockLock lock(mailbox_->lock);
+    mailbox_->hook = hook;
+  }
+
+  void
+  Scheduler::wake_up_remote_jobs_()
+  {
+    std::vector<rWaker> wakers;
+    {
+      libport::BlockLock lock(mailbox_->lock);
+      std::swap(wakers, mailbox_->wakers);
+      mailbox_->pending = false;
+    }
+    foreach (const rWaker& waker, wakers)
+      if (Job* job = waker->job_)
+      {
+        GD_FINFO_DEBUG("job %s: woken up remotely", job);
+        job->wake_up();
+      }
+  }
+
+  Scheduler::Mailbox::Mailbox()
+    : pending(false)
+  {
+  }
+
+  /*--------.
+  | Waker.  |
+  `--------*/
+
+  Waker::Waker(const Scheduler::rMailbox& mailbox, Job& job)
+    : mailbox_(mailbox)
+    , job_(&job)
+  {
+  }
+
+  void
+  Waker::wake_up()
+  {
+    boost::function0<void> hook;
+    {
+      libport::BlockLock lock(mailbox_->lock);
+      mailbox_->wakers.push_back(this);
+      mailbox_->pending = true;
+      hook = mailbox_->hook;
+    }
+    if (hook)
+      hook();
+  }
+
+  void
+  Waker::cancel()
+  {
+    job_ = 0;
+  }
+
   jobs_type
   Scheduler::jobs_get() const
   {
@@ -483,6 +570,64 @@ namespace sched
     return current_job_ ? pending_ : jobs_;
   }
 
+  namespace
+  {
+    void
+    dump_backtrace(int fd, const Job& job, const libport::RawBacktrace& bt)
+    {
+      libport::signal_safe_write(fd, "job ");
+      libport::signal_safe_write(fd, &job);
+      libport::signal_safe_write(fd, ": ");
+      libport::signal_safe_write(fd, name(job.state_get()));
+      libport::signal_safe_write(fd, "\n");
+      bt.dump(fd);
+    }
+  }
+
+  void
+  Scheduler::dump_backtraces(int fd) const
+  {
+    // During a round, the jobs that have not run yet are after the
+    // current one in pending_, and the others are back in jobs_.
+    if (current_job_)
+    {
+      libport::RawBacktrace bt;
+      bt.capture();
+      dump_backtrace(fd, *current_job_, bt);
+      for (jobs_type::const_iterator i = next_job_p_; i != pending_.end(); ++i)
+        dump_backtrace(fd, **i, (*i)->backtrace_get());
+    }
+    foreach (const rJob& job, jobs_)
+      dump_backtrace(fd, *job, job->backtrace_get());
+  }
+
+# ifndef WIN32
+  namespace
+  {
+    Scheduler* dumped_scheduler = 0;
+
+    void
+    dump_backtraces_handler(int)
+    {
+      if (dumped_scheduler)
+        dumped_scheduler->dump_backtraces(STDERR_FILENO);
+    }
+  }
+
+  void
+  Scheduler::dump_backtraces_on(int sig)
+  {
+    dumped_scheduler = this;
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_handler = dump_backtraces_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(sig, &action, 0))
+      perror("sigaction");
+  }
+# endif
+
   const scheduler_stats_type&
   Scheduler::stats_get() const
   {
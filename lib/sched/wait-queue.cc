@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+/**
+ ** \file sched/wait-queue.cc
+ ** \brief Implementation of sched::WaitQueue.
+ */
+
+#include <libport/bind.hh>
+#include <libport/containers.hh>
+#include <libport/debug.hh>
+#include <libport/foreach.hh>
+
+#include <sched/job.hh>
+#include <sched/wait-queue.hh>
+
+GD_CATEGORY(Sched);
+
+namespace sched
+{
+  static bool
+  job_compare(const Job* j1, const rJob& j2)
+  {
+    return j1 == j2.get();
+  }
+
+  void
+  WaitQueue::wait(Job& job)
+  {
+    waiters_.push_back(&job);
+    try
+    {
+      GD_FINFO_DEBUG("job %s: waiting on %s", &job, this);
+      job.yield_until_woken_up();
+    }
+    catch (...)
+    {
+      GD_FINFO_DEBUG("job %s: dequeued from %s by exception", &job, this);
+      libport::erase_if(waiters_, boost::bind(job_compare, &job, _1));
+      throw;
+    }
+    // We may have been woken up by someone else: leave the queue, lest
+    // a later notification is spent on us.
+    libport::erase_if(waiters_, boost::bind(job_compare, &job, _1));
+  }
+
+  bool
+  WaitQueue::notify_one()
+  {
+    while (!waiters_.empty())
+    {
+      rJob job = waiters_.front();
+      waiters_.pop_front();
+      if (!job->terminated())
+      {
+        job->wake_up();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t
+  WaitQueue::notify_all()
+  {
+    jobs_type waiters;
+    std::swap(waiters, waiters_);
+    size_t res = 0;
+    foreach (const rJob& job, waiters)
+      if (!job->terminated())
+      {
+        job->wake_up();
+        ++res;
+      }
+    return res;
+  }
+}
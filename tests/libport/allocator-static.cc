@@ -9,6 +9,9 @@
  */
 
 #include <libport/allocator-static.hh>
+#include <libport/bind.hh>
+#include <libport/foreach.hh>
+#include <libport/thread.hh>
 #include <libport/unit-test.hh>
 
 using libport::test_suite;
@@ -100,10 +103,78 @@ static void test()
   delete h;
 }
 
+class SafeInt: public libport::ThreadSafeStaticallyAllocated<SafeInt, 4, 8>
+{
+public:
+  SafeInt(int i = 0)
+    : i_(i)
+  {}
+
+  operator int () const
+  {
+    return i_;
+  }
+
+  static const size_t allocator_static_max_size;
+
+private:
+  int i_;
+};
+
+const size_t SafeInt::allocator_static_max_size = sizeof(SafeInt);
+
+typedef std::vector<SafeInt*> safe_ints_type;
+
+static safe_ints_type
+make_safe_ints(int n)
+{
+  safe_ints_type res;
+  for (int i = 0; i < n; ++i)
+    res.push_back(new SafeInt(i));
+  return res;
+}
+
+// Objects allocated in a thread are released by another one.
+static void test_thread_safe()
+{
+  static const int n = 100;
+  libport::ThreadedCall<safe_ints_type>
+    alloc(boost::bind(&make_safe_ints, n));
+  alloc.wait();
+  safe_ints_type ints = alloc.get();
+  BOOST_CHECK_EQUAL(ints.size(), size_t(n));
+
+  // The slots released by the dead thread are reused here.
+  SafeInt* extra = new SafeInt(n);
+  for (int i = 0; i < n; ++i)
+  {
+    BOOST_CHECK_EQUAL(*ints[i], i);
+    BOOST_CHECK(ints[i] != extra);
+  }
+  BOOST_CHECK_EQUAL(*extra, n);
+
+  // Nothing can be trimmed while objects are alive.
+  SafeInt::flush();
+  BOOST_CHECK_EQUAL(SafeInt::trim(), 0U);
+
+  foreach (SafeInt* i, ints)
+    delete i;
+  delete extra;
+  SafeInt::flush();
+  BOOST_CHECK_GT(SafeInt::trim(), 0U);
+  BOOST_CHECK_EQUAL(SafeInt::trim(), 0U);
+
+  // The allocator still works after being trimmed.
+  SafeInt* a = new SafeInt(42);
+  BOOST_CHECK_EQUAL(*a, 42);
+  delete a;
+}
+
 test_suite*
 init_test_suite()
 {
   test_suite* suite = BOOST_TEST_SUITE("libport::StaticallyAllocated test suite");
   suite->add(BOOST_TEST_CASE(test));
+  suite->add(BOOST_TEST_CASE(test_thread_safe));
   return suite;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -33,10 +33,19 @@ using libport::test_suite;
 
 #include <libport/asio.hh>
 #include <libport/lexical-cast.hh>
+#include <libport/semaphore.hh>
 #include <libport/thread.hh>
 #include <libport/utime.hh>
 #include <libport/unistd.h>
 
+#if defined __linux__
+# include <fcntl.h>
+# include <sys/eventfd.h>
+# include <sys/mman.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
 using boost::system::error_code;
 
 bool abort_ctor = false;
@@ -436,6 +445,290 @@ void test_pipe()
 }
 
 
+#if defined __linux__
+void test_shm_pipe()
+{
+  // test_pipe leaks its sockets.
+  size_t instances = TestSocket::nInstance;
+  TestSocket* s1 = new TestSocket(false, true);
+  TestSocket* s2 = new TestSocket(false, true);
+  s1->destroyOnError = false;
+  s2->destroyOnError = false;
+  libport::makeShmPipe(std::make_pair(s1, s2));
+
+  // Both ways.
+  s1->send("canard");
+  s2->send("coin");
+  usleep(delay);
+  BOOST_CHECK_EQUAL(s2->received, "canard");
+  BOOST_CHECK_EQUAL(s1->received, "coin");
+
+  // More than the rings hold.
+  std::string big;
+  for (int i = 0; big.size() < 3 << 20; ++i)
+    big += string_cast(i);
+  s2->received.clear();
+  s1->send(big);
+  usleep(delay * 2);
+  BOOST_CHECK_EQUAL(s2->received.size(), big.size());
+  BOOST_CHECK(s2->received == big);
+  BOOST_CHECK_EQUAL(s1->bytesSent(), big.size() + 6);
+  BOOST_CHECK_EQUAL(s2->bytesReceived(), big.size() + 6);
+
+  // Closing one end is reported to the other.
+  s1->close();
+  usleep(delay);
+  BOOST_CHECK(s1->lastError);
+  BOOST_CHECK(s2->lastError);
+  BOOST_CHECK(!s2->isConnected());
+  s1->destroy();
+  s2->destroy();
+  usleep(delay);
+  BOOST_CHECK_EQUAL(TestSocket::nInstance, instances);
+}
+
+static std::string
+shm_path()
+{
+  std::string res = libport::format("/tmp/libport-asio-%s", getpid());
+  unlink(res.c_str());
+  return res;
+}
+
+void test_shm_listen()
+{
+  size_t instances = TestSocket::nInstance;
+  std::string path = shm_path();
+  libport::Socket* h = new libport::Socket();
+  error_code err =
+    h->listenShm(boost::bind(&TestSocket::factoryEx, true, true), path);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  BOOST_CHECK_EQUAL(h->getLocalHost(), path);
+
+  TestSocket* client = new TestSocket(false, true);
+  err = client->connectShm(path);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  BOOST_CHECK_NO_THROW(client->send(msg));
+  usleep(delay);
+  BOOST_CHECK_EQUAL(TestSocket::nInstance, instances + 2);
+  BOOST_CHECK_EQUAL(client->received, msg);
+  BOOST_CHECK_EQUAL(TestSocket::lastInstance->received, msg);
+
+  // Synchronous operations.
+  TestSocket* sync = new TestSocket(false, false);
+  sync->setAutoRead(false);
+  err = sync->connectShm(path);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  sync->syncWrite("coin", 4);
+  BOOST_CHECK_EQUAL(sync->syncRead(4), "coin");
+  BOOST_CHECK_EQUAL(sync->nRead, 0u);
+  sync->close();
+
+  // Close client-end. Should send error both ways and destroy all sockets.
+  BOOST_CHECK_NO_THROW(client->close());
+  usleep(delay);
+  BOOST_CHECK_EQUAL(TestSocket::nInstance, instances);
+
+  h->destroy();
+  usleep(delay);
+  client = new TestSocket();
+  BOOST_CHECK(client->connectShm(path));
+  client->destroy();
+  usleep(delay);
+  BOOST_CHECK_EQUAL(TestSocket::nInstance, instances);
+  unlink(path.c_str());
+}
+
+/// The connection of the hostile server.
+static int hostile_connection = -1;
+
+/// Accept a shared memory connection on \a listener, and give \a fds
+/// to the client, as listenShm does.
+static void
+hostile_accept(int listener, const int* fds)
+{
+  hostile_connection = accept(listener, 0, 0);
+  char byte = 0;
+  iovec iov = { &byte, 1 };
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+  sendmsg(hostile_connection, &msg, MSG_NOSIGNAL);
+}
+
+// The server breaks the rings: the client must not trust them.
+void test_shm_corrupt()
+{
+  std::string path = shm_path();
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof addr.sun_path - 1);
+  BOOST_REQUIRE(!bind(listener, (sockaddr*) &addr, sizeof addr));
+  BOOST_REQUIRE(!listen(listener, 1));
+
+  // The layout of the memory: the rings from the server to the
+  // client and back, two cache lines each, then their data.
+  static const size_t ring = 2 * 64;
+  static const size_t capacity = 1 << 20;
+  static const size_t size = 2 * ring + 2 * capacity;
+  std::string name = libport::format("/libport-asio-%s", getpid());
+  int memory = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  BOOST_REQUIRE(memory != -1);
+  shm_unlink(name.c_str());
+  BOOST_REQUIRE(!ftruncate(memory, size));
+  char* m = (char*) mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         memory, 0);
+  BOOST_REQUIRE(m != MAP_FAILED);
+  int wake = eventfd(0, EFD_NONBLOCK);
+  int peer_wake = eventfd(0, EFD_NONBLOCK);
+  int fds[3] = { memory, peer_wake, wake };
+  pthread_t server =
+    libport::startThread(boost::bind(&hostile_accept, listener, fds));
+
+  TestSocket* client = new TestSocket(false, true);
+  client->destroyOnError = false;
+  error_code err = client->connectShm(path);
+  pthread_join(server, 0);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+
+  // The server pretends to have read 2MB more than the client wrote,
+  // which leaves the client more room than the ring has.
+  volatile long* read = (volatile long*) (m + ring);
+  *read = 2 * capacity;
+  std::string big(3 * capacity, 'x');
+  client->send(big);
+  usleep(delay);
+  BOOST_CHECK_EQUAL(client->lastError,
+                    boost::system::errc::make_error_code(
+                      boost::system::errc::protocol_error));
+  BOOST_CHECK(!client->isConnected());
+
+  client->destroy();
+  usleep(delay);
+  munmap(m, size);
+  close(memory);
+  close(wake);
+  close(peer_wake);
+  close(hostile_connection);
+  close(listener);
+  unlink(path.c_str());
+}
+
+/*------------.
+| Benchmark.  |
+`------------*/
+
+/// Counts the bytes it receives, and echoes them back in ping-pong
+/// mode, until \a expected are received.
+class BenchSocket: public libport::Socket
+{
+public:
+  BenchSocket(size_t expected, bool ping)
+    : expected(expected), got(0), ping(ping)
+  {}
+
+  size_t onRead(const void* data, size_t size)
+  {
+    got += size;
+    if (ping && got < expected)
+      write(data, size);
+    if (got == expected)
+      done++;
+    return size;
+  }
+
+  size_t expected;
+  size_t got;
+  bool ping;
+  libport::Semaphore done;
+};
+
+/// Time a ping-pong of \a rounds bytes, and the echo of \a size
+/// bytes, through connections made by \a connect.
+static void
+bench(const char* name,
+      boost::function1<error_code, libport::Socket*> connect)
+{
+  static const size_t rounds = 10000;
+  static const size_t size = 32 << 20;
+  static const size_t chunk = 64 << 10;
+
+  BenchSocket* pinger = new BenchSocket(rounds, true);
+  error_code err = connect(pinger);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  libport::utime_t start = libport::utime();
+  pinger->write("x", 1);
+  pinger->done--;
+  libport::utime_t ping = libport::utime() - start;
+  BOOST_CHECK_EQUAL(pinger->got, rounds);
+  pinger->destroy();
+
+  std::vector<char> data(chunk, 'x');
+  BenchSocket* sender = new BenchSocket(size, false);
+  err = connect(sender);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  start = libport::utime();
+  for (size_t i = 0; i < size; i += chunk)
+    sender->write(&data[0], chunk);
+  sender->done--;
+  libport::utime_t bulk = libport::utime() - start;
+  BOOST_CHECK_EQUAL(sender->got, size);
+  sender->destroy();
+
+  BOOST_TEST_MESSAGE("  " << name << ": "
+                     << "round trip " << ping * 1000 / rounds << "ns, "
+                     << "echo " << (size >> 20) * 1000000 / bulk << "MB/s");
+}
+
+static error_code
+connect_tcp(libport::Socket* s)
+{
+  return s->connect(connect_host, string_cast(AVAIL_PORT + 1), false);
+}
+
+static error_code
+connect_shm(const std::string& path, libport::Socket* s)
+{
+  return s->connectShm(path);
+}
+
+void test_shm_bench()
+{
+  size_t instances = TestSocket::nInstance;
+  libport::Socket* tcp = new libport::Socket();
+  error_code err =
+    tcp->listen(boost::bind(&TestSocket::factoryEx, true, false),
+                listen_host, string_cast(AVAIL_PORT + 1), false);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+  std::string path = shm_path();
+  libport::Socket* shm = new libport::Socket();
+  err = shm->listenShm(boost::bind(&TestSocket::factoryEx, true, false),
+                       path);
+  BOOST_REQUIRE_MESSAGE(!err, err.message());
+
+  bench("loopback TCP", &connect_tcp);
+  bench("shared memory", boost::bind(&connect_shm, path, _1));
+
+  tcp->destroy();
+  shm->destroy();
+  usleep(delay);
+  BOOST_CHECK_EQUAL(TestSocket::nInstance, instances);
+  unlink(path.c_str());
+}
+#endif
+
+
 test_suite*
 init_test_suite()
 {
@@ -447,5 +740,11 @@ init_test_suite()
   suite->add(BOOST_TEST_CASE(test));
   suite->add(BOOST_TEST_CASE(test_udp));
   suite->add(BOOST_TEST_CASE(test_pipe));
+#if defined __linux__
+  suite->add(BOOST_TEST_CASE(test_shm_pipe));
+  suite->add(BOOST_TEST_CASE(test_shm_listen));
+  suite->add(BOOST_TEST_CASE(test_shm_corrupt));
+  suite->add(BOOST_TEST_CASE(test_shm_bench));
+#endif
   return suite;
 }
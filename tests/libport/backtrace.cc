@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -16,6 +16,8 @@
 #include <libport/foreach.hh>
 #include "test.hh"
 #include <libport/compiler.hh>
+#include <libport/unistd.h>
+#include <libport/utime.hh>
 
 #include <iostream>
 
@@ -69,11 +71,127 @@ namespace object
   }
 }
 
+namespace raw
+{
+  ATTRIBUTE_NOINLINE
+  void
+  inner(RawBacktrace& bt)
+  {
+    bt.capture();
+  }
+
+  ATTRIBUTE_NOINLINE
+  void
+  outer(RawBacktrace& bt)
+  {
+    inner(bt);
+  }
+
+  void
+  check()
+  {
+    // Captured twice from the same place: keep the loop.
+    RawBacktrace bts[2];
+    BOOST_CHECK(bts[0].empty());
+    volatile size_t n = 2;
+    for (size_t i = 0; i < n; ++i)
+      outer(bts[i]);
+    RawBacktrace& bt = bts[0];
+    RawBacktrace& same = bts[1];
+    BOOST_CHECK(!bt.empty());
+    BOOST_CHECK_LE(bt.size(), size_t(RawBacktrace::capacity));
+
+    backtrace_cache_clear();
+    backtrace_type symbols = bt.symbolize();
+    BOOST_CHECK_EQUAL(symbols.size(), bt.size());
+    std::cout << bt << std::endl;
+    size_t cached = backtrace_cache_size();
+    BOOST_CHECK_LE(cached, bt.size());
+
+    // Symbolizing the same frames only uses the cache.
+    BOOST_CHECK_EQUAL(same.size(), bt.size());
+    for (size_t i = 0; i < bt.size() && i < same.size(); ++i)
+      BOOST_CHECK_EQUAL(same[i], bt[i]);
+    BOOST_CHECK(same.symbolize() == symbols);
+    BOOST_CHECK_EQUAL(backtrace_cache_size(), cached);
+
+    bt.clear();
+    BOOST_CHECK(bt.empty());
+    BOOST_CHECK(bt.symbolize().empty());
+  }
+
+# ifndef WIN32
+  void
+  check_dump()
+  {
+    RawBacktrace bt;
+    outer(bt);
+    int fds[2];
+    BOOST_REQUIRE(!pipe(fds));
+    bt.dump(fds[1]);
+    close(fds[1]);
+    std::string out;
+    char buf[1024];
+    for (ssize_t n; 0 < (n = read(fds[0], buf, sizeof buf)); )
+      out.append(buf, n);
+    close(fds[0]);
+
+    std::string expected;
+    for (size_t i = 0; i < bt.size(); ++i)
+    {
+      std::ostringstream o;
+      o << "  0x" << std::hex << reinterpret_cast<size_t>(bt[i]) << "\n";
+      expected += o.str();
+    }
+    BOOST_CHECK_EQUAL(out, expected);
+  }
+# endif
+
+  /*------------.
+  | Benchmark.  |
+  `------------*/
+
+  void
+  bench()
+  {
+    static const size_t n = 2000;
+
+    libport::utime_t start = libport::utime();
+    for (size_t i = 0; i < n; ++i)
+      backtrace();
+    libport::utime_t eager = libport::utime() - start;
+
+    RawBacktrace bt;
+    start = libport::utime();
+    for (size_t i = 0; i < n; ++i)
+      outer(bt);
+    libport::utime_t capture = libport::utime() - start;
+
+    start = libport::utime();
+    for (size_t i = 0; i < n; ++i)
+    {
+      outer(bt);
+      bt.symbolize();
+    }
+    libport::utime_t cached = libport::utime() - start;
+
+    BOOST_CHECK(!bt.empty());
+    BOOST_TEST_MESSAGE(n << " traces: backtrace() " << eager << "us, "
+                       << "RawBacktrace::capture " << capture << "us, "
+                       << "capture and symbolize " << cached << "us");
+  }
+}
+
 test_suite*
 init_test_suite()
 {
   test_suite* suite = BOOST_TEST_SUITE("libport::backtrace");
   suite->add(BOOST_TEST_CASE(freefunction::check));
   suite->add(BOOST_TEST_CASE(object::check));
+  suite->add(BOOST_TEST_CASE(raw::check));
+# ifndef WIN32
+  suite->add(BOOST_TEST_CASE(raw::check_dump));
+# endif
+  suite->add(BOOST_TEST_CASE(raw::bench));
   return suite;
 }
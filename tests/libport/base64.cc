@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,8 +8,14 @@
  * See the LICENSE file for more information.
  */
 
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
 #include <libport/base64.hh>
+#include <libport/foreach.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 
 using libport::test_suite;
 
@@ -27,10 +33,160 @@ static void test()
                     "AP/+/fz7+vn4AA==");
 }
 
+static void test_decode()
+{
+  BOOST_CHECK_EQUAL(libport::base64_decode("Z29zdGFpOmdvc3RhaQ=="),
+                    "gostai:gostai");
+  BOOST_CHECK_EQUAL(libport::base64_decode("Z29zdGFpOmdvc3Rh"),
+                    "gostai:gosta");
+  BOOST_CHECK_EQUAL(libport::base64_decode("Z29zdGFpOmdvc3Q="),
+                    "gostai:gost");
+  // Without padding.
+  BOOST_CHECK_EQUAL(libport::base64_decode("Z29zdGFpOmdvc3RhaQ"),
+                    "gostai:gostai");
+  BOOST_CHECK_EQUAL(libport::base64_decode(""), "");
+
+  BOOST_CHECK_THROW(libport::base64_decode("Z29zd GFp"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::base64_decode("Z29zd"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::base64_decode("Z2=zdGFp"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::base64_decode("Z29zdG==Z29z"),
+                    std::runtime_error);
+  // An error far in the input, past the SIMD blocks.
+  std::string long_input(100, 'A');
+  long_input[70] = '\xc3';
+  BOOST_CHECK_THROW(libport::base64_decode(long_input), std::runtime_error);
+}
+
+/// The original, character per character, implementation.
+static std::string
+reference(const std::string& input)
+{
+  const char encoding[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string res;
+  size_t size = input.size();
+  for (unsigned i = 0; i < size; i += 3)
+  {
+    bool b2 = size > (i + 1);
+    bool b3 = size > (i + 2);
+    unsigned char chunk[3];
+    chunk[0] =      input[i    ]      ;
+    chunk[1] = b2 ? input[i + 1] : 0x0;
+    chunk[2] = b3 ? input[i + 2] : 0x0;
+    res += encoding[chunk[0] >> 2];
+    res += encoding[((chunk[0] & 0x03) << 4) | ((chunk[1] & 0xf0) >> 4)];
+    res += b2 ? encoding[((chunk[1] & 0x0f) << 2) | ((chunk[2] & 0xc0) >> 6)] : '=';
+    res += b3 ? encoding[(chunk[2] & 0x3f)] : '=';
+  }
+  return res;
+}
+
+static std::string
+random_string(size_t size)
+{
+  std::string res(size, 0);
+  for (size_t i = 0; i < size; ++i)
+    res[i] = rand();
+  return res;
+}
+
+static const libport::Base64Kernel kernels[] =
+{
+  libport::BASE64_SCALAR,
+  libport::BASE64_SSSE3,
+  libport::BASE64_AVX2,
+};
+
+static void test_kernels()
+{
+  libport::Base64Kernel best = libport::base64_kernel();
+  srand(3);
+  foreach (libport::Base64Kernel k, kernels)
+  {
+    libport::base64_kernel_set(k);
+    BOOST_TEST_MESSAGE("kernel " << libport::base64_kernel());
+    for (size_t size = 0; size < 200; ++size)
+    {
+      std::string in = random_string(size);
+      std::string out = libport::base64(in);
+      BOOST_CHECK_EQUAL(out, reference(in));
+      BOOST_CHECK_EQUAL(libport::base64_decode(out), in);
+    }
+  }
+  libport::base64_kernel_set(best);
+  BOOST_CHECK_EQUAL(libport::base64_kernel(), best);
+}
+
+static void test_stream()
+{
+  srand(7);
+  std::string in = random_string(10000);
+  std::string expected = reference(in);
+
+  libport::Base64Encoder encoder;
+  std::vector<char> buffer(expected.size() + 4);
+  size_t size = 0;
+  for (size_t i = 0; i < in.size(); )
+  {
+    size_t n = std::min(size_t(rand() % 100), in.size() - i);
+    BOOST_REQUIRE_LE(size + encoder.update_size(n), buffer.size());
+    size += encoder.update(in.data() + i, n, &buffer[size]);
+    i += n;
+  }
+  size += encoder.finish(&buffer[size]);
+  BOOST_CHECK_EQUAL(std::string(&buffer[0], size), expected);
+
+  libport::Base64Decoder decoder;
+  buffer.resize(in.size() + 2);
+  size = 0;
+  for (size_t i = 0; i < expected.size(); )
+  {
+    size_t n = std::min(size_t(rand() % 100), expected.size() - i);
+    BOOST_REQUIRE_LE(size + decoder.update_size(n), buffer.size());
+    size += decoder.update(expected.data() + i, n, &buffer[size]);
+    i += n;
+  }
+  size += decoder.finish(&buffer[size]);
+  BOOST_CHECK_EQUAL(std::string(&buffer[0], size), in);
+}
+
+static void test_bench()
+{
+  std::string in = random_string(16 * 1024 * 1024);
+  libport::Base64Kernel best = libport::base64_kernel();
+
+  libport::utime_t start = libport::utime();
+  std::string out = reference(in);
+  libport::utime_t ref = libport::utime() - start;
+  BOOST_TEST_MESSAGE("reference encoding: " << in.size() / ref << "MB/s");
+
+  foreach (libport::Base64Kernel k, kernels)
+  {
+    libport::base64_kernel_set(k);
+    if (libport::base64_kernel() != k)
+      continue;
+    start = libport::utime();
+    bool same = libport::base64(in) == out;
+    libport::utime_t encode = libport::utime() - start;
+    start = libport::utime();
+    same = same && libport::base64_decode(out) == in;
+    libport::utime_t decode = libport::utime() - start;
+    BOOST_CHECK(same);
+    BOOST_TEST_MESSAGE("kernel " << k << ": "
+                       << "encoding " << in.size() / encode << "MB/s, "
+                       << "decoding " << in.size() / decode << "MB/s");
+  }
+  libport::base64_kernel_set(best);
+}
+
 test_suite*
 init_test_suite()
 {
   test_suite* suite = BOOST_TEST_SUITE("libport::base64 test suite");
   suite->add(BOOST_TEST_CASE(test));
+  suite->add(BOOST_TEST_CASE(test_decode));
+  suite->add(BOOST_TEST_CASE(test_kernels));
+  suite->add(BOOST_TEST_CASE(test_stream));
+  suite->add(BOOST_TEST_CASE(test_bench));
   return suite;
 }
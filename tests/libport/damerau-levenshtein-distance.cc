@@ -8,9 +8,15 @@
  * See the LICENSE file for more information.
  */
 
-#include <libport/damerau-levenshtein-distance.hh>
+#include <cstdlib>
+
+#include <boost/multi_array.hpp>
 
+#include <libport/damerau-levenshtein-distance.hh>
+#include <libport/symbol.hh>
+#include <libport/thread-pool.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 
 using libport::test_suite;
 
@@ -76,6 +82,149 @@ void check_transposition()
   CHECK("1234567890", "1324576809", 3u);
 }
 
+/// The plain dynamic programming version.
+static size_t
+reference(const std::string& s1, const std::string& s2)
+{
+  size_t ss1 = s1.size();
+  size_t ss2 = s2.size();
+  boost::multi_array<size_t, 2> d(boost::extents[ss1+1][ss2+1]);
+  for (size_t i = 0; i <= ss1; ++i)
+    d[i][0] = i;
+  for (size_t j = 1; j <= ss2; ++j)
+    d[0][j] = j;
+  for (size_t i = 1; i <= ss1; ++i)
+    for (size_t j = 1; j <= ss2; ++j)
+    {
+      size_t cost = s1[i-1] == s2[j-1] ? 0 : 1;
+      d[i][j] = std::min(std::min(d[i-1][j] + 1, d[i][j-1] + 1),
+                         d[i-1][j-1] + cost);
+      if (i > 1 && j > 1 && s1[i-1] == s2[j-2] && s1[i-2] == s2[j-1])
+        d[i][j] = std::min(d[i][j], d[i-2][j-2] + cost);
+    }
+  return d[ss1][ss2];
+}
+
+/// A random string over a small alphabet, to have many matches.
+static std::string
+random_string(size_t max)
+{
+  std::string res(rand() % (max + 1), 'a');
+  for (size_t i = 0; i < res.size(); ++i)
+    res[i] += rand() % 4;
+  return res;
+}
+
+void check_random()
+{
+  srand(42);
+  // Below, around, and well above a word of 64 characters.
+  size_t sizes[] = { 10, 70, 200 };
+  foreach (size_t max, sizes)
+    for (int i = 0; i < 300; ++i)
+    {
+      std::string s1 = random_string(max);
+      std::string s2 = random_string(max);
+      size_t d = reference(s1, s2);
+      BOOST_CHECK_EQUAL(libport::damerau_levenshtein_distance(s1, s2), d);
+      BOOST_CHECK_EQUAL(libport::DamerauLevenshteinMatcher(s1).distance(s2),
+                        d);
+      // Cut off.
+      for (size_t m = d - std::min(d, size_t(2)); m < d + 2; ++m)
+        BOOST_CHECK_EQUAL(libport::damerau_levenshtein_distance(s1, s2, m),
+                          std::min(d, m + 1));
+    }
+}
+
+static const char* words[] =
+{
+  "print", "printf", "sprint", "paint", "point", "prune", "pint", "rpint",
+  "echo", "each", "every", "evert",
+};
+
+void check_closest()
+{
+  std::vector<std::string> candidates(words, words + sizeof words / sizeof *words);
+  std::vector<std::string> res =
+    libport::closest(std::string("prnit"), candidates, 3);
+  BOOST_REQUIRE_EQUAL(res.size(), 3u);
+  // print (transposition), then the first ones at distance 2.
+  BOOST_CHECK_EQUAL(res[0], "print");
+  BOOST_CHECK_EQUAL(res[1], "printf");
+  BOOST_CHECK_EQUAL(res[2], "sprint");
+
+  // Cut off.
+  BOOST_CHECK_EQUAL(libport::closest(std::string("prnit"), candidates,
+                                     10, 1).size(), 1u);
+  BOOST_CHECK(libport::closest(std::string("xyzzy"), candidates,
+                               10, 2).empty());
+
+  std::vector<libport::Symbol> symbols;
+  foreach (const std::string& s, candidates)
+    symbols.push_back(libport::Symbol(s));
+  std::vector<libport::Symbol> sres =
+    libport::closest(std::string("evry"), symbols, 1);
+  BOOST_REQUIRE_EQUAL(sres.size(), 1u);
+  BOOST_CHECK_EQUAL(sres[0], libport::Symbol("every"));
+}
+
+/// Many identifiers, with one to find.
+static std::vector<std::string>
+identifiers(size_t n)
+{
+  srand(51);
+  std::vector<std::string> res;
+  for (size_t i = 0; i < n; ++i)
+  {
+    std::string s(5 + rand() % 15, 'a');
+    for (size_t j = 0; j < s.size(); ++j)
+      s[j] += rand() % 26;
+    res.push_back(s);
+  }
+  res[n / 2] = "socket_connect_timeout";
+  return res;
+}
+
+void check_bench()
+{
+  std::vector<std::string> candidates = identifiers(20000);
+  std::string query = "sockte_connect_timeuot";
+
+  libport::utime_t start = libport::utime();
+  size_t best = query.size();
+  foreach (const std::string& c, candidates)
+    best = std::min(best, reference(query, c));
+  libport::utime_t dp = libport::utime() - start;
+  BOOST_CHECK_EQUAL(best, 2u);
+
+  start = libport::utime();
+  best = query.size();
+  foreach (const std::string& c, candidates)
+    best = std::min(best, libport::damerau_levenshtein_distance(query, c));
+  libport::utime_t bits = libport::utime() - start;
+  BOOST_CHECK_EQUAL(best, 2u);
+
+  start = libport::utime();
+  std::vector<std::string> res = libport::closest(query, candidates, 1);
+  libport::utime_t closest = libport::utime() - start;
+  BOOST_REQUIRE_EQUAL(res.size(), 1u);
+  BOOST_CHECK_EQUAL(res[0], "socket_connect_timeout");
+
+  // The pool threads outlive the test.
+  libport::ThreadPool& pool = *new libport::ThreadPool(4);
+  start = libport::utime();
+  res = libport::closest(query, candidates, 1, size_t(-1), &pool);
+  libport::utime_t parallel = libport::utime() - start;
+  BOOST_REQUIRE_EQUAL(res.size(), 1u);
+  BOOST_CHECK_EQUAL(res[0], "socket_connect_timeout");
+
+  BOOST_TEST_MESSAGE(candidates.size() << " candidates: "
+                     << "matrix " << dp << "us, "
+                     << "bit-vectors " << bits << "us, "
+                     << "closest " << closest << "us, "
+                     << "closest in parallel " << parallel << "us");
+}
+
 test_suite*
 init_test_suite()
 {
@@ -86,5 +235,8 @@ init_test_suite()
   suite->add(BOOST_TEST_CASE(check_insertion));
   suite->add(BOOST_TEST_CASE(check_substitution));
   suite->add(BOOST_TEST_CASE(check_transposition));
+  suite->add(BOOST_TEST_CASE(check_random));
+  suite->add(BOOST_TEST_CASE(check_closest));
+  suite->add(BOOST_TEST_CASE(check_bench));
   return suite;
 }
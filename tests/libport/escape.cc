@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2007-2011, Gostai S.A.S.
+ * Copyright (C) 2007-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -12,10 +12,15 @@
  ** Test code for libport/escape.hh.
  */
 
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
 #include <sstream>
+#include <stdexcept>
 #include <libport/escape.hh>
 #include <libport/unit-test.hh>
 #include <libport/lexical-cast.hh>
+#include <libport/utime.hh>
 
 using libport::escape;
 using libport::test_suite;
@@ -60,11 +65,110 @@ check_lexical_cast()
 # undef CHECK
 }
 
+/// The character by character escape.
+static std::string
+escape_reference(const std::string& s, char delimiter)
+{
+  std::ostringstream o;
+  o << std::hex << std::setfill('0');
+  for (std::string::const_iterator p = s.begin(); p != s.end(); ++p)
+    switch (*p)
+    {
+      case '\b': o << "\\b"; break;
+      case '\f': o << "\\f"; break;
+      case '\n': o << "\\n"; break;
+      case '\r': o << "\\r"; break;
+      case '\t': o << "\\t"; break;
+      case '\v': o << "\\v"; break;
+      case '\\': o << "\\\\"; break;
+      default:
+        if (*p == delimiter)
+          o << '\\' << *p;
+        else if (std::isprint((unsigned char) *p))
+          o << *p;
+        else
+          o << "\\x" << std::setw(2) << (int) (unsigned char) *p;
+    }
+  return o.str();
+}
+
+/// A string of \a size characters, one in \a special being random.
+static std::string
+random_string(size_t size, int special)
+{
+  std::string res;
+  for (size_t i = 0; i < size; ++i)
+    res += rand() % special ? char('a' + rand() % 26) : char(rand());
+  return res;
+}
+
+void
+check_span()
+{
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::string s = random_string(rand() % 100, 1 + i % 10);
+    char delimiter = i % 2 ? '"' : '\'';
+    std::ostringstream o;
+    o << escape(s, delimiter);
+    BOOST_CHECK_EQUAL(o.str(), escape_reference(s, delimiter));
+    BOOST_CHECK_EQUAL(libport::unescape(o.str()), s);
+  }
+
+  BOOST_CHECK_EQUAL(libport::unescape("a\\x4A\\x4a\\'\\\"\\\\b"),
+                    "aJJ'\"\\b");
+  BOOST_CHECK_EQUAL(libport::unescape(""), "");
+  BOOST_CHECK_THROW(libport::unescape("a\\"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::unescape("a\\x4"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::unescape("a\\x4g"), std::runtime_error);
+  BOOST_CHECK_THROW(libport::unescape("a\\q"), std::runtime_error);
+}
+
+void
+bench()
+{
+  // Mostly printable text, as in logs.
+  static const size_t size = 16 * 1024 * 1024;
+  std::string s = random_string(size, 64);
+
+  libport::utime_t start = libport::utime();
+  std::string reference = escape_reference(s, '"');
+  libport::utime_t old = libport::utime() - start;
+
+  start = libport::utime();
+  std::ostringstream o;
+  o << escape(s);
+  libport::utime_t stream = libport::utime() - start;
+
+  std::string out(4 * size, 0);
+  start = libport::utime();
+  char* end = libport::escape(s.data(), s.data() + size, &out[0], '"');
+  libport::utime_t span = libport::utime() - start;
+  out.resize(end - &out[0]);
+  BOOST_CHECK(o.str() == reference);
+  BOOST_CHECK(out == reference);
+
+  std::string back(out.size(), 0);
+  start = libport::utime();
+  end = libport::unescape(out.data(), out.data() + out.size(), &back[0]);
+  libport::utime_t unescape = libport::utime() - start;
+  back.resize(end - &back[0]);
+  BOOST_CHECK(back == s);
+
+  BOOST_TEST_MESSAGE("escape: character by character "
+                     << size / old << "MB/s, "
+                     << "Escape " << size / stream << "MB/s, "
+                     << "span " << size / span << "MB/s");
+  BOOST_TEST_MESSAGE("unescape: " << out.size() / unescape << "MB/s");
+}
+
 test_suite*
 init_test_suite()
 {
   test_suite* suite = BOOST_TEST_SUITE("libport::escape");
   suite->add(BOOST_TEST_CASE(check));
   suite->add(BOOST_TEST_CASE(check_lexical_cast));
+  suite->add(BOOST_TEST_CASE(check_span));
+  suite->add(BOOST_TEST_CASE(bench));
   return suite;
 }
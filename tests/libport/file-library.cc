@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,14 +8,19 @@
  * See the LICENSE file for more information.
  */
 
+#include <fstream>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/filesystem.hpp>
 #include <libport/bind.hh>
 using namespace boost::assign;
 
 #include <libport/file-library.hh>
+#include <libport/format.hh>
 #include <libport/lexical-cast.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 using boost::bind;
 using libport::file_library;
 using libport::test_suite;
@@ -40,6 +45,111 @@ void ctor(const Library& lib, const char* sep,
   BOOST_CHECK_EQUAL(string_cast(l), expected);
 }
 
+namespace fs = boost::filesystem;
+
+/*--------.
+| Cache.  |
+`--------*/
+
+static void
+touch(const fs::path& p)
+{
+  std::ofstream(p.string().c_str());
+}
+
+/// \a dirs directories of \a files files each, under a fresh directory.
+static fs::path
+make_tree(size_t dirs, size_t files)
+{
+  fs::path root = fs::temp_directory_path() / fs::unique_path();
+  for (size_t d = 0; d < dirs; ++d)
+  {
+    fs::path dir = root / libport::format("dir%s", d);
+    fs::create_directories(dir / "sub");
+    for (size_t f = 0; f < files; ++f)
+      touch(dir / libport::format("file%s-%s.so", d, f));
+  }
+  touch(root / "dir0" / "sub" / "nested");
+  return root;
+}
+
+static void
+cache()
+{
+  fs::path root = make_tree(3, 2);
+  file_library l;
+  l.push_back((root / "dir0").string());
+  l.push_back((root / "missing").string());
+  l.push_back((root / "dir2").string());
+  l.cache_set(true);
+  BOOST_CHECK(l.cache_get());
+
+  BOOST_CHECK_EQUAL(l.find_file("file2-1.so").to_string(),
+                    libport::path((root / "dir2").string()).to_string());
+  BOOST_CHECK_EQUAL(l.find_file("sub/nested").to_string(),
+                    libport::path((root / "dir0" / "sub").string())
+                    .to_string());
+  BOOST_CHECK_THROW(l.find_file("file1-1.so"), file_library::Not_found);
+  BOOST_CHECK(l.find_in_directory((root / "dir1").string(), "file1-1.so"));
+
+  // The changes are seen.
+  touch(root / "dir2" / "new.so");
+  BOOST_CHECK(l.find_in_directory((root / "dir2").string(), "new.so"));
+  fs::remove(root / "dir2" / "file2-0.so");
+  BOOST_CHECK_THROW(l.find_file("file2-0.so"), file_library::Not_found);
+  fs::create_directory(root / "missing");
+  touch(root / "missing" / "file2-0.so");
+  BOOST_CHECK_EQUAL(l.find_file("file2-0.so").to_string(),
+                    libport::path((root / "missing").string()).to_string());
+  fs::rename(root / "dir2", root / "moved");
+  BOOST_CHECK_THROW(l.find_file("file2-1.so"), file_library::Not_found);
+  fs::rename(root / "moved", root / "dir2");
+  BOOST_CHECK(l.find_in_directory((root / "dir2").string(), "file2-1.so"));
+
+  // Copies share the cache.
+  file_library copy = l;
+  BOOST_CHECK(copy.cache_get());
+  l.cache_clear();
+  BOOST_CHECK(copy.find_in_directory((root / "dir0").string(), "file0-0.so"));
+  l.cache_set(false);
+  BOOST_CHECK(!l.cache_get());
+  BOOST_CHECK(l.find_in_directory((root / "dir0").string(), "file0-0.so"));
+
+  fs::remove_all(root);
+}
+
+/// Load every file of a tree through its search path, as at startup.
+static libport::utime_t
+bench_lookups(const fs::path& root, size_t dirs, size_t files, bool cache)
+{
+  libport::utime_t start = libport::utime();
+  file_library l;
+  l.cache_set(cache);
+  for (size_t d = 0; d < dirs; ++d)
+    l.push_back((root / libport::format("dir%s", d)).string());
+  size_t found = 0;
+  for (size_t d = 0; d < dirs; ++d)
+    for (size_t f = 0; f < files; ++f)
+      found += l.find_file(libport::format("file%s-%s.so", d, f))
+        == libport::path((root / libport::format("dir%s", d)).string());
+  BOOST_CHECK_EQUAL(found, dirs * files);
+  return libport::utime() - start;
+}
+
+static void
+bench()
+{
+  static const size_t dirs = 30;
+  static const size_t files = 20;
+  fs::path root = make_tree(dirs, files);
+  libport::utime_t stat = bench_lookups(root, dirs, files, false);
+  libport::utime_t cached = bench_lookups(root, dirs, files, true);
+  BOOST_TEST_MESSAGE(dirs * files << " files in " << dirs
+                     << " directories: stat " << stat << "us, "
+                     << "cache " << cached << "us");
+  fs::remove_all(root);
+}
+
 test_suite*
 init_test_suite()
 {
@@ -107,5 +217,8 @@ init_test_suite()
   def(("")("")(""), ":", ".");
 #undef def
 
+  suite->add(BOOST_TEST_CASE(cache));
+  suite->add(BOOST_TEST_CASE(bench));
+
   return suite;
 }
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <libport/flat-hash-map.hh>
+#include <libport/foreach.hh>
+#include <libport/format.hh>
+#include <libport/symbol.hh>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+using libport::test_suite;
+
+template <typename T>
+void
+test_map()
+{
+  libport::flat_hash_map<T, std::string> map;
+
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK_EQUAL(map.size(), 0u);
+  BOOST_CHECK(map.find(T("foo")) == map.end());
+  BOOST_CHECK(map.begin() == map.end());
+
+  map[T("foo")] = "foo";
+  BOOST_CHECK(!map.empty());
+  BOOST_CHECK_EQUAL(map.size(), 1u);
+  BOOST_CHECK_EQUAL(map[T("foo")], "foo");
+
+  BOOST_CHECK(map.insert(std::make_pair(T("bar"), "bar")).second);
+  BOOST_CHECK(!map.insert(std::make_pair(T("bar"), "baz")).second);
+  BOOST_CHECK_EQUAL(map.size(), 2u);
+  BOOST_CHECK_EQUAL(map.find(T("bar"))->second, "bar");
+
+  map[T("bar")] = "baz";
+  BOOST_CHECK_EQUAL(map.size(), 2u);
+  BOOST_CHECK_EQUAL(map[T("foo")], "foo");
+  BOOST_CHECK_EQUAL(map[T("bar")], "baz");
+
+  typedef typename libport::flat_hash_map<T, std::string>::value_type
+    value_type;
+  size_t n = 0;
+  foreach (const value_type& v, map)
+  {
+    BOOST_CHECK_EQUAL(std::string(v.first), v.second == "baz" ? "bar" : "foo");
+    ++n;
+  }
+  BOOST_CHECK_EQUAL(n, 2u);
+
+  BOOST_CHECK_EQUAL(map.erase(T("foo")), 1u);
+  BOOST_CHECK_EQUAL(map.erase(T("foo")), 0u);
+  BOOST_CHECK_EQUAL(map.size(), 1u);
+  BOOST_CHECK_EQUAL(map.count(T("foo")), 0u);
+  BOOST_CHECK_EQUAL(map.count(T("bar")), 1u);
+
+  libport::flat_hash_map<T, std::string> copy = map;
+  map.erase(map.find(T("bar")));
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(map.begin() == map.end());
+  BOOST_CHECK_EQUAL(copy.size(), 1u);
+  BOOST_CHECK_EQUAL(copy[T("bar")], "baz");
+  copy.clear();
+  BOOST_CHECK(copy.empty());
+}
+
+void
+test_set()
+{
+  libport::flat_hash_set<int*> set;
+  std::vector<int> ints(100);
+  for (size_t i = 0; i < ints.size(); i += 2)
+    BOOST_CHECK(set.insert(&ints[i]).second);
+  BOOST_CHECK_EQUAL(set.size(), 50u);
+  for (size_t i = 0; i < ints.size(); ++i)
+    BOOST_CHECK_EQUAL(set.count(&ints[i]), 1u - i % 2);
+  // Erase while iterating.
+  for (libport::flat_hash_set<int*>::iterator i = set.begin();
+       i != set.end(); )
+    if ((*i - &ints[0]) % 4)
+      set.erase(i++);
+    else
+      ++i;
+  BOOST_CHECK_EQUAL(set.size(), 25u);
+}
+
+/// Random operations, checked against std::map.
+void
+test_random()
+{
+  srand(12);
+  libport::flat_hash_map<int, int> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 200000; ++i)
+  {
+    // A small range of keys, to have many erasures and reinsertions.
+    int k = rand() % 3000;
+    switch (rand() % 3)
+    {
+    case 0:
+      map[k] = i;
+      expected[k] = i;
+      break;
+    case 1:
+      BOOST_REQUIRE_EQUAL(map.erase(k), expected.erase(k));
+      break;
+    case 2:
+      BOOST_REQUIRE_EQUAL(map.count(k), expected.count(k));
+      if (map.count(k))
+        BOOST_REQUIRE_EQUAL(map.find(k)->second, expected[k]);
+      break;
+    }
+    BOOST_REQUIRE_EQUAL(map.size(), expected.size());
+  }
+  typedef libport::flat_hash_map<int, int>::value_type value_type;
+  std::map<int, int> content;
+  foreach (const value_type& v, map)
+    content.insert(v);
+  BOOST_CHECK(content == expected);
+  // Deleted slots do not accumulate.
+  BOOST_CHECK_LE(map.capacity(), 8192u);
+}
+
+/*------------.
+| Benchmark.  |
+`------------*/
+
+template <typename Map>
+static void
+bench(const char* name, const std::vector<typename Map::key_type>& keys)
+{
+  libport::utime_t start = libport::utime();
+  Map map;
+  for (size_t i = 0; i < keys.size(); ++i)
+    map[keys[i]] = i;
+  libport::utime_t insert = libport::utime() - start;
+
+  start = libport::utime();
+  size_t sum = 0;
+  for (int round = 0; round < 4; ++round)
+    for (size_t i = 0; i < keys.size(); ++i)
+      sum += map.find(keys[i])->second;
+  libport::utime_t find = libport::utime() - start;
+
+  start = libport::utime();
+  for (size_t i = 0; i < keys.size(); ++i)
+    map.erase(keys[i]);
+  libport::utime_t erase = libport::utime() - start;
+
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK_EQUAL(sum, 4 * keys.size() * (keys.size() - 1) / 2);
+  BOOST_TEST_MESSAGE("  " << name << ": "
+                     << "insert " << insert << "us, "
+                     << "find " << find << "us, "
+                     << "erase " << erase << "us");
+}
+
+template <typename K>
+static void
+bench_both(const char* name, const std::vector<K>& keys)
+{
+  BOOST_TEST_MESSAGE(keys.size() << " " << name << " keys");
+  bench<boost::unordered_map<K, size_t> >("boost::unordered_map", keys);
+  bench<libport::flat_hash_map<K, size_t> >("flat_hash_map", keys);
+}
+
+void
+test_bench()
+{
+  static const size_t n = 200000;
+  std::vector<long> longs;
+  std::vector<libport::Symbol> symbols;
+  std::vector<std::string> strings;
+  for (size_t i = 0; i < n; ++i)
+  {
+    longs.push_back(long(i) * 4096);
+    strings.push_back(libport::format("identifier_%s", i));
+    symbols.push_back(libport::Symbol(strings.back()));
+  }
+  bench_both("pointer-like long", longs);
+  bench_both("Symbol", symbols);
+  bench_both("std::string", strings);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::flat_hash_map");
+  suite->add(BOOST_TEST_CASE(&test_map<std::string>));
+  suite->add(BOOST_TEST_CASE(&test_map<libport::Symbol>));
+  suite->add(BOOST_TEST_CASE(test_set));
+  suite->add(BOOST_TEST_CASE(test_random));
+  suite->add(BOOST_TEST_CASE(test_bench));
+  return suite;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <libport/bind.hh>
+#include <libport/future.hh>
+#include <libport/thread-pool.hh>
+#include <libport/unistd.h>
+
+#include "test.hh"
+
+using libport::test_suite;
+
+typedef libport::ThreadPool ThreadPool;
+typedef libport::Future<int> Future;
+
+// Threads of a pool must not outlive it: share a leaked one.
+static ThreadPool& tp = *new ThreadPool(4);
+
+static int answer()
+{
+  return 42;
+}
+
+static int fail()
+{
+  throw std::runtime_error("fail");
+}
+
+static int twice(Future f)
+{
+  return f.get() * 2;
+}
+
+static int slow(int v)
+{
+  usleep(100000);
+  return v;
+}
+
+static void test_async()
+{
+  Future f = tp.async(&answer);
+  BOOST_CHECK(f.valid());
+  BOOST_CHECK_EQUAL(f.get(), 42);
+  BOOST_CHECK(f.ready());
+  BOOST_CHECK(!f.failed());
+
+  Future g = tp.async(&fail);
+  BOOST_CHECK_THROW(g.get(), std::runtime_error);
+  BOOST_CHECK(g.failed());
+}
+
+static void test_then()
+{
+  Future f = tp.async(boost::bind(&slow, 21)).then(tp, &twice);
+  BOOST_CHECK_EQUAL(f.then(tp, &twice).get(), 84);
+
+  // Exceptions go through the continuations.
+  Future g = tp.async(&fail).then(tp, &twice);
+  BOOST_CHECK_THROW(g.get(), std::runtime_error);
+}
+
+static void test_when_all()
+{
+  std::vector<Future> fs;
+  for (int i = 0; i < 8; ++i)
+    fs.push_back(tp.async(boost::bind(&slow, i)));
+  libport::when_all(fs).get();
+  for (int i = 0; i < 8; ++i)
+    BOOST_CHECK_EQUAL(fs[i].get(), i);
+
+  fs.push_back(tp.async(&fail));
+  BOOST_CHECK_THROW(libport::when_all(fs).get(), std::runtime_error);
+
+  BOOST_CHECK(libport::when_all(std::vector<Future>()).ready());
+}
+
+static void test_dropped()
+{
+  ThreadPool::rTaskLock l(new ThreadPool::TaskLock(1));
+  Future f1 = tp.async(boost::bind(&slow, 1), l);
+  Future f2 = tp.async(boost::bind(&slow, 2), l);
+  usleep(50000);
+  Future f3 = tp.async(boost::bind(&slow, 3), l);
+  BOOST_CHECK_EQUAL(f1.get(), 1);
+  BOOST_CHECK_THROW(f2.get(), libport::TaskDropped);
+  BOOST_CHECK_THROW(f3.get(), libport::TaskDropped);
+}
+
+static void square(std::vector<int>* v, size_t i)
+{
+  (*v)[i] = i * i;
+}
+
+static long sum_range(size_t b, size_t e)
+{
+  long res = 0;
+  for (size_t i = b; i < e; ++i)
+    res += i;
+  return res;
+}
+
+static void check_small(size_t i)
+{
+  if (i == 500)
+    throw std::runtime_error("500");
+}
+
+static void test_parallel()
+{
+  static const size_t n = 10000;
+  std::vector<int> v(n);
+  libport::parallel_for(tp, size_t(0), n, boost::bind(&square, &v, _1));
+  for (size_t i = 0; i < n; ++i)
+    BOOST_CHECK_EQUAL(v[i], int(i * i));
+
+  long sum = libport::parallel_reduce(tp, size_t(0), n, 0L, &sum_range,
+                                      std::plus<long>());
+  BOOST_CHECK_EQUAL(sum, long(n * (n - 1) / 2));
+
+  BOOST_CHECK_THROW(libport::parallel_for(tp, size_t(0), n, &check_small,
+                                          size_t(7)),
+                    std::runtime_error);
+  // Empty ranges are fine.
+  libport::parallel_for(tp, size_t(0), size_t(0), &check_small);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::Future test suite");
+  suite->add(BOOST_TEST_CASE(test_async));
+  suite->add(BOOST_TEST_CASE(test_then));
+  suite->add(BOOST_TEST_CASE(test_when_all));
+  suite->add(BOOST_TEST_CASE(test_dropped));
+  suite->add(BOOST_TEST_CASE(test_parallel));
+  return suite;
+}
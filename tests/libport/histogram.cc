@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include <libport/histogram.hh>
+#include <libport/unit-test.hh>
+
+using libport::test_suite;
+
+typedef libport::Histogram<> histogram_type;
+typedef histogram_type::value_type value_type;
+
+static void
+test_buckets()
+{
+  // Exact below 2 * sub_buckets.
+  for (value_type v = 0; v < 2 * histogram_type::sub_buckets; ++v)
+  {
+    BOOST_CHECK_EQUAL(histogram_type::index(v), v);
+    BOOST_CHECK_EQUAL(histogram_type::lowest(v), v);
+    BOOST_CHECK_EQUAL(histogram_type::highest(v), v);
+  }
+  // Contiguous buckets, narrower than 1/16 of their values,
+  // up to the greatest value.
+  size_t last = histogram_type::index(value_type(-1));
+  BOOST_CHECK_EQUAL(last, 61u * histogram_type::sub_buckets - 1);
+  BOOST_CHECK_EQUAL(histogram_type::highest(last), value_type(-1));
+  for (size_t i = 1; i <= last; ++i)
+  {
+    value_type low = histogram_type::lowest(i);
+    value_type high = histogram_type::highest(i);
+    BOOST_REQUIRE_EQUAL(histogram_type::highest(i - 1) + 1, low);
+    BOOST_REQUIRE_EQUAL(histogram_type::index(low), i);
+    BOOST_REQUIRE_EQUAL(histogram_type::index(high), i);
+    BOOST_REQUIRE_LE(high - low, low / histogram_type::sub_buckets);
+  }
+}
+
+static void
+test_quantiles()
+{
+  histogram_type h;
+  BOOST_CHECK(h.empty());
+  BOOST_CHECK_EQUAL(h.quantile(0.5), 0u);
+
+  for (int i = 1; i <= 100; ++i)
+    h.add(i);
+  BOOST_CHECK_EQUAL(h.size(), 100u);
+  // Exact under 32.
+  BOOST_CHECK_EQUAL(h.quantile(0), 1u);
+  BOOST_CHECK_EQUAL(h.quantile(0.1), 10u);
+  BOOST_CHECK_EQUAL(h.quantile(0.3), 30u);
+  // Within the width of the buckets above.
+  BOOST_CHECK_LE(h.quantile(0.5), 51u);
+  BOOST_CHECK_GE(h.quantile(0.5), 49u);
+  BOOST_CHECK_LE(h.quantile(0.99), 101u);
+  BOOST_CHECK_GE(h.quantile(0.99), 97u);
+  BOOST_CHECK_LE(h.quantile(1), 101u);
+  BOOST_CHECK_GE(h.quantile(1), 97u);
+
+  // Negative samples count as 0.
+  h.add(-5, 100);
+  BOOST_CHECK_EQUAL(h.quantile(0.5), 0u);
+  for (int i = 0; i < 100; ++i)
+    h.remove(-1);
+  BOOST_CHECK_EQUAL(h.size(), 100u);
+  BOOST_CHECK_EQUAL(h.quantile(0.1), 10u);
+
+  h.clear();
+  BOOST_CHECK(h.empty());
+  BOOST_CHECK_EQUAL(h.buckets(), 0u);
+}
+
+/// Random samples, against the sorted samples.
+static void
+test_random()
+{
+  srand(42);
+  std::vector<value_type> samples;
+  histogram_type h1, h2;
+  for (int i = 0; i < 100000; ++i)
+  {
+    // Spread over several orders of magnitude.
+    value_type v = value_type(rand() % 1000) << (rand() % 20);
+    samples.push_back(v);
+    (i % 2 ? h1 : h2).add(v);
+  }
+  histogram_type h = h1;
+  h.merge(h2);
+  BOOST_CHECK_EQUAL(h.size(), samples.size());
+  std::sort(samples.begin(), samples.end());
+  static const double qs[] = { 0.01, 0.1, 0.5, 0.9, 0.99, 0.999, 1 };
+  for (size_t i = 0; i < sizeof qs / sizeof *qs; ++i)
+  {
+    value_type expected =
+      samples[size_t(std::ceil(qs[i] * samples.size())) - 1];
+    value_type v = h.quantile(qs[i]);
+    BOOST_TEST_MESSAGE("p" << qs[i] * 100 << ": " << v
+                       << ", expected " << expected);
+    BOOST_CHECK_EQUAL(histogram_type::index(v),
+                      histogram_type::index(expected));
+  }
+  // The memory only depends on the greatest sample.
+  BOOST_CHECK_EQUAL(h.buckets(), histogram_type::index(samples.back()) + 1);
+}
+
+static void
+test_dump()
+{
+  histogram_type h;
+  for (int i = 0; i < 1000; ++i)
+    h.add(i * i);
+  std::stringstream s;
+  s << h;
+  BOOST_TEST_MESSAGE("dump: " << s.str().size() << " bytes");
+  histogram_type h2;
+  BOOST_CHECK(h2.load(s));
+  BOOST_CHECK_EQUAL(h2.size(), h.size());
+  BOOST_CHECK_EQUAL(h2.buckets(), h.buckets());
+  for (size_t i = 0; i < h.buckets(); ++i)
+    BOOST_CHECK_EQUAL(h2.count(i), h.count(i));
+
+  h.clear();
+  std::stringstream empty;
+  empty << h;
+  BOOST_CHECK_EQUAL(empty.str(), "4 0");
+  BOOST_CHECK(h2.load(empty));
+  BOOST_CHECK(h2.empty());
+
+  // Invalid input is rejected.
+  std::stringstream bits("5 0");
+  BOOST_CHECK(!h2.load(bits));
+  std::stringstream truncated("4 10 0 3");
+  BOOST_CHECK(!h2.load(truncated));
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::Histogram");
+  suite->add(BOOST_TEST_CASE(test_buckets));
+  suite->add(BOOST_TEST_CASE(test_quantiles));
+  suite->add(BOOST_TEST_CASE(test_random));
+  suite->add(BOOST_TEST_CASE(test_dump));
+  return suite;
+}
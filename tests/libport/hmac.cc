@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <libport/config.h>
+#include <libport/hmac.hh>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+#ifdef LIBPORT_ENABLE_SSL
+# include <openssl/hmac.h>
+#endif
+
+using libport::test_suite;
+
+#ifdef LIBPORT_ENABLE_SSL
+static std::string
+hex(const std::string& s)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string res;
+  for (size_t i = 0; i < s.size(); ++i)
+  {
+    res += digits[(unsigned char) s[i] >> 4];
+    res += digits[s[i] & 0xf];
+  }
+  return res;
+}
+#endif
+
+// Test vectors from RFC 2202 and RFC 4231.
+static void test_vectors()
+{
+#ifdef LIBPORT_ENABLE_SSL
+  BOOST_CHECK_EQUAL(hex(libport::hmac_sha256("Hi There",
+                                             std::string(20, '\x0b'))),
+                    "b0344c61d8db38535ca8afceaf0bf12b"
+                    "881dc200c9833da726e9376c2e32cff7");
+  BOOST_CHECK_EQUAL(hex(libport::hmac_sha256("what do ya want for nothing?",
+                                             "Jefe")),
+                    "5bdcc146bf60754e6a042426089575c7"
+                    "5a003f089d2739839dec58b964ec3843");
+  // A key longer than a block.
+  BOOST_CHECK_EQUAL(hex(libport::hmac_sha256(
+                          "Test Using Larger Than Block-Size Key - "
+                          "Hash Key First",
+                          std::string(131, '\xaa'))),
+                    "60e431591ee0b67f0d8a26aacbf5b77f"
+                    "8e0bc6213728c5140546040f0ee37f54");
+
+  libport::Hmac sha1(libport::Hmac::SHA1, "Jefe");
+  BOOST_CHECK_EQUAL(sha1.size(), 20u);
+  sha1.update("what do ya want for nothing?");
+  BOOST_CHECK_EQUAL(hex(sha1.final()),
+                    "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+#endif
+}
+
+static void test_stream()
+{
+#ifdef LIBPORT_ENABLE_SSL
+  std::string key = "uV3F3YluFJax1cknvbcGwgjvx4QpvB+leU8dUj2o";
+  std::string msg =
+    "GET\n\n\nTue, 27 Mar 2007 19:36:42 +0000\n"
+    "/johnsmith/photos/puppy.jpg";
+  std::string expected = libport::hmac_sha256(msg, key);
+  libport::Hmac hmac(libport::Hmac::SHA256, key);
+  BOOST_CHECK_EQUAL(hmac.size(), 32u);
+
+  // The context is reused for each message.
+  for (size_t split = 0; split <= msg.size(); split += 7)
+  {
+    hmac.update(msg.data(), split);
+    hmac.update(msg.data() + split, msg.size() - split);
+    BOOST_CHECK_EQUAL(hmac.final(), expected);
+  }
+
+  struct iovec iov[3];
+  iov[0].iov_base = const_cast<char*>(msg.data());
+  iov[0].iov_len = 10;
+  iov[1].iov_base = 0;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = const_cast<char*>(msg.data() + 10);
+  iov[2].iov_len = msg.size() - 10;
+  hmac.update(iov, 3);
+  char out[32];
+  hmac.final(out);
+  BOOST_CHECK_EQUAL(std::string(out, sizeof out), expected);
+#endif
+}
+
+static void test_bench()
+{
+#ifdef LIBPORT_ENABLE_SSL
+  std::string key(40, 'k');
+  for (size_t size = 64; size <= 64 * 1024; size *= 4)
+  {
+    std::string msg(size, 'm');
+    size_t n = 64 * 1024 * 1024 / size;
+    std::string expected = libport::hmac_sha256(msg, key);
+
+    libport::utime_t start = libport::utime();
+    unsigned char out[32];
+    unsigned out_size;
+    for (size_t i = 0; i < n; ++i)
+      HMAC(EVP_sha256(), key.data(), key.size(),
+           (const unsigned char*) msg.data(), msg.size(), out, &out_size);
+    libport::utime_t one_shot = libport::utime() - start;
+    bool same = std::string((char*) out, out_size) == expected;
+
+    libport::Hmac hmac(libport::Hmac::SHA256, key);
+    char res[32];
+    start = libport::utime();
+    for (size_t i = 0; i < n; ++i)
+    {
+      hmac.update(msg);
+      hmac.final(res);
+    }
+    libport::utime_t reused = libport::utime() - start;
+    same = same && std::string(res, sizeof res) == expected;
+
+    BOOST_CHECK(same);
+    BOOST_TEST_MESSAGE(size << "B messages: "
+                       << "one-shot HMAC " << n * 1000000 / one_shot
+                       << "/s, Hmac " << n * 1000000 / reused << "/s");
+  }
+#endif
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::Hmac test suite");
+  suite->add(BOOST_TEST_CASE(test_vectors));
+  suite->add(BOOST_TEST_CASE(test_stream));
+  suite->add(BOOST_TEST_CASE(test_bench));
+  return suite;
+}
@@ -15,7 +15,11 @@
 #include <libport/ref-counted.hh>
 #include <libport/intrusive-ptr.hh>
 
+#include <libport/bind.hh>
+#include <libport/lockable.hh>
+#include <libport/thread.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 
 using libport::test_suite;
 
@@ -147,6 +151,88 @@ void ward()
   BOOST_CHECK_EQUAL(w.x, 1);
 }
 
+/*-----------------------.
+| ThreadSafeRefCounted.  |
+`-----------------------*/
+
+struct Shared : libport::ThreadSafeRefCounted
+{
+  Shared () { ++instances; }
+  virtual ~Shared () { --instances; }
+  static unsigned instances;
+};
+
+unsigned Shared::instances;
+
+/// The former ThreadSafeRefCounted, which locked a mutex.
+struct LockedShared : libport::RefCounted
+{
+  void counter_inc() const
+  {
+    libport::BlockLock bl(lock_);
+    RefCounted::counter_inc();
+  }
+
+  bool counter_dec() const
+  {
+    libport::BlockLock bl(lock_);
+    return RefCounted::counter_dec();
+  }
+
+  mutable libport::Lockable lock_;
+};
+
+static const unsigned threads = 4;
+static const unsigned copies = 1000000;
+
+template <typename T>
+static void
+copy(const libport::intrusive_ptr<T>* p)
+{
+  for (unsigned i = 0; i < copies; ++i)
+    libport::intrusive_ptr<T> c = *p;
+}
+
+/// Copy \a p from several threads at once.
+/// \return the time it took.
+template <typename T>
+static libport::utime_t
+contend(const libport::intrusive_ptr<T>& p)
+{
+  libport::utime_t start = libport::utime();
+  pthread_t ts[threads];
+  for (unsigned i = 0; i < threads; ++i)
+    ts[i] = libport::startThread(
+      boost::function0<void>(boost::bind(&copy<T>, &p)));
+  for (unsigned i = 0; i < threads; ++i)
+    pthread_join(ts[i], 0);
+  return libport::utime() - start;
+}
+
+void
+thread_safe()
+{
+  {
+    libport::intrusive_ptr<Shared> p = new Shared;
+    libport::utime_t atomic = contend(p);
+    BOOST_CHECK_EQUAL(p->counter_get(), 1);
+    BOOST_CHECK_EQUAL(Shared::instances, 1u);
+
+    libport::intrusive_ptr<LockedShared> l = new LockedShared;
+    libport::utime_t locked = contend(l);
+    BOOST_CHECK_EQUAL(l->counter_get(), 1);
+
+    BOOST_TEST_MESSAGE(threads << " threads copying " << copies
+                       << " times: "
+                       << "mutex " << locked << "us, "
+                       << "atomic " << atomic << "us");
+    BOOST_TEST_MESSAGE("object size: "
+                       << "mutex " << sizeof(LockedShared) << ", "
+                       << "atomic " << sizeof(Shared));
+  }
+  BOOST_CHECK_EQUAL(Shared::instances, 0u);
+}
+
 test_suite*
 init_test_suite()
 {
@@ -159,5 +245,6 @@ init_test_suite()
   suite->add(BOOST_TEST_CASE(held_ref_from_dtor));
 #endif
   suite->add(BOOST_TEST_CASE(ward));
+  suite->add(BOOST_TEST_CASE(thread_safe));
   return suite;
 }
@@ -1,4 +1,4 @@
-## Copyright (C) 2009-2011, Gostai S.A.S.
+## Copyright (C) 2009-2012, Gostai S.A.S.
 ##
 ## This software is provided "as is" without warranty of any kind,
 ## either expressed or implied, including but not limited to the
@@ -42,12 +42,16 @@ TESTS_BINARIES =                                \
   tests/libport/fifo.cc                         \
   tests/libport/file-library.cc                 \
   tests/libport/finally.cc                      \
+  tests/libport/flat-hash-map.cc                \
   tests/libport/fnmatch.cc                      \
   tests/libport/foreach.cc                      \
+  tests/libport/future.cc                       \
   tests/libport/format.cc                       \
   tests/libport/has-if.cc                       \
   tests/libport/hash.cc                         \
+  tests/libport/histogram.cc                    \
   tests/libport/hmac-sha1.cc                    \
+  tests/libport/hmac.cc                         \
   tests/libport/indent.cc                       \
   tests/libport/input-arguments.cc              \
   tests/libport/intrusive-ptr.cc                \
@@ -60,6 +64,7 @@ TESTS_BINARIES =                                \
   tests/libport/pthread.cc                      \
   tests/libport/read-stdin.cc                   \
   tests/libport/reserved-vector.cc              \
+  tests/libport/ring-fifo.cc                    \
   tests/libport/safe-container.cc               \
   tests/libport/semaphore.cc                    \
   tests/libport/separate.cc                     \
@@ -72,6 +77,7 @@ TESTS_BINARIES =                                \
   tests/libport/time.cc                         \
   tests/libport/timer.cc                        \
   tests/libport/tokenizer.cc                    \
+  tests/libport/trace.cc                        \
   tests/libport/traits.cc                       \
   tests/libport/ufloat-double.cc                \
   tests/libport/unescape.cc                     \
@@ -95,7 +101,12 @@ endif
 #ufloat-floating-tab.cc
 #ufloat-floating.cc
 
-EXTRA_PROGRAMS = $(TESTS_BINARIES:.cc=)
+# Benchmarks, run by "make bench" only.
+BENCHES_BINARIES =				\
+  tests/libport/statistics-bench.cc		\
+  tests/libport/thread-pool-bench.cc
+
+EXTRA_PROGRAMS = $(TESTS_BINARIES:.cc=) $(BENCHES_BINARIES:.cc=)
 CLEANFILES += $(EXTRA_PROGRAMS)
 
 AM_LDFLAGS +=                                   \
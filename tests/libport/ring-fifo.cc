@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <sched.h>
+
+#include <vector>
+
+#include <libport/bind.hh>
+#include <libport/cstring>
+#include <libport/fifo.hh>
+#include <libport/lockable.hh>
+#include <libport/ring-fifo.hh>
+#include <libport/thread.hh>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+using libport::test_suite;
+
+/*-------------.
+| Sequential.  |
+`-------------*/
+
+static void
+test_sequential()
+{
+  libport::RingFifo fifo(1);
+  BOOST_CHECK(fifo.empty());
+  // Rounded up to the page size, a power of two.
+  size_t capacity = fifo.capacity();
+  BOOST_CHECK(capacity && !(capacity & (capacity - 1)));
+
+  std::string in(capacity / 3 * 2, 'x');
+  for (size_t i = 0; i < in.size(); ++i)
+    in[i] = 'a' + i % 26;
+  std::vector<char> buffer(capacity);
+  char* out = &buffer[0];
+  // The second round wraps around the end of the buffer.
+  for (int i = 0; i < 3; ++i)
+  {
+    BOOST_CHECK_EQUAL(fifo.push(in.c_str(), in.size()), in.size());
+    BOOST_CHECK_EQUAL(fifo.size(), in.size());
+    BOOST_CHECK_EQUAL(fifo.pop(out, capacity), in.size());
+    BOOST_CHECK_EQUAL(std::string(out, in.size()), in);
+    BOOST_CHECK(fifo.empty());
+  }
+
+  // Full.
+  BOOST_CHECK_EQUAL(fifo.push(in.c_str(), in.size()), in.size());
+  BOOST_CHECK_EQUAL(fifo.push(in.c_str(), in.size()),
+                    capacity - in.size());
+  BOOST_CHECK_EQUAL(fifo.push(in.c_str(), 1), 0u);
+  BOOST_CHECK_EQUAL(fifo.size(), capacity);
+}
+
+static void
+test_spans()
+{
+  libport::RingFifo fifo(1);
+  size_t capacity = fifo.capacity();
+  // Move to the middle of the buffer.
+  std::string half(capacity / 2, '-');
+  std::vector<char> buffer(capacity);
+  char* out = &buffer[0];
+  fifo.push(half.c_str(), half.size());
+  fifo.pop(out, half.size());
+
+  size_t size;
+  char* w = fifo.write_begin(size);
+  BOOST_CHECK_EQUAL(size, fifo.mirrored() ? capacity : capacity / 2);
+  for (size_t i = 0; i < size; ++i)
+    w[i] = i % 251;
+  // Batch commit.
+  fifo.write_commit(size / 2);
+  fifo.write_commit(size - size / 2);
+
+  size_t n;
+  const char* r = fifo.read_begin(n);
+  BOOST_CHECK_EQUAL(n, size);
+  for (size_t i = 0; i < n; ++i)
+    BOOST_CHECK_EQUAL(r[i], char(i % 251));
+  fifo.read_commit(n);
+  BOOST_CHECK(fifo.empty());
+}
+
+/*-----------.
+| Threaded.  |
+`-----------*/
+
+static const size_t total = 16 * 1024 * 1024;
+static const size_t chunk = 64;
+
+static void
+yield()
+{
+  sched_yield();
+}
+
+static void
+ring_producer(libport::RingFifo* fifo)
+{
+  char data[chunk];
+  for (size_t sent = 0; sent < total; )
+  {
+    for (size_t i = 0; i < chunk; ++i)
+      data[i] = (sent + i) % 251;
+    size_t n = fifo->push(data, chunk);
+    if (n < chunk)
+    {
+      // Do not resend the part which was pushed.
+      sent += n;
+      yield();
+      continue;
+    }
+    sent += n;
+  }
+}
+
+/// Consume \a total bytes, return the number of wrong ones.
+static size_t
+ring_consumer(libport::RingFifo& fifo)
+{
+  size_t res = 0;
+  for (size_t received = 0; received < total; )
+  {
+    size_t n;
+    const char* data = fifo.read_begin(n);
+    if (!n)
+    {
+      yield();
+      continue;
+    }
+    for (size_t i = 0; i < n; ++i)
+      res += data[i] != char((received + i) % 251);
+    received += n;
+    fifo.read_commit(n);
+  }
+  return res;
+}
+
+static void
+test_threads()
+{
+  libport::RingFifo fifo;
+  pthread_t t = libport::startThread(
+    boost::function0<void>(boost::bind(&ring_producer, &fifo)));
+  BOOST_CHECK_EQUAL(ring_consumer(fifo), 0u);
+  pthread_join(t, 0);
+  BOOST_CHECK(fifo.empty());
+}
+
+/*-----------------.
+| Multi producer.  |
+`-----------------*/
+
+static const unsigned producers = 3;
+static const unsigned records = 100000;
+
+struct Record
+{
+  unsigned producer;
+  unsigned count;
+};
+
+static void
+mp_producer(libport::MultiProducerRingFifo* fifo, unsigned id)
+{
+  for (unsigned i = 0; i < records; ++i)
+  {
+    Record r = { id, i };
+    // Alternate the copying and the in place interfaces.
+    if (i % 2)
+      while (!fifo->push(reinterpret_cast<char*>(&r), sizeof r))
+        yield();
+    else
+    {
+      unsigned long position;
+      char* span;
+      while (!(span = fifo->write_begin(sizeof r, position)))
+        yield();
+      memcpy(span, &r, sizeof r);
+      fifo->write_commit(position, sizeof r);
+    }
+  }
+}
+
+static void
+test_multi_producer()
+{
+  libport::MultiProducerRingFifo fifo(4096);
+  pthread_t threads[producers];
+  for (unsigned i = 0; i < producers; ++i)
+    threads[i] = libport::startThread(
+      boost::function0<void>(boost::bind(&mp_producer, &fifo, i)));
+
+  unsigned next[producers] = { 0 };
+  size_t errors = 0;
+  for (unsigned received = 0; received < producers * records; ++received)
+  {
+    Record r;
+    while (fifo.size() < sizeof r)
+      yield();
+    BOOST_REQUIRE_EQUAL(fifo.pop(reinterpret_cast<char*>(&r), sizeof r),
+                        sizeof r);
+    // The records of each producer arrive in order.
+    errors += producers <= r.producer || r.count != next[r.producer]++;
+  }
+  for (unsigned i = 0; i < producers; ++i)
+    pthread_join(threads[i], 0);
+  BOOST_CHECK_EQUAL(errors, 0u);
+  BOOST_CHECK(fifo.empty());
+}
+
+/*------------.
+| Benchmark.  |
+`------------*/
+
+typedef libport::Fifo<char, '\0'> fifo_type;
+
+static void
+locked_producer(fifo_type* fifo, libport::Lockable* lock)
+{
+  char data[chunk];
+  for (size_t sent = 0; sent < total; sent += chunk)
+  {
+    for (size_t i = 0; i < chunk; ++i)
+      data[i] = (sent + i) % 251;
+    libport::BlockLock l(lock);
+    fifo->push(data, chunk);
+  }
+}
+
+static size_t
+locked_consumer(fifo_type& fifo, libport::Lockable& lock)
+{
+  size_t res = 0;
+  for (size_t received = 0; received < total; )
+  {
+    size_t n;
+    {
+      libport::BlockLock l(lock);
+      n = fifo.size();
+      if (n)
+      {
+        const char* data = fifo.pop(n);
+        for (size_t i = 0; i < n; ++i)
+          res += data[i] != char((received + i) % 251);
+      }
+    }
+    if (!n)
+      yield();
+    received += n;
+  }
+  return res;
+}
+
+static void
+test_bench()
+{
+  libport::utime_t locked;
+  {
+    fifo_type fifo;
+    libport::Lockable lock;
+    libport::utime_t start = libport::utime();
+    pthread_t t = libport::startThread(
+      boost::function0<void>(boost::bind(&locked_producer, &fifo, &lock)));
+    BOOST_CHECK_EQUAL(locked_consumer(fifo, lock), 0u);
+    pthread_join(t, 0);
+    locked = libport::utime() - start;
+  }
+
+  libport::utime_t ring;
+  {
+    libport::RingFifo fifo;
+    libport::utime_t start = libport::utime();
+    pthread_t t = libport::startThread(
+      boost::function0<void>(boost::bind(&ring_producer, &fifo)));
+    BOOST_CHECK_EQUAL(ring_consumer(fifo), 0u);
+    pthread_join(t, 0);
+    ring = libport::utime() - start;
+  }
+
+  BOOST_TEST_MESSAGE(total / 1024 / 1024 << "MB by chunks of " << chunk
+                     << ": Fifo and mutex " << total / locked << "MB/s, "
+                     << "RingFifo " << total / ring << "MB/s");
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::RingFifo test suite");
+  suite->add(BOOST_TEST_CASE(test_sequential));
+  suite->add(BOOST_TEST_CASE(test_spans));
+  suite->add(BOOST_TEST_CASE(test_threads));
+  suite->add(BOOST_TEST_CASE(test_multi_producer));
+  suite->add(BOOST_TEST_CASE(test_bench));
+  return suite;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -9,6 +9,8 @@
  */
 
 #include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <libport/lexical-cast.hh>
 #include <libport/cstdlib>
 
@@ -22,6 +24,7 @@
 #include <libport/sysexits.hh>
 #include <libport/time.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 
 using boost::assign::list_of;
 using libport::test_suite;
@@ -67,9 +70,10 @@ fail:
 }
 
 // Check basic behavior
+template <template <class, class> class C>
 void test()
 {
-  libport::SafeContainer<std::list, int> s;
+  libport::SafeContainer<C, int> s;
   std::list<int> b = list_of(3)(4)(5)(6)(7)(8)(9)(10)(11);
   foreach(int i, b)
     s.push_back(i);
@@ -80,7 +84,7 @@ void test()
 
   BOOST_CHECK(check_list(s, tolist(13, (1,2,3,4,5,6,7,8,9,10,11,12,13))));
   std::vector<int> tv;
-  for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
        i != s.end(); ++i)
   {
     tv.push_back(*i);
@@ -91,7 +95,7 @@ void test()
   check_list(tv, expect);
 
   BOOST_CHECK(check_list(s, tolist(12, (1,2,3,4,5,6,7,8,9,10,11,13))));
-  for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
        i != s.end(); ++i)
   {
     if (*i == 9)
@@ -99,7 +103,7 @@ void test()
   }
 
   BOOST_CHECK(check_list(s, tolist(11, (1,2,3,4,5,6,7,8,10,11,13))));
-  for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
        i != s.end(); ++i)
   {
     if (*i == 8)
@@ -110,7 +114,7 @@ void test()
     }
   }
   BOOST_CHECK(check_list(s, tolist(8, (1,2,3,4,5,6,11,13))));
-  for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
        i != s.end(); ++i)
   {
     if (*i == 1)
@@ -118,7 +122,7 @@ void test()
   }
   BOOST_CHECK(check_list(s, tolist(7, (2,3,4,5,6,11,13))));
   tv.clear();
-  for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
        i != s.end(); ++i)
   {
     tv.push_back(*i);
@@ -130,9 +134,10 @@ void test()
 }
 
 // Check that everything still works when making multiple turns of the flags.
+template <template <class, class> class C>
 void test2()
 {
-  libport::SafeContainer<std::list, int> s;
+  libport::SafeContainer<C, int> s;
   std::list<int> b = list_of(3)(4)(5)(6)(7)(8)(9)(10)(11);
   foreach(int i, b)
     s.push_back(i);
@@ -153,7 +158,7 @@ void test2()
   for (int i = 0; i < 100; ++i)
   {
     tv.clear();
-    for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+    for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
          i != s.end(); ++i)
     {
       tv.push_back(*i);
@@ -170,7 +175,7 @@ void test2()
     int item = rand()% v.size();
     int p = 0;
     tv.clear();
-    for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+    for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
          i != s.end(); ++i, ++p)
     {
       tv.push_back(*i);
@@ -188,7 +193,7 @@ void test2()
     s.push_back(i);
   BOOST_CHECK_EQUAL(s.size(), 9u);
   std::list<int> ins = list_of(100)(101)(102);
-  libport::SafeContainer<std::list, int>::iterator i = s.begin();
+  typename libport::SafeContainer<C, int>::iterator i = s.begin();
   i++;i++;i++;
   s.insert(i, ins.begin(), ins.end());
   BOOST_CHECK(check_list(s, tolist(12, (3,4,5,100,101,102,6,7,8,9,10,11))));
@@ -205,9 +210,10 @@ void test2()
 }
 
 // Interrupt iteration
+template <template <class, class> class C>
 void test3()
 {
-  libport::SafeContainer<std::list, int> s;
+  libport::SafeContainer<C, int> s;
   std::vector<int> b =
     list_of(1)(2)(3)(4)(5)(6)(7)(8)(9)(10)(11)(12)(13)(14)(15);
   foreach(int i, b)
@@ -218,7 +224,7 @@ void test3()
     int item = rand() % b.size();
     int p = 0;
     tv.clear();
-    for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+    for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
          i != s.end(); ++i, ++p)
     {
       if (p == item)
@@ -230,6 +236,7 @@ void test3()
 }
 
 // Check multiple iterators in parallel
+template <template <class, class> class C>
 void test4()
 {
   std::vector<int> b =
@@ -237,10 +244,10 @@ void test4()
   std::vector<int> tv;
   for (int i_=0; i_<100; ++i_)
   {
-    libport::SafeContainer<std::list, int> s;
+    libport::SafeContainer<C, int> s;
     foreach(int i, b)
     s.push_back(i);
-    std::vector<libport::SafeContainer<std::list, int>::iterator> iters;
+    std::vector<typename libport::SafeContainer<C, int>::iterator> iters;
     std::vector<int> ipos;
     std::vector<std::vector<int> > effective;
     // Store some iterators at various positions.
@@ -253,7 +260,7 @@ void test4()
       int p = 0;
       iters.push_back(s.begin());
       BOOST_CHECK(true);
-      libport::SafeContainer<std::list, int>::iterator &i = iters[piter];
+      typename libport::SafeContainer<C, int>::iterator &i = iters[piter];
       for (; i != s.end(); ++i, ++p)
       {
         effective[piter].push_back(*i);
@@ -269,7 +276,7 @@ void test4()
     {
       int item = rand()% b.size();
       int p = 0;
-      for (libport::SafeContainer<std::list, int>::iterator i = s.begin();
+      for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
            i != s.end(); ++i, ++p)
         if (p == item)
         {
@@ -286,7 +293,7 @@ void test4()
     {
       BOOST_TEST_MESSAGE("finish iteration " << piter);
       effective[piter].push_back(-1);
-      libport::SafeContainer<std::list, int>::iterator &i = iters[piter];
+      typename libport::SafeContainer<C, int>::iterator &i = iters[piter];
       if (i != s.end())
         i++;
       while (i != s.end())
@@ -311,6 +318,167 @@ void test4()
   }
 }
 
+// Vector specific: no limit on the iterators, independent copies.
+void test_vector()
+{
+  typedef libport::SafeContainer<std::vector, int> container;
+  container s;
+  for (int i = 0; i < 10; ++i)
+    s.push_back(i);
+
+  // More live iterators than the bits of a mask.
+  std::vector<container::iterator> iters;
+  for (int i = 0; i < 100; ++i)
+  {
+    iters.push_back(s.begin());
+    for (int j = 0; j < i % 10; ++j)
+      ++iters.back();
+  }
+  for (int i = 0; i < 100; ++i)
+    BOOST_CHECK_EQUAL(*iters[i], i % 10);
+
+  // Erase, insert in the middle, and in front: the live iterators
+  // stay on their element, and ignore the new ones.
+  s.erase(std::find(s.begin(), s.end(), 5));
+  std::vector<int> ins = tolist(2, (100, 101));
+  s.insert(std::find(s.begin(), s.end(), 3), ins.begin(), ins.end());
+  s.push_front(-1);
+  s.push_back(10);
+  BOOST_CHECK_EQUAL(s.size(), 13u);
+  BOOST_CHECK(check_list(s, tolist(13, (-1,0,1,2,100,101,3,4,6,7,8,9,10))));
+  for (int i = 0; i < 100; ++i)
+  {
+    std::vector<int> tv;
+    for (container::iterator& j = iters[i]; j != s.end(); ++j)
+      tv.push_back(*j);
+    std::vector<int> expect;
+    for (int j = i % 10; j < 10; ++j)
+      if (j != 5 || i % 10 == 5)
+        expect.push_back(j);
+    BOOST_CHECK(check_list(tv, expect));
+  }
+  iters.clear();
+
+  // Copies are independent.
+  container::iterator i = s.begin();
+  container::iterator j = i;
+  ++i;
+  BOOST_CHECK_EQUAL(*i, 0);
+  BOOST_CHECK_EQUAL(*j, -1);
+  j = i++;
+  BOOST_CHECK_EQUAL(*i, 1);
+  BOOST_CHECK_EQUAL(*j, 0);
+  i = s.end();
+  j = s.end();
+
+  // Reentrant iteration erasing the whole container: the outer one
+  // stops.
+  std::vector<int> tv;
+  foreach (int v, s)
+  {
+    tv.push_back(v);
+    for (container::iterator k = s.begin(); k != s.end(); ++k)
+      s.erase(k);
+    BOOST_CHECK(s.empty());
+    s.push_back(v);
+  }
+  BOOST_CHECK(check_list(tv, std::vector<int>(1, -1)));
+  BOOST_CHECK(check_list(s, std::vector<int>(1, -1)));
+
+  // Copy while iterating.
+  foreach (int v, s)
+  {
+    container c = s;
+    c.push_back(v);
+    s = c;
+  }
+  BOOST_CHECK(check_list(s, tolist(2, (-1, -1))));
+  s.pop_front();
+  s.pop_back();
+  BOOST_CHECK(s.empty());
+}
+
+typedef libport::SafeContainer<std::vector, boost::function0<void> >
+  callbacks_type;
+
+/// Add callbacks to \a cs, then log \a name, which is bound in our
+/// own callback.
+static void
+grow(callbacks_type& cs, const std::string& name,
+     std::vector<std::string>& log)
+{
+  for (int i = 0; i < 100; ++i)
+    cs.push_back(boost::bind(&grow, boost::ref(cs), name + "'",
+                             boost::ref(log)));
+  log.push_back(name);
+}
+
+// Vector specific: the elements do not move while iterating, even if
+// they make the container grow.
+void test_vector_callbacks()
+{
+  callbacks_type cs;
+  std::vector<std::string> log;
+  cs.push_back(boost::bind(&grow, boost::ref(cs), "a", boost::ref(log)));
+  cs.push_back(boost::bind(&grow, boost::ref(cs), "b", boost::ref(log)));
+  for (callbacks_type::iterator i = cs.begin(); i != cs.end(); ++i)
+  {
+    const boost::function0<void>& f = *i;
+    f();
+    BOOST_CHECK(&f == &*i);
+  }
+  BOOST_REQUIRE_EQUAL(log.size(), 2u);
+  BOOST_CHECK_EQUAL(log[0], "a");
+  BOOST_CHECK_EQUAL(log[1], "b");
+  BOOST_CHECK_EQUAL(cs.size(), 202u);
+
+  // The new ones follow, once the iteration is over.
+  log.clear();
+  cs.pop_front();
+  cs.pop_front();
+  (*cs.begin())();
+  BOOST_REQUIRE_EQUAL(log.size(), 1u);
+  BOOST_CHECK_EQUAL(log[0], "a'");
+  BOOST_CHECK_EQUAL(cs.size(), 300u);
+}
+
+template <template <class, class> class C>
+static libport::utime_t
+bench_iteration()
+{
+  libport::SafeContainer<C, int> s;
+  for (int i = 0; i < 100; ++i)
+    s.push_back(i);
+  int sum = 0;
+  libport::utime_t start = libport::utime();
+  for (int round = 0; round < 20000; ++round)
+    for (typename libport::SafeContainer<C, int>::iterator i = s.begin();
+         i != s.end(); ++i)
+    {
+      sum += *i;
+      if (*i == round % 100)
+      {
+        // Reentrant iteration, and removal.
+        foreach (int v, s)
+          sum -= v;
+        s.erase(i);
+        s.push_back(round % 100);
+      }
+    }
+  libport::utime_t res = libport::utime() - start;
+  BOOST_CHECK_EQUAL(sum, 20000 * (4950 - 4950));
+  return res;
+}
+
+void bench()
+{
+  libport::utime_t list = bench_iteration<std::list>();
+  libport::utime_t vector = bench_iteration<std::vector>();
+  BOOST_TEST_MESSAGE("20000 iterations on 100 elements: "
+                     << "std::list " << list << "us, "
+                     << "std::vector " << vector << "us");
+}
+
 test_suite*
 init_test_suite()
 {
@@ -319,9 +487,16 @@ init_test_suite()
   srand(seed);
   libport::program_initialize("safe-container");
   test_suite* suite = BOOST_TEST_SUITE("libport::SafeContainer test suite");
-  suite->add(BOOST_TEST_CASE(test));
-  suite->add(BOOST_TEST_CASE(test2));
-  suite->add(BOOST_TEST_CASE(test3));
-  suite->add(BOOST_TEST_CASE(test4));
+  suite->add(BOOST_TEST_CASE(test<std::list>));
+  suite->add(BOOST_TEST_CASE(test2<std::list>));
+  suite->add(BOOST_TEST_CASE(test3<std::list>));
+  suite->add(BOOST_TEST_CASE(test4<std::list>));
+  suite->add(BOOST_TEST_CASE(test<std::vector>));
+  suite->add(BOOST_TEST_CASE(test2<std::vector>));
+  suite->add(BOOST_TEST_CASE(test3<std::vector>));
+  suite->add(BOOST_TEST_CASE(test4<std::vector>));
+  suite->add(BOOST_TEST_CASE(test_vector));
+  suite->add(BOOST_TEST_CASE(test_vector_callbacks));
+  suite->add(BOOST_TEST_CASE(bench));
   return suite;
 }
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+// Cost of the histograms of libport::Statistics.  Run by "make
+// bench", not by the test suite.
+
+#include <libport/statistics.hh>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+using libport::test_suite;
+
+template <typename S>
+static libport::utime_t
+bench_add(size_t n)
+{
+  S s;
+  libport::utime_t start = libport::utime();
+  for (size_t i = 0; i < n; ++i)
+    s.add_sample(i % 100000);
+  BOOST_CHECK_EQUAL(s.size(), n);
+  return libport::utime() - start;
+}
+
+static void
+bench()
+{
+  static const size_t n = 10000000;
+  libport::utime_t plain =
+    bench_add<libport::Statistics<unsigned int> >(n);
+  libport::utime_t histogram =
+    bench_add<libport::Statistics<unsigned int, double,
+                                  libport::Histogram<> > >(n);
+  BOOST_TEST_MESSAGE(n << " samples: "
+                     << plain << "us without histogram, "
+                     << histogram << "us with");
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::statistics benchmark");
+  suite->add(BOOST_TEST_CASE(bench));
+  return suite;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2011, Gostai S.A.S.
+ * Copyright (C) 2008-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -25,9 +25,9 @@ _fabs(double d)
   return fabs(d);
 }
 
-template<typename T, typename R>
+template<typename T, typename R, typename H>
 static void
-check(const libport::Statistics<T, R>& s,
+check(const libport::Statistics<T, R, H>& s,
       size_t size, T min, T max, R mean, R variance)
 {
   BOOST_TEST_MESSAGE("Mean: " << s.mean());
@@ -56,6 +56,53 @@ check1(size_t capacity, unsigned int size,
   check(s, size, min, max, mean, variance);
 }
 
+typedef libport::Statistics<unsigned int, double, libport::Histogram<> >
+  hstat_type;
+
+static void
+add_samples(bool running)
+{
+  hstat_type s1(running ? 3 : 0);
+  hstat_type s2(running ? 3 : 0);
+  s1.add_sample(2);
+  s1.add_sample(2);
+  s2.add_sample(3);
+  s2.add_sample(4);
+  s2.add_sample(7);
+  s1.add_samples(s2);
+  if (running)
+    check(s1, 3, 3u, 7u, 4.666666666, 2.8888888888);
+  else
+    check(s1, 5, 2u, 7u, 3.6, 3.44);
+  BOOST_CHECK_EQUAL(s1.histogram().size(), s1.size());
+  BOOST_CHECK_EQUAL(s1.quantile(0.5), running ? 4 : 3);
+  BOOST_CHECK_EQUAL(s1.quantile(1), 7);
+
+  // Into non-running statistics.
+  hstat_type s3;
+  s3.add_sample(1);
+  s3.add_samples(s1);
+  BOOST_CHECK_EQUAL(s3.size(), s1.size() + 1);
+  BOOST_CHECK_EQUAL(s3.min(), 1u);
+  BOOST_CHECK_EQUAL(s3.quantile(0), 1);
+}
+
+static void
+quantiles()
+{
+  hstat_type s(100);
+  for (unsigned i = 0; i < 1000; ++i)
+    s.add_sample(i);
+  // Only the last 100 samples.
+  BOOST_CHECK_EQUAL(s.histogram().size(), 100u);
+  BOOST_CHECK_GE(s.quantile(0), 900 * 0.97);
+  BOOST_CHECK_LE(s.quantile(0), 900 * 1.03);
+  BOOST_CHECK_GE(s.quantile(0.5), 950 * 0.97);
+  BOOST_CHECK_LE(s.quantile(0.5), 950 * 1.03);
+  s.resize(0);
+  BOOST_CHECK(s.histogram().empty());
+}
+
 test_suite*
 init_test_suite()
 {
@@ -75,5 +122,9 @@ init_test_suite()
   // Running samples with non-full buffer
   TEST((check1<unsigned int>, 10, 5, 2, 7, 3, 3));
   TEST((check1<double>, 10, 5, 2, 7, 3.6, 3.44));
+
+  TEST((add_samples, true));
+  TEST((add_samples, false));
+  suite->add(BOOST_TEST_CASE(quantiles));
   return suite;
 }
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+// Throughput and latency of libport::ThreadPool.  Run by "make
+// bench", not by the test suite.
+
+#include <list>
+#include <vector>
+
+#include <libport/atomic.hh>
+#include <libport/bind.hh>
+#include <libport/foreach.hh>
+#include <libport/thread.hh>
+#include <libport/thread-pool.hh>
+#include <libport/unistd.h>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+using libport::test_suite;
+
+typedef libport::ThreadPool ThreadPool;
+
+static volatile long counter;
+
+// Reference pool: one lock around a shared queue, as ThreadPool used
+// to be implemented.
+class LockedPool
+{
+public:
+  typedef ThreadPool::TaskFunc TaskFunc;
+
+  LockedPool(size_t nThreads)
+  {
+    for (size_t i = 0; i < nThreads; ++i)
+      threads_.push_back(
+        libport::startThread(boost::bind(&LockedPool::loop, this)));
+  }
+
+  // An empty task stops a thread.
+  ~LockedPool()
+  {
+    for (size_t i = 0; i < threads_.size(); ++i)
+      queueTask(TaskFunc());
+    foreach (pthread_t t, threads_)
+      pthread_join(t, 0);
+  }
+
+  void queueTask(TaskFunc func)
+  {
+    LOCKED(lock_, queue_.push_back(func));
+    sem_++;
+  }
+
+private:
+  void loop()
+  {
+    while (true)
+    {
+      sem_--;
+      TaskFunc func;
+      {
+        libport::BlockLock bl(lock_);
+        func = queue_.front();
+        queue_.pop_front();
+      }
+      if (func.empty())
+        return;
+      func();
+    }
+  }
+
+  std::vector<pthread_t> threads_;
+  libport::Lockable lock_;
+  std::list<TaskFunc> queue_;
+  libport::Semaphore sem_;
+};
+
+static void task_inc()
+{
+  libport::atomic::increment_fetch(&counter);
+}
+
+static void task_stamp(libport::utime_t* when)
+{
+  *when = libport::utime();
+  libport::atomic::increment_fetch(&counter);
+}
+
+static void wait_counter(long val)
+{
+  while (libport::atomic::load_acquire(&counter) != val)
+    usleep(100);
+}
+
+// Time to run \a n empty tasks queued at once.
+template <typename Pool>
+static libport::utime_t bench_throughput(Pool& pool, long n)
+{
+  counter = 0;
+  libport::utime_t start = libport::utime();
+  for (long i = 0; i < n; ++i)
+    pool.queueTask(&task_inc);
+  wait_counter(n);
+  return libport::utime() - start;
+}
+
+// Mean delay between queuing a task and its start.
+template <typename Pool>
+static libport::utime_t bench_latency(Pool& pool, long n)
+{
+  counter = 0;
+  libport::utime_t total = 0;
+  for (long i = 0; i < n; ++i)
+  {
+    libport::utime_t when;
+    libport::utime_t start = libport::utime();
+    pool.queueTask(boost::bind(&task_stamp, &when));
+    wait_counter(i + 1);
+    total += when - start;
+    usleep(100);
+  }
+  return total / n;
+}
+
+static void bench()
+{
+  static const size_t nThreads = 4;
+  static const long nTasks = 100000;
+  static const long nSamples = 1000;
+  {
+    ThreadPool tp(nThreads);
+    LockedPool lp(nThreads);
+    BOOST_TEST_MESSAGE("throughput (us for " << nTasks << " tasks):"
+                       << " ThreadPool: " << bench_throughput(tp, nTasks)
+                       << " locked: " << bench_throughput(lp, nTasks));
+    BOOST_TEST_MESSAGE("latency (us):"
+                       << " ThreadPool: " << bench_latency(tp, nSamples)
+                       << " locked: " << bench_latency(lp, nSamples));
+  }
+
+  ThreadPool sp(nThreads);
+  sp.setSpin(10000);
+  sp.setMetrics(true);
+  BOOST_TEST_MESSAGE("latency with spinning (us): "
+                     << bench_latency(sp, nSamples)
+                     << ", spin hits: " << sp.metrics().spinHits);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::ThreadPool benchmark");
+  suite->add(BOOST_TEST_CASE(bench));
+  return suite;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011, Gostai S.A.S.
+ * Copyright (C) 2010-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -150,6 +150,86 @@ static void test_drop()
   BOOST_CHECK_EQUAL(h3->getState(), ThreadPool::TaskHandle::DROPPED);
 }
 
+static void task_spawn(ThreadPool* tp, int depth)
+{
+  atomic_inc32(&counter);
+  if (depth)
+    for (int i = 0; i < 2; ++i)
+      tp->queueTask(boost::bind(&task_spawn, tp, depth - 1));
+}
+
+// Tasks queued from the pool threads go through the thread deques and
+// get stolen by the idle threads.
+static void test_nested()
+{
+  ThreadPool tp(4);
+  counter = 0;
+  static const int depth = 12;
+  static const boost::uint32_t nTasks = (1 << (depth + 1)) - 1;
+  tp.queueTask(boost::bind(&task_spawn, &tp, depth));
+  boost::uint32_t val;
+  for (int i = 0; i < 20; ++i)
+  {
+    val = atomic_read32(&counter);
+    if (val == nTasks)
+      break;
+    usleep(500000);
+  }
+  BOOST_CHECK_EQUAL(nTasks, val);
+  BOOST_CHECK_EQUAL(tp.queueSize(), 0U);
+}
+
+// Pinned, spinning threads with metrics.
+static void test_policies()
+{
+  ThreadPool tp(2);
+  std::vector<ThreadPool::CpuSet> cpus(1, ThreadPool::CpuSet(1, 0));
+  tp.setAffinity(cpus);
+  tp.setSpin(1000);
+  tp.setMetrics(true);
+  counter = 0;
+  static const boost::uint32_t nTasks = 100;
+  for (boost::uint32_t i = 0; i < nTasks; ++i)
+  {
+    tp.queueTask(boost::bind(&task_sleep_inc, 100));
+    usleep(rand() % 1000);
+  }
+  for (int i = 0; i < 20 && atomic_read32(&counter) != nTasks; ++i)
+    usleep(500000);
+  BOOST_CHECK_EQUAL(atomic_read32(&counter), nTasks);
+  ThreadPool::Metrics m = tp.metrics();
+  BOOST_CHECK_EQUAL(m.queueDepth.n_samples(), nTasks);
+  BOOST_CHECK_LE(m.queueDepth.max(), long(nTasks));
+  BOOST_CHECK(m.wakeupLatency.n_samples());
+  BOOST_TEST_MESSAGE("wakeup latency: " << m.wakeupLatency.mean()
+                     << "us, p99: " << m.wakeupLatency.quantile(0.99)
+                     << "us, spin hits: " << m.spinHits
+                     << ", sleeps: " << m.sleeps);
+  tp.resetMetrics();
+  BOOST_CHECK_EQUAL(tp.metrics().queueDepth.n_samples(), 0U);
+}
+
+// The destruction waits for the queued tasks, and stops the threads.
+static void test_destroy()
+{
+  counter = 0;
+  static const boost::uint32_t nTasks = 100;
+  {
+    ThreadPool tp(4);
+    for (boost::uint32_t i = 0; i < nTasks; ++i)
+      tp.queueTask(boost::bind(&task_sleep_inc, 1000));
+  }
+  BOOST_CHECK_EQUAL(atomic_read32(&counter), nTasks);
+  // Some threads sleep, some spin.
+  {
+    ThreadPool tp(4);
+    tp.setSpin(100000);
+    tp.queueTask(boost::bind(&task_sleep_inc, 0));
+    usleep(10000);
+  }
+  BOOST_CHECK_EQUAL(atomic_read32(&counter), nTasks + 1);
+}
+
 test_suite*
 init_test_suite()
 {
@@ -165,5 +245,8 @@ init_test_suite()
   suite->add(BOOST_TEST_CASE(test_many_fast));
   suite->add(BOOST_TEST_CASE(test_lock));
   suite->add(BOOST_TEST_CASE(test_drop));
+  suite->add(BOOST_TEST_CASE(test_nested));
+  suite->add(BOOST_TEST_CASE(test_policies));
+  suite->add(BOOST_TEST_CASE(test_destroy));
   return suite;
 }
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <sstream>
+
+#include <boost/thread.hpp>
+
+#include <libport/trace.hh>
+#include <libport/unit-test.hh>
+#include <libport/utime.hh>
+
+using libport::test_suite;
+
+static size_t
+count(const std::string& s, const std::string& what)
+{
+  size_t res = 0;
+  for (size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1))
+    ++res;
+  return res;
+}
+
+static std::string
+dump()
+{
+  std::ostringstream o;
+  libport::trace_dump(o);
+  return o.str();
+}
+
+static void
+probe()
+{
+  LIBPORT_TRACE_SCOPE("probe");
+}
+
+static void
+test_disabled()
+{
+  libport::trace_clear();
+  BOOST_CHECK(!libport::trace_enabled());
+  for (int i = 0; i < 10; ++i)
+    probe();
+  BOOST_CHECK_EQUAL(libport::trace_size(), 0u);
+}
+
+static void
+test_scopes()
+{
+  libport::trace_clear();
+  libport::trace_enable();
+  BOOST_CHECK(libport::trace_enabled());
+  {
+    LIBPORT_TRACE_SCOPE("outer");
+    probe();
+    probe();
+  }
+  // Not recorded: it started while disabled.
+  {
+    libport::trace_enable(false);
+    LIBPORT_TRACE_SCOPE("late");
+    libport::trace_enable();
+  }
+  libport::trace_enable(false);
+  BOOST_CHECK_EQUAL(libport::trace_size(), 3u);
+
+  std::string s = dump();
+  BOOST_TEST_MESSAGE(s);
+  BOOST_CHECK_EQUAL(s.find("{\"traceEvents\":["), 0u);
+  BOOST_CHECK_EQUAL(count(s, "\"name\":\"probe\",\"ph\":\"X\""), 2u);
+  BOOST_CHECK_EQUAL(count(s, "\"name\":\"outer\",\"ph\":\"X\""), 1u);
+  BOOST_CHECK_EQUAL(count(s, "\"late\""), 0u);
+  BOOST_CHECK_EQUAL(count(s, "\"args\":{\"context\""), 0u);
+  // The inner scopes end first.
+  BOOST_CHECK_LT(s.find("\"probe\""), s.find("\"outer\""));
+}
+
+static void
+test_context()
+{
+  libport::trace_clear();
+  libport::trace_enable();
+  int context;
+  libport::trace_context_set(&context);
+  probe();
+  libport::trace_context_set(0);
+  probe();
+  libport::trace_enable(false);
+
+  std::ostringstream expected;
+  expected << "\"args\":{\"context\":\"" << &context << "\"}";
+  std::string s = dump();
+  BOOST_CHECK_EQUAL(count(s, "\"args\":{\"context\""), 1u);
+  BOOST_CHECK_EQUAL(count(s, expected.str()), 1u);
+}
+
+static void
+probes(unsigned n)
+{
+  for (unsigned i = 0; i < n; ++i)
+    probe();
+}
+
+/// Record \a n probes, and wait for the other threads to do so, so
+/// that they do not reuse our ring.
+static void
+probes_together(unsigned n, boost::barrier* b)
+{
+  probes(n);
+  b->wait();
+}
+
+static void
+test_threads()
+{
+  libport::trace_clear();
+  libport::trace_enable();
+  boost::barrier b(2);
+  boost::thread t1(boost::bind(&probes_together, 10, &b));
+  boost::thread t2(boost::bind(&probes_together, 20, &b));
+  t1.join();
+  t2.join();
+  libport::trace_enable(false);
+  BOOST_CHECK_EQUAL(libport::trace_size(), 30u);
+  // One track per thread recording at the same time.
+  std::string s = dump();
+  BOOST_CHECK_GE(count(s, "\"thread_name\""), 3u);
+}
+
+// The rings of the threads are reused once they exit.
+static void
+test_reuse()
+{
+  libport::trace_clear();
+  libport::trace_enable();
+  size_t rings = count(dump(), "\"thread_name\"");
+  for (int i = 0; i < 10; ++i)
+  {
+    boost::thread t(boost::bind(&probes, 1));
+    t.join();
+  }
+  libport::trace_enable(false);
+  BOOST_CHECK_EQUAL(libport::trace_size(), 10u);
+  BOOST_CHECK_LE(count(dump(), "\"thread_name\""), rings + 1);
+}
+
+static void
+test_overwrite()
+{
+  libport::trace_clear();
+  libport::trace_enable();
+  probes(libport::trace_ring_size + 10);
+  libport::trace_enable(false);
+  BOOST_CHECK_EQUAL(libport::trace_size(), size_t(libport::trace_ring_size));
+  BOOST_CHECK_EQUAL(count(dump(), "\"probe\""),
+                    size_t(libport::trace_ring_size));
+  libport::trace_clear();
+  BOOST_CHECK_EQUAL(libport::trace_size(), 0u);
+}
+
+/*-------------.
+| Benchmarks.  |
+`-------------*/
+
+static libport::utime_t
+bench_probes(unsigned n)
+{
+  libport::utime_t start = libport::utime();
+  probes(n);
+  return libport::utime() - start;
+}
+
+static void
+bench()
+{
+  static const unsigned n = 1000000;
+  libport::trace_clear();
+  libport::utime_t disabled = bench_probes(n);
+  libport::trace_enable();
+  libport::utime_t enabled = bench_probes(n);
+  libport::trace_enable(false);
+  libport::trace_clear();
+  BOOST_TEST_MESSAGE("disabled probe: " << disabled * 1000.0 / n << "ns");
+  BOOST_TEST_MESSAGE("enabled probe: " << enabled * 1000.0 / n << "ns");
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("libport::trace");
+  suite->add(BOOST_TEST_CASE(test_disabled));
+  suite->add(BOOST_TEST_CASE(test_scopes));
+  suite->add(BOOST_TEST_CASE(test_context));
+  suite->add(BOOST_TEST_CASE(test_threads));
+  suite->add(BOOST_TEST_CASE(test_reuse));
+  suite->add(BOOST_TEST_CASE(test_overwrite));
+  suite->add(BOOST_TEST_CASE(bench));
+  return suite;
+}
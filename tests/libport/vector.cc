@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2011, Gostai S.A.S.
+ * Copyright (C) 2011-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -8,9 +8,12 @@
  * See the LICENSE file for more information.
  */
 
+#include <vector>
+
 #include <libport/foreach.hh>
 #include <libport/vector.hh>
 #include <libport/unit-test.hh>
+#include <libport/utime.hh>
 
 using libport::test_suite;
 
@@ -62,6 +65,44 @@ class Content
 };
 int Content::count = 0;
 
+/// Policies which know nothing about bitwise moves.
+class LegacyAllocator
+{
+  public:
+    Content* allocate(unsigned count)
+    {
+      return allocator_.allocate(count);
+    }
+
+    void deallocate(void* p, unsigned count)
+    {
+      allocator_.deallocate(p, count);
+    }
+
+    Content* grow(void* p, unsigned count)
+    {
+      return allocator_.grow(p, count);
+    }
+
+    Content* shrink(void* p, unsigned count)
+    {
+      return allocator_.shrink(p, count);
+    }
+
+  private:
+    libport::Allocator<Content> allocator_;
+};
+
+class LegacyConstructor: private libport::Constructor<Content, true>
+{
+  public:
+    typedef libport::Constructor<Content, true> super_type;
+    using super_type::construct;
+    using super_type::destroy;
+    using super_type::move;
+    using super_type::rmove;
+};
+
 TEMPLATE
 static void test_push_back()
 {
@@ -266,6 +307,64 @@ static void test_erase()
   T::after();
 }
 
+/*------------.
+| Benchmark.  |
+`------------*/
+
+typedef libport::Vector<int> Relocating;
+typedef libport::Vector<int,
+                        libport::Allocator<int>,
+                        libport::Constructor<int, false> > Copying;
+
+template <typename Vector>
+static libport::utime_t
+bench_push_back(unsigned n)
+{
+  libport::utime_t start = libport::utime();
+  {
+    Vector v;
+    for (unsigned i = 0; i < n; ++i)
+      v.push_back(i);
+    BOOST_CHECK_EQUAL(v.size(), n);
+  }
+  return libport::utime() - start;
+}
+
+template <typename Vector>
+static libport::utime_t
+bench_insert_erase(unsigned n)
+{
+  libport::utime_t start = libport::utime();
+  Vector v;
+  for (unsigned i = 0; i < n; ++i)
+    v.insert(v.begin() + v.size() / 2, i);
+  while (!v.empty())
+    v.erase(v.begin() + v.size() / 2);
+  return libport::utime() - start;
+}
+
+#define BENCH(Name, N)                                                  \
+  do {                                                                  \
+    libport::utime_t relocating = bench_##Name<Relocating>(N);          \
+    libport::utime_t copying = bench_##Name<Copying>(N);                \
+    libport::utime_t standard = bench_##Name<std::vector<int> >(N);     \
+    BOOST_TEST_MESSAGE(#Name " (" << N << "): "                         \
+                       << "relocating " << relocating                   \
+                       << "us, copying " << copying                     \
+                       << "us, std::vector " << standard << "us");      \
+  } while (false)
+
+static void
+test_bench()
+{
+  BOOST_CHECK(libport::traits::IsTriviallyRelocatable<int>::res);
+  BOOST_CHECK(!libport::traits::IsTriviallyRelocatable<Content>::res);
+  BENCH(push_back, 1000000);
+  BENCH(insert_erase, 20000);
+}
+
+#undef BENCH
+
 test_suite*
 init_test_suite()
 {
@@ -303,6 +402,8 @@ init_test_suite()
     TEST_ITERS(Name, A, Ctor, Cap, 129);
 
   typedef libport::FlooredAllocator<Content, 8> FlooredAllocator;
+  // Content does not depend on its address, check the bitwise moves.
+  typedef libport::Constructor<Content, true> Relocator;
 
 #define TEST(Name)                                              \
   TEST_POLICIES(Name,                                           \
@@ -317,6 +418,22 @@ init_test_suite()
                 FlooredAllocator,                               \
                 libport::Constructor<Content>,                  \
                 libport::FlooredExponentialCapacity<8>);        \
+  TEST_POLICIES(Name,                                           \
+                libport::Allocator<Content>,                    \
+                Relocator,                                      \
+                libport::ExponentialCapacity);                  \
+  TEST_POLICIES(Name,                                           \
+                FlooredAllocator,                               \
+                Relocator,                                      \
+                libport::FlooredExponentialCapacity<8>);        \
+  TEST_POLICIES(Name,                                           \
+                LegacyAllocator,                                \
+                Relocator,                                      \
+                libport::ExponentialCapacity);                  \
+  TEST_POLICIES(Name,                                           \
+                libport::Allocator<Content>,                    \
+                LegacyConstructor,                              \
+                libport::ExponentialCapacity);                  \
 
     TEST(push_back);
     TEST(push_back_pop_back);
@@ -326,5 +443,6 @@ init_test_suite()
     TEST(push_front_pop_front);
     TEST(insert);
     TEST(erase);
+    suite->add(BOOST_TEST_CASE(test_bench));
     return suite;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2011, Gostai S.A.S.
+ * Copyright (C) 2009-2012, Gostai S.A.S.
  *
  * This software is provided "as is" without warranty of any kind,
  * either expressed or implied, including but not limited to the
@@ -9,9 +9,16 @@
  */
 
 #include <libport/config.h>
+#include <libport/thread-pool.hh>
 #include <libport/xltdl.hh>
 #include "test.hh"
 
+#if defined __linux__
+# include <fstream>
+# include <link.h>
+# include <boost/filesystem.hpp>
+#endif
+
 using libport::test_suite;
 
 using libport::xlt_advise;
@@ -63,10 +70,108 @@ check()
   BOOST_CHECK_NO_THROW(h.close());
 }
 
+#if defined __linux__
+/// The file of the loaded library whose name starts with \a prefix.
+static int
+find_loaded(struct dl_phdr_info* info, size_t, void* data)
+{
+  std::pair<std::string, std::string>& p =
+    *static_cast<std::pair<std::string, std::string>*>(data);
+  std::string name = info->dlpi_name;
+  if (name.find("/" + p.first) != name.npos)
+    p.second = name;
+  return 0;
+}
+
+static std::string
+loaded(const std::string& prefix)
+{
+  std::pair<std::string, std::string> res(prefix, "");
+  dl_iterate_phdr(find_loaded, &res);
+  return res.second;
+}
+#endif
+
+static void
+check_open_all()
+{
+#if defined __linux__
+  // libstdc++ needs libm, use links to them.
+  namespace fs = boost::filesystem;
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directory(dir);
+  fs::create_symlink(loaded("libstdc++.so"), dir / "cxx.so");
+  fs::create_symlink(loaded("libm.so"), dir / "m.so");
+
+  xlt_advise a;
+  a.path().push_back(dir.string());
+  std::vector<std::string> names;
+  names.push_back("cxx");
+  names.push_back("m");
+  // The pool has no destructor.
+  libport::ThreadPool& pool = *new libport::ThreadPool(2);
+  std::vector<libport::xlt_library> libs = a.open_all(names, pool);
+
+  BOOST_REQUIRE_EQUAL(libs.size(), 2u);
+  BOOST_CHECK_EQUAL(libs[0].name, "m");
+  BOOST_CHECK_EQUAL(libs[0].file, (dir / "m.so").string());
+  BOOST_CHECK_EQUAL(libs[1].name, "cxx");
+  foreach (const libport::xlt_library& l, libs)
+  {
+    BOOST_CHECK(l.handle.handle);
+    BOOST_TEST_MESSAGE(l.name << ": read " << l.read_time << "us, "
+                       << "open " << l.open_time << "us");
+  }
+
+  names.push_back("missing");
+  BOOST_CHECK_THROW(a.open_all(names, pool), xlt_advise::exception);
+
+  // Invalid libraries are reported as open does.
+  std::ofstream((dir / "bad.so").string().c_str()) << "not a library";
+  names.clear();
+  names.push_back("bad");
+  std::string open_error;
+  try
+  {
+    a.open("bad");
+  }
+  catch (const xlt_advise::exception& e)
+  {
+    open_error = e.what();
+  }
+  BOOST_CHECK_NE(open_error, "");
+  try
+  {
+    a.open_all(names, pool);
+    BOOST_ERROR("open_all did not throw");
+  }
+  catch (const xlt_advise::exception& e)
+  {
+    BOOST_CHECK_EQUAL(e.what(), open_error);
+  }
+
+  // As open, try the next directories.
+  fs::path next = dir / "next";
+  fs::create_directory(next);
+  std::ofstream((dir / "fallback.so").string().c_str()) << "not a library";
+  fs::create_symlink(loaded("libm.so"), next / "fallback.so");
+  a.path().push_back(next.string());
+  BOOST_CHECK(a.open("fallback").handle);
+  names.clear();
+  names.push_back("fallback");
+  libs = a.open_all(names, pool);
+  BOOST_REQUIRE_EQUAL(libs.size(), 1u);
+  BOOST_CHECK(libs[0].handle.handle);
+  BOOST_CHECK_EQUAL(libs[0].file, (next / "fallback.so").string());
+  fs::remove_all(dir);
+#endif
+}
+
 test_suite*
 init_test_suite()
 {
   test_suite* suite = BOOST_TEST_SUITE("libport::xltdl test suite");
   suite->add(BOOST_TEST_CASE(check));
+  suite->add(BOOST_TEST_CASE(check_open_all));
   return suite;
 }
@@ -54,7 +54,7 @@ endif
 ## Bench suite.  ##
 ## ------------- ##
 
-BENCHES = tests/libport/utime.cc
+BENCHES = tests/libport/utime.cc $(BENCHES_BINARIES)
 BENCH_LOGS = $(BENCHES:.cc=.bench)
 AM_BENCHFLAGS = --hook-module=$(BENCH_MALLOC_HOOK) --format=xls
 include $(top_srcdir)/build-aux/make/bench.mk
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <libport/csignal>
+#include <libport/unistd.h>
+
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+/// What is written on \a fd while running \a f.
+static std::string
+output(int fd, const boost::function0<void>& f)
+{
+  int fds[2];
+  BOOST_REQUIRE(!pipe(fds));
+  int saved = dup(fd);
+  dup2(fds[1], fd);
+  close(fds[1]);
+  f();
+  dup2(saved, fd);
+  close(saved);
+  std::string res;
+  char buf[1024];
+  for (ssize_t n; 0 < (n = read(fds[0], buf, sizeof buf)); )
+    res.append(buf, n);
+  close(fds[0]);
+  return res;
+}
+
+static size_t
+count(const std::string& s, const std::string& what)
+{
+  size_t res = 0;
+  for (size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1))
+    ++res;
+  return res;
+}
+
+static void
+yielding(TestJob& job, unsigned n)
+{
+  for (unsigned i = 0; i < n; ++i)
+    job.yield();
+}
+
+static std::string dumped;
+static const void* dumper;
+
+static void
+dumping(TestJob& job)
+{
+  dumper = &job;
+  dumped = output(STDERR_FILENO,
+                  boost::bind(&sched::Scheduler::dump_backtraces,
+                              &job.scheduler_get(), STDERR_FILENO));
+}
+
+static void
+test_capture()
+{
+  sched::Scheduler s(&test_time);
+  sched::rJob job = new TestJob(s, boost::bind(&yielding, _1, 3));
+  sched::jobs_type jobs;
+  jobs.push_back(job);
+
+  // Off by default.
+  BOOST_CHECK(!s.capture_backtraces_get());
+  run_jobs(s, jobs);
+  BOOST_CHECK(job->backtrace_get().empty());
+
+  s.capture_backtraces_set(true);
+  job = new TestJob(s, boost::bind(&yielding, _1, 3));
+  jobs.clear();
+  jobs.push_back(job);
+  run_jobs(s, jobs);
+  BOOST_CHECK(!job->backtrace_get().empty());
+  BOOST_CHECK_EQUAL(job->backtrace_get().symbolize().size(),
+                    job->backtrace_get().size());
+}
+
+static void
+test_dump()
+{
+  static const unsigned n = 10;
+  sched::Scheduler s(&test_time);
+  s.capture_backtraces_set(true);
+  sched::jobs_type jobs;
+  for (unsigned i = 0; i < n; ++i)
+    jobs.push_back(new TestJob(s, boost::bind(&yielding, _1, 3)));
+  jobs.push_back(new TestJob(s, &dumping));
+  dumped.clear();
+  run_jobs(s, jobs);
+
+  // The current job first, and the others, maybe not started yet.
+  BOOST_CHECK_EQUAL(count(dumped, "job 0x"), n + 1);
+  std::ostringstream current;
+  current << "job " << dumper << ": running\n  0x";
+  BOOST_CHECK_EQUAL(dumped.find(current.str()), 0u);
+  BOOST_CHECK_GE(count(dumped, "\n  0x"), n);
+}
+
+#ifndef WIN32
+static void
+raise_usr1()
+{
+  raise(SIGUSR1);
+}
+
+static void
+test_signal()
+{
+  sched::Scheduler s(&test_time);
+  s.capture_backtraces_set(true);
+  sched::rJob job = new TestJob(s, boost::bind(&yielding, _1, 1));
+  job->start_job();
+  s.work();
+  s.dump_backtraces_on(SIGUSR1);
+
+  // Outside of the jobs, only their captured stacks are dumped.
+  std::string out = output(STDERR_FILENO, &raise_usr1);
+  BOOST_CHECK_EQUAL(count(out, "job 0x"), 1u);
+  BOOST_CHECK_EQUAL(count(out, "  0x"), job->backtrace_get().size());
+
+  libport::signal(SIGUSR1, SIG_DFL);
+  while (!job->terminated())
+    s.work();
+  s.work();
+}
+#endif
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched::Job backtraces");
+  suite->add(BOOST_TEST_CASE(test_capture));
+  suite->add(BOOST_TEST_CASE(test_dump));
+#ifndef WIN32
+  suite->add(BOOST_TEST_CASE(test_signal));
+#endif
+  return suite;
+}
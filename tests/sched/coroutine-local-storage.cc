@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <sched/coroutine-local-storage.hh>
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+// Stored inline.
+static sched::CoroutineLocalStorage<int> number;
+// Allocated.
+static sched::CoroutineLocalStorage<std::string> name;
+
+static unsigned checked;
+
+static void
+values(TestJob& job, int n)
+{
+  *number = n;
+  *name = std::string(n, 'x');
+  for (int i = 0; i < 10; ++i)
+  {
+    job.yield();
+    BOOST_CHECK_EQUAL(*number, n);
+    BOOST_CHECK_EQUAL(name->size(), size_t(n));
+  }
+  ++checked;
+}
+
+static void
+test_values()
+{
+  sched::Scheduler s(&test_time);
+  *number = -1;
+  *name = "main";
+  checked = 0;
+  sched::jobs_type jobs;
+  for (int i = 0; i < 5; ++i)
+    jobs.push_back(new TestJob(s, boost::bind(&values, _1, i)));
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(checked, 5u);
+  BOOST_CHECK_EQUAL(*number, -1);
+  BOOST_CHECK_EQUAL(*name, "main");
+}
+
+struct Counted
+{
+  Counted()
+  {
+    ++alive;
+  }
+
+  ~Counted()
+  {
+    --alive;
+  }
+
+  static int alive;
+};
+
+int Counted::alive = 0;
+
+static sched::CoroutineLocalStorage<Counted> counted;
+
+static void
+count(TestJob&)
+{
+  counted.get();
+  BOOST_CHECK_EQUAL(Counted::alive, 1);
+}
+
+static void
+test_destroy()
+{
+  {
+    sched::Scheduler s(&test_time);
+    sched::jobs_type jobs;
+    jobs.push_back(new TestJob(s, &count));
+    run_jobs(s, jobs);
+    jobs.clear();
+    // The value went away with the coroutine.
+    BOOST_CHECK_EQUAL(Counted::alive, 0);
+  }
+
+  {
+    sched::CoroutineLocalStorage<Counted> local;
+    local.get();
+    BOOST_CHECK_EQUAL(Counted::alive, 1);
+  }
+  // The value went away with the storage.
+  BOOST_CHECK_EQUAL(Counted::alive, 0);
+}
+
+static void
+test_bench()
+{
+  static const unsigned n = 10000000;
+  *number = 0;
+  libport::utime_t start = libport::utime();
+  for (unsigned i = 0; i < n; ++i)
+    ++*number;
+  libport::utime_t elapsed = libport::utime() - start;
+  BOOST_CHECK_EQUAL(*number, int(n));
+  BOOST_TEST_MESSAGE(elapsed * 1000. / n << "ns per access");
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite =
+    BOOST_TEST_SUITE("sched::CoroutineLocalStorage test suite");
+  suite->add(BOOST_TEST_CASE(test_values));
+  suite->add(BOOST_TEST_CASE(test_destroy));
+  suite->add(BOOST_TEST_CASE(test_bench));
+  return suite;
+}
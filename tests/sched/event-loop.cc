@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/write.hpp>
+
+#include <libport/thread.hh>
+#include <libport/unistd.h>
+
+#include <sched/event-loop.hh>
+#include <sched/wait-queue.hh>
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+static sched::EventLoop* current;
+static bool finished;
+
+/// Called by the tested job when it is done.
+static void
+finish()
+{
+  finished = true;
+  current->stop();
+}
+
+/// Start \a job and run \a loop until it is done.
+/// \return the number of rounds.
+static unsigned
+run_loop(sched::EventLoop& loop, const sched::rJob& job)
+{
+  current = &loop;
+  finished = false;
+  job->start_job();
+  unsigned res = 0;
+  while (!finished)
+  {
+    loop.run_once();
+    ++res;
+  }
+  // Release the terminated job.
+  loop.scheduler_get().work();
+  return res;
+}
+
+static const libport::utime_t delay = 20000;
+
+/*--------.
+| Sleep.  |
+`--------*/
+
+static void
+sleeper(TestJob& job)
+{
+  job.yield_for(delay);
+  finish();
+}
+
+static void
+test_sleep()
+{
+  boost::asio::io_service io;
+  sched::Scheduler s(&test_time);
+  sched::EventLoop loop(s, io);
+  libport::utime_t start = libport::utime();
+  unsigned rounds = run_loop(loop, new TestJob(s, &sleeper));
+  BOOST_CHECK_LE(delay, libport::utime() - start);
+  // No busy rounds while sleeping.
+  BOOST_CHECK_LE(rounds, 4u);
+}
+
+/*---------.
+| Socket.  |
+`---------*/
+
+typedef boost::asio::local::stream_protocol::socket socket_type;
+
+static sched::Event readable;
+static libport::utime_t sent;
+static libport::utime_t latency;
+
+static void
+on_read(const boost::system::error_code& e, size_t n)
+{
+  BOOST_CHECK(!e);
+  BOOST_CHECK_EQUAL(n, 1u);
+  // Run in the scheduler thread, no need for a Waker.
+  readable.set();
+}
+
+static void
+reader(TestJob& job)
+{
+  readable.wait(job);
+  latency = libport::utime() - sent;
+  finish();
+}
+
+static void
+writer(socket_type* socket)
+{
+  usleep(delay);
+  sent = libport::utime();
+  boost::asio::write(*socket, boost::asio::buffer("x", 1));
+}
+
+static void
+test_socket()
+{
+  boost::asio::io_service io;
+  socket_type in(io);
+  socket_type out(io);
+  boost::asio::local::connect_pair(in, out);
+  char c;
+  in.async_read_some(boost::asio::buffer(&c, 1), &on_read);
+
+  sched::Scheduler s(&test_time);
+  sched::EventLoop loop(s, io);
+  readable.reset();
+  pthread_t t =
+    libport::startThread(boost::function0<void>(boost::bind(&writer, &out)));
+  unsigned rounds = run_loop(loop, new TestJob(s, &reader));
+  pthread_join(t, 0);
+  BOOST_CHECK_LE(rounds, 4u);
+  BOOST_TEST_MESSAGE("socket to job: " << latency << "us in "
+                     << rounds << " rounds");
+}
+
+/*---------.
+| Remote.  |
+`---------*/
+
+static sched::rWaker waker;
+static volatile bool woken;
+
+static void
+remote()
+{
+  usleep(delay);
+  sent = libport::utime();
+  woken = true;
+  waker->wake_up();
+}
+
+static void
+remote_waiter(TestJob& job)
+{
+  waker = job.scheduler_get().waker_make(job);
+  woken = false;
+  pthread_t t = libport::startThread(boost::function0<void>(&remote));
+  while (!woken)
+    job.yield_until_woken_up();
+  latency = libport::utime() - sent;
+  waker->cancel();
+  waker = 0;
+  pthread_join(t, 0);
+  finish();
+}
+
+static void
+test_remote()
+{
+  boost::asio::io_service io;
+  sched::Scheduler s(&test_time);
+  sched::EventLoop loop(s, io);
+  unsigned rounds = run_loop(loop, new TestJob(s, &remote_waiter));
+  BOOST_CHECK_LE(rounds, 4u);
+  BOOST_TEST_MESSAGE("thread to job: " << latency << "us in "
+                     << rounds << " rounds");
+}
+
+/*-------.
+| Stop.  |
+`-------*/
+
+static void
+stopper(sched::EventLoop* loop)
+{
+  usleep(delay);
+  loop->stop();
+}
+
+static void
+test_stop()
+{
+  boost::asio::io_service io;
+  sched::Scheduler s(&test_time);
+  sched::EventLoop loop(s, io);
+  pthread_t t =
+    libport::startThread(boost::function0<void>(boost::bind(&stopper,
+                                                            &loop)));
+  libport::utime_t start = libport::utime();
+  loop.run();
+  BOOST_CHECK_LE(delay, libport::utime() - start);
+  pthread_join(t, 0);
+}
+
+static void
+test_stop_early()
+{
+  boost::asio::io_service io;
+  sched::Scheduler s(&test_time);
+  sched::EventLoop loop(s, io);
+  // Not lost if run() is not running yet.
+  loop.stop();
+  loop.run();
+  // Nor is the stopping of the io_service, which is then restarted.
+  io.stop();
+  loop.run();
+  BOOST_CHECK(!io.stopped());
+  run_loop(loop, new TestJob(s, &sleeper));
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched::EventLoop test suite");
+  suite->add(BOOST_TEST_CASE(test_sleep));
+  suite->add(BOOST_TEST_CASE(test_socket));
+  suite->add(BOOST_TEST_CASE(test_remote));
+  suite->add(BOOST_TEST_CASE(test_stop));
+  suite->add(BOOST_TEST_CASE(test_stop_early));
+  return suite;
+}
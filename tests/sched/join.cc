@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <set>
+
+#include <libport/containers.hh>
+
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+struct TestException: public sched::SchedulerException
+{
+  COMPLETE_EXCEPTION(TestException)
+};
+
+static void
+yielding(TestJob& job, unsigned n, bool fail)
+{
+  for (unsigned i = 0; i < n; ++i)
+    job.yield();
+  if (fail)
+    throw TestException();
+}
+
+static const unsigned n_children = 100;
+
+/// Spawn \a n children of \a parent, the i-th one yielding \a i times,
+/// the ones whose index is in \a failing throw afterwards.
+static void
+spawn(TestJob& parent, sched::Job::Collector& children, unsigned n,
+      const std::set<unsigned>& failing = std::set<unsigned>())
+{
+  for (unsigned i = 0; i < n; ++i)
+  {
+    sched::rJob child =
+      new TestJob(parent.scheduler_get(),
+                  boost::bind(&yielding, _1, i, libport::has(failing, i)));
+    parent.register_child(child, children);
+    child->start_job();
+  }
+}
+
+/*-----------.
+| Join all.  |
+`-----------*/
+
+static unsigned resumed;
+static unsigned terminated;
+
+static void
+join_all(TestJob& job)
+{
+  sched::Job::Collector children(&job);
+  spawn(job, children, n_children);
+  unsigned before = job.resumed();
+  job.yield_until_terminated(children);
+  resumed = job.resumed() - before;
+  foreach (const sched::rJob& child, children)
+    terminated += child->terminated();
+}
+
+static void
+test_join_all()
+{
+  sched::Scheduler s(&test_time);
+  resumed = terminated = 0;
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &join_all));
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(terminated, n_children);
+  // Suspended once, rather than once per child.
+  BOOST_CHECK_EQUAL(resumed, 1u);
+}
+
+/*-----------.
+| Join any.  |
+`-----------*/
+
+static sched::rJob first;
+
+static void
+join_any(TestJob& job)
+{
+  sched::Job::Collector children(&job);
+  // The first child does not yield.
+  spawn(job, children, 10);
+  children.reverse();
+  first = job.yield_until_any_terminated(children);
+  terminated = 0;
+  foreach (const sched::rJob& child, children)
+    terminated += child->terminated();
+  job.yield_until_terminated(children);
+}
+
+static void
+test_join_any()
+{
+  sched::Scheduler s(&test_time);
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &join_any));
+  run_jobs(s, jobs);
+  BOOST_REQUIRE(first);
+  BOOST_CHECK(first->terminated());
+  // The others are still running.
+  BOOST_CHECK_LT(terminated, 3u);
+  first = 0;
+}
+
+static size_t caught;
+
+static void
+join_any_terminated(TestJob& job)
+{
+  sched::Job::Collector children(&job);
+  sched::rJob done =
+    new TestJob(job.scheduler_get(), boost::bind(&yielding, _1, 0, false));
+  job.register_child(done, children);
+  done->start_job();
+  while (!done->terminated())
+    job.yield();
+  sched::rJob failing =
+    new TestJob(job.scheduler_get(), boost::bind(&yielding, _1, 5, true));
+  job.register_child(failing, children);
+  failing->start_job();
+
+  // The terminated job comes after a running one.
+  sched::jobs_type jobs;
+  jobs.push_back(failing);
+  jobs.push_back(done);
+  first = job.yield_until_any_terminated(jobs);
+
+  // The first join left no trace: this one gets the exception.
+  jobs.pop_back();
+  try
+  {
+    job.yield_until_terminated(jobs);
+  }
+  catch (const sched::ChildException&)
+  {
+    caught = 1;
+  }
+}
+
+static void
+test_join_any_terminated()
+{
+  sched::Scheduler s(&test_time);
+  caught = 0;
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &join_any_terminated));
+  run_jobs(s, jobs);
+  BOOST_REQUIRE(first);
+  BOOST_CHECK(first->terminated());
+  BOOST_CHECK_EQUAL(caught, 1u);
+  first = 0;
+}
+
+/*-------------.
+| Exceptions.  |
+`-------------*/
+
+static void
+join_failing(TestJob& job, std::set<unsigned> failing)
+{
+  sched::Job::Collector children(&job);
+  spawn(job, children, 10, failing);
+  try
+  {
+    job.yield_until_terminated(children);
+  }
+  catch (const sched::ChildException& e)
+  {
+    caught = 1;
+    BOOST_CHECK_THROW(e.rethrow_child_exception(), TestException);
+  }
+  catch (const sched::ChildrenException& e)
+  {
+    caught = e.exceptions_get().size();
+    foreach (const boost::shared_ptr<sched::exception>& c,
+             e.exceptions_get())
+      BOOST_CHECK_THROW(c->rethrow(), TestException);
+  }
+  // All the children are done, none interrupted the join.
+  terminated = 0;
+  foreach (const sched::rJob& child, children)
+    terminated += child->terminated();
+}
+
+static void
+test_exceptions()
+{
+  std::set<unsigned> failing;
+  failing.insert(3);
+  for (size_t n = 1; n <= 3; n += 2)
+  {
+    sched::Scheduler s(&test_time);
+    caught = 0;
+    sched::jobs_type jobs;
+    jobs.push_back(new TestJob(s, boost::bind(&join_failing, _1, failing)));
+    run_jobs(s, jobs);
+    BOOST_CHECK_EQUAL(caught, n);
+    BOOST_CHECK_EQUAL(terminated, 10u);
+    failing.insert(5);
+    failing.insert(9);
+  }
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched::Job join test suite");
+  suite->add(BOOST_TEST_CASE(test_join_all));
+  suite->add(BOOST_TEST_CASE(test_join_any));
+  suite->add(BOOST_TEST_CASE(test_join_any_terminated));
+  suite->add(BOOST_TEST_CASE(test_exceptions));
+  return suite;
+}
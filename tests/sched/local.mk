@@ -1,4 +1,4 @@
-## Copyright (C) 2009-2011, Gostai S.A.S.
+## Copyright (C) 2009-2012, Gostai S.A.S.
 ##
 ## This software is provided "as is" without warranty of any kind,
 ## either expressed or implied, including but not limited to the
@@ -10,20 +10,59 @@ if ! SCHED_CORO_OSTHREAD
 ## This test is directly checking the coroutine interface, not
 ## the sched interface.
 TESTS_BINARIES +=				\
+  tests/sched/backtrace.cc			\
+  tests/sched/coroutine-local-storage.cc	\
   tests/sched/debug.cc				\
+  tests/sched/event-loop.cc			\
+  tests/sched/join.cc				\
   tests/sched/sched-except.cc			\
   tests/sched/sched.cc				\
-  tests/sched/thread-coro.cc
+  tests/sched/thread-coro.cc			\
+  tests/sched/thread-pool.cc			\
+  tests/sched/trace.cc				\
+  tests/sched/wait-queue.cc
 endif
 
+## Measures whichever coroutine backend is configured, os threads
+## included.
+TESTS_BINARIES +=				\
+  tests/sched/switch-bench.cc
+
+tests_sched_backtrace_SOURCES = tests/sched/backtrace.cc
+tests_sched_backtrace_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+tests_sched_coroutine_local_storage_SOURCES = tests/sched/coroutine-local-storage.cc
+tests_sched_coroutine_local_storage_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
 tests_sched_debug_SOURCES = tests/sched/debug.cc
 tests_sched_debug_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
 
+tests_sched_event_loop_SOURCES = tests/sched/event-loop.cc
+tests_sched_event_loop_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+tests_sched_join_SOURCES = tests/sched/join.cc
+tests_sched_join_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
 tests_sched_sched_SOURCES = tests/sched/sched.cc
 tests_sched_sched_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
 
 tests_sched_sched_except_SOURCES = tests/sched/sched-except.cc
 tests_sched_sched_except_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
 
+tests_sched_switch_bench_SOURCES = tests/sched/switch-bench.cc
+tests_sched_switch_bench_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
 tests_sched_thread_coro_SOURCES = tests/sched/thread-coro.cc
 tests_sched_thread_coro_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+tests_sched_thread_pool_SOURCES = tests/sched/thread-pool.cc
+tests_sched_thread_pool_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+tests_sched_trace_SOURCES = tests/sched/trace.cc
+tests_sched_trace_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+tests_sched_wait_queue_SOURCES = tests/sched/wait-queue.cc
+tests_sched_wait_queue_LDFLAGS = $(SCHED_LIBS) $(AM_LDFLAGS)
+
+EXTRA_DIST +=					\
+  tests/sched/test-job.hh
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+// Cost of the coroutine backend selected at configuration time, so
+// that the backends can be compared build against build.
+
+#include <sched/coroutine.hh>
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+static double
+ns_per(libport::utime_t elapsed, unsigned n)
+{
+  return elapsed * 1000. / n;
+}
+
+/*----------------------.
+| coroutine_switch_to.  |
+`----------------------*/
+
+static Coro* main_coro;
+static Coro* bouncer_coro;
+static unsigned bounces;
+
+static void
+bouncer(void*)
+{
+  while (true)
+  {
+    ++bounces;
+    coroutine_switch_to(bouncer_coro, main_coro);
+  }
+}
+
+static void
+test_switch()
+{
+  static const unsigned n = 200000;
+  main_coro = coroutine_new();
+  coroutine_initialize_main(main_coro);
+  bouncer_coro = coroutine_new();
+  bounces = 0;
+  coroutine_start(main_coro, bouncer_coro, &bouncer, (void*)0);
+
+  libport::utime_t start = libport::utime();
+  for (unsigned i = 0; i < n; ++i)
+    coroutine_switch_to(main_coro, bouncer_coro);
+  libport::utime_t elapsed = libport::utime() - start;
+
+  BOOST_CHECK_EQUAL(bounces, n + 1);
+  // Each iteration switches there and back.
+  BOOST_TEST_MESSAGE(SCHED_CORO_BACKEND << ": "
+                     << ns_per(elapsed, 2 * n) << "ns per switch");
+  coroutine_free(bouncer_coro);
+}
+
+/*------------.
+| Job start.  |
+`------------*/
+
+static void
+nothing(TestJob&)
+{}
+
+static void
+test_start()
+{
+  static const unsigned n = 2000;
+  sched::Scheduler s(&test_time);
+  sched::jobs_type jobs;
+  for (unsigned i = 0; i < n; ++i)
+    jobs.push_back(new TestJob(s, &nothing));
+
+  libport::utime_t start = libport::utime();
+  run_jobs(s, jobs);
+  libport::utime_t elapsed = libport::utime() - start;
+
+  foreach (const sched::rJob& j, jobs)
+    BOOST_CHECK(j->terminated());
+  BOOST_TEST_MESSAGE(SCHED_CORO_BACKEND << ": "
+                     << ns_per(elapsed, n) << "ns per job start");
+}
+
+/*------------------.
+| Scheduler round.  |
+`------------------*/
+
+static const unsigned n_yields = 2000;
+
+static void
+yielding(TestJob& job)
+{
+  for (unsigned i = 0; i < n_yields; ++i)
+    job.yield();
+}
+
+static void
+test_rounds()
+{
+  static const unsigned n_jobs = 10;
+  sched::Scheduler s(&test_time);
+  sched::jobs_type jobs;
+  for (unsigned i = 0; i < n_jobs; ++i)
+    jobs.push_back(new TestJob(s, &yielding));
+
+  unsigned cycle = s.cycle_get();
+  libport::utime_t start = libport::utime();
+  run_jobs(s, jobs);
+  libport::utime_t elapsed = libport::utime() - start;
+  unsigned rounds = s.cycle_get() - cycle;
+
+  BOOST_CHECK_GE(rounds, n_yields);
+  BOOST_TEST_MESSAGE(SCHED_CORO_BACKEND << ": "
+                     << ns_per(elapsed, rounds) << "ns per round of "
+                     << n_jobs << " jobs");
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched coroutine switch benchmark");
+  suite->add(BOOST_TEST_CASE(test_switch));
+  suite->add(BOOST_TEST_CASE(test_start));
+  suite->add(BOOST_TEST_CASE(test_rounds));
+  return suite;
+}
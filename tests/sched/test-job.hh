@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef TESTS_SCHED_TEST_JOB_HH
+# define TESTS_SCHED_TEST_JOB_HH
+
+# include <libport/bind.hh>
+# include <libport/foreach.hh>
+# include <libport/semaphore.hh>
+# include <libport/utime.hh>
+
+# include <sched/job.hh>
+# include <sched/scheduler.hh>
+# include <sched/tag.hh>
+# include <tests/libport/test.hh>
+
+/// A job running a function, never frozen.
+class TestJob: public sched::Job
+{
+public:
+  typedef boost::function1<void, TestJob&> body_type;
+
+  TestJob(sched::Scheduler& s, const body_type& body)
+    : sched::Job(s)
+    , body_(body)
+    , resumed_(0)
+  {}
+
+  virtual bool frozen() const
+  {
+    return false;
+  }
+
+  virtual size_t has_tag(const sched::Tag&, size_t) const
+  {
+    return 0;
+  }
+
+  virtual sched::prio_type prio_get() const
+  {
+    return sched::UPRIO_DEFAULT;
+  }
+
+  /// Number of times the job was resumed by the scheduler.
+  unsigned resumed() const
+  {
+    return resumed_;
+  }
+
+protected:
+  virtual void work()
+  {
+    body_(*this);
+  }
+
+  virtual void scheduling_error(const std::string& msg)
+  {
+    BOOST_ERROR(msg);
+  }
+
+  virtual void hook_resumed() const
+  {
+    ++resumed_;
+  }
+
+private:
+  body_type body_;
+  mutable unsigned resumed_;
+};
+
+inline libport::utime_t
+test_time()
+{
+  return libport::utime();
+}
+
+inline void
+test_post(libport::Semaphore* sem)
+{
+  ++*sem;
+}
+
+/// Start \a jobs, and run \a s until they are all done, sleeping
+/// until the deadline or a remote wake up.
+inline void
+run_jobs(sched::Scheduler& s, const sched::jobs_type& jobs)
+{
+  libport::Semaphore sem;
+  s.remote_wakeup_hook_set(boost::bind(&test_post, &sem));
+  foreach (const sched::rJob& j, jobs)
+    j->start_job();
+  while (true)
+  {
+    libport::utime_t deadline = s.work();
+    bool done = true;
+    foreach (const sched::rJob& j, jobs)
+      done &= j->terminated();
+    if (done)
+      break;
+    if (deadline != sched::SCHED_IMMEDIATE)
+      sem.uget(std::max(deadline - libport::utime(), libport::utime_t(1)));
+  }
+  s.remote_wakeup_hook_set(0);
+  // Release the terminated jobs.
+  s.work();
+}
+
+#endif // !TESTS_SCHED_TEST_JOB_HH
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2011, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <libport/thread-pool.hh>
+#include <libport/unistd.h>
+
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+# include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+// Threads of a pool must not outlive it.
+static libport::ThreadPool& pool = *new libport::ThreadPool(2);
+
+static int slow_square(int i)
+{
+  usleep(200000);
+  return i * i;
+}
+
+static int slow_fail()
+{
+  usleep(100000);
+  throw std::runtime_error("slow_fail");
+}
+
+static int result;
+static bool caught;
+
+static void offloading(TestJob& job)
+{
+  result = job.offload(pool, boost::bind(&slow_square, 7));
+  try
+  {
+    job.offload(pool, &slow_fail);
+  }
+  catch (const std::runtime_error& e)
+  {
+    caught = true;
+  }
+}
+
+static unsigned yields;
+
+static void yielding(TestJob& job)
+{
+  for (yields = 0; yields < 20; ++yields)
+    job.yield();
+}
+
+static void test_offload()
+{
+  sched::Scheduler s(&test_time);
+  result = 0;
+  caught = false;
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &offloading));
+  jobs.push_back(new TestJob(s, &yielding));
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(result, 49);
+  BOOST_CHECK(caught);
+  BOOST_CHECK_EQUAL(yields, 20u);
+  // The waiting job did not keep the scheduler busy: a round for each
+  // yield, and a few for the offloaded tasks.
+  BOOST_CHECK_LT(s.cycle_get(), 30u);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched::Job thread pool test suite");
+  suite->add(BOOST_TEST_CASE(test_offload));
+  return suite;
+}
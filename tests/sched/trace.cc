@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <sstream>
+
+#include <libport/trace.hh>
+
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+#include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+static size_t
+count(const std::string& s, const std::string& what)
+{
+  size_t res = 0;
+  for (size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1))
+    ++res;
+  return res;
+}
+
+static void
+yielding(TestJob& job, unsigned n)
+{
+  for (unsigned i = 0; i < n; ++i)
+  {
+    LIBPORT_TRACE_SCOPE("work");
+    job.yield();
+  }
+}
+
+/// The context of the events of \a job.
+static std::string
+context(const sched::rJob& job)
+{
+  std::ostringstream o;
+  o << "\"args\":{\"context\":\"" << job.get() << "\"}";
+  return o.str();
+}
+
+static void
+test_slices()
+{
+  sched::Scheduler s(&test_time);
+  sched::rJob j1 = new TestJob(s, boost::bind(&yielding, _1, 2));
+  sched::rJob j2 = new TestJob(s, boost::bind(&yielding, _1, 4));
+  sched::jobs_type jobs;
+  jobs.push_back(j1);
+  jobs.push_back(j2);
+
+  libport::trace_clear();
+  libport::trace_enable();
+  run_jobs(s, jobs);
+  libport::trace_enable(false);
+
+  std::ostringstream o;
+  libport::trace_dump(o);
+  std::string dump = o.str();
+  BOOST_TEST_MESSAGE(dump);
+  BOOST_CHECK_GE(count(dump, "\"scheduler round\""), 5u);
+  // A slice per yield, and the last one, with the probes of the jobs
+  // within.
+  BOOST_CHECK_EQUAL(count(dump, "\"job\""), 3u + 5);
+  BOOST_CHECK_EQUAL(count(dump, "\"work\""), 2u + 4);
+  BOOST_CHECK_EQUAL(count(dump, context(j1)), 3u + 2);
+  BOOST_CHECK_EQUAL(count(dump, context(j2)), 5u + 4);
+  libport::trace_clear();
+}
+
+static void
+test_disabled()
+{
+  sched::Scheduler s(&test_time);
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, boost::bind(&yielding, _1, 3)));
+  libport::trace_clear();
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(libport::trace_size(), 0u);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched tracing");
+  suite->add(BOOST_TEST_CASE(test_slices));
+  suite->add(BOOST_TEST_CASE(test_disabled));
+  return suite;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2012, Gostai S.A.S.
+ *
+ * This software is provided "as is" without warranty of any kind,
+ * either expressed or implied, including but not limited to the
+ * implied warranties of fitness for a particular purpose.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include <vector>
+
+#include <libport/thread.hh>
+#include <libport/unistd.h>
+
+#include <sched/channel.hh>
+#include <sched/wait-queue.hh>
+#include <tests/sched/test-job.hh>
+
+// Do not test coroutine with valgrind if it is not enabled.
+# include <libport/instrument.hh>
+INSTRUMENTFLAGS(--mode=none);
+
+using libport::test_suite;
+
+static sched::WaitQueue queue;
+static unsigned woken;
+
+static void waiter(TestJob& job)
+{
+  queue.wait(job);
+  ++woken;
+}
+
+static void notifier(TestJob& job)
+{
+  for (unsigned i = 0; i < 3; ++i)
+  {
+    for (unsigned j = 0; j < 10; ++j)
+      job.yield();
+    BOOST_CHECK_EQUAL(woken, i);
+    BOOST_CHECK(queue.notify_one());
+  }
+}
+
+static void test_wait_queue()
+{
+  sched::Scheduler s(&test_time);
+  woken = 0;
+  sched::jobs_type jobs;
+  for (unsigned i = 0; i < 3; ++i)
+    jobs.push_back(new TestJob(s, &waiter));
+  jobs.push_back(new TestJob(s, &notifier));
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(woken, 3u);
+  BOOST_CHECK(queue.empty());
+}
+
+static sched::Event event;
+
+static void event_waiter(TestJob& job)
+{
+  event.wait(job);
+  ++woken;
+}
+
+static void event_setter(TestJob& job)
+{
+  job.yield();
+  BOOST_CHECK_EQUAL(woken, 0u);
+  event.set();
+}
+
+static void test_event()
+{
+  sched::Scheduler s(&test_time);
+  woken = 0;
+  sched::jobs_type jobs;
+  for (unsigned i = 0; i < 3; ++i)
+    jobs.push_back(new TestJob(s, &event_waiter));
+  jobs.push_back(new TestJob(s, &event_setter));
+  run_jobs(s, jobs);
+  BOOST_CHECK_EQUAL(woken, 3u);
+  BOOST_CHECK(event.is_set());
+  event.reset();
+}
+
+static sched::rJob victim;
+
+static void killer(TestJob& job)
+{
+  job.yield();
+  BOOST_CHECK_EQUAL(queue.size(), 1u);
+  victim->terminate_asap();
+  job.yield();
+  BOOST_CHECK(queue.empty());
+  BOOST_CHECK(!queue.notify_one());
+}
+
+// Exceptions thrown into a waiting job remove it from the queue.
+static void test_exception()
+{
+  sched::Scheduler s(&test_time);
+  woken = 0;
+  victim = new TestJob(s, &waiter);
+  sched::jobs_type jobs;
+  jobs.push_back(victim);
+  jobs.push_back(new TestJob(s, &killer));
+  run_jobs(s, jobs);
+  victim = 0;
+  BOOST_CHECK_EQUAL(woken, 0u);
+}
+
+static void waker(TestJob& job)
+{
+  job.yield();
+  BOOST_CHECK_EQUAL(queue.size(), 2u);
+  victim->wake_up();
+  job.yield();
+  // The victim left the queue: the notification goes to the other.
+  BOOST_CHECK_EQUAL(queue.size(), 1u);
+  BOOST_CHECK(queue.notify_one());
+  job.yield();
+  BOOST_CHECK(queue.empty());
+}
+
+// Jobs woken up by someone else leave the queue.
+static void test_wake_up()
+{
+  sched::Scheduler s(&test_time);
+  woken = 0;
+  victim = new TestJob(s, &waiter);
+  sched::jobs_type jobs;
+  jobs.push_back(victim);
+  jobs.push_back(new TestJob(s, &waiter));
+  jobs.push_back(new TestJob(s, &waker));
+  run_jobs(s, jobs);
+  victim = 0;
+  BOOST_CHECK_EQUAL(woken, 2u);
+}
+
+static sched::Channel<int> channel(4);
+static const int count = 1000;
+static long sum;
+
+static void thread_sender()
+{
+  for (int i = 0; i < count; ++i)
+    channel.send(i);
+}
+
+static void job_sender(TestJob& job)
+{
+  for (int i = 0; i < count; ++i)
+    channel.send(job, i);
+}
+
+static void receiver(TestJob& job)
+{
+  for (int i = 0; i < 2 * count; ++i)
+    sum += channel.receive(job);
+}
+
+static void test_channel()
+{
+  sched::Scheduler s(&test_time);
+  sum = 0;
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &receiver));
+  jobs.push_back(new TestJob(s, &job_sender));
+  pthread_t t =
+    libport::startThread(boost::function0<void>(&thread_sender));
+  run_jobs(s, jobs);
+  pthread_join(t, 0);
+  BOOST_CHECK_EQUAL(sum, long(count) * (count - 1));
+  int v;
+  BOOST_CHECK(!channel.try_receive(v));
+  BOOST_CHECK(channel.try_send(1));
+  BOOST_CHECK(channel.try_receive(v));
+  BOOST_CHECK_EQUAL(v, 1);
+}
+
+static sched::Channel<int> full(1);
+static std::vector<int> received;
+
+static void full_thread_sender()
+{
+  full.send(2);
+}
+
+static void full_job_sender(TestJob& job)
+{
+  full.send(job, 1);
+}
+
+static void full_receiver(TestJob& job)
+{
+  // The job sender is waiting, let the thread wait behind it.
+  job.yield();
+  pthread_t t =
+    libport::startThread(boost::function0<void>(&full_thread_sender));
+  usleep(100000);
+  for (int i = 0; i < 3; ++i)
+    received.push_back(full.receive(job));
+  pthread_join(t, 0);
+}
+
+// Waiting jobs and threads send in turn.
+static void test_channel_order()
+{
+  sched::Scheduler s(&test_time);
+  BOOST_CHECK(full.try_send(0));
+  sched::jobs_type jobs;
+  jobs.push_back(new TestJob(s, &full_job_sender));
+  jobs.push_back(new TestJob(s, &full_receiver));
+  run_jobs(s, jobs);
+  BOOST_REQUIRE_EQUAL(received.size(), 3u);
+  for (int i = 0; i < 3; ++i)
+    BOOST_CHECK_EQUAL(received[i], i);
+}
+
+test_suite*
+init_test_suite()
+{
+  test_suite* suite = BOOST_TEST_SUITE("sched::WaitQueue test suite");
+  suite->add(BOOST_TEST_CASE(test_wait_queue));
+  suite->add(BOOST_TEST_CASE(test_event));
+  suite->add(BOOST_TEST_CASE(test_exception));
+  suite->add(BOOST_TEST_CASE(test_wake_up));
+  suite->add(BOOST_TEST_CASE(test_channel));
+  suite->add(BOOST_TEST_CASE(test_channel_order));
+  return suite;
+}